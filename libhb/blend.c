@@ -8,8 +8,17 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/blend.h"
 #include "libavutil/bswap.h"
 
+// Overlay columns with a non zero alpha of an overlay row,
+// start == end for fully transparent rows
+typedef struct
+{
+    int start;
+    int end;
+} blend_extent_t;
+
 struct hb_blend_private_s
 {
     int hshift;
@@ -18,8 +27,16 @@ struct hb_blend_private_s
 
     unsigned chroma_coeffs[2][4];
 
+    BlendFunctions functions;
+
+    // One extent per row of each overlay, kept until the overlays change
+    blend_extent_t *extents;
+    int             extents_size;
+    int             extents_count;
+
     void (*blend)(const struct hb_blend_private_s *pv, hb_buffer_t *dst,
-                  const hb_buffer_t *src, const int shift);
+                  const hb_buffer_t *src, const blend_extent_t *extents,
+                  const int shift);
 };
 
 static int hb_blend_init(hb_blend_object_t *object,
@@ -45,7 +62,165 @@ hb_blend_object_t hb_blend =
     .close = hb_blend_close,
 };
 
-static void blend_subsample_8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend_row_8(uint8_t *dst, const uint8_t *src,
+                        const uint8_t *a, int alpha_step,
+                        int count, int bias)
+{
+    for (int x = 0; x < count; x++)
+    {
+        const unsigned alpha = a[x * alpha_step];
+        dst[x] = (dst[x] * (255 - alpha) + src[x] * alpha + bias) / 255;
+    }
+}
+
+static void blend_row_uv_8(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                           const uint8_t *a, int alpha_step,
+                           int count, int bias)
+{
+    for (int x = 0; x < count; x++)
+    {
+        const unsigned alpha = a[x * alpha_step];
+        dst[2 * x]     = (dst[2 * x]     * (255 - alpha) + src_u[x] * alpha + bias) / 255;
+        dst[2 * x + 1] = (dst[2 * x + 1] * (255 - alpha) + src_v[x] * alpha + bias) / 255;
+    }
+}
+
+static void blend_row_16(uint16_t *dst, const uint8_t *src,
+                         const uint8_t *a, int alpha_step,
+                         int count, int shift, int src_shift, int bias)
+{
+    const unsigned max = (256 << shift) - 1;
+
+    for (int x = 0; x < count; x++)
+    {
+        const unsigned alpha = a[x * alpha_step] << shift;
+        dst[x] = ((uint32_t)dst[x] * (max - alpha) +
+                  ((uint32_t)src[x] << src_shift) * alpha + bias) / max;
+    }
+}
+
+static void blend_row_uv_16(uint16_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                            const uint8_t *a, int alpha_step,
+                            int count, int shift, int src_shift, int bias)
+{
+    const unsigned max = (256 << shift) - 1;
+
+    for (int x = 0; x < count; x++)
+    {
+        const unsigned alpha = a[x * alpha_step] << shift;
+        dst[2 * x]     = ((uint32_t)dst[2 * x] * (max - alpha) +
+                          ((uint32_t)src_u[x] << src_shift) * alpha + bias) / max;
+        dst[2 * x + 1] = ((uint32_t)dst[2 * x + 1] * (max - alpha) +
+                          ((uint32_t)src_v[x] << src_shift) * alpha + bias) / max;
+    }
+}
+
+static void blend_subsample_row_8(uint8_t *dst_u, uint8_t *dst_v, int dst_step,
+                                  const uint8_t *const u[2], const uint8_t *const v[2],
+                                  const uint8_t *const a[2], int rows, int count,
+                                  const unsigned coeffs[2][4])
+{
+    unsigned res_u, res_v, alpha;
+    unsigned accu_a, accu_b, accu_c, coeff;
+
+    for (int x = 0; x < count; x++)
+    {
+        accu_a = accu_b = accu_c = 0;
+        for (int yz = 0; yz < rows; yz++)
+        {
+            for (int xz = 0; xz < 2; xz++)
+            {
+                coeff = coeffs[0][xz] * coeffs[1][yz];
+                alpha = a[yz][2 * x + xz];
+                res_u = (dst_u[x * dst_step] * (255 - alpha) + u[yz][2 * x + xz] * alpha + 127) / 255;
+                res_v = (dst_v[x * dst_step] * (255 - alpha) + v[yz][2 * x + xz] * alpha + 127) / 255;
+
+                accu_a += coeff * res_u;
+                accu_b += coeff * res_v;
+                accu_c += coeff;
+            }
+        }
+        dst_u[x * dst_step] = (accu_a + (accu_c >> 1)) / accu_c;
+        dst_v[x * dst_step] = (accu_b + (accu_c >> 1)) / accu_c;
+    }
+}
+
+static void blend_subsample_row_16(uint16_t *dst_u, uint16_t *dst_v, int dst_step,
+                                   const uint8_t *const u[2], const uint8_t *const v[2],
+                                   const uint8_t *const a[2], int rows, int count,
+                                   const unsigned coeffs[2][4],
+                                   int shift, int src_shift)
+{
+    const unsigned max_val = (256 << shift) - 1;
+    unsigned res_u, res_v, alpha;
+    unsigned accu_a, accu_b, accu_c, coeff;
+
+    for (int x = 0; x < count; x++)
+    {
+        accu_a = accu_b = accu_c = 0;
+        for (int yz = 0; yz < rows; yz++)
+        {
+            for (int xz = 0; xz < 2; xz++)
+            {
+                coeff = coeffs[0][xz] * coeffs[1][yz];
+                alpha = (uint32_t)a[yz][2 * x + xz] << shift;
+                res_u = ((uint32_t)dst_u[x * dst_step] * (max_val - alpha) +
+                         ((uint32_t)u[yz][2 * x + xz] << src_shift) * alpha + (max_val >> 1)) / max_val;
+                res_v = ((uint32_t)dst_v[x * dst_step] * (max_val - alpha) +
+                         ((uint32_t)v[yz][2 * x + xz] << src_shift) * alpha + (max_val >> 1)) / max_val;
+
+                accu_a += coeff * res_u;
+                accu_b += coeff * res_v;
+                accu_c += coeff;
+            }
+        }
+        dst_u[x * dst_step] = (accu_a + (accu_c >> 1)) / accu_c;
+        dst_v[x * dst_step] = (accu_b + (accu_c >> 1)) / accu_c;
+    }
+}
+
+// Find the chroma samples of the chroma line at oy that overlap a non
+// transparent overlay pixel. Samples elsewhere are left unchanged by the
+// blend, so only [*xx_start, *xx_end) needs to be processed. The samples
+// in [*in_start, *in_end) are entirely inside the overlay and can be
+// blended by blend_subsample_row, *in_start is -1 if there are none.
+static int blend_chroma_span(const hb_blend_private_t *pv, const blend_extent_t *extents,
+                             int x0, int x0c, int oy, int width, int height,
+                             int *xx_start, int *xx_end, int *in_start, int *in_end)
+{
+    const int wstep = 1 << pv->wshift;
+    const int hstep = 1 << pv->hshift;
+    int start = width, end = 0;
+
+    for (int oyz = MAX(oy, 0); oyz < oy + hstep && oyz < height; oyz++)
+    {
+        start = MIN(start, extents[oyz].start);
+        end   = MAX(end, extents[oyz].end);
+    }
+    if (start >= end)
+    {
+        return 0;
+    }
+
+    *xx_start = MAX(x0c, (x0 + start) & ~(wstep - 1));
+    *xx_end   = x0 + end;
+
+    *in_start = -1;
+    if (pv->wshift == 1 && pv->hshift <= 1 && oy >= 0 && oy + hstep <= height)
+    {
+        const int first = MAX(*xx_start, (x0 + wstep - 1) & ~(wstep - 1));
+        const int last  = MIN(*xx_end, ((x0 + width - wstep) & ~(wstep - 1)) + wstep);
+        if (first < last)
+        {
+            *in_start = first;
+            *in_end   = first + (((last - first + wstep - 1) >> pv->wshift) << pv->wshift);
+        }
+    }
+    return 1;
+}
+
+static void blend_subsample_8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                                   const blend_extent_t *extents, const int shift)
 {
     int x0, y0, x0c, y0c;
     int ox, oy;
@@ -76,7 +251,9 @@ static void blend_subsample_8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst
     // This is setting the pointer outside of the array range if y0c < y0
     oy = y0c - y0;
 
-    unsigned is_chroma_line, res_u, res_v, alpha;
+    const int wstep = 1 << pv->wshift;
+    int xx_start, xx_end, in_start, in_end;
+    unsigned res_u, res_v, alpha;
     unsigned accu_a, accu_b, accu_c, coeff;
     for (int yy = y0c; oy < height; oy = ++yy - y0)
     {
@@ -89,57 +266,85 @@ static void blend_subsample_8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst
         v_in = src->plane[2].data + oy * src->plane[2].stride;
         a_in = src->plane[3].data + oy * src->plane[3].stride;
 
-        ox = x0c - x0;
-        is_chroma_line = yy == (yy & ~((1 << pv->hshift) - 1));
-        for (int xx = x0c; ox < width; ox = ++xx - x0)
+        if (oy >= 0)
         {
-            if (ox >= 0 && oy >= 0)
+            // Blend luma
+            const int start = MAX(x0c - x0, extents[oy].start);
+            const int end   = MIN(width, extents[oy].end);
+            if (start < end)
             {
-                alpha = a_in[ox] << shift;
-                y_out[xx] = ((uint32_t)y_out[xx] * (max_val - alpha) + ((uint32_t)y_in[ox] << shift) * alpha + (max_val >> 1)) / max_val;
+                pv->functions.blend_row_16(y_out + x0 + start, y_in + start, a_in + start, 1,
+                                           end - start, shift, shift, max_val >> 1);
             }
+        }
 
-            if (is_chroma_line && xx == (xx & ~((1 << pv->wshift) - 1)))
+        if (yy != (yy & ~((1 << pv->hshift) - 1)) ||
+            blend_chroma_span(pv, extents, x0, x0c, oy, width, height,
+                              &xx_start, &xx_end, &in_start, &in_end) == 0)
+        {
+            continue;
+        }
+
+        for (int xx = xx_start; xx < xx_end; xx += wstep)
+        {
+            ox = xx - x0;
+            if (xx == in_start)
+            {
+                const int stride_u = src->plane[1].stride;
+                const int stride_v = src->plane[2].stride;
+                const int stride_a = src->plane[3].stride;
+                const uint8_t *const u[2] = {u_in + ox, pv->hshift ? u_in + stride_u + ox : NULL};
+                const uint8_t *const v[2] = {v_in + ox, pv->hshift ? v_in + stride_v + ox : NULL};
+                const uint8_t *const a[2] = {a_in + ox, pv->hshift ? a_in + stride_a + ox : NULL};
+
+                pv->functions.blend_subsample_row_16(u_out + (xx >> pv->wshift),
+                                                     v_out + (xx >> pv->wshift), 1,
+                                                     u, v, a, 1 << pv->hshift,
+                                                     (in_end - in_start) >> pv->wshift,
+                                                     pv->chroma_coeffs, shift, shift);
+                xx = in_end - wstep;
+                continue;
+            }
+
+            // Perform chromaloc-aware subsampling and blending
+            accu_a = accu_b = accu_c = 0;
+            for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
             {
-                // Perform chromaloc-aware subsampling and blending
-                accu_a = accu_b = accu_c = 0;
-                for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
+                for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
                 {
-                    for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
+                    // Weight of the current chroma sample
+                    coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
+                    res_u = u_out[xx >> pv->wshift];
+                    res_v = v_out[xx >> pv->wshift];
+
+                    // Chroma sampled area overlap with bitmap
+                    if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
                     {
-                        // Weight of the current chroma sample
-                        coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
-                        res_u = u_out[xx >> pv->wshift];
-                        res_v = v_out[xx >> pv->wshift];
-
-                        // Chroma sampled area overlap with bitmap
-                        if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
-                        {
-                            alpha = (uint32_t)a_in[oxz + yz * src->plane[3].stride] << shift;
-                            res_u *= (max_val - alpha);
-                            res_u = (res_u + ((uint32_t)(u_in + yz * src->plane[1].stride)[oxz] << shift) * alpha + (max_val>>1)) / max_val;
-
-                            res_v *= (max_val - alpha);
-                            res_v = (res_v + ((uint32_t)(v_in + yz * src->plane[2].stride)[oxz] << shift) * alpha + (max_val>>1)) / max_val;
-                        }
-
-                        // Accumulate
-                        accu_a += coeff * res_u;
-                        accu_b += coeff * res_v;
-                        accu_c += coeff;
+                        alpha = (uint32_t)a_in[oxz + yz * src->plane[3].stride] << shift;
+                        res_u *= (max_val - alpha);
+                        res_u = (res_u + ((uint32_t)(u_in + yz * src->plane[1].stride)[oxz] << shift) * alpha + (max_val>>1)) / max_val;
+
+                        res_v *= (max_val - alpha);
+                        res_v = (res_v + ((uint32_t)(v_in + yz * src->plane[2].stride)[oxz] << shift) * alpha + (max_val>>1)) / max_val;
                     }
-                }
-                if (accu_c)
-                {
-                    u_out[xx >> pv->wshift] = (accu_a + (accu_c >> 1)) / accu_c;
-                    v_out[xx >> pv->wshift] = (accu_b + (accu_c >> 1)) / accu_c;
+
+                    // Accumulate
+                    accu_a += coeff * res_u;
+                    accu_b += coeff * res_v;
+                    accu_c += coeff;
                 }
             }
+            if (accu_c)
+            {
+                u_out[xx >> pv->wshift] = (accu_a + (accu_c >> 1)) / accu_c;
+                v_out[xx >> pv->wshift] = (accu_b + (accu_c >> 1)) / accu_c;
+            }
         }
     }
 }
 
-static void blend_subsample_8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend_subsample_8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                                     const blend_extent_t *extents, const int shift)
 {
     int x0, y0, x0c, y0c;
     int ox, oy;
@@ -170,7 +375,9 @@ static void blend_subsample_8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *d
     // This is setting the pointer outside of the array range if y0c < y0
     oy = y0c - y0;
 
-    unsigned is_chroma_line, res_u, res_v, alpha;
+    const int wstep = 1 << pv->wshift;
+    int xx_start, xx_end, in_start, in_end;
+    unsigned res_u, res_v, alpha;
     unsigned accu_a, accu_b, accu_c, coeff;
     for (int yy = y0c; oy < height; oy = ++yy - y0)
     {
@@ -183,57 +390,85 @@ static void blend_subsample_8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *d
         v_in = src->plane[2].data + oy * src->plane[2].stride;
         a_in = src->plane[3].data + oy * src->plane[3].stride;
 
-        ox = x0c - x0;
-        is_chroma_line = yy == (yy & ~((1 << pv->hshift) - 1));
-        for (int xx = x0c; ox < width; ox = ++xx - x0)
+        if (oy >= 0)
         {
-            if (ox >= 0 && oy >= 0)
+            // Blend luma
+            const int start = MAX(x0c - x0, extents[oy].start);
+            const int end   = MIN(width, extents[oy].end);
+            if (start < end)
             {
-                alpha = a_in[ox] << shift;
-                y_out[xx] = ((uint32_t)y_out[xx] * (max_val - alpha) + av_bswap16(y_in[ox]) * alpha + (max_val >> 1)) / max_val;
+                pv->functions.blend_row_16(y_out + x0 + start, y_in + start, a_in + start, 1,
+                                           end - start, shift, 8, max_val >> 1);
             }
+        }
 
-            if (is_chroma_line && xx == (xx & ~((1 << pv->wshift) - 1)))
+        if (yy != (yy & ~((1 << pv->hshift) - 1)) ||
+            blend_chroma_span(pv, extents, x0, x0c, oy, width, height,
+                              &xx_start, &xx_end, &in_start, &in_end) == 0)
+        {
+            continue;
+        }
+
+        for (int xx = xx_start; xx < xx_end; xx += wstep)
+        {
+            ox = xx - x0;
+            if (xx == in_start)
             {
-                // Perform chromaloc-aware subsampling and blending
-                accu_a = accu_b = accu_c = 0;
-                for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
+                const int stride_u = src->plane[1].stride;
+                const int stride_v = src->plane[2].stride;
+                const int stride_a = src->plane[3].stride;
+                const uint8_t *const u[2] = {u_in + ox, pv->hshift ? u_in + stride_u + ox : NULL};
+                const uint8_t *const v[2] = {v_in + ox, pv->hshift ? v_in + stride_v + ox : NULL};
+                const uint8_t *const a[2] = {a_in + ox, pv->hshift ? a_in + stride_a + ox : NULL};
+
+                pv->functions.blend_subsample_row_16(u_out + (xx >> pv->wshift) * 2,
+                                                     v_out + (xx >> pv->wshift) * 2 + 1, 2,
+                                                     u, v, a, 1 << pv->hshift,
+                                                     (in_end - in_start) >> pv->wshift,
+                                                     pv->chroma_coeffs, shift, 8);
+                xx = in_end - wstep;
+                continue;
+            }
+
+            // Perform chromaloc-aware subsampling and blending
+            accu_a = accu_b = accu_c = 0;
+            for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
+            {
+                for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
                 {
-                    for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
+                    // Weight of the current chroma sample
+                    coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
+                    res_u = u_out[(xx >> pv->wshift) * 2 + 0];
+                    res_v = v_out[(xx >> pv->wshift) * 2 + 1];
+
+                    // Chroma sampled area overlap with bitmap
+                    if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
                     {
-                        // Weight of the current chroma sample
-                        coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
-                        res_u = u_out[(xx >> pv->wshift) * 2 + 0];
-                        res_v = v_out[(xx >> pv->wshift) * 2 + 1];
-
-                        // Chroma sampled area overlap with bitmap
-                        if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
-                        {
-                            alpha = a_in[oxz + yz*src->plane[3].stride] << shift;
-                            res_u *= (max_val - alpha);
-                            res_u = (res_u + av_bswap16((u_in + yz * src->plane[1].stride)[oxz]) * alpha + (max_val>>1)) / max_val;
-
-                            res_v *= (max_val - alpha);
-                            res_v = (res_v + av_bswap16((v_in + yz * src->plane[2].stride)[oxz]) * alpha + (max_val>>1)) / max_val;
-                        }
-
-                        // Accumulate
-                        accu_a += coeff * res_u;
-                        accu_b += coeff * res_v;
-                        accu_c += coeff;
+                        alpha = a_in[oxz + yz*src->plane[3].stride] << shift;
+                        res_u *= (max_val - alpha);
+                        res_u = (res_u + av_bswap16((u_in + yz * src->plane[1].stride)[oxz]) * alpha + (max_val>>1)) / max_val;
+
+                        res_v *= (max_val - alpha);
+                        res_v = (res_v + av_bswap16((v_in + yz * src->plane[2].stride)[oxz]) * alpha + (max_val>>1)) / max_val;
                     }
+
+                    // Accumulate
+                    accu_a += coeff * res_u;
+                    accu_b += coeff * res_v;
+                    accu_c += coeff;
                 }
-                if (accu_c)
-                {
-                    u_out[(xx >> pv->wshift) * 2 + 0] = (accu_a + (accu_c >> 1)) / accu_c;
-                    v_out[(xx >> pv->wshift) * 2 + 1] = (accu_b + (accu_c >> 1)) / accu_c;
-                }
+            }
+            if (accu_c)
+            {
+                u_out[(xx >> pv->wshift) * 2 + 0] = (accu_a + (accu_c >> 1)) / accu_c;
+                v_out[(xx >> pv->wshift) * 2 + 1] = (accu_b + (accu_c >> 1)) / accu_c;
             }
         }
     }
 }
 
-static void blend_subsample_8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend_subsample_8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                                  const blend_extent_t *extents, const int shift)
 {
     int x0, y0, x0c, y0c;
     int ox, oy;
@@ -265,7 +500,9 @@ static void blend_subsample_8on8(const hb_blend_private_t *pv, hb_buffer_t *dst,
     // This is setting the pointer outside of the array range if y0c < y0
     oy = y0c - y0;
 
-    unsigned is_chroma_line, res_u, res_v, alpha;
+    const int wstep = 1 << pv->wshift;
+    int xx_start, xx_end, in_start, in_end;
+    unsigned res_u, res_v, alpha;
     unsigned accu_a, accu_b, accu_c, coeff;
     for (int yy = y0c; oy < height; oy = ++yy - y0)
     {
@@ -278,56 +515,85 @@ static void blend_subsample_8on8(const hb_blend_private_t *pv, hb_buffer_t *dst,
         v_in = src->plane[2].data + oy * src->plane[2].stride;
         a_in = src->plane[3].data + oy * src->plane[3].stride;
 
-        ox = x0c - x0;
-        is_chroma_line = yy == (yy & ~((1 << pv->hshift) - 1));
-        for (int xx = x0c; ox < width; ox = ++xx - x0)
+        if (oy >= 0)
+        {
+            // Blend luma
+            const int start = MAX(x0c - x0, extents[oy].start);
+            const int end   = MIN(width, extents[oy].end);
+            if (start < end)
+            {
+                pv->functions.blend_row_8(y_out + x0 + start, y_in + start, a_in + start, 1,
+                                          end - start, 127);
+            }
+        }
+
+        if (yy != (yy & ~((1 << pv->hshift) - 1)) ||
+            blend_chroma_span(pv, extents, x0, x0c, oy, width, height,
+                              &xx_start, &xx_end, &in_start, &in_end) == 0)
+        {
+            continue;
+        }
+
+        for (int xx = xx_start; xx < xx_end; xx += wstep)
         {
-            if (ox >= 0 && oy >= 0)
+            ox = xx - x0;
+            if (xx == in_start)
             {
-                y_out[xx] = (y_out[xx] * (255 - a_in[ox]) + y_in[ox] * a_in[ox] + 127) / 255;
+                const int stride_u = src->plane[1].stride;
+                const int stride_v = src->plane[2].stride;
+                const int stride_a = src->plane[3].stride;
+                const uint8_t *const u[2] = {u_in + ox, pv->hshift ? u_in + stride_u + ox : NULL};
+                const uint8_t *const v[2] = {v_in + ox, pv->hshift ? v_in + stride_v + ox : NULL};
+                const uint8_t *const a[2] = {a_in + ox, pv->hshift ? a_in + stride_a + ox : NULL};
+
+                pv->functions.blend_subsample_row_8(u_out + (xx >> pv->wshift),
+                                                    v_out + (xx >> pv->wshift), 1,
+                                                    u, v, a, 1 << pv->hshift,
+                                                    (in_end - in_start) >> pv->wshift,
+                                                    pv->chroma_coeffs);
+                xx = in_end - wstep;
+                continue;
             }
 
-            if (is_chroma_line && xx == (xx & ~((1 << pv->wshift) - 1)))
+            // Perform chromaloc-aware subsampling and blending
+            accu_a = accu_b = accu_c = 0;
+            for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
             {
-                // Perform chromaloc-aware subsampling and blending
-                accu_a = accu_b = accu_c = 0;
-                for (int yz = 0, oyz = oy; yz < (1 << pv->hshift) && oy + yz < height; yz++, oyz++)
+                for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
                 {
-                    for (int xz = 0, oxz = ox; xz < (1 << pv->wshift) && ox + xz < width; xz++, oxz++)
+                    // Weight of the current chroma sample
+                    coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
+                    res_u = u_out[xx >> pv->wshift];
+                    res_v = v_out[xx >> pv->wshift];
+
+                    // Chroma sampled area overlap with bitmap
+                    if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
                     {
-                        // Weight of the current chroma sample
-                        coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
-                        res_u = u_out[xx >> pv->wshift];
-                        res_v = v_out[xx >> pv->wshift];
-
-                        // Chroma sampled area overlap with bitmap
-                        if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
-                        {
-                            alpha = a_in[oxz + yz*src->plane[3].stride];
-                            res_u *= (255 - alpha);
-                            res_u = (res_u + (u_in + yz * src->plane[1].stride)[oxz] * alpha + 127) / 255;
-
-                            res_v *= (255 - alpha);
-                            res_v = (res_v + (v_in + yz * src->plane[2].stride)[oxz] * alpha + 127) / 255;
-                        }
-
-                        // Accumulate
-                        accu_a += coeff * res_u;
-                        accu_b += coeff * res_v;
-                        accu_c += coeff;
+                        alpha = a_in[oxz + yz*src->plane[3].stride];
+                        res_u *= (255 - alpha);
+                        res_u = (res_u + (u_in + yz * src->plane[1].stride)[oxz] * alpha + 127) / 255;
+
+                        res_v *= (255 - alpha);
+                        res_v = (res_v + (v_in + yz * src->plane[2].stride)[oxz] * alpha + 127) / 255;
                     }
+
+                    // Accumulate
+                    accu_a += coeff * res_u;
+                    accu_b += coeff * res_v;
+                    accu_c += coeff;
                 }
-                if (accu_c)
-                {
-                    u_out[xx >> pv->wshift] = (accu_a + (accu_c >> 1)) / accu_c;
-                    v_out[xx >> pv->wshift] = (accu_b + (accu_c >> 1)) / accu_c;
-                }
+            }
+            if (accu_c)
+            {
+                u_out[xx >> pv->wshift] = (accu_a + (accu_c >> 1)) / accu_c;
+                v_out[xx >> pv->wshift] = (accu_b + (accu_c >> 1)) / accu_c;
             }
         }
     }
 }
 
-static void blend_subsample_8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend_subsample_8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                                    const blend_extent_t *extents, const int shift)
 {
     int x0, y0, x0c, y0c;
     int ox, oy;
@@ -359,7 +625,9 @@ static void blend_subsample_8onbi8(const hb_blend_private_t *pv, hb_buffer_t *ds
     // This is setting the pointer outside of the array range if y0c < y0
     oy = y0c - y0;
 
-    unsigned is_chroma_line, res_u, res_v, alpha;
+    const int wstep = 1 << pv->wshift;
+    int xx_start, xx_end, in_start, in_end;
+    unsigned res_u, res_v, alpha;
     unsigned accu_a, accu_b, accu_c, coeff;
     for (int yy = y0c; oy < height; oy = ++yy - y0)
     {
@@ -372,64 +640,93 @@ static void blend_subsample_8onbi8(const hb_blend_private_t *pv, hb_buffer_t *ds
         v_in = src->plane[2].data + oy * src->plane[2].stride;
         a_in = src->plane[3].data + oy * src->plane[3].stride;
 
-        ox = x0c - x0;
-        is_chroma_line = yy == (yy & ~((1 << pv->hshift) - 1));
-        for (int xx = x0c; ox < width; ox = ++xx - x0)
+        if (oy >= 0)
         {
-            if (ox >= 0 && oy >= 0)
+            // Blend luma
+            const int start = MAX(x0c - x0, extents[oy].start);
+            const int end   = MIN(width, extents[oy].end);
+            if (start < end)
             {
-                y_out[xx] = (y_out[xx] * (255 - a_in[ox]) + y_in[ox] * a_in[ox] + 127) / 255;
+                pv->functions.blend_row_8(y_out + x0 + start, y_in + start, a_in + start, 1,
+                                          end - start, 127);
             }
+        }
+
+        if (yy != (yy & ~((1 << pv->hshift) - 1)) ||
+            blend_chroma_span(pv, extents, x0, x0c, oy, width, height,
+                              &xx_start, &xx_end, &in_start, &in_end) == 0)
+        {
+            continue;
+        }
 
-            if (is_chroma_line && xx == (xx & ~((1 << pv->wshift) - 1)))
+        for (int xx = xx_start; xx < xx_end; xx += wstep)
+        {
+            ox = xx - x0;
+            if (xx == in_start)
             {
-                // Perform chromaloc-aware subsampling and blending
-                accu_a = accu_b = accu_c = 0;
-                for (int yz = 0, oyz = oy; yz < (1 << pv->hshift); yz++, oyz++)
+                const int stride_u = src->plane[1].stride;
+                const int stride_v = src->plane[2].stride;
+                const int stride_a = src->plane[3].stride;
+                const uint8_t *const u[2] = {u_in + ox, pv->hshift ? u_in + stride_u + ox : NULL};
+                const uint8_t *const v[2] = {v_in + ox, pv->hshift ? v_in + stride_v + ox : NULL};
+                const uint8_t *const a[2] = {a_in + ox, pv->hshift ? a_in + stride_a + ox : NULL};
+
+                pv->functions.blend_subsample_row_8(u_out + (xx >> pv->wshift) * 2,
+                                                    v_out + (xx >> pv->wshift) * 2 + 1, 2,
+                                                    u, v, a, 1 << pv->hshift,
+                                                    (in_end - in_start) >> pv->wshift,
+                                                    pv->chroma_coeffs);
+                xx = in_end - wstep;
+                continue;
+            }
+
+            // Perform chromaloc-aware subsampling and blending
+            accu_a = accu_b = accu_c = 0;
+            for (int yz = 0, oyz = oy; yz < (1 << pv->hshift); yz++, oyz++)
+            {
+                for (int xz = 0, oxz = ox; xz < (1 << pv->wshift); xz++, oxz++)
                 {
-                    for (int xz = 0, oxz = ox; xz < (1 << pv->wshift); xz++, oxz++)
+                    // Weight of the current chroma sample
+                    coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
+                    res_u = u_out[(xx >> pv->wshift) * 2 + 0];
+                    res_v = v_out[(xx >> pv->wshift) * 2 + 1];
+
+                    // Chroma sampled area overlap with bitmap
+                    if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
                     {
-                        // Weight of the current chroma sample
-                        coeff = pv->chroma_coeffs[0][xz] * pv->chroma_coeffs[1][yz];
-                        res_u = u_out[(xx >> pv->wshift) * 2 + 0];
-                        res_v = v_out[(xx >> pv->wshift) * 2 + 1];
-
-                        // Chroma sampled area overlap with bitmap
-                        if (oxz >= 0 && oyz >= 0 && ox + xz < width && oy + yz < height)
-                        {
-                            alpha = a_in[oxz + yz*src->plane[3].stride];
-                            res_u *= (255 - alpha);
-                            res_u = (res_u + (u_in + yz * src->plane[1].stride)[oxz] * alpha + 127) / 255;
-
-                            res_v *= (255 - alpha);
-                            res_v = (res_v + (v_in + yz * src->plane[2].stride)[oxz] * alpha + 127) / 255;
-                        }
-
-                        // Accumulate
-                        accu_a += coeff*res_u;
-                        accu_b += coeff*res_v;
-                        accu_c += coeff;
+                        alpha = a_in[oxz + yz*src->plane[3].stride];
+                        res_u *= (255 - alpha);
+                        res_u = (res_u + (u_in + yz * src->plane[1].stride)[oxz] * alpha + 127) / 255;
+
+                        res_v *= (255 - alpha);
+                        res_v = (res_v + (v_in + yz * src->plane[2].stride)[oxz] * alpha + 127) / 255;
                     }
+
+                    // Accumulate
+                    accu_a += coeff*res_u;
+                    accu_b += coeff*res_v;
+                    accu_c += coeff;
                 }
-                if (accu_c)
-                {
-                    u_out[(xx >> pv->wshift) * 2 + 0] = (accu_a + (accu_c >> 1)) / accu_c;
-                    v_out[(xx >> pv->wshift) * 2 + 1] = (accu_b + (accu_c >> 1)) / accu_c;
-                }
+            }
+            if (accu_c)
+            {
+                u_out[(xx >> pv->wshift) * 2 + 0] = (accu_a + (accu_c >> 1)) / accu_c;
+                v_out[(xx >> pv->wshift) * 2 + 1] = (accu_b + (accu_c >> 1)) / accu_c;
             }
         }
     }
 }
 
 // blends src YUVA4**P buffer into dst
-static void blend8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                       const blend_extent_t *extents, const int shift)
 {
     int ww, hh;
     int x0, y0;
     uint8_t *y_in, *y_out;
     uint8_t *u_in, *u_out;
     uint8_t *v_in, *v_out;
-    uint8_t *a_in, alpha;
+    uint8_t *a_in;
 
     const int left = src->f.x;
     const int top  = src->f.y;
@@ -457,17 +754,19 @@ static void blend8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_b
     // Blend luma
     for (int yy = y0; yy < hh; yy++)
     {
+        const int start = MAX(x0, extents[yy].start);
+        const int end   = MIN(ww, extents[yy].end);
+        if (start >= end)
+        {
+            continue;
+        }
         y_in  = src->plane[0].data + yy * src->plane[0].stride;
         y_out = dst->plane[0].data + (yy + top) * dst->plane[0].stride;
         a_in = src->plane[3].data + yy * src->plane[3].stride;
-        for (int xx = x0; xx < ww; xx++)
-        {
-            alpha = a_in[xx];
-            // Merge the luminance and alpha with the picture
-            y_out[left + xx] =
-                ((uint16_t)y_out[left + xx] * (255 - alpha) +
-                     (uint16_t)y_in[xx] * alpha) / 255;
-        }
+
+        // Merge the luminance and alpha with the picture
+        pv->functions.blend_row_8(y_out + left + start, y_in + start, a_in + start, 1,
+                                  end - start, 0);
     }
 
     // Blend U & V
@@ -485,34 +784,36 @@ static void blend8on8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_b
 
     for (int yy = y0 >> hshift; yy < hh >> hshift; yy++)
     {
+        const blend_extent_t *extent = &extents[yy << hshift];
+        const int start = MAX(x0 >> wshift, extent->start >> wshift);
+        const int end   = MIN(ww >> wshift, (extent->end + (1 << wshift) - 1) >> wshift);
+        if (start >= end)
+        {
+            continue;
+        }
         u_in = src->plane[1].data + yy * src->plane[1].stride;
         u_out = dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride;
         v_in = src->plane[2].data + yy * src->plane[2].stride;
         v_out = dst->plane[2].data + (yy + (top >> hshift)) * dst->plane[2].stride;
         a_in = src->plane[3].data + (yy << hshift) * src->plane[3].stride;
 
-        for (int xx = x0 >> wshift; xx < ww >> wshift; xx++)
-        {
-            alpha = a_in[xx << wshift];
-
-            // Blend U and alpha
-            u_out[(left >> wshift) + xx] =
-                ((uint16_t)u_out[(left >> wshift) + xx] * (255 - alpha) +
-                 (uint16_t)u_in[xx] * alpha) / 255;
+        // Blend U and alpha
+        pv->functions.blend_row_8(u_out + (left >> wshift) + start, u_in + start,
+                                  a_in + (start << wshift), 1 << wshift,
+                                  end - start, 0);
 
-            // Blend V and alpha
-            v_out[(left >> wshift) + xx] =
-                ((uint16_t)v_out[(left >> wshift) + xx] * (255 - alpha) +
-                 (uint16_t)v_in[xx] * alpha) / 255;
-        }
+        // Blend V and alpha
+        pv->functions.blend_row_8(v_out + (left >> wshift) + start, v_in + start,
+                                  a_in + (start << wshift), 1 << wshift,
+                                  end - start, 0);
     }
 }
 
-static void blend8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                        const blend_extent_t *extents, const int shift)
 {
     int ww, hh;
     int x0, y0;
-    int max;
 
     uint8_t *y_in;
     uint8_t *u_in;
@@ -522,7 +823,6 @@ static void blend8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_
     uint16_t *y_out;
     uint16_t *u_out;
     uint16_t *v_out;
-    uint16_t alpha;
 
     const int left = src->f.x;
     const int top  = src->f.y;
@@ -548,22 +848,22 @@ static void blend8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_
         hh = dst->f.height - top + y0;
     }
 
-    max = (256 << shift) -1;
-
     // Blend luma
     for (int yy = y0; yy < hh; yy++)
     {
+        const int start = MAX(x0, extents[yy].start);
+        const int end   = MIN(ww, extents[yy].end);
+        if (start >= end)
+        {
+            continue;
+        }
         y_in  = src->plane[0].data + yy * src->plane[0].stride;
         y_out = (uint16_t*)(dst->plane[0].data + (yy + top) * dst->plane[0].stride);
         a_in = src->plane[3].data + yy * src->plane[3].stride;
-        for (int xx = x0; xx < ww; xx++)
-        {
-            alpha = a_in[xx] << shift;
-            // Merge the luminance and alpha with the picture
-            y_out[left + xx] =
-                ((uint32_t)y_out[left + xx] * (max - alpha) +
-                    ((uint32_t)y_in[xx] << shift) * alpha) / max;
-        }
+
+        // Merge the luminance and alpha with the picture
+        pv->functions.blend_row_16(y_out + left + start, y_in + start, a_in + start, 1,
+                                   end - start, shift, shift, 0);
     }
 
     // Blend U & V
@@ -580,37 +880,40 @@ static void blend8on1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_
 
     for (int yy = y0 >> hshift; yy < hh >> hshift; yy++)
     {
+        const blend_extent_t *extent = &extents[yy << hshift];
+        const int start = MAX(x0 >> wshift, extent->start >> wshift);
+        const int end   = MIN(ww >> wshift, (extent->end + (1 << wshift) - 1) >> wshift);
+        if (start >= end)
+        {
+            continue;
+        }
         u_in = src->plane[1].data + yy * src->plane[1].stride;
         u_out = (uint16_t*)(dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride);
         v_in = src->plane[2].data + yy * src->plane[2].stride;
         v_out = (uint16_t*)(dst->plane[2].data + (yy + (top >> hshift)) * dst->plane[2].stride);
         a_in = src->plane[3].data + (yy << hshift) * src->plane[3].stride;
 
-        for (int xx = x0 >> wshift; xx < ww >> wshift; xx++)
-        {
-            alpha = a_in[xx << wshift] << shift;
-
-            // Blend U and alpha
-            u_out[(left >> wshift) + xx] =
-                ((uint32_t)u_out[(left >> wshift) + xx] * (max - alpha) +
-                 ((uint32_t)u_in[xx] << shift) * alpha) / max;
+        // Blend U and alpha
+        pv->functions.blend_row_16(u_out + (left >> wshift) + start, u_in + start,
+                                   a_in + (start << wshift), 1 << wshift,
+                                   end - start, shift, shift, 0);
 
-            // Blend V and alpha
-            v_out[(left >> wshift) + xx] =
-                ((uint32_t)v_out[(left >> wshift) + xx] * (max - alpha) +
-                 ((uint32_t)v_in[xx] << shift) * alpha) / max;
-        }
+        // Blend V and alpha
+        pv->functions.blend_row_16(v_out + (left >> wshift) + start, v_in + start,
+                                   a_in + (start << wshift), 1 << wshift,
+                                   end - start, shift, shift, 0);
     }
 }
 
-static void blend8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                         const blend_extent_t *extents, const int shift)
 {
     int ww, hh;
     int x0, y0;
     uint8_t *y_in, *y_out;
-    uint8_t *u_in, *u_out;
-    uint8_t *v_in, *v_out;
-    uint8_t *a_in, alpha;
+    uint8_t *u_in, *v_in;
+    uint8_t *uv_out;
+    uint8_t *a_in;
 
     const int left = src->f.x;
     const int top  = src->f.y;
@@ -639,17 +942,19 @@ static void blend8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb
     // Blend luma
     for (int yy = y0; yy < hh; yy++)
     {
+        const int start = MAX(x0, extents[yy].start);
+        const int end   = MIN(ww, extents[yy].end);
+        if (start >= end)
+        {
+            continue;
+        }
         y_in  = src->plane[0].data + yy * src->plane[0].stride;
         y_out = dst->plane[0].data + (yy + top) * dst->plane[0].stride;
         a_in = src->plane[3].data + yy * src->plane[3].stride;
-        for (int xx = x0; xx < ww; xx++)
-        {
-            alpha = a_in[xx];
-            // Merge the luminance and alpha with the picture
-            y_out[left + xx] =
-                ((uint16_t)y_out[left + xx] * (255 - alpha) +
-                    (uint16_t)y_in[xx] * alpha) / 255;
-        }
+
+        // Merge the luminance and alpha with the picture
+        pv->functions.blend_row_8(y_out + left + start, y_in + start, a_in + start, 1,
+                                  end - start, 0);
     }
 
     // Blend U & V
@@ -667,34 +972,31 @@ static void blend8onbi8(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb
 
     for (int yy = y0 >> hshift; yy < hh >> hshift; yy++)
     {
+        const blend_extent_t *extent = &extents[yy << hshift];
+        const int start = MAX(x0 >> wshift, extent->start >> wshift);
+        const int end   = MIN(ww >> wshift, (extent->end + (1 << wshift) - 1) >> wshift);
+        if (start >= end)
+        {
+            continue;
+        }
         u_in = src->plane[1].data + yy * src->plane[1].stride;
-        u_out = dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride;
         v_in = src->plane[2].data + yy * src->plane[2].stride;
-        v_out = dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride;
+        uv_out = dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride;
         a_in = src->plane[3].data + (yy << hshift) * src->plane[3].stride;
 
-        for (int xx = x0 >> wshift; xx < ww >> wshift; xx++)
-        {
-            alpha = a_in[xx << wshift];
-
-            // Blend U and alpha
-            u_out[((left >> wshift) + xx) * 2] =
-                ((uint16_t)u_out[((left >> wshift) + xx) * 2] * (255 - alpha) +
-                 (uint16_t)u_in[xx] * alpha) / 255;
-
-            // Blend V and alpha
-            v_out[((left >> wshift) + xx) * 2 +1] =
-                ((uint16_t)v_out[((left >> wshift) + xx) * 2 + 1] * (255 - alpha) +
-                 (uint16_t)v_in[xx] * alpha) / 255;
-        }
+        // Blend U, V and alpha
+        pv->functions.blend_row_uv_8(uv_out + ((left >> wshift) + start) * 2,
+                                     u_in + start, v_in + start,
+                                     a_in + (start << wshift), 1 << wshift,
+                                     end - start, 0);
     }
 }
 
-static void blend8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src, const int shift)
+static void blend8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const hb_buffer_t *src,
+                          const blend_extent_t *extents, const int shift)
 {
     int ww, hh;
     int x0, y0;
-    int max;
 
     uint8_t *y_in;
     uint8_t *u_in;
@@ -702,9 +1004,7 @@ static void blend8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const h
     uint8_t *a_in;
 
     uint16_t *y_out;
-    uint16_t *u_out;
-    uint16_t *v_out;
-    uint16_t alpha;
+    uint16_t *uv_out;
 
     const int left = src->f.x;
     const int top  = src->f.y;
@@ -730,22 +1030,23 @@ static void blend8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const h
         hh = dst->f.height - top + y0;
     }
 
-    max = (256 << shift) -1;
-
     // Blend luma
     for (int yy = y0; yy < hh; yy++)
     {
+        const int start = MAX(x0, extents[yy].start);
+        const int end   = MIN(ww, extents[yy].end);
+        if (start >= end)
+        {
+            continue;
+        }
         y_in  = src->plane[0].data + yy * src->plane[0].stride;
         y_out = (uint16_t*)(dst->plane[0].data + (yy + top) * dst->plane[0].stride);
         a_in  = src->plane[3].data + yy * src->plane[3].stride;
-        for (int xx = x0; xx < ww; xx++)
-        {
-            alpha = a_in[xx] << shift;
-            // Merge the luminance and alpha with the picture
-            y_out[left + xx] =
-                ((uint32_t)y_out[left + xx] * (max - alpha) +
-                    ((uint32_t)av_bswap16(y_in[xx])) * alpha) / max;
-        }
+
+        // Merge the luminance and alpha with the picture,
+        // av_bswap16() of the 8 bit overlay is a shift by 8
+        pv->functions.blend_row_16(y_out + left + start, y_in + start, a_in + start, 1,
+                                   end - start, shift, 8, 0);
     }
 
     // Blend U & V
@@ -762,26 +1063,23 @@ static void blend8onbi1x(const hb_blend_private_t *pv, hb_buffer_t *dst, const h
 
     for (int yy = y0 >> hshift; yy < hh >> hshift; yy++)
     {
+        const blend_extent_t *extent = &extents[yy << hshift];
+        const int start = MAX(x0 >> wshift, extent->start >> wshift);
+        const int end   = MIN(ww >> wshift, (extent->end + (1 << wshift) - 1) >> wshift);
+        if (start >= end)
+        {
+            continue;
+        }
         u_in = src->plane[1].data + yy * src->plane[1].stride;
-        u_out = (uint16_t *)(dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride);
         v_in = src->plane[2].data + yy * src->plane[2].stride;
-        v_out = (uint16_t *)(dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride);
+        uv_out = (uint16_t *)(dst->plane[1].data + (yy + (top >> hshift)) * dst->plane[1].stride);
         a_in = src->plane[3].data + (yy << hshift) * src->plane[3].stride;
 
-        for (int xx = x0 >> wshift; xx < ww >> wshift; xx++)
-        {
-            alpha = a_in[xx << wshift] << shift;
-
-            // Blend averge U and alpha
-            u_out[((left >> wshift) + xx) * 2] =
-                ((uint32_t)u_out[((left >> wshift) + xx) * 2] * (max - alpha) +
-                 ((uint32_t)av_bswap16(u_in[xx])) * alpha) / max;
-
-            // Blend V and alpha
-            v_out[((left >> wshift) + xx) * 2 + 1] =
-                ((uint32_t)v_out[((left >> wshift) + xx) * 2 + 1] * (max - alpha) +
-                 ((uint32_t)av_bswap16(v_in[xx])) * alpha) / max;
-        }
+        // Blend U, V and alpha
+        pv->functions.blend_row_uv_16(uv_out + ((left >> wshift) + start) * 2,
+                                      u_in + start, v_in + start,
+                                      a_in + (start << wshift), 1 << wshift,
+                                      end - start, shift, 8, 0);
     }
 }
 
@@ -812,6 +1110,16 @@ static int hb_blend_init(hb_blend_object_t *object,
                                             in_pix_fmt,
                                             in_chroma_location);
 
+    pv->functions.blend_row_8            = blend_row_8;
+    pv->functions.blend_row_uv_8         = blend_row_uv_8;
+    pv->functions.blend_row_16           = blend_row_16;
+    pv->functions.blend_row_uv_16        = blend_row_uv_16;
+    pv->functions.blend_subsample_row_8  = blend_subsample_row_8;
+    pv->functions.blend_subsample_row_16 = blend_subsample_row_16;
+#if defined(ARCH_X86)
+    blend_init_x86(&pv->functions);
+#endif
+
     const int needs_subsample = in_desc->log2_chroma_w != overlay_desc->log2_chroma_w ||
                                 in_desc->log2_chroma_h != overlay_desc->log2_chroma_h;
     const int planes_count = av_pix_fmt_count_planes(in_pix_fmt);
@@ -841,6 +1149,47 @@ static int hb_blend_init(hb_blend_object_t *object,
             }
     }
 
+    return 0;
+}
+
+// Most subtitle overlays are largely transparent, find the non
+// transparent span of each row so that the rest can be skipped
+static int compute_extents(hb_blend_private_t *pv, hb_buffer_list_t *overlays, int rows)
+{
+    if (rows > pv->extents_size)
+    {
+        blend_extent_t *extents = realloc(pv->extents, rows * sizeof(blend_extent_t));
+        if (extents == NULL)
+        {
+            hb_error("blend: realloc failed");
+            pv->extents_count = 0;
+            return -1;
+        }
+        pv->extents      = extents;
+        pv->extents_size = rows;
+    }
+
+    blend_extent_t *extent = pv->extents;
+    for (hb_buffer_t *overlay = hb_buffer_list_head(overlays); overlay; overlay = overlay->next)
+    {
+        const int width = overlay->f.width;
+        for (int yy = 0; yy < overlay->f.height; yy++, extent++)
+        {
+            const uint8_t *a = overlay->plane[3].data + yy * overlay->plane[3].stride;
+            int start = 0, end = width;
+            while (start < end && a[start] == 0)
+            {
+                start++;
+            }
+            while (end > start && a[end - 1] == 0)
+            {
+                end--;
+            }
+            extent->start = start;
+            extent->end   = end;
+        }
+    }
+    pv->extents_count = rows;
 
     return 0;
 }
@@ -855,18 +1204,34 @@ static hb_buffer_t * hb_blend_work(hb_blend_object_t *object,
 
     if (hb_buffer_list_count(overlays) == 0)
     {
+        pv->extents_count = 0;
         return out;
     }
 
+    int rows = 0;
+    for (hb_buffer_t *overlay = hb_buffer_list_head(overlays); overlay; overlay = overlay->next)
+    {
+        rows += overlay->f.height;
+    }
+    if (changed || rows != pv->extents_count)
+    {
+        if (compute_extents(pv, overlays, rows))
+        {
+            return out;
+        }
+    }
+
     if (hb_buffer_is_writable(in) == 0)
     {
         out = hb_buffer_dup(in);
         hb_buffer_close(&in);
     }
 
+    const blend_extent_t *extents = pv->extents;
     for (hb_buffer_t *overlay = hb_buffer_list_head(overlays); overlay; overlay = overlay->next)
     {
-        pv->blend(pv, out, overlay, pv->depth - 8);
+        pv->blend(pv, out, overlay, extents, pv->depth - 8);
+        extents += overlay->f.height;
     }
 
     return out;
@@ -881,5 +1246,6 @@ static void hb_blend_close(hb_blend_object_t *object)
         return;
     }
 
+    free(pv->extents);
     free(pv);
 }
@@ -0,0 +1,747 @@
+/* blend_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/blend.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// All the intermediate values are computed exactly: the 8 bit blends
+// fit in 16 bit lanes and are divided by 255 with (x + 1 + (x >> 8)) >> 8,
+// which is exact below 65535. The deeper blends are computed in 32 bit
+// lanes and divided with a multiply by a magic number, which is exact
+// for every 32 bit numerator. The results are identical to the scalar code.
+//
+// The last partial block of a row is blended in a zero padded copy.
+
+typedef struct
+{
+    uint32_t magic;
+    int      shift;
+} divisor_t;
+
+// Unsigned division by the constant d >= 2, see Hacker's Delight 10-8
+static divisor_t divisor_init(uint32_t d)
+{
+    divisor_t div;
+    int l = 0;
+    while (((uint64_t)1 << l) < d)
+    {
+        l++;
+    }
+    div.magic = (((((uint64_t)1 << l) - d) << 32) / d) + 1;
+    div.shift = l - 1;
+    return div;
+}
+
+static av_always_inline __m128i div_epu32_sse2(__m128i n, __m128i magic, __m128i shift)
+{
+    const __m128i even = _mm_srli_epi64(_mm_mul_epu32(n, magic), 32);
+    const __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(n, 32), magic);
+    const __m128i t    = _mm_or_si128(even, _mm_and_si128(odd, _mm_set_epi32(-1, 0, -1, 0)));
+    return _mm_srl_epi32(_mm_add_epi32(t, _mm_srli_epi32(_mm_sub_epi32(n, t), 1)), shift);
+}
+
+static av_always_inline __m128i div255_epu16_sse2(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)),
+                                        _mm_srli_epi16(x, 8)), 8);
+}
+
+// Pack the low 16 bits of the epi32 lanes of a and b
+static av_always_inline __m128i pack_lo16_sse2(__m128i a, __m128i b)
+{
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                           _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+static av_always_inline __m128i loadl(const void *src)
+{
+    return _mm_loadl_epi64((const __m128i *)src);
+}
+
+static av_always_inline __m128i loadu(const void *src)
+{
+    return _mm_loadu_si128((const __m128i *)src);
+}
+
+static av_always_inline __m128i even_epu8_sse2(__m128i a, __m128i b)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    return _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+}
+
+// 16 alpha values a[x * step] for steps of 1 or 2
+static av_always_inline __m128i load_alpha16_sse2(const uint8_t *a, int step)
+{
+    return step == 1 ? loadu(a) : even_epu8_sse2(loadu(a), loadu(a + 16));
+}
+
+// 8 alpha values a[x * step] in the low half
+static av_always_inline __m128i load_alpha8_sse2(const uint8_t *a, int step)
+{
+    return step == 1 ? loadl(a) : even_epu8_sse2(loadu(a), _mm_setzero_si128());
+}
+
+// (d * (255 - alpha) + s * alpha + bias) / 255 in epi16 lanes
+static av_always_inline __m128i blend_epu16_8_sse2(__m128i d, __m128i s, __m128i alpha, __m128i bias)
+{
+    const __m128i n = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), alpha)),
+                                    _mm_add_epi16(_mm_mullo_epi16(s, alpha), bias));
+    return div255_epu16_sse2(n);
+}
+
+// Blend 16 bytes of dst with the 16 bytes of src and alpha
+static av_always_inline __m128i blend_epu8_sse2(__m128i d, __m128i s, __m128i alpha, __m128i bias)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo   = blend_epu16_8_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero),
+                                            _mm_unpacklo_epi8(alpha, zero), bias);
+    const __m128i hi   = blend_epu16_8_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero),
+                                            _mm_unpackhi_epi8(alpha, zero), bias);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// (d * (max - alpha) + s * alpha + bias) / max of 8 epu16 lanes,
+// s and alpha are already scaled
+static av_always_inline __m128i blend_epu16_16_sse2(__m128i d, __m128i s, __m128i alpha,
+                                                    __m128i max, __m128i bias,
+                                                    __m128i magic, __m128i shift)
+{
+    const __m128i ma     = _mm_sub_epi16(max, alpha);
+    const __m128i dlo    = _mm_mullo_epi16(d, ma);
+    const __m128i dhi    = _mm_mulhi_epu16(d, ma);
+    const __m128i slo    = _mm_mullo_epi16(s, alpha);
+    const __m128i shi    = _mm_mulhi_epu16(s, alpha);
+    const __m128i n0     = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(dlo, dhi),
+                                                       _mm_unpacklo_epi16(slo, shi)), bias);
+    const __m128i n1     = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(dlo, dhi),
+                                                       _mm_unpackhi_epi16(slo, shi)), bias);
+    return pack_lo16_sse2(div_epu32_sse2(n0, magic, shift), div_epu32_sse2(n1, magic, shift));
+}
+
+static av_always_inline void blend_block_8_sse2(uint8_t *dst, const uint8_t *src,
+                                                const uint8_t *a, int alpha_step, __m128i bias)
+{
+    const __m128i d = blend_epu8_sse2(loadu(dst), loadu(src), load_alpha16_sse2(a, alpha_step), bias);
+    _mm_storeu_si128((__m128i *)dst, d);
+}
+
+static void blend_row_8_sse2(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *a, int alpha_step,
+                             int count, int bias)
+{
+    const __m128i vbias = _mm_set1_epi16(bias);
+    int x = 0;
+
+    for (; x + 16 <= count; x += 16)
+    {
+        blend_block_8_sse2(dst + x, src + x, a + x * alpha_step, alpha_step, vbias);
+    }
+    if (x < count)
+    {
+        uint8_t d[16] = {0}, s[16] = {0}, al[32] = {0};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            d[i] = dst[x + i];
+            s[i] = src[x + i];
+            al[i * alpha_step] = a[(x + i) * alpha_step];
+        }
+        blend_block_8_sse2(d, s, al, alpha_step, vbias);
+        memcpy(dst + x, d, n);
+    }
+}
+
+static av_always_inline void blend_block_uv_8_sse2(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                                   const uint8_t *a, int alpha_step, __m128i bias)
+{
+    const __m128i s     = _mm_unpacklo_epi8(loadl(src_u), loadl(src_v));
+    const __m128i alpha = load_alpha8_sse2(a, alpha_step);
+    const __m128i d     = blend_epu8_sse2(loadu(dst), s, _mm_unpacklo_epi8(alpha, alpha), bias);
+    _mm_storeu_si128((__m128i *)dst, d);
+}
+
+static void blend_row_uv_8_sse2(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                const uint8_t *a, int alpha_step,
+                                int count, int bias)
+{
+    const __m128i vbias = _mm_set1_epi16(bias);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        blend_block_uv_8_sse2(dst + 2 * x, src_u + x, src_v + x, a + x * alpha_step, alpha_step, vbias);
+    }
+    if (x < count)
+    {
+        uint8_t d[16] = {0}, su[8] = {0}, sv[8] = {0}, al[16] = {0};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            d[2 * i]     = dst[2 * (x + i)];
+            d[2 * i + 1] = dst[2 * (x + i) + 1];
+            su[i] = src_u[x + i];
+            sv[i] = src_v[x + i];
+            al[i * alpha_step] = a[(x + i) * alpha_step];
+        }
+        blend_block_uv_8_sse2(d, su, sv, al, alpha_step, vbias);
+        memcpy(dst + 2 * x, d, 2 * n);
+    }
+}
+
+typedef struct
+{
+    __m128i max;
+    __m128i bias;
+    __m128i magic;
+    __m128i div_shift;
+    __m128i shift;
+    __m128i src_shift;
+} blend16_t;
+
+static blend16_t blend16_init(int shift, int src_shift, int bias)
+{
+    const unsigned  max = (256 << shift) - 1;
+    const divisor_t div = divisor_init(max);
+    blend16_t b;
+
+    b.max       = _mm_set1_epi16(max);
+    b.bias      = _mm_set1_epi32(bias);
+    b.magic     = _mm_set1_epi32(div.magic);
+    b.div_shift = _mm_cvtsi32_si128(div.shift);
+    b.shift     = _mm_cvtsi32_si128(shift);
+    b.src_shift = _mm_cvtsi32_si128(src_shift);
+    return b;
+}
+
+// Blend 8 epu16 lanes of dst with 8 bit src and alpha in epi16 lanes
+static av_always_inline __m128i blend_epu16_scale_sse2(__m128i d, __m128i s, __m128i alpha,
+                                                       const blend16_t *b)
+{
+    return blend_epu16_16_sse2(d, _mm_sll_epi16(s, b->src_shift), _mm_sll_epi16(alpha, b->shift),
+                               b->max, b->bias, b->magic, b->div_shift);
+}
+
+static av_always_inline void blend_block_16_sse2(uint16_t *dst, const uint8_t *src,
+                                                 const uint8_t *a, int alpha_step,
+                                                 const blend16_t *b)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i alpha = _mm_unpacklo_epi8(load_alpha8_sse2(a, alpha_step), zero);
+    const __m128i d     = blend_epu16_scale_sse2(loadu(dst), _mm_unpacklo_epi8(loadl(src), zero), alpha, b);
+    _mm_storeu_si128((__m128i *)dst, d);
+}
+
+static void blend_row_16_sse2(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *a, int alpha_step,
+                              int count, int shift, int src_shift, int bias)
+{
+    const blend16_t b = blend16_init(shift, src_shift, bias);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        blend_block_16_sse2(dst + x, src + x, a + x * alpha_step, alpha_step, &b);
+    }
+    if (x < count)
+    {
+        uint16_t d[8] = {0};
+        uint8_t s[8] = {0}, al[16] = {0};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            d[i] = dst[x + i];
+            s[i] = src[x + i];
+            al[i * alpha_step] = a[(x + i) * alpha_step];
+        }
+        blend_block_16_sse2(d, s, al, alpha_step, &b);
+        memcpy(dst + x, d, n * sizeof(uint16_t));
+    }
+}
+
+static av_always_inline void blend_block_uv_16_sse2(uint16_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                                    const uint8_t *a, int alpha_step,
+                                                    const blend16_t *b)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i s     = _mm_unpacklo_epi8(loadl(src_u), loadl(src_v));
+    const __m128i alpha = load_alpha8_sse2(a, alpha_step);
+    const __m128i a2    = _mm_unpacklo_epi8(alpha, alpha);
+    const __m128i d0    = blend_epu16_scale_sse2(loadu(dst), _mm_unpacklo_epi8(s, zero),
+                                                 _mm_unpacklo_epi8(a2, zero), b);
+    const __m128i d1    = blend_epu16_scale_sse2(loadu(dst + 8), _mm_unpackhi_epi8(s, zero),
+                                                 _mm_unpackhi_epi8(a2, zero), b);
+    _mm_storeu_si128((__m128i *)dst, d0);
+    _mm_storeu_si128((__m128i *)(dst + 8), d1);
+}
+
+static void blend_row_uv_16_sse2(uint16_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                 const uint8_t *a, int alpha_step,
+                                 int count, int shift, int src_shift, int bias)
+{
+    const blend16_t b = blend16_init(shift, src_shift, bias);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        blend_block_uv_16_sse2(dst + 2 * x, src_u + x, src_v + x, a + x * alpha_step, alpha_step, &b);
+    }
+    if (x < count)
+    {
+        uint16_t d[16] = {0};
+        uint8_t su[8] = {0}, sv[8] = {0}, al[16] = {0};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            d[2 * i]     = dst[2 * (x + i)];
+            d[2 * i + 1] = dst[2 * (x + i) + 1];
+            su[i] = src_u[x + i];
+            sv[i] = src_v[x + i];
+            al[i * alpha_step] = a[(x + i) * alpha_step];
+        }
+        blend_block_uv_16_sse2(d, su, sv, al, alpha_step, &b);
+        memcpy(dst + 2 * x, d, 2 * n * sizeof(uint16_t));
+    }
+}
+
+// The chroma subsampling blends 8 samples at a time, the even and odd
+// overlay columns of a sample are split into the low and high byte of
+// epi16 lanes.
+
+static unsigned coeffs_sum(const unsigned coeffs[2][4], int rows)
+{
+    unsigned sum = 0;
+    for (int yz = 0; yz < rows; yz++)
+    {
+        sum += (coeffs[0][0] + coeffs[0][1]) * coeffs[1][yz];
+    }
+    return sum;
+}
+
+static av_always_inline void blend_subsample_block_8_sse2(uint8_t *dst_u, uint8_t *dst_v, int dst_step,
+                                                          const uint8_t *const u[2],
+                                                          const uint8_t *const v[2],
+                                                          const uint8_t *const a[2], int rows,
+                                                          const unsigned coeffs[2][4],
+                                                          __m128i half, __m128i magic, __m128i shift)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i bias = _mm_set1_epi16(127);
+    __m128i du, dv;
+
+    if (dst_step == 1)
+    {
+        du = _mm_unpacklo_epi8(loadl(dst_u), zero);
+        dv = _mm_unpacklo_epi8(loadl(dst_v), zero);
+    }
+    else
+    {
+        const __m128i uv = loadu(dst_u);
+        du = _mm_and_si128(uv, mask);
+        dv = _mm_srli_epi16(uv, 8);
+    }
+
+    __m128i accu_u0 = half, accu_u1 = half;
+    __m128i accu_v0 = half, accu_v1 = half;
+    for (int yz = 0; yz < rows; yz++)
+    {
+        const __m128i coeff = _mm_set1_epi32((coeffs[0][1] * coeffs[1][yz]) << 16 |
+                                             (coeffs[0][0] * coeffs[1][yz]));
+        const __m128i al = loadu(a[yz]);
+        const __m128i su = loadu(u[yz]);
+        const __m128i sv = loadu(v[yz]);
+        const __m128i a0 = _mm_and_si128(al, mask), a1 = _mm_srli_epi16(al, 8);
+
+        const __m128i ru0 = blend_epu16_8_sse2(du, _mm_and_si128(su, mask), a0, bias);
+        const __m128i ru1 = blend_epu16_8_sse2(du, _mm_srli_epi16(su, 8), a1, bias);
+        const __m128i rv0 = blend_epu16_8_sse2(dv, _mm_and_si128(sv, mask), a0, bias);
+        const __m128i rv1 = blend_epu16_8_sse2(dv, _mm_srli_epi16(sv, 8), a1, bias);
+
+        accu_u0 = _mm_add_epi32(accu_u0, _mm_madd_epi16(_mm_unpacklo_epi16(ru0, ru1), coeff));
+        accu_u1 = _mm_add_epi32(accu_u1, _mm_madd_epi16(_mm_unpackhi_epi16(ru0, ru1), coeff));
+        accu_v0 = _mm_add_epi32(accu_v0, _mm_madd_epi16(_mm_unpacklo_epi16(rv0, rv1), coeff));
+        accu_v1 = _mm_add_epi32(accu_v1, _mm_madd_epi16(_mm_unpackhi_epi16(rv0, rv1), coeff));
+    }
+
+    const __m128i qu = _mm_packs_epi32(div_epu32_sse2(accu_u0, magic, shift),
+                                       div_epu32_sse2(accu_u1, magic, shift));
+    const __m128i qv = _mm_packs_epi32(div_epu32_sse2(accu_v0, magic, shift),
+                                       div_epu32_sse2(accu_v1, magic, shift));
+    if (dst_step == 1)
+    {
+        _mm_storel_epi64((__m128i *)dst_u, _mm_packus_epi16(qu, qu));
+        _mm_storel_epi64((__m128i *)dst_v, _mm_packus_epi16(qv, qv));
+    }
+    else
+    {
+        _mm_storeu_si128((__m128i *)dst_u, _mm_or_si128(qu, _mm_slli_epi16(qv, 8)));
+    }
+}
+
+static void blend_subsample_row_8_sse2(uint8_t *dst_u, uint8_t *dst_v, int dst_step,
+                                       const uint8_t *const u[2], const uint8_t *const v[2],
+                                       const uint8_t *const a[2], int rows, int count,
+                                       const unsigned coeffs[2][4])
+{
+    const unsigned  sum   = coeffs_sum(coeffs, rows);
+    const divisor_t div   = divisor_init(sum);
+    const __m128i   half  = _mm_set1_epi32(sum >> 1);
+    const __m128i   magic = _mm_set1_epi32(div.magic);
+    const __m128i   shift = _mm_cvtsi32_si128(div.shift);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        const uint8_t *const ux[2] = {u[0] + 2 * x, rows > 1 ? u[1] + 2 * x : NULL};
+        const uint8_t *const vx[2] = {v[0] + 2 * x, rows > 1 ? v[1] + 2 * x : NULL};
+        const uint8_t *const ax[2] = {a[0] + 2 * x, rows > 1 ? a[1] + 2 * x : NULL};
+        blend_subsample_block_8_sse2(dst_u + x * dst_step, dst_v + x * dst_step, dst_step,
+                                     ux, vx, ax, rows, coeffs, half, magic, shift);
+    }
+    if (x < count)
+    {
+        uint8_t du[16] = {0}, dv[8] = {0};
+        uint8_t su[2][16] = {{0}}, sv[2][16] = {{0}}, al[2][16] = {{0}};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            du[i * dst_step] = dst_u[(x + i) * dst_step];
+            if (dst_step == 1)
+            {
+                dv[i] = dst_v[x + i];
+            }
+            else
+            {
+                du[2 * i + 1] = dst_v[(x + i) * dst_step];
+            }
+        }
+        for (int yz = 0; yz < rows; yz++)
+        {
+            memcpy(su[yz], u[yz] + 2 * x, 2 * n);
+            memcpy(sv[yz], v[yz] + 2 * x, 2 * n);
+            memcpy(al[yz], a[yz] + 2 * x, 2 * n);
+        }
+        const uint8_t *const ux[2] = {su[0], su[1]};
+        const uint8_t *const vx[2] = {sv[0], sv[1]};
+        const uint8_t *const ax[2] = {al[0], al[1]};
+        blend_subsample_block_8_sse2(du, dst_step == 1 ? dv : du + 1, dst_step,
+                                     ux, vx, ax, rows, coeffs, half, magic, shift);
+        for (int i = 0; i < n; i++)
+        {
+            dst_u[(x + i) * dst_step] = du[i * dst_step];
+            dst_v[(x + i) * dst_step] = dst_step == 1 ? dv[i] : du[2 * i + 1];
+        }
+    }
+}
+
+// Multiply the epu16 lanes of r by coeff and add them to the epi32 lanes of accu
+static av_always_inline void accumulate_epu16_sse2(__m128i *accu0, __m128i *accu1, __m128i r, __m128i coeff)
+{
+    const __m128i lo = _mm_mullo_epi16(r, coeff);
+    const __m128i hi = _mm_mulhi_epu16(r, coeff);
+    *accu0 = _mm_add_epi32(*accu0, _mm_unpacklo_epi16(lo, hi));
+    *accu1 = _mm_add_epi32(*accu1, _mm_unpackhi_epi16(lo, hi));
+}
+
+// Move the even epi16 lanes of a and b to the low and the odd ones to the high half
+static av_always_inline void deinterleave_epi16_sse2(__m128i a, __m128i b, __m128i *even, __m128i *odd)
+{
+    a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 1, 2, 0));
+    a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shufflehi_epi16(b, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+    *even = _mm_unpacklo_epi64(a, b);
+    *odd  = _mm_unpackhi_epi64(a, b);
+}
+
+static av_always_inline void blend_subsample_block_16_sse2(uint16_t *dst_u, uint16_t *dst_v, int dst_step,
+                                                           const uint8_t *const u[2],
+                                                           const uint8_t *const v[2],
+                                                           const uint8_t *const a[2], int rows,
+                                                           const unsigned coeffs[2][4],
+                                                           const blend16_t *b,
+                                                           __m128i half, __m128i magic, __m128i shift)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    __m128i du, dv;
+
+    if (dst_step == 1)
+    {
+        du = loadu(dst_u);
+        dv = loadu(dst_v);
+    }
+    else
+    {
+        deinterleave_epi16_sse2(loadu(dst_u), loadu(dst_u + 8), &du, &dv);
+    }
+
+    __m128i accu_u0 = half, accu_u1 = half;
+    __m128i accu_v0 = half, accu_v1 = half;
+    for (int yz = 0; yz < rows; yz++)
+    {
+        const __m128i c0 = _mm_set1_epi16(coeffs[0][0] * coeffs[1][yz]);
+        const __m128i c1 = _mm_set1_epi16(coeffs[0][1] * coeffs[1][yz]);
+        const __m128i al = loadu(a[yz]);
+        const __m128i su = loadu(u[yz]);
+        const __m128i sv = loadu(v[yz]);
+        const __m128i a0 = _mm_and_si128(al, mask), a1 = _mm_srli_epi16(al, 8);
+
+        accumulate_epu16_sse2(&accu_u0, &accu_u1, blend_epu16_scale_sse2(du, _mm_and_si128(su, mask), a0, b), c0);
+        accumulate_epu16_sse2(&accu_u0, &accu_u1, blend_epu16_scale_sse2(du, _mm_srli_epi16(su, 8), a1, b), c1);
+        accumulate_epu16_sse2(&accu_v0, &accu_v1, blend_epu16_scale_sse2(dv, _mm_and_si128(sv, mask), a0, b), c0);
+        accumulate_epu16_sse2(&accu_v0, &accu_v1, blend_epu16_scale_sse2(dv, _mm_srli_epi16(sv, 8), a1, b), c1);
+    }
+
+    const __m128i qu = pack_lo16_sse2(div_epu32_sse2(accu_u0, magic, shift),
+                                      div_epu32_sse2(accu_u1, magic, shift));
+    const __m128i qv = pack_lo16_sse2(div_epu32_sse2(accu_v0, magic, shift),
+                                      div_epu32_sse2(accu_v1, magic, shift));
+    if (dst_step == 1)
+    {
+        _mm_storeu_si128((__m128i *)dst_u, qu);
+        _mm_storeu_si128((__m128i *)dst_v, qv);
+    }
+    else
+    {
+        _mm_storeu_si128((__m128i *)dst_u, _mm_unpacklo_epi16(qu, qv));
+        _mm_storeu_si128((__m128i *)(dst_u + 8), _mm_unpackhi_epi16(qu, qv));
+    }
+}
+
+static void blend_subsample_row_16_sse2(uint16_t *dst_u, uint16_t *dst_v, int dst_step,
+                                        const uint8_t *const u[2], const uint8_t *const v[2],
+                                        const uint8_t *const a[2], int rows, int count,
+                                        const unsigned coeffs[2][4],
+                                        int shift, int src_shift)
+{
+    const blend16_t b     = blend16_init(shift, src_shift, ((256 << shift) - 1) >> 1);
+    const unsigned  sum   = coeffs_sum(coeffs, rows);
+    const divisor_t div   = divisor_init(sum);
+    const __m128i   half  = _mm_set1_epi32(sum >> 1);
+    const __m128i   magic = _mm_set1_epi32(div.magic);
+    const __m128i   dsh   = _mm_cvtsi32_si128(div.shift);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        const uint8_t *const ux[2] = {u[0] + 2 * x, rows > 1 ? u[1] + 2 * x : NULL};
+        const uint8_t *const vx[2] = {v[0] + 2 * x, rows > 1 ? v[1] + 2 * x : NULL};
+        const uint8_t *const ax[2] = {a[0] + 2 * x, rows > 1 ? a[1] + 2 * x : NULL};
+        blend_subsample_block_16_sse2(dst_u + x * dst_step, dst_v + x * dst_step, dst_step,
+                                      ux, vx, ax, rows, coeffs, &b, half, magic, dsh);
+    }
+    if (x < count)
+    {
+        uint16_t du[16] = {0}, dv[8] = {0};
+        uint8_t su[2][16] = {{0}}, sv[2][16] = {{0}}, al[2][16] = {{0}};
+        const int n = count - x;
+        for (int i = 0; i < n; i++)
+        {
+            du[i * dst_step] = dst_u[(x + i) * dst_step];
+            if (dst_step == 1)
+            {
+                dv[i] = dst_v[x + i];
+            }
+            else
+            {
+                du[2 * i + 1] = dst_v[(x + i) * dst_step];
+            }
+        }
+        for (int yz = 0; yz < rows; yz++)
+        {
+            memcpy(su[yz], u[yz] + 2 * x, 2 * n);
+            memcpy(sv[yz], v[yz] + 2 * x, 2 * n);
+            memcpy(al[yz], a[yz] + 2 * x, 2 * n);
+        }
+        const uint8_t *const ux[2] = {su[0], su[1]};
+        const uint8_t *const vx[2] = {sv[0], sv[1]};
+        const uint8_t *const ax[2] = {al[0], al[1]};
+        blend_subsample_block_16_sse2(du, dst_step == 1 ? dv : du + 1, dst_step,
+                                      ux, vx, ax, rows, coeffs, &b, half, magic, dsh);
+        for (int i = 0; i < n; i++)
+        {
+            dst_u[(x + i) * dst_step] = du[i * dst_step];
+            dst_v[(x + i) * dst_step] = dst_step == 1 ? dv[i] : du[2 * i + 1];
+        }
+    }
+}
+
+// The AVX2 row blends widen 16 bytes at a time with vpmovzxbw, so every
+// lane holds the pixels in order and the partial blocks are left to SSE2
+
+static av_always_inline TARGET_AVX2 __m256i div255_epu16_avx2(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)),
+                                              _mm256_srli_epi16(x, 8)), 8);
+}
+
+static av_always_inline TARGET_AVX2 __m256i blend_epu16_8_avx2(__m256i d, __m256i s, __m256i alpha, __m256i bias)
+{
+    const __m256i n = _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), alpha)),
+                                       _mm256_add_epi16(_mm256_mullo_epi16(s, alpha), bias));
+    return div255_epu16_avx2(n);
+}
+
+// Blend 32 bytes of dst, s and alpha hold 16 bytes each in their halves
+static av_always_inline TARGET_AVX2 void blend_epu8_avx2(uint8_t *dst, __m128i s0, __m128i s1,
+                                                         __m128i a0, __m128i a1, __m256i bias)
+{
+    const __m256i lo = blend_epu16_8_avx2(_mm256_cvtepu8_epi16(loadu(dst)), _mm256_cvtepu8_epi16(s0),
+                                          _mm256_cvtepu8_epi16(a0), bias);
+    const __m256i hi = blend_epu16_8_avx2(_mm256_cvtepu8_epi16(loadu(dst + 16)), _mm256_cvtepu8_epi16(s1),
+                                          _mm256_cvtepu8_epi16(a1), bias);
+    const __m256i d  = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)dst, d);
+}
+
+static TARGET_AVX2 void blend_row_8_avx2(uint8_t *dst, const uint8_t *src,
+                                         const uint8_t *a, int alpha_step,
+                                         int count, int bias)
+{
+    const __m256i vbias = _mm256_set1_epi16(bias);
+    int x = 0;
+
+    for (; x + 32 <= count; x += 32)
+    {
+        blend_epu8_avx2(dst + x, loadu(src + x), loadu(src + x + 16),
+                        load_alpha16_sse2(a + x * alpha_step, alpha_step),
+                        load_alpha16_sse2(a + (x + 16) * alpha_step, alpha_step), vbias);
+    }
+    if (x < count)
+    {
+        blend_row_8_sse2(dst + x, src + x, a + x * alpha_step, alpha_step, count - x, bias);
+    }
+}
+
+static TARGET_AVX2 void blend_row_uv_8_avx2(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                            const uint8_t *a, int alpha_step,
+                                            int count, int bias)
+{
+    const __m256i vbias = _mm256_set1_epi16(bias);
+    int x = 0;
+
+    for (; x + 16 <= count; x += 16)
+    {
+        const __m128i su    = loadu(src_u + x);
+        const __m128i sv    = loadu(src_v + x);
+        const __m128i alpha = load_alpha16_sse2(a + x * alpha_step, alpha_step);
+        blend_epu8_avx2(dst + 2 * x, _mm_unpacklo_epi8(su, sv), _mm_unpackhi_epi8(su, sv),
+                        _mm_unpacklo_epi8(alpha, alpha), _mm_unpackhi_epi8(alpha, alpha), vbias);
+    }
+    if (x < count)
+    {
+        blend_row_uv_8_sse2(dst + 2 * x, src_u + x, src_v + x, a + x * alpha_step, alpha_step,
+                            count - x, bias);
+    }
+}
+
+static av_always_inline TARGET_AVX2 __m256i div_epu32_avx2(__m256i n, __m256i magic, __m128i shift)
+{
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, magic), 32);
+    const __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(n, 32), magic);
+    const __m256i t    = _mm256_blend_epi32(even, odd, 0xaa);
+    return _mm256_srl_epi32(_mm256_add_epi32(t, _mm256_srli_epi32(_mm256_sub_epi32(n, t), 1)), shift);
+}
+
+// Blend 16 pixels of dst with 8 bit s and alpha
+static av_always_inline TARGET_AVX2 void blend_epu16_avx2(uint16_t *dst, __m128i s, __m128i alpha,
+                                                          const blend16_t *b)
+{
+    const __m256i d      = _mm256_loadu_si256((const __m256i *)dst);
+    const __m256i vs     = _mm256_sll_epi16(_mm256_cvtepu8_epi16(s), b->src_shift);
+    const __m256i va     = _mm256_sll_epi16(_mm256_cvtepu8_epi16(alpha), b->shift);
+    const __m256i ma     = _mm256_sub_epi16(_mm256_broadcastsi128_si256(b->max), va);
+    const __m256i bias   = _mm256_broadcastsi128_si256(b->bias);
+    const __m256i magic  = _mm256_broadcastsi128_si256(b->magic);
+    const __m256i dlo    = _mm256_mullo_epi16(d, ma);
+    const __m256i dhi    = _mm256_mulhi_epu16(d, ma);
+    const __m256i slo    = _mm256_mullo_epi16(vs, va);
+    const __m256i shi    = _mm256_mulhi_epu16(vs, va);
+    const __m256i n0     = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(dlo, dhi),
+                                                             _mm256_unpacklo_epi16(slo, shi)), bias);
+    const __m256i n1     = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(dlo, dhi),
+                                                             _mm256_unpackhi_epi16(slo, shi)), bias);
+    const __m256i q      = _mm256_packus_epi32(div_epu32_avx2(n0, magic, b->div_shift),
+                                               div_epu32_avx2(n1, magic, b->div_shift));
+    _mm256_storeu_si256((__m256i *)dst, q);
+}
+
+static TARGET_AVX2 void blend_row_16_avx2(uint16_t *dst, const uint8_t *src,
+                                          const uint8_t *a, int alpha_step,
+                                          int count, int shift, int src_shift, int bias)
+{
+    const blend16_t b = blend16_init(shift, src_shift, bias);
+    int x = 0;
+
+    for (; x + 16 <= count; x += 16)
+    {
+        blend_epu16_avx2(dst + x, loadu(src + x), load_alpha16_sse2(a + x * alpha_step, alpha_step), &b);
+    }
+    if (x < count)
+    {
+        blend_row_16_sse2(dst + x, src + x, a + x * alpha_step, alpha_step,
+                          count - x, shift, src_shift, bias);
+    }
+}
+
+static TARGET_AVX2 void blend_row_uv_16_avx2(uint16_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                                             const uint8_t *a, int alpha_step,
+                                             int count, int shift, int src_shift, int bias)
+{
+    const blend16_t b = blend16_init(shift, src_shift, bias);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8)
+    {
+        const __m128i alpha = load_alpha8_sse2(a + x * alpha_step, alpha_step);
+        blend_epu16_avx2(dst + 2 * x, _mm_unpacklo_epi8(loadl(src_u + x), loadl(src_v + x)),
+                         _mm_unpacklo_epi8(alpha, alpha), &b);
+    }
+    if (x < count)
+    {
+        blend_row_uv_16_sse2(dst + 2 * x, src_u + x, src_v + x, a + x * alpha_step, alpha_step,
+                             count - x, shift, src_shift, bias);
+    }
+}
+
+void blend_init_x86(BlendFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2)
+    {
+        functions->blend_row_8            = blend_row_8_sse2;
+        functions->blend_row_uv_8         = blend_row_uv_8_sse2;
+        functions->blend_row_16           = blend_row_16_sse2;
+        functions->blend_row_uv_16        = blend_row_uv_16_sse2;
+        functions->blend_subsample_row_8  = blend_subsample_row_8_sse2;
+        functions->blend_subsample_row_16 = blend_subsample_row_16_sse2;
+        hb_log("blend using SSE2 optimizations");
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->blend_row_8     = blend_row_8_avx2;
+        functions->blend_row_uv_8  = blend_row_uv_8_avx2;
+        functions->blend_row_16    = blend_row_16_avx2;
+        functions->blend_row_uv_16 = blend_row_uv_16_avx2;
+        hb_log("blend using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
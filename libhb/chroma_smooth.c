@@ -9,6 +9,7 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/unsharp.h"
 
 #define CHROMA_SMOOTH_STRENGTH_DEFAULT 0.25
 #define CHROMA_SMOOTH_SIZE_DEFAULT 7
@@ -26,14 +27,13 @@ typedef struct
     int        size;      // pixel context region width (must be odd)
 
     int        steps;
-    int        amount;
-    int        scalebits;
-    int32_t    halfscale;
+    UnsharpMix mix;
 } chroma_smooth_plane_context_t;
 
 typedef struct
 {
     uint32_t * SC[CHROMA_SMOOTH_SIZE_MAX - 1];
+    uint32_t * row;
 } chroma_smooth_thread_context_t;
 
 typedef chroma_smooth_thread_context_t chroma_smooth_thread_context3_t[3];
@@ -42,6 +42,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    UnsharpFunctions                  functions;
     chroma_smooth_plane_context_t     plane_ctx[3];
     chroma_smooth_thread_context3_t * thread_ctx;
     int                               threads;
@@ -83,99 +84,65 @@ hb_filter_object_t hb_filter_chroma_smooth =
 };
 
 
-#define DEF_CHROMA_SMOOTH_FUNC(name, nbits)                                                                 \
-static void name##_##nbits(const uint8_t *frame_src,                                                        \
-                                 uint8_t *frame_dst,                                                        \
-                           const int width,                                                                 \
-                           const int height,                                                                \
-                           int stride_src,                                                                  \
-                           int stride_dst,                                                                  \
-                           chroma_smooth_plane_context_t * ctx,                                             \
-                           chroma_smooth_thread_context_t * tctx)                                           \
-{                                                                                                           \
-    uint32_t **SC = tctx->SC;                                                                               \
-    uint32_t SR[CHROMA_SMOOTH_SIZE_MAX - 1],                                                                \
-             Tmp1,                                                                                          \
-             Tmp2;                                                                                          \
-    const uint##nbits##_t *src  = (const uint##nbits##_t *)frame_src;                                       \
-    uint##nbits##_t       *dst  = (uint##nbits##_t *)frame_dst;                                             \
-    const uint##nbits##_t *src2 = (const uint##nbits##_t *)frame_src;                                       \
-    int32_t res;                                                                                            \
-    int x, y, z;                                                                                            \
-    const int amount        = ctx->amount;                                                                  \
-    const int steps         = ctx->steps;                                                                   \
-    const int scalebits     = ctx->scalebits;                                                               \
-    const int32_t halfscale = ctx->halfscale;                                                               \
-    const int16_t max_value = ctx->max_value;                                                               \
-    const int16_t min_value = ctx->min_value;                                                               \
-                                                                                                            \
-    if (!amount)                                                                                            \
-    {                                                                                                       \
-        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);                          \
-        return;                                                                                             \
-    }                                                                                                       \
-                                                                                                            \
-    for (y = 0; y < 2 * steps; y++)                                                                         \
-    {                                                                                                       \
-        memset(SC[y], 0, sizeof(SC[y][0]) * (width + 2 * steps));                                           \
-    }                                                                                                       \
-                                                                                                            \
-    stride_src /= ctx->bps;                                                                                 \
-    stride_dst /= ctx->bps;                                                                                 \
-                                                                                                            \
-    for (y = -steps; y < height + steps; y++)                                                               \
-    {                                                                                                       \
-        if (y < height)                                                                                     \
-        {                                                                                                   \
-            src2 = src;                                                                                     \
-        }                                                                                                   \
-                                                                                                            \
-        memset(SR, 0, sizeof(SR[0]) * (2 * steps));                                                         \
-                                                                                                            \
-        for (x = -steps; x < width + steps; x++)                                                            \
-        {                                                                                                   \
-            Tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width - 1] : src2[x];                               \
-                                                                                                            \
-            for (z = 0; z < steps * 2; z += 2)                                                              \
-            {                                                                                               \
-                Tmp2 = SR[z + 0] + Tmp1; SR[z + 0] = Tmp1;                                                  \
-                Tmp1 = SR[z + 1] + Tmp2; SR[z + 1] = Tmp2;                                                  \
-            }                                                                                               \
-                                                                                                            \
-            for (z = 0; z < steps * 2; z += 2)                                                              \
-            {                                                                                               \
-                Tmp2 = SC[z + 0][x + steps] + Tmp1; SC[z + 0][x + steps] = Tmp1;                            \
-                Tmp1 = SC[z + 1][x + steps] + Tmp2; SC[z + 1][x + steps] = Tmp2;                            \
-            }                                                                                               \
-                                                                                                            \
-            if (x >= steps && y >= steps)                                                                   \
-            {                                                                                               \
-                const uint##nbits##_t *srx = src - steps * stride_src + x - steps;                          \
-                uint##nbits##_t       *dsx = dst - steps * stride_dst + x - steps;                          \
-                                                                                                            \
-                res = (int32_t)*srx - ((((int32_t)*srx -                                                    \
-                      (int32_t)((Tmp1 + halfscale) >> scalebits)) * amount) >> 16);                         \
-                *dsx = res > max_value ? max_value : res < min_value ? min_value : (uint##nbits##_t)res;    \
-            }                                                                                               \
-        }                                                                                                   \
-                                                                                                            \
-        if (y >= 0)                                                                                         \
-        {                                                                                                   \
-            dst += stride_dst;                                                                              \
-            src += stride_src;                                                                              \
-        }                                                                                                   \
-    }                                                                                                       \
-}                                                                                                           \
-
-DEF_CHROMA_SMOOTH_FUNC(chroma_smooth, 16)
-DEF_CHROMA_SMOOTH_FUNC(chroma_smooth, 8)
-
-#define chroma_smooth(...)                                  \
-    switch (pv->depth)                                      \
-    {                                                       \
-        case  8: chroma_smooth_8(__VA_ARGS__); break;       \
-        default: chroma_smooth_16(__VA_ARGS__); break;      \
+static void chroma_smooth(const UnsharpFunctions *functions,
+                          const uint8_t *frame_src,
+                                uint8_t *frame_dst,
+                          const int width,
+                          const int height,
+                          const int stride_src,
+                          const int stride_dst,
+                          chroma_smooth_plane_context_t * ctx,
+                          chroma_smooth_thread_context_t * tctx)
+{
+    uint32_t **SC  = tctx->SC;
+    uint32_t *row  = tctx->row;
+    const int steps = ctx->steps;
+    const int w     = width + 2 * steps;
+
+    if (!ctx->mix.amount)
+    {
+        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);
+        return;
+    }
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        memset(SC[z], 0, sizeof(SC[z][0]) * w);
+    }
+
+    // Same binomial blur as unsharp, see unsharp.c
+    for (int y = -steps; y < height + steps; y++)
+    {
+        const int ys = y < 0 ? 0 : y >= height ? height - 1 : y;
+        const uint8_t *src = frame_src + ys * stride_src;
+
+        if (ctx->bps == 1)
+        {
+            functions->blur_row_8(row, src, width, steps);
+        }
+        else
+        {
+            functions->blur_row_16(row, (const uint16_t *)src, width, steps);
+        }
+        functions->blur_column(row, SC, w, steps);
+
+        if (y >= steps)
+        {
+            src          = frame_src + (y - steps) * stride_src;
+            uint8_t *dst = frame_dst + (y - steps) * stride_dst;
+
+            if (ctx->bps == 1)
+            {
+                functions->mix_row_8(dst, src, row + 2 * steps, width, &ctx->mix);
+            }
+            else
+            {
+                functions->mix_row_16((uint16_t *)dst, (const uint16_t *)src,
+                                      row + 2 * steps, width, &ctx->mix);
+            }
+        }
     }
+}
 
 static int chroma_smooth_init(hb_filter_object_t *filter,
                               hb_filter_init_t   *init)
@@ -253,21 +220,26 @@ static int chroma_smooth_init(hb_filter_object_t *filter,
         if (c)
         {
             // Chroma
-            ctx->amount    = ctx->strength * 65536.0;
-            ctx->steps     = ctx->size / 2;
-            ctx->scalebits = ctx->steps * 4;
-            ctx->halfscale = 1 << (ctx->scalebits - 1);
+            ctx->steps         = ctx->size / 2;
+            ctx->mix.amount    = ctx->strength * 65536.0;
+            ctx->mix.scalebits = ctx->steps * 4;
+            ctx->mix.halfscale = 1 << (ctx->mix.scalebits - 1);
         }
         else
         {
             // Luma
-            ctx->amount    = 0;
-            ctx->steps     = 0;
-            ctx->scalebits = 0;
-            ctx->halfscale = 0;
+            ctx->steps         = 0;
+            ctx->mix.amount    = 0;
+            ctx->mix.scalebits = 0;
+            ctx->mix.halfscale = 0;
         }
+        ctx->mix.min_value = ctx->min_value;
+        ctx->mix.max_value = ctx->max_value;
+        ctx->mix.smooth    = 1;
     }
 
+    unsharp_init_functions(&pv->functions, "Chroma Smooth");
+
     if (chroma_smooth_init_thread(filter, 1) < 0)
     {
         chroma_smooth_close(filter);
@@ -296,6 +268,8 @@ static void chroma_smooth_thread_close(hb_filter_private_t *pv)
                     free(tctx->SC[z]);
                     tctx->SC[z] = NULL;
                 }
+                free(tctx->row);
+                tctx->row = NULL;
             }
         }
     }
@@ -336,6 +310,12 @@ static int chroma_smooth_init_thread(hb_filter_object_t *filter, int threads)
                         return -1;
                     }
                 }
+                tctx->row = malloc(sizeof(*(tctx->row)) * (w + 2 * ctx->steps));
+                if (tctx->row == NULL)
+                {
+                    hb_error("Chroma Smooth calloc failed");
+                    return -1;
+                }
             }
         }
     }
@@ -383,7 +363,8 @@ static int chroma_smooth_work_thread(hb_filter_object_t *filter,
         chroma_smooth_plane_context_t  * ctx  = &pv->plane_ctx[c];
         chroma_smooth_thread_context_t * tctx = &pv->thread_ctx[thread][c];
 
-        chroma_smooth(in->plane[c].data,
+        chroma_smooth(&pv->functions,
+                      in->plane[c].data,
                       out->plane[c].data,
                       in->plane[c].width,
                       in->plane[c].height,
@@ -22,6 +22,7 @@ hb_filter_object_t hb_filter_colorspace =
     .id                = HB_FILTER_COLORSPACE,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Colorspace",
     .settings          = NULL,
     .init              = colorspace_init,
@@ -30,6 +30,7 @@ Original "Faster" settings:
 
 #include "handbrake/handbrake.h"
 #include "handbrake/taskset.h"
+#include "handbrake/comb_detect.h"
 
 #if defined(__aarch64__)
 #include <arm_neon.h>
@@ -101,6 +102,8 @@ struct hb_filter_private_s
                                   int segment_start, int segment_stop);
     void (*apply_mask)(hb_filter_private_t *pv, hb_buffer_t *b);
 
+    CombDetectFunctions functions;
+
     hb_buffer_list_t   out_list;
 
     // Filter statistics
@@ -138,6 +141,119 @@ hb_filter_object_t hb_filter_comb_detect =
     .settings_template = comb_detect_template,
 };
 
+static inline void comb_detect_params(hb_filter_private_t *pv, CombDetectParams *params)
+{
+    params->spatial_metric            = pv->spatial_metric;
+    params->motion_threshold          = pv->motion_threshold;
+    params->spatial_threshold         = pv->spatial_threshold;
+    params->spatial_threshold_squared = pv->spatial_threshold_squared;
+    params->spatial_threshold6        = pv->spatial_threshold6;
+    params->comb32detect_min          = pv->comb32detect_min;
+    params->comb32detect_max          = pv->comb32detect_max;
+    params->gamma_motion_threshold    = pv->gamma_motion_threshold;
+    params->gamma_spatial_threshold   = pv->gamma_spatial_threshold;
+    params->gamma_spatial_threshold6  = pv->gamma_spatial_threshold6;
+    params->gamma_lut                 = pv->gamma_lut;
+    params->force_exaustive_check     = pv->force_exaustive_check;
+}
+
+static void mask_filter_row(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                            const uint8_t *curn, int width, int classic)
+{
+    for (int xx = 1; xx < width - 1; xx++)
+    {
+        const int h_count = cur[xx-1] & cur[xx] & cur[xx+1];
+        const int v_count = curp[xx] & cur[xx] & curn[xx];
+
+        if (classic)
+        {
+            dst[xx] = h_count;
+        }
+        else
+        {
+            dst[xx] = h_count & v_count;
+        }
+    }
+}
+
+static void mask_dilate_row(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                            const uint8_t *curn, int width)
+{
+    const int dilation_threshold = 4;
+
+    for (int xx = 1; xx < width - 1; xx++)
+    {
+        if (cur[xx])
+        {
+            dst[xx] = 1;
+            continue;
+        }
+
+        const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                          cur [xx-1] +            cur [xx+1] +
+                          curn[xx-1] + curn[xx] + curn[xx+1];
+
+        dst[xx] = count >= dilation_threshold;
+    }
+}
+
+static void mask_erode_row(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                           const uint8_t *curn, int width)
+{
+    const int erosion_threshold = 2;
+
+    for (int xx = 1; xx < width - 1; xx++)
+    {
+        if (cur[xx] == 0)
+        {
+            dst[xx] = 0;
+            continue;
+        }
+
+        const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                          cur [xx-1] +            cur [xx+1] +
+                          curn[xx-1] + curn[xx] + curn[xx+1];
+
+        dst[xx] = count >= erosion_threshold;
+    }
+}
+
+static int mask_block_score(const uint8_t *mask, int stride, int block_width,
+                            int block_height, int left_edge, int filtered)
+{
+    int score = 0;
+
+    for (int block_y = 0; block_y < block_height; block_y++)
+    {
+        const uint8_t *mask_p = &mask[block_y * stride];
+
+        if (filtered)
+        {
+            for (int block_x = 0; block_x < block_width; block_x++)
+            {
+                score += mask_p[block_x];
+            }
+            continue;
+        }
+
+        // We only want to mark a pixel in a block as combed
+        // if the adjacent pixels are as well. The right edge
+        // of the mask is never part of a block.
+        int block_x = 0;
+        if (left_edge)
+        {
+            score += mask_p[0] & mask_p[1];
+            block_x++;
+        }
+        for (; block_x < block_width; block_x++)
+        {
+            score += mask_p[block_x - 1] & mask_p[block_x] & mask_p[block_x + 1];
+        }
+    }
+
+    return score;
+}
+
 #define BIT_DEPTH 8
 #include "templates/comb_detect_template.c"
 #undef BIT_DEPTH
@@ -238,19 +354,9 @@ static void check_filtered_combing_mask(hb_filter_private_t *pv, int segment, in
     {
         for (int x = 0; x < (width - block_width); x = x + block_width)
         {
-            int block_score = 0;
-
-            for (int block_y = 0; block_y < block_height; block_y++)
-            {
-                const int my = y + block_y;
-                const uint8_t *mask_p = &pv->mask_filtered->plane[0].data[my * stride + x];
-
-                for (int block_x = 0; block_x < block_width; block_x++)
-                {
-                    block_score += mask_p[0];
-                    mask_p++;
-                }
-            }
+            const int block_score =
+                pv->functions.block_score(&pv->mask_filtered->plane[0].data[y * stride + x],
+                                          stride, block_width, block_height, x == 0, 1);
 
             if (pv->comb_check_complete)
             {
@@ -401,34 +507,9 @@ static void check_combing_mask(hb_filter_private_t *pv, int segment, int start,
     {
         for (int x = 0; x < (width - block_width); x = x + block_width)
         {
-            int block_score = 0;
-
-            for (int block_y = 0; block_y < block_height; block_y++)
-            {
-                const int mask_y = y + block_y;
-                const uint8_t *mask_p = &pv->mask->plane[0].data[mask_y * stride + x];
-
-                for (int block_x = 0; block_x < block_width; block_x++)
-                {
-                    // We only want to mark a pixel in a block as combed
-                    // if the adjacent pixels are as well. Got to
-                    // handle the sides separately.
-                    if ((x + block_x) == 0)
-                    {
-                        block_score += mask_p[0] & mask_p[1];
-                    }
-                    else if ((x + block_x) == (width -1))
-                    {
-                        block_score += mask_p[-1] & mask_p[0];
-                    }
-                    else
-                    {
-                        block_score += mask_p[-1] & mask_p[0] & mask_p[1];
-                    }
-
-                    mask_p++;
-                }
-            }
+            const int block_score =
+                pv->functions.block_score(&pv->mask->plane[0].data[y * stride + x],
+                                          stride, block_width, block_height, x == 0, 0);
 
             if (pv->comb_check_complete)
             {
@@ -560,8 +641,6 @@ static void mask_dilate_work(void *thread_args_v)
     const int segment_start = thread_args->segment_start[0];
     const int segment_stop = segment_start + thread_args->segment_height[0];
 
-    const int dilation_threshold = 4;
-
     const int width = pv->mask_filtered->plane[0].width;
     const int height = pv->mask_filtered->plane[0].height;
     const int stride = pv->mask_filtered->plane[0].stride;
@@ -599,20 +678,7 @@ static void mask_dilate_work(void *thread_args_v)
 
     for (int yy = start; yy < stop; yy++)
     {
-        for (int xx = 1; xx < width - 1; xx++)
-        {
-            if (cur[xx])
-            {
-                dst[xx] = 1;
-                continue;
-            }
-
-            const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
-                              cur [xx-1] +            cur [xx+1] +
-                              curn[xx-1] + curn[xx] + curn[xx+1];
-
-            dst[xx] = count >= dilation_threshold;
-        }
+        pv->functions.mask_dilate_row(dst, curp, cur, curn, width);
         curp += stride;
         cur += stride;
         curn += stride;
@@ -730,8 +796,6 @@ static void mask_erode_work(void *thread_args_v)
     const int segment_start = thread_args->segment_start[0];
     const int segment_stop = segment_start + thread_args->segment_height[0];
 
-    const int erosion_threshold = 2;
-
     const int width = pv->mask_filtered->plane[0].width;
     const int height = pv->mask_filtered->plane[0].height;
     const int stride = pv->mask_filtered->plane[0].stride;
@@ -769,20 +833,7 @@ static void mask_erode_work(void *thread_args_v)
 
     for (int yy = start; yy < stop; yy++)
     {
-        for (int xx = 1; xx < width - 1; xx++)
-        {
-            if (cur[xx] == 0)
-            {
-                dst[xx] = 0;
-                continue;
-            }
-
-            const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
-                              cur [xx-1] +            cur [xx+1] +
-                              curn[xx-1] + curn[xx] + curn[xx+1];
-
-            dst[xx] = count >= erosion_threshold;
-        }
+        pv->functions.mask_erode_row(dst, curp, cur, curn, width);
         curp += stride;
         cur += stride;
         curn += stride;
@@ -943,20 +994,8 @@ static void mask_filter_work(void *thread_args_v)
 
     for (int yy = start; yy < stop; yy++)
     {
-        for (int xx = 1; xx < width - 1; xx++)
-        {
-            const int h_count = cur[xx-1] & cur[xx] & cur[xx+1];
-            const int v_count = curp[xx] & cur[xx] & curn[xx];
-
-            if (pv->filter_mode == FILTER_CLASSIC)
-            {
-                dst[xx] = h_count;
-            }
-            else
-            {
-                dst[xx] = h_count & v_count;
-            }
-        }
+        pv->functions.mask_filter_row(dst, curp, cur, curn, width,
+                                      pv->filter_mode == FILTER_CLASSIC);
         curp += stride;
         cur += stride;
         curn += stride;
@@ -1089,6 +1128,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
         return -1;
     }
     hb_filter_private_t *pv = filter->private_data;
+    taskset_budget_t *budget = init->job != NULL ? init->job->filter_budget : NULL;
 
     hb_buffer_list_clear(&pv->out_list);
 
@@ -1180,6 +1220,18 @@ static int comb_detect_init(hb_filter_object_t *filter,
     memset(pv->mask_filtered->data, 0, pv->mask_filtered->size);
     memset(pv->mask_temp->data, 0, pv->mask_temp->size);
 
+    pv->functions.detect_combed_row_8        = detect_combed_row_8;
+    pv->functions.detect_combed_row_16       = detect_combed_row_16;
+    pv->functions.detect_gamma_combed_row_8  = detect_gamma_combed_row_8;
+    pv->functions.detect_gamma_combed_row_16 = detect_gamma_combed_row_16;
+    pv->functions.mask_filter_row            = mask_filter_row;
+    pv->functions.mask_dilate_row            = mask_dilate_row;
+    pv->functions.mask_erode_row             = mask_erode_row;
+    pv->functions.block_score                = mask_block_score;
+#if defined(ARCH_X86)
+    comb_detect_init_x86(&pv->functions);
+#endif
+
     // Set the functions for the current bit depth
     switch (pv->depth)
     {
@@ -1205,6 +1257,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
         hb_error("comb_detect could not initialize taskset");
         return -1;
     }
+    taskset_set_budget(&pv->comb_detect_filter_taskset, budget);
 
     comb_detect_thread_arg_t *comb_detect_prev_thread_args = NULL;
     for (int ii = 0; ii < pv->cpu_count; ii++)
@@ -1258,6 +1311,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
         hb_error("comb_detect check could not initialize taskset");
         return -1;
     }
+    taskset_set_budget(&pv->comb_detect_check_taskset, budget);
 
     comb_detect_prev_thread_args = NULL;
     for (int ii = 0; ii < pv->comb_check_nthreads; ii++)
@@ -1308,6 +1362,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
             hb_error( "mask filter could not initialize taskset" );
             return -1;
         }
+        taskset_set_budget(&pv->mask_filter_taskset, budget);
 
         comb_detect_prev_thread_args = NULL;
         for (int ii = 0; ii < pv->cpu_count; ii++)
@@ -1352,6 +1407,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
                 hb_error("mask erode could not initialize taskset");
                 return -1;
             }
+            taskset_set_budget(&pv->mask_erode_taskset, budget);
 
             comb_detect_prev_thread_args = NULL;
             for (int ii = 0; ii < pv->cpu_count; ii++)
@@ -1394,6 +1450,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
                 hb_error("mask dilate could not initialize taskset");
                 return -1;
             }
+            taskset_set_budget(&pv->mask_dilate_taskset, budget);
 
             comb_detect_prev_thread_args = NULL;
             for (int ii = 0; ii < pv->cpu_count; ii++)
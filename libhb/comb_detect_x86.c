@@ -0,0 +1,544 @@
+/* comb_detect_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/comb_detect.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static av_always_inline int load_pixel(const void *src, int offset, int bps)
+{
+    return bps == 1 ? ((const uint8_t *)src)[offset] :
+                      ((const uint16_t *)src)[offset];
+}
+
+// Same tests as detect_combed_row in comb_detect_template.c,
+// used for the pixels that do not fill a vector
+static av_always_inline int detect_combed_pixel(const void *prev, const void *cur,
+                                                const void *next,
+                                                int stride_prev, int stride_cur,
+                                                int stride_next, int x,
+                                                const CombDetectParams *params,
+                                                int bps)
+{
+    const int c0 = load_pixel(cur, x, bps);
+    const int u1 = load_pixel(cur, x - stride_cur, bps);
+    const int d1 = load_pixel(cur, x + stride_cur, bps);
+    const int athresh = params->spatial_threshold;
+    const int mthresh = params->motion_threshold;
+
+    const int up_diff   = c0 - u1;
+    const int down_diff = c0 - d1;
+
+    if (!((up_diff >  athresh && down_diff >  athresh) ||
+          (up_diff < -athresh && down_diff < -athresh)))
+    {
+        return 0;
+    }
+
+    int motion = 1;
+    if (mthresh > 0 && !params->force_exaustive_check)
+    {
+        motion = (abs(load_pixel(prev, x, bps) - c0) > mthresh &&
+                  abs(u1 - load_pixel(next, x - stride_next, bps)) > mthresh &&
+                  abs(d1 - load_pixel(next, x + stride_next, bps)) > mthresh) ||
+                 (abs(load_pixel(next, x, bps) - c0) > mthresh &&
+                  abs(load_pixel(prev, x - stride_prev, bps) - u1) > mthresh &&
+                  abs(load_pixel(prev, x + stride_prev, bps) - d1) > mthresh);
+    }
+    if (!motion)
+    {
+        return 0;
+    }
+
+    const int u2 = load_pixel(cur, x - 2 * stride_cur, bps);
+    const int d2 = load_pixel(cur, x + 2 * stride_cur, bps);
+    switch (params->spatial_metric)
+    {
+        case 0:
+            return abs(c0 - d2) < params->comb32detect_min &&
+                   abs(c0 - d1) > params->comb32detect_max;
+        case 1:
+            return (u1 - c0) * (d1 - c0) > params->spatial_threshold_squared;
+        case 2:
+            return abs(u2 + (4 * c0) + d2 - (3 * (u1 + d1))) > params->spatial_threshold6;
+    }
+    return 0;
+}
+
+static av_always_inline int detect_gamma_combed_pixel(const void *prev, const void *cur,
+                                                      const void *next,
+                                                      int stride_prev, int stride_cur,
+                                                      int stride_next, int x,
+                                                      const CombDetectParams *params,
+                                                      int bps)
+{
+    const float *lut = params->gamma_lut;
+    const float c0 = lut[load_pixel(cur, x, bps)];
+    const float u1 = lut[load_pixel(cur, x - stride_cur, bps)];
+    const float d1 = lut[load_pixel(cur, x + stride_cur, bps)];
+    const float athresh = params->gamma_spatial_threshold;
+    const float mthresh = params->gamma_motion_threshold;
+
+    const float up_diff   = c0 - u1;
+    const float down_diff = c0 - d1;
+
+    if (!((up_diff >  athresh && down_diff >  athresh) ||
+          (up_diff < -athresh && down_diff < -athresh)))
+    {
+        return 0;
+    }
+
+    int motion = 1;
+    if (mthresh > 0 && !params->force_exaustive_check)
+    {
+        motion = (fabsf(lut[load_pixel(prev, x, bps)] - c0) > mthresh &&
+                  fabsf(u1 - lut[load_pixel(next, x - stride_next, bps)]) > mthresh &&
+                  fabsf(d1 - lut[load_pixel(next, x + stride_next, bps)]) > mthresh) ||
+                 (fabsf(lut[load_pixel(next, x, bps)] - c0) > mthresh &&
+                  fabsf(lut[load_pixel(prev, x - stride_prev, bps)] - u1) > mthresh &&
+                  fabsf(lut[load_pixel(prev, x + stride_prev, bps)] - d1) > mthresh);
+    }
+    if (!motion)
+    {
+        return 0;
+    }
+
+    const float u2 = lut[load_pixel(cur, x - 2 * stride_cur, bps)];
+    const float d2 = lut[load_pixel(cur, x + 2 * stride_cur, bps)];
+    return fabsf(u2 + (4 * c0) + d2 - (3 * (u1 + d1))) > params->gamma_spatial_threshold6;
+}
+
+static av_always_inline TARGET_AVX2 __m256i load8_epi32(const void *src, int offset, int bps)
+{
+    if (bps == 1)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)((const uint8_t *)src + offset)));
+    }
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)((const uint16_t *)src + offset)));
+}
+
+static av_always_inline TARGET_AVX2 __m256 load8_lut(const float *lut, const void *src,
+                                                     int offset, int bps)
+{
+    return _mm256_i32gather_ps(lut, load8_epi32(src, offset, bps), 4);
+}
+
+// Stores the low bit of 8 all-ones / all-zeros lanes as 8 mask bytes
+static av_always_inline TARGET_AVX2 void store8_mask(uint8_t *mask, __m256i combed)
+{
+    combed = _mm256_and_si256(combed, _mm256_set1_epi32(1));
+    combed = _mm256_packs_epi32(combed, combed);
+    combed = _mm256_packs_epi16(combed, combed);
+    const uint32_t lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(combed));
+    const uint32_t hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(combed, 1));
+    memcpy(mask,     &lo, 4);
+    memcpy(mask + 4, &hi, 4);
+}
+
+static av_always_inline TARGET_AVX2 __m256i abs_gt(__m256i a, __m256i b, __m256i threshold)
+{
+    return _mm256_cmpgt_epi32(_mm256_abs_epi32(_mm256_sub_epi32(a, b)), threshold);
+}
+
+static av_always_inline TARGET_AVX2 void detect_combed_row_avx2(uint8_t *mask,
+                                                                const void *prev,
+                                                                const void *cur,
+                                                                const void *next,
+                                                                int stride_prev,
+                                                                int stride_cur,
+                                                                int stride_next,
+                                                                int width,
+                                                                const CombDetectParams *params,
+                                                                int bps)
+{
+    const __m256i athresh     = _mm256_set1_epi32(params->spatial_threshold);
+    const __m256i neg_athresh = _mm256_set1_epi32(-params->spatial_threshold);
+    const __m256i mthresh     = _mm256_set1_epi32(params->motion_threshold);
+    const __m256i athresh_sq  = _mm256_set1_epi32(params->spatial_threshold_squared);
+    const __m256i athresh6    = _mm256_set1_epi32(params->spatial_threshold6);
+    const __m256i c32_min     = _mm256_set1_epi32(params->comb32detect_min);
+    const __m256i c32_max     = _mm256_set1_epi32(params->comb32detect_max);
+    const int check_motion    = params->motion_threshold > 0 &&
+                                !params->force_exaustive_check;
+    const int spatial_metric  = params->spatial_metric;
+
+    int x;
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        const __m256i c0 = load8_epi32(cur, x, bps);
+        const __m256i u1 = load8_epi32(cur, x - stride_cur, bps);
+        const __m256i d1 = load8_epi32(cur, x + stride_cur, bps);
+
+        const __m256i up_diff   = _mm256_sub_epi32(c0, u1);
+        const __m256i down_diff = _mm256_sub_epi32(c0, d1);
+
+        // The pixel above and below are different,
+        // and they change in the same "direction" too.
+        __m256i combed = _mm256_or_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(up_diff, athresh),
+                             _mm256_cmpgt_epi32(down_diff, athresh)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(neg_athresh, up_diff),
+                             _mm256_cmpgt_epi32(neg_athresh, down_diff)));
+
+        if (_mm256_testz_si256(combed, combed))
+        {
+            memset(mask + x, 0, 8);
+            continue;
+        }
+
+        if (check_motion)
+        {
+            __m256i motion1 = abs_gt(load8_epi32(prev, x, bps), c0, mthresh);
+            motion1 = _mm256_and_si256(motion1, abs_gt(u1, load8_epi32(next, x - stride_next, bps), mthresh));
+            motion1 = _mm256_and_si256(motion1, abs_gt(d1, load8_epi32(next, x + stride_next, bps), mthresh));
+            __m256i motion2 = abs_gt(load8_epi32(next, x, bps), c0, mthresh);
+            motion2 = _mm256_and_si256(motion2, abs_gt(load8_epi32(prev, x - stride_prev, bps), u1, mthresh));
+            motion2 = _mm256_and_si256(motion2, abs_gt(load8_epi32(prev, x + stride_prev, bps), d1, mthresh));
+            combed  = _mm256_and_si256(combed, _mm256_or_si256(motion1, motion2));
+        }
+
+        __m256i spatial;
+        if (spatial_metric == 0)
+        {
+            const __m256i d2 = load8_epi32(cur, x + 2 * stride_cur, bps);
+            spatial = _mm256_andnot_si256(abs_gt(c0, d2, _mm256_sub_epi32(c32_min, _mm256_set1_epi32(1))),
+                                          abs_gt(c0, d1, c32_max));
+        }
+        else if (spatial_metric == 1)
+        {
+            spatial = _mm256_cmpgt_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(u1, c0),
+                                                            _mm256_sub_epi32(d1, c0)),
+                                         athresh_sq);
+        }
+        else if (spatial_metric == 2)
+        {
+            const __m256i u2 = load8_epi32(cur, x - 2 * stride_cur, bps);
+            const __m256i d2 = load8_epi32(cur, x + 2 * stride_cur, bps);
+            __m256i sum = _mm256_add_epi32(_mm256_add_epi32(u2, _mm256_slli_epi32(c0, 2)), d2);
+            __m256i ud  = _mm256_add_epi32(u1, d1);
+            ud  = _mm256_add_epi32(ud, _mm256_add_epi32(ud, ud));
+            spatial = _mm256_cmpgt_epi32(_mm256_abs_epi32(_mm256_sub_epi32(sum, ud)), athresh6);
+        }
+        else
+        {
+            spatial = _mm256_setzero_si256();
+        }
+
+        store8_mask(mask + x, _mm256_and_si256(combed, spatial));
+    }
+
+    for (; x < width; x++)
+    {
+        mask[x] = detect_combed_pixel(prev, cur, next, stride_prev, stride_cur,
+                                      stride_next, x, params, bps);
+    }
+}
+
+static av_always_inline TARGET_AVX2 __m256i fabs_gt(__m256 a, __m256 b, __m256 threshold,
+                                                    __m256 sign)
+{
+    return _mm256_castps_si256(_mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(a, b)),
+                                             threshold, _CMP_GT_OQ));
+}
+
+static av_always_inline TARGET_AVX2 void detect_gamma_combed_row_avx2(uint8_t *mask,
+                                                                      const void *prev,
+                                                                      const void *cur,
+                                                                      const void *next,
+                                                                      int stride_prev,
+                                                                      int stride_cur,
+                                                                      int stride_next,
+                                                                      int width,
+                                                                      const CombDetectParams *params,
+                                                                      int bps)
+{
+    const float  *lut         = params->gamma_lut;
+    const __m256  athresh     = _mm256_set1_ps(params->gamma_spatial_threshold);
+    const __m256  neg_athresh = _mm256_set1_ps(-params->gamma_spatial_threshold);
+    const __m256  mthresh     = _mm256_set1_ps(params->gamma_motion_threshold);
+    const __m256  athresh6    = _mm256_set1_ps(params->gamma_spatial_threshold6);
+    const __m256  sign        = _mm256_set1_ps(-0.0f);
+    const __m256  four        = _mm256_set1_ps(4.0f);
+    const __m256  three       = _mm256_set1_ps(3.0f);
+    const int check_motion    = params->gamma_motion_threshold > 0 &&
+                                !params->force_exaustive_check;
+
+    int x;
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        const __m256 c0 = load8_lut(lut, cur, x, bps);
+        const __m256 u1 = load8_lut(lut, cur, x - stride_cur, bps);
+        const __m256 d1 = load8_lut(lut, cur, x + stride_cur, bps);
+
+        const __m256 up_diff   = _mm256_sub_ps(c0, u1);
+        const __m256 down_diff = _mm256_sub_ps(c0, d1);
+
+        __m256i combed = _mm256_castps_si256(_mm256_or_ps(
+            _mm256_and_ps(_mm256_cmp_ps(up_diff, athresh, _CMP_GT_OQ),
+                          _mm256_cmp_ps(down_diff, athresh, _CMP_GT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(up_diff, neg_athresh, _CMP_LT_OQ),
+                          _mm256_cmp_ps(down_diff, neg_athresh, _CMP_LT_OQ))));
+
+        if (_mm256_testz_si256(combed, combed))
+        {
+            memset(mask + x, 0, 8);
+            continue;
+        }
+
+        if (check_motion)
+        {
+            __m256i motion1 = fabs_gt(load8_lut(lut, prev, x, bps), c0, mthresh, sign);
+            motion1 = _mm256_and_si256(motion1, fabs_gt(u1, load8_lut(lut, next, x - stride_next, bps), mthresh, sign));
+            motion1 = _mm256_and_si256(motion1, fabs_gt(d1, load8_lut(lut, next, x + stride_next, bps), mthresh, sign));
+            __m256i motion2 = fabs_gt(load8_lut(lut, next, x, bps), c0, mthresh, sign);
+            motion2 = _mm256_and_si256(motion2, fabs_gt(load8_lut(lut, prev, x - stride_prev, bps), u1, mthresh, sign));
+            motion2 = _mm256_and_si256(motion2, fabs_gt(load8_lut(lut, prev, x + stride_prev, bps), d1, mthresh, sign));
+            combed  = _mm256_and_si256(combed, _mm256_or_si256(motion1, motion2));
+        }
+
+        // Evaluated in the same order as the scalar code
+        const __m256 u2 = load8_lut(lut, cur, x - 2 * stride_cur, bps);
+        const __m256 d2 = load8_lut(lut, cur, x + 2 * stride_cur, bps);
+        __m256 combing = _mm256_add_ps(_mm256_add_ps(u2, _mm256_mul_ps(four, c0)), d2);
+        combing = _mm256_sub_ps(combing, _mm256_mul_ps(three, _mm256_add_ps(u1, d1)));
+        combing = _mm256_andnot_ps(sign, combing);
+        combed  = _mm256_and_si256(combed, _mm256_castps_si256(_mm256_cmp_ps(combing, athresh6, _CMP_GT_OQ)));
+
+        store8_mask(mask + x, combed);
+    }
+
+    for (; x < width; x++)
+    {
+        mask[x] = detect_gamma_combed_pixel(prev, cur, next, stride_prev, stride_cur,
+                                            stride_next, x, params, bps);
+    }
+}
+
+static TARGET_AVX2 void detect_combed_row_8_avx2(uint8_t *mask,
+                                                 const uint8_t *prev, const uint8_t *cur, const uint8_t *next,
+                                                 int stride_prev, int stride_cur, int stride_next,
+                                                 int width, const CombDetectParams *params)
+{
+    detect_combed_row_avx2(mask, prev, cur, next, stride_prev, stride_cur,
+                           stride_next, width, params, 1);
+}
+
+static TARGET_AVX2 void detect_combed_row_16_avx2(uint8_t *mask,
+                                                  const uint16_t *prev, const uint16_t *cur, const uint16_t *next,
+                                                  int stride_prev, int stride_cur, int stride_next,
+                                                  int width, const CombDetectParams *params)
+{
+    detect_combed_row_avx2(mask, prev, cur, next, stride_prev, stride_cur,
+                           stride_next, width, params, 2);
+}
+
+static TARGET_AVX2 void detect_gamma_combed_row_8_avx2(uint8_t *mask,
+                                                       const uint8_t *prev, const uint8_t *cur, const uint8_t *next,
+                                                       int stride_prev, int stride_cur, int stride_next,
+                                                       int width, const CombDetectParams *params)
+{
+    detect_gamma_combed_row_avx2(mask, prev, cur, next, stride_prev, stride_cur,
+                                 stride_next, width, params, 1);
+}
+
+static TARGET_AVX2 void detect_gamma_combed_row_16_avx2(uint8_t *mask,
+                                                        const uint16_t *prev, const uint16_t *cur, const uint16_t *next,
+                                                        int stride_prev, int stride_cur, int stride_next,
+                                                        int width, const CombDetectParams *params)
+{
+    detect_gamma_combed_row_avx2(mask, prev, cur, next, stride_prev, stride_cur,
+                                 stride_next, width, params, 2);
+}
+
+// The mask is made of 0 and 1 bytes, 16 of them are filtered at a time
+static av_always_inline __m128i load16(const uint8_t *src)
+{
+    return _mm_loadu_si128((const __m128i *)src);
+}
+
+static av_always_inline __m128i neighbour_count(const uint8_t *curp, const uint8_t *cur,
+                                                const uint8_t *curn, int xx)
+{
+    __m128i count = _mm_adds_epu8(load16(curp + xx - 1), load16(curp + xx));
+    count = _mm_adds_epu8(count, load16(curp + xx + 1));
+    count = _mm_adds_epu8(count, load16(cur  + xx - 1));
+    count = _mm_adds_epu8(count, load16(cur  + xx + 1));
+    count = _mm_adds_epu8(count, load16(curn + xx - 1));
+    count = _mm_adds_epu8(count, load16(curn + xx));
+    return  _mm_adds_epu8(count, load16(curn + xx + 1));
+}
+
+static av_always_inline __m128i at_least(__m128i count, int threshold)
+{
+    return _mm_cmpeq_epi8(_mm_max_epu8(count, _mm_set1_epi8(threshold)), count);
+}
+
+static void mask_filter_row_sse2(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                                 const uint8_t *curn, int width, int classic)
+{
+    int xx;
+    for (xx = 1; xx + 16 <= width - 1; xx += 16)
+    {
+        const __m128i c = load16(cur + xx);
+        __m128i res = _mm_and_si128(_mm_and_si128(load16(cur + xx - 1), c),
+                                    load16(cur + xx + 1));
+        if (!classic)
+        {
+            res = _mm_and_si128(res, _mm_and_si128(load16(curp + xx), load16(curn + xx)));
+        }
+        _mm_storeu_si128((__m128i *)(dst + xx), res);
+    }
+    for (; xx < width - 1; xx++)
+    {
+        const int h_count = cur[xx-1] & cur[xx] & cur[xx+1];
+        const int v_count = curp[xx] & cur[xx] & curn[xx];
+
+        dst[xx] = classic ? h_count : h_count & v_count;
+    }
+}
+
+static void mask_dilate_row_sse2(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                                 const uint8_t *curn, int width)
+{
+    const int dilation_threshold = 4;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+
+    int xx;
+    for (xx = 1; xx + 16 <= width - 1; xx += 16)
+    {
+        const __m128i set = _mm_andnot_si128(_mm_cmpeq_epi8(load16(cur + xx), zero), one);
+        const __m128i res = _mm_and_si128(at_least(neighbour_count(curp, cur, curn, xx),
+                                                   dilation_threshold), one);
+        _mm_storeu_si128((__m128i *)(dst + xx), _mm_or_si128(set, res));
+    }
+    for (; xx < width - 1; xx++)
+    {
+        if (cur[xx])
+        {
+            dst[xx] = 1;
+            continue;
+        }
+
+        const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                          cur [xx-1] +            cur [xx+1] +
+                          curn[xx-1] + curn[xx] + curn[xx+1];
+
+        dst[xx] = count >= dilation_threshold;
+    }
+}
+
+static void mask_erode_row_sse2(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                                const uint8_t *curn, int width)
+{
+    const int erosion_threshold = 2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+
+    int xx;
+    for (xx = 1; xx + 16 <= width - 1; xx += 16)
+    {
+        const __m128i set = _mm_andnot_si128(_mm_cmpeq_epi8(load16(cur + xx), zero), one);
+        const __m128i res = at_least(neighbour_count(curp, cur, curn, xx), erosion_threshold);
+        _mm_storeu_si128((__m128i *)(dst + xx), _mm_and_si128(set, res));
+    }
+    for (; xx < width - 1; xx++)
+    {
+        if (cur[xx] == 0)
+        {
+            dst[xx] = 0;
+            continue;
+        }
+
+        const int count = curp[xx-1] + curp[xx] + curp[xx+1] +
+                          cur [xx-1] +            cur [xx+1] +
+                          curn[xx-1] + curn[xx] + curn[xx+1];
+
+        dst[xx] = count >= erosion_threshold;
+    }
+}
+
+static int block_score_sse2(const uint8_t *mask, int stride, int block_width,
+                            int block_height, int left_edge, int filtered)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int score = 0;
+
+    for (int block_y = 0; block_y < block_height; block_y++)
+    {
+        const uint8_t *mask_p = &mask[block_y * stride];
+        int block_x = 0;
+
+        if (filtered)
+        {
+            for (; block_x + 16 <= block_width; block_x += 16)
+            {
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(load16(mask_p + block_x), zero));
+            }
+            for (; block_x < block_width; block_x++)
+            {
+                score += mask_p[block_x];
+            }
+            continue;
+        }
+
+        // A pixel only counts when its horizontal neighbours are set too
+        if (left_edge)
+        {
+            score += mask_p[0] & mask_p[1];
+            block_x++;
+        }
+        for (; block_x + 16 <= block_width; block_x += 16)
+        {
+            const __m128i v = _mm_and_si128(_mm_and_si128(load16(mask_p + block_x - 1),
+                                                          load16(mask_p + block_x)),
+                                            load16(mask_p + block_x + 1));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        }
+        for (; block_x < block_width; block_x++)
+        {
+            score += mask_p[block_x - 1] & mask_p[block_x] & mask_p[block_x + 1];
+        }
+    }
+
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+    return score + _mm_cvtsi128_si32(acc);
+}
+
+void comb_detect_init_x86(CombDetectFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2)
+    {
+        functions->mask_filter_row = mask_filter_row_sse2;
+        functions->mask_dilate_row = mask_dilate_row_sse2;
+        functions->mask_erode_row  = mask_erode_row_sse2;
+        functions->block_score     = block_score_sse2;
+        hb_log("comb detect using SSE2 optimizations");
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->detect_combed_row_8        = detect_combed_row_8_avx2;
+        functions->detect_combed_row_16       = detect_combed_row_16_avx2;
+        functions->detect_gamma_combed_row_8  = detect_gamma_combed_row_8_avx2;
+        functions->detect_gamma_combed_row_16 = detect_gamma_combed_row_16_avx2;
+        hb_log("comb detect using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
@@ -28,6 +28,7 @@ hb_filter_object_t hb_filter_crop_scale =
     .id                = HB_FILTER_CROP_SCALE,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Crop and Scale",
     .settings          = NULL,
     .init              = crop_scale_init,
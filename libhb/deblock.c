@@ -21,6 +21,7 @@ hb_filter_object_t hb_filter_deblock =
     .id                = HB_FILTER_DEBLOCK,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Deblock",
     .settings          = NULL,
     .init              = deblock_init,
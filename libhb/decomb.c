@@ -73,6 +73,49 @@ which will feed EEDI2 interpolations to yadif.
 #define TMP2PF 3
 #define DST2MPF 4
 
+// Smallest band of rows of the half-height planes an eedi2 thread filters
+#define EEDI2_BAND_HEIGHT_MIN 8
+
+// EEDI2 passes, each one runs in bands across the eedi2 threads
+// and waits for all the bands of the previous one to finish
+enum
+{
+    EEDI2_FILL_HALF_HEIGHT,
+    EEDI2_BUILD_EDGE_MASK,
+    EEDI2_ERODE_EDGE_MASK,
+    EEDI2_DILATE_EDGE_MASK,
+    EEDI2_ERODE_EDGE_MASK_2,
+    EEDI2_REMOVE_SMALL_GAPS,
+    EEDI2_CALC_DIRECTIONS,
+    EEDI2_FILTER_DIR_MAP,
+    EEDI2_EXPAND_DIR_MAP,
+    EEDI2_FILTER_MAP,
+    EEDI2_UPSCALE_BY_2,
+    EEDI2_MARK_DIRECTIONS_2X,
+    EEDI2_FILTER_DIR_MAP_2X,
+    EEDI2_EXPAND_DIR_MAP_2X,
+    EEDI2_FILL_GAPS_2X,
+    EEDI2_FILL_GAPS_2X_2,
+    EEDI2_INTERPOLATE_LATTICE,
+    // post_processing 1 and 3
+    EEDI2_POST_BIT_BLIT,
+    EEDI2_POST_FILTER_DIR_MAP_2X,
+    EEDI2_POST_EXPAND_DIR_MAP_2X,
+    EEDI2_POST_PROCESS,
+    // post_processing 2 and 3
+    EEDI2_BLUR_HORIZONTAL,
+    EEDI2_BLUR_VERTICAL,
+    EEDI2_CALC_DERIVATIVES,
+    EEDI2_BLUR_X2_HORIZONTAL,
+    EEDI2_BLUR_X2_VERTICAL,
+    EEDI2_BLUR_Y2_HORIZONTAL,
+    EEDI2_BLUR_Y2_VERTICAL,
+    EEDI2_BLUR_XY_HORIZONTAL,
+    EEDI2_BLUR_XY_VERTICAL,
+    EEDI2_POST_PROCESS_CORNER,
+    EEDI2_STAGE_COUNT
+};
+
 typedef struct yadif_arguments_s
 {
     hb_buffer_t *dst;
@@ -85,7 +128,6 @@ typedef struct eedi2_thread_arg_s
 {
     taskset_thread_arg_t arg;
     hb_filter_private_t *pv;
-    int plane;
 } eedi2_thread_arg_t;
 
 typedef struct yadif_thread_arg_s
@@ -129,12 +171,13 @@ struct hb_filter_private_s
     hb_buffer_t        *ref[3];
 
     const void         *eedi_limlut;
+    EEDI2Functions      eedi2_functions;
     hb_buffer_t        *eedi_half[4];
     hb_buffer_t        *eedi_full[5];
-    int                *cx2;
-    int                *cy2;
-    int                *cxy;
-    int                *tmpc;
+    int                *cx2[3];
+    int                *cy2[3];
+    int                *cxy[3];
+    int                *tmpc[3];
 
     const void         *crop_table;
     int                 cpu_count;
@@ -149,7 +192,9 @@ struct hb_filter_private_s
     taskset_t           yadif_taskset;     // Threads for Yadif - one per CPU
     yadif_arguments_t  *yadif_arguments;   // Arguments to thread for work
 
-    taskset_t           eedi2_taskset;     // Threads for eedi2 - one per plane
+    taskset_t           eedi2_taskset;     // Threads for eedi2 - one per band
+    int                 eedi2_threads;
+    int                 eedi2_stage;       // Pass the eedi2 threads run
 
     hb_buffer_list_t    out_list;
 
@@ -177,7 +222,8 @@ static const char decomb_template[] =
     "magnitude-thresh=^"HB_INT_REG"$:variance-thresh=^"HB_INT_REG"$:"
     "laplacian-thresh=^"HB_INT_REG"$:dilation-thresh=^"HB_INT_REG"$:"
     "erosion-thresh=^"HB_INT_REG"$:noise-thresh=^"HB_INT_REG"$:"
-    "search-distance=^"HB_INT_REG"$:postproc=^([0-3])$:parity=^([01])$";
+    "search-distance=^"HB_INT_REG"$:postproc=^([0-3])$:parity=^([01])$:"
+    "threads=^"HB_INT_REG"$";
 
 hb_filter_object_t hb_filter_decomb =
 {
@@ -191,6 +237,14 @@ hb_filter_object_t hb_filter_decomb =
     .settings_template = decomb_template,
 };
 
+// Rows of a plane filtered by an eedi2 thread
+static inline void eedi2_band(hb_filter_private_t *pv, int band, int height,
+                              int *y_start, int *y_stop)
+{
+    *y_start = height * band / pv->eedi2_threads;
+    *y_stop  = height * (band + 1) / pv->eedi2_threads;
+}
+
 static void store_ref(hb_filter_private_t *pv, hb_buffer_t *b)
 {
     hb_buffer_close(&pv->ref[0]);
@@ -216,6 +270,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
         return -1;
     }
     hb_filter_private_t *pv = filter->private_data;
+    taskset_budget_t *budget = init->job != NULL ? init->job->filter_budget : NULL;
     pv->input                = *init;
     hb_buffer_list_clear(&pv->out_list);
 
@@ -240,6 +295,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
     pv->maximum_search_distance = 24;
     pv->post_processing         = 1;
     pv->parity                  = PARITY_DEFAULT;
+    pv->eedi2_threads           = 0;
 
     if (filter->settings)
     {
@@ -268,6 +324,8 @@ static int hb_decomb_init(hb_filter_object_t *filter,
                                 "search-distance");
             hb_dict_extract_int(&pv->post_processing, dict,
                                 "postproc");
+            hb_dict_extract_int(&pv->eedi2_threads, dict,
+                                "threads");
         }
     }
 
@@ -335,6 +393,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
         hb_error("decomb yadif could not initialize taskset");
         return -1;
     }
+    taskset_set_budget(&pv->yadif_taskset, budget);
 
     yadif_thread_arg_t *yadif_prev_thread_args = NULL;
     for (int ii = 0; ii < pv->cpu_count; ii++)
@@ -372,35 +431,52 @@ static int hb_decomb_init(hb_filter_object_t *filter,
 
     if (pv->mode & MODE_DECOMB_EEDI2)
     {
+        // Every plane is split in one band of rows per thread,
+        // the smallest half-height plane bounds the number of bands
+        if (pv->eedi2_threads < 1)
+        {
+            pv->eedi2_threads = pv->cpu_count;
+        }
+        const int band_rows = pv->eedi_half[SRCPF]->plane[2].height;
+        pv->eedi2_threads = MAX(1, MIN(pv->eedi2_threads, band_rows / EEDI2_BAND_HEIGHT_MIN));
+
         // Create eedi2 taskset.
-        if (taskset_init(&pv->eedi2_taskset, "eedi2_filter_segment", /*thread_count*/3,
+        if (taskset_init(&pv->eedi2_taskset, "eedi2_filter_segment", pv->eedi2_threads,
                          sizeof(eedi2_thread_arg_t), eedi2_filter_work) == 0)
         {
             hb_error("decomb eedi2 could not initialize taskset");
             return -1;
         }
+        taskset_set_budget(&pv->eedi2_taskset, budget);
+        hb_log("decomb EEDI2 using %d threads", pv->eedi2_threads);
+
+        eedi2_init_functions(&pv->eedi2_functions);
 
         if (pv->post_processing > 1)
         {
-            int stride = hb_image_stride(init->pix_fmt, init->geometry.width, 0);
-
-            pv->cx2 = (int *)eedi2_aligned_malloc(init->geometry.height * stride * sizeof(int), 16);
-            pv->cy2 = (int *)eedi2_aligned_malloc(init->geometry.height * stride * sizeof(int), 16);
-            pv->cxy = (int *)eedi2_aligned_malloc(init->geometry.height * stride * sizeof(int), 16);
-            pv->tmpc = (int*)eedi2_aligned_malloc(init->geometry.height * stride * sizeof(int), 16);
-
-            if (!pv->cx2 || !pv->cy2 || !pv->cxy || !pv->tmpc)
+            // Derivatives of the half-height planes, the bands of all the
+            // planes are filtered at the same time so each one has its own.
+            // The blur reads a little past the end of a row, hence the extra row.
+            for (int pp = 0; pp < 3; pp++)
             {
-                hb_error("EEDI2: failed to malloc derivative arrays");
-                return -1;
-            }
-            else
-            {
-                hb_log("EEDI2: successfully malloced derivative arrays");
+                const size_t size = (pv->eedi_half[SRCPF]->plane[pp].height + 1) *
+                                    (pv->eedi_full[0]->plane[pp].stride / pv->bps) * sizeof(int);
+
+                pv->cx2[pp]  = (int *)eedi2_aligned_malloc(size, 16);
+                pv->cy2[pp]  = (int *)eedi2_aligned_malloc(size, 16);
+                pv->cxy[pp]  = (int *)eedi2_aligned_malloc(size, 16);
+                pv->tmpc[pp] = (int *)eedi2_aligned_malloc(size, 16);
+
+                if (!pv->cx2[pp] || !pv->cy2[pp] || !pv->cxy[pp] || !pv->tmpc[pp])
+                {
+                    hb_error("EEDI2: failed to malloc derivative arrays");
+                    return -1;
+                }
             }
+            hb_log("EEDI2: successfully malloced derivative arrays");
         }
 
-        for (int ii = 0; ii < 3; ii++)
+        for (int ii = 0; ii < pv->eedi2_threads; ii++)
         {
             eedi2_thread_arg_t *eedi2_thread_args;
 
@@ -468,10 +544,13 @@ static void hb_decomb_close(hb_filter_object_t *filter)
 
     if (pv->post_processing > 1  && (pv->mode & MODE_DECOMB_EEDI2))
     {
-        if (pv->cx2) eedi2_aligned_free(pv->cx2);
-        if (pv->cy2) eedi2_aligned_free(pv->cy2);
-        if (pv->cxy) eedi2_aligned_free(pv->cxy);
-        if (pv->tmpc) eedi2_aligned_free(pv->tmpc);
+        for (int pp = 0; pp < 3; pp++)
+        {
+            if (pv->cx2[pp]) eedi2_aligned_free(pv->cx2[pp]);
+            if (pv->cy2[pp]) eedi2_aligned_free(pv->cy2[pp]);
+            if (pv->cxy[pp]) eedi2_aligned_free(pv->cxy[pp]);
+            if (pv->tmpc[pp]) eedi2_aligned_free(pv->tmpc[pp]);
+        }
     }
 
     free((void *)pv->eedi_limlut);
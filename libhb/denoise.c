@@ -20,29 +20,70 @@
  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 
+/* Threading
+ *
+ * Each plane is split into column strips, one per thread. The vertical
+ * recursion runs down each column on its own, but the horizontal one
+ * runs across the whole row, so the strips are filtered as a wavefront:
+ * a strip filters row y once the strip on its left has, taking over the
+ * horizontal filter state where that strip left it. The output is the
+ * same as filtering the plane on one thread.
+ *
+ * A plane that gets a single strip and has no vector lowpass_row goes
+ * through the fused per pixel loops instead, which are faster there.
+ */
+
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
+#include "handbrake/taskset.h"
+#include "handbrake/denoise.h"
 #include "libavutil/intreadwrite.h"
 
 #define HQDN3D_SPATIAL_LUMA_DEFAULT    4.0f
 #define HQDN3D_SPATIAL_CHROMA_DEFAULT  3.0f
 #define HQDN3D_TEMPORAL_LUMA_DEFAULT   6.0f
 
+// Narrowest column strip given to a thread
+#define HQDN3D_STRIP_MIN               128
+// Rows whose horizontal recursions are computed together
+#define HQDN3D_ROWS                    4
+
 #define LUT_BITS (depth==16 ? 8 : 4)
-#define LOAD(x) (((depth == 8 ? frame_src[x] : AV_RN16A(frame_src + (x) * 2)) << (16 - depth))\
+#define LOAD_FROM(src,x) (((depth == 8 ? (src)[x] : AV_RN16A((src) + (x) * 2)) << (16 - depth))\
                  + (((1 << (16 - depth)) - 1) >> 1))
+#define LOAD(x) LOAD_FROM(frame_src, x)
 #define STORE(x,val) (depth == 8 ? frame_dst[x] = (val) >> (16 - depth) : \
                                    AV_WN16A(frame_dst + (x) * 2, (val) >> (16 - depth)))
 
+typedef struct
+{
+    taskset_thread_arg_t arg;
+    hb_filter_private_t *pv;
+    uint16_t *line;          // horizontally filtered rows of the strip
+} hqdn3d_thread_arg_t;
+
 struct hb_filter_private_s
 {
     int16_t  *hqdn3d_coef[6];
-    uint16_t *hqdn3d_line;
+    uint16_t *hqdn3d_line[3];
     uint16_t *hqdn3d_frame[3];
+    int       hqdn3d_frame_init;
 
     int hsub, vsub;
     int depth;
 
+    HQDN3DFunctions functions;
+
+    int          threads;
+    int          strips[3];
+    int         *progress[3];    // rows finished by each strip
+    uint32_t    *carry[3];       // horizontal state leaving each strip, per row
+    hb_buffer_t *src;
+    hb_buffer_t *dst;
+
+    taskset_t              taskset;
+    hqdn3d_thread_arg_t ** thread_data;
+
     hb_filter_init_t input;
     hb_filter_init_t output;
 };
@@ -56,16 +97,19 @@ static int hb_denoise_work(hb_filter_object_t *filter,
 
 static void hb_denoise_close(hb_filter_object_t *filter);
 
+static void hqdn3d_denoise_work(void *thread_args_v);
+
 static const char denoise_template[] =
     "y-spatial=^"HB_FLOAT_REG"$:cb-spatial=^"HB_FLOAT_REG"$:"
     "cr-spatial=^"HB_FLOAT_REG"$:"
     "y-temporal=^"HB_FLOAT_REG"$:cb-temporal=^"HB_FLOAT_REG"$:"
-    "cr-temporal=^"HB_FLOAT_REG"$";
+    "cr-temporal=^"HB_FLOAT_REG"$:threads=^"HB_INT_REG"$";
 
 hb_filter_object_t hb_filter_denoise =
 {
     .id                = HB_FILTER_DENOISE,
     .enforce_order     = 1,
+    .fuse              = 1,
     .name              = "Denoise (hqdn3d)",
     .settings          = NULL,
     .init              = hb_denoise_init,
@@ -98,16 +142,27 @@ static inline unsigned int hqdn3d_lowpass_mul(int prev_mul, int curr_mul, int16_
     return curr_mul + coef[d];
 }
 
-static void hqdn3d_denoise_temporal(uint8_t *frame_src, uint8_t *frame_dst,
-                                    uint16_t *frame_ant,
-                                    int w, int h, int sstride, int dstride,
-                                    int16_t *temporal, int depth)
+static void hqdn3d_lowpass_row_c(uint16_t *prev,
+                           const uint16_t *curr,
+                           const int16_t  *coef,
+                                 int       shift,
+                                 int       w)
+{
+    for (int x = 0; x < w; x++)
+    {
+        prev[x] = curr[x] + coef[(prev[x] - curr[x]) >> shift];
+    }
+}
+
+// The whole plane on one thread, with the recursions fused per pixel
+static av_always_inline void hqdn3d_denoise_temporal(uint8_t *frame_src, uint8_t *frame_dst,
+                                                     uint16_t *frame_ant,
+                                                     int w, int h, int sstride, int dstride,
+                                                     int16_t *temporal, int depth)
 {
     long x, y;
     uint32_t tmp;
 
-    temporal += 256 << LUT_BITS;
-
     for (y = 0; y < h; y++)
     {
         for (x = 0; x < w; x++)
@@ -122,18 +177,15 @@ static void hqdn3d_denoise_temporal(uint8_t *frame_src, uint8_t *frame_dst,
     }
 }
 
-static void hqdn3d_denoise_spatial(uint8_t *frame_src, uint8_t *frame_dst,
-                                   uint16_t *line_ant, uint16_t *frame_ant,
-                                   int w, int h, int sstride, int dstride,
-                                   int16_t *spatial, int16_t *temporal, int depth)
+static av_always_inline void hqdn3d_denoise_spatial(uint8_t *frame_src, uint8_t *frame_dst,
+                                                    uint16_t *line_ant, uint16_t *frame_ant,
+                                                    int w, int h, int sstride, int dstride,
+                                                    int16_t *spatial, int16_t *temporal, int depth)
 {
     long x, y;
     uint32_t pixel_ant;
     uint32_t tmp;
 
-    spatial  += 256 << LUT_BITS;
-    temporal += 256 << LUT_BITS;
-
     /* First line has no top neighbor. Only left one for each tmp and last frame */
     pixel_ant = LOAD(0);
     for (x = 0; x < w; x++)
@@ -163,52 +215,274 @@ static void hqdn3d_denoise_spatial(uint8_t *frame_src, uint8_t *frame_dst,
     }
 }
 
-static void hqdn3d_denoise_depth(uint8_t *frame_src, uint8_t *frame_dst,
-                                 uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                                 int w, int h, int sstride, int dstride,
-                                 int16_t *spatial, int16_t *temporal, int depth)
+// Waits until the strip on the left has finished row y
+static void hqdn3d_wait(int *progress, int y)
 {
-    long x, y;
-    uint16_t *frame_ant = (*frame_ant_ptr);
+    int spins = 0;
 
-    if (!frame_ant)
+    while (hb_atomic_load(progress) <= y)
     {
-        uint8_t *src = frame_src;
-        (*frame_ant_ptr) = frame_ant = calloc(w * h, sizeof(uint16_t));
-        for (y = 0; y < h; y++, frame_src += sstride, frame_ant += w)
+        if (++spins < 1024)
         {
-            for (x = 0; x < w; x++)
-            {
-                frame_ant[x] = LOAD(x);
-            }
+            hb_cpu_relax();
+        }
+        else
+        {
+            hb_yield();
         }
-        frame_src = src;
-        frame_ant = *frame_ant_ptr;
     }
+}
+
+// Horizontally filters row x0 to x1 of src into dst, starting from *state
+static av_always_inline void hqdn3d_horizontal(const uint8_t *src, uint16_t *dst,
+                                               uint32_t *state, int x0, int x1,
+                                               int w, int16_t *spatial, int depth)
+{
+    const int xe = MIN(x1, w - 1);
+    uint32_t pixel_ant = *state;
+    int x;
 
-    /* If no spatial coefficients, do temporal denoise only */
-    if (spatial[0])
+    for (x = x0; x < xe; x++)
     {
-        hqdn3d_denoise_spatial(frame_src, frame_dst, line_ant, frame_ant,
-                               w, h, sstride, dstride, spatial, temporal, depth);
+        dst[x - x0] = pixel_ant;
+        pixel_ant   = hqdn3d_lowpass_mul(pixel_ant, LOAD_FROM(src, x+1), spatial, depth);
     }
-    else
+    if (x < x1)
     {
-        hqdn3d_denoise_temporal(frame_src, frame_dst, frame_ant,
-                                w, h, sstride, dstride, temporal, depth);
+        dst[x - x0] = pixel_ant;
+    }
+    *state = pixel_ant;
+}
+
+// Same for HQDN3D_ROWS rows at once, which overlaps the latency of the
+// lookups of each row with the others
+static av_always_inline void hqdn3d_horizontal4(const uint8_t *src, int stride,
+                                                uint16_t *dst, int dst_stride,
+                                                uint32_t *state, int x0, int x1,
+                                                int w, int16_t *spatial, int depth)
+{
+    const uint8_t *src0 = src,  *src1 = src  + stride;
+    const uint8_t *src2 = src1 + stride, *src3 = src2 + stride;
+    uint16_t *dst0 = dst - x0,  *dst1 = dst0 + dst_stride;
+    uint16_t *dst2 = dst1 + dst_stride, *dst3 = dst2 + dst_stride;
+    uint32_t ant0 = state[0], ant1 = state[1], ant2 = state[2], ant3 = state[3];
+    const int xe = MIN(x1, w - 1);
+    int x;
+
+    for (x = x0; x < xe; x++)
+    {
+        dst0[x] = ant0;
+        dst1[x] = ant1;
+        dst2[x] = ant2;
+        dst3[x] = ant3;
+        ant0 = hqdn3d_lowpass_mul(ant0, LOAD_FROM(src0, x+1), spatial, depth);
+        ant1 = hqdn3d_lowpass_mul(ant1, LOAD_FROM(src1, x+1), spatial, depth);
+        ant2 = hqdn3d_lowpass_mul(ant2, LOAD_FROM(src2, x+1), spatial, depth);
+        ant3 = hqdn3d_lowpass_mul(ant3, LOAD_FROM(src3, x+1), spatial, depth);
+    }
+    if (x < x1)
+    {
+        dst0[x] = ant0;
+        dst1[x] = ant1;
+        dst2[x] = ant2;
+        dst3[x] = ant3;
+    }
+    state[0] = ant0;
+    state[1] = ant1;
+    state[2] = ant2;
+    state[3] = ant3;
+}
+
+static int hqdn3d_strip_start(int w, int strips, int strip)
+{
+    // Keep strip boundaries aligned for the vector code
+    return strip < strips ? (int)((int64_t)w * strip / strips) & ~15 : w;
+}
+
+static void hqdn3d_denoise_strip(hb_filter_private_t *pv, uint16_t *line,
+                                 int c, int strip, int depth)
+{
+    const int strips = pv->strips[c];
+    if (strip >= strips)
+    {
+        return;
+    }
+
+    const int w       = AV_CEIL_RSHIFT(pv->src->f.width,  (!!c * pv->hsub));
+    const int h       = AV_CEIL_RSHIFT(pv->src->f.height, (!!c * pv->vsub));
+    const int x0      = hqdn3d_strip_start(w, strips, strip);
+    const int x1      = hqdn3d_strip_start(w, strips, strip + 1);
+    const int sw      = x1 - x0;
+    const int sstride = pv->src->plane[c].stride;
+    const int dstride = pv->dst->plane[c].stride;
+    const int shift   = 8 - LUT_BITS;
+
+    uint8_t  *frame_src = pv->src->plane[c].data;
+    uint8_t  *frame_dst = pv->dst->plane[c].data;
+    uint16_t *frame_ant = pv->hqdn3d_frame[c];
+    uint16_t *line_ant  = pv->hqdn3d_line[c];
+    int16_t  *spatial   = pv->hqdn3d_coef[c * 2];
+    int16_t  *temporal  = pv->hqdn3d_coef[c * 2 + 1] + (256 << LUT_BITS);
+    const int use_spatial = spatial[0];
+
+    spatial += 256 << LUT_BITS;
+
+    if (strips == 1 && pv->functions.lowpass_row == hqdn3d_lowpass_row_c)
+    {
+        if (pv->hqdn3d_frame_init)
+        {
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    frame_ant[y * w + x] = LOAD_FROM(frame_src + y * sstride, x);
+                }
+            }
+        }
+        if (use_spatial)
+        {
+            hqdn3d_denoise_spatial(frame_src, frame_dst, line_ant, frame_ant,
+                                   w, h, sstride, dstride, spatial, temporal, depth);
+        }
+        else
+        {
+            hqdn3d_denoise_temporal(frame_src, frame_dst, frame_ant,
+                                    w, h, sstride, dstride, temporal, depth);
+        }
+        return;
+    }
+
+    int      *progress  = &pv->progress[c][strip];
+    uint32_t *carry_in  = strip > 0          ? pv->carry[c] + (strip - 1) * h : NULL;
+    uint32_t *carry_out = strip < strips - 1 ? pv->carry[c] +  strip      * h : NULL;
+
+    int rows;
+    for (int y = 0; y < h; y += rows)
+    {
+        // The first line is filtered on its own
+        rows = y == 0 ? 1 : MIN(HQDN3D_ROWS, h - y);
+
+        if (pv->hqdn3d_frame_init)
+        {
+            for (int r = 0; r < rows; r++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    frame_ant[r * w + x] = LOAD_FROM(frame_src + r * sstride, x);
+                }
+            }
+        }
+
+        /* If no spatial coefficients, do temporal denoise only */
+        if (!use_spatial)
+        {
+            for (int r = 0; r < rows; r++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    line[r * sw + x - x0] = LOAD_FROM(frame_src + r * sstride, x);
+                }
+                pv->functions.lowpass_row(frame_ant + r * w + x0, line + r * sw,
+                                          temporal, shift, sw);
+            }
+        }
+        else
+        {
+            uint32_t pixel_ant[HQDN3D_ROWS];
+
+            if (strip > 0)
+            {
+                hqdn3d_wait(progress - 1, y + rows - 1);
+            }
+            for (int r = 0; r < rows; r++)
+            {
+                pixel_ant[r] = strip > 0 ? carry_in[y + r] :
+                                           LOAD_FROM(frame_src + r * sstride, 0);
+            }
+
+            if (y == 0)
+            {
+                /* First line has no top neighbor. Only left one for each tmp and last frame */
+                for (int x = x0; x < x1; x++)
+                {
+                    line_ant[x] = pixel_ant[0] = hqdn3d_lowpass_mul(pixel_ant[0], LOAD(x), spatial, depth);
+                }
+            }
+            else
+            {
+                // Horizontal recursion, serial along each row
+                if (rows == HQDN3D_ROWS)
+                {
+                    hqdn3d_horizontal4(frame_src, sstride, line, sw, pixel_ant,
+                                       x0, x1, w, spatial, depth);
+                }
+                else
+                {
+                    for (int r = 0; r < rows; r++)
+                    {
+                        hqdn3d_horizontal(frame_src + r * sstride, line + r * sw,
+                                          &pixel_ant[r], x0, x1, w, spatial, depth);
+                    }
+                }
+            }
+
+            // Hand the horizontal state over to the next strip
+            if (carry_out != NULL)
+            {
+                for (int r = 0; r < rows; r++)
+                {
+                    carry_out[y + r] = pixel_ant[r];
+                }
+                hb_atomic_store(progress, y + rows);
+            }
+
+            // Vertical recursion, independent for each column
+            for (int r = 0; r < rows; r++)
+            {
+                if (y > 0)
+                {
+                    pv->functions.lowpass_row(line_ant + x0, line + r * sw,
+                                              spatial, shift, sw);
+                }
+                pv->functions.lowpass_row(frame_ant + r * w + x0, line_ant + x0,
+                                          temporal, shift, sw);
+            }
+        }
+
+        for (int r = 0; r < rows; r++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                STORE(x, frame_ant[x]);
+            }
+            frame_src += sstride;
+            frame_dst += dstride;
+            frame_ant += w;
+        }
     }
 }
 
 #define hqdn3d_denoise(...)                                             \
         switch (pv->depth) {                                            \
-            case  8: hqdn3d_denoise_depth(__VA_ARGS__,  8); break;      \
-            case  9: hqdn3d_denoise_depth(__VA_ARGS__,  9); break;      \
-            case 10: hqdn3d_denoise_depth(__VA_ARGS__, 10); break;      \
-            case 12: hqdn3d_denoise_depth(__VA_ARGS__, 12); break;      \
-            case 14: hqdn3d_denoise_depth(__VA_ARGS__, 14); break;      \
-            case 16: hqdn3d_denoise_depth(__VA_ARGS__, 16); break;      \
+            case  8: hqdn3d_denoise_strip(__VA_ARGS__,  8); break;      \
+            case  9: hqdn3d_denoise_strip(__VA_ARGS__,  9); break;      \
+            case 10: hqdn3d_denoise_strip(__VA_ARGS__, 10); break;      \
+            case 12: hqdn3d_denoise_strip(__VA_ARGS__, 12); break;      \
+            case 14: hqdn3d_denoise_strip(__VA_ARGS__, 14); break;      \
+            case 16: hqdn3d_denoise_strip(__VA_ARGS__, 16); break;      \
         }                                                               \
 
+static void hqdn3d_denoise_work(void *thread_args_v)
+{
+    hqdn3d_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    const int strip = thread_data->arg.segment;
+
+    for (int c = 0; c < 3; c++)
+    {
+        hqdn3d_denoise(pv, thread_data->line, c, strip);
+    }
+}
 
 static int hb_denoise_init( hb_filter_object_t * filter,
                             hb_filter_init_t * init )
@@ -261,7 +535,8 @@ static int hb_denoise_init( hb_filter_object_t * filter,
 
     for (i = 0; i < 6; i++)
     {
-        pv->hqdn3d_coef[i] = av_malloc((512<<LUT_BITS) * sizeof(int16_t));
+        // One spare entry for the vector code, see denoise_x86.c
+        pv->hqdn3d_coef[i] = av_mallocz(((512<<LUT_BITS) + 1) * sizeof(int16_t));
         if (!pv->hqdn3d_coef[i])
         {
             return 0;
@@ -275,6 +550,48 @@ static int hb_denoise_init( hb_filter_object_t * filter,
     hqdn3d_precalc_coef(pv->hqdn3d_coef[4], pv->depth, spatial_chroma_r);
     hqdn3d_precalc_coef(pv->hqdn3d_coef[5], pv->depth, temporal_chroma_r);
 
+    pv->functions.lowpass_row = hqdn3d_lowpass_row_c;
+#if defined(ARCH_X86)
+    hqdn3d_init_x86(&pv->functions);
+#endif
+
+    // Threads
+    pv->threads = 0;
+    hb_dict_extract_int(&pv->threads, filter->settings, "threads");
+    if (pv->threads < 1)
+    {
+        pv->threads = hb_get_cpu_count();
+    }
+    pv->threads = MAX(1, MIN(pv->threads, init->geometry.width / HQDN3D_STRIP_MIN));
+
+    pv->thread_data = calloc(pv->threads, sizeof(hqdn3d_thread_arg_t *));
+    if (pv->thread_data == NULL ||
+        taskset_init(&pv->taskset, "hqdn3d_filter_segment", pv->threads,
+                     sizeof(hqdn3d_thread_arg_t), hqdn3d_denoise_work) == 0)
+    {
+        hb_error("denoise could not initialize taskset");
+        return -1;
+    }
+    taskset_set_budget(&pv->taskset,
+                       init->job != NULL ? init->job->filter_budget : NULL);
+    for (i = 0; i < pv->threads; i++)
+    {
+        pv->thread_data[i] = taskset_thread_args(&pv->taskset, i);
+        pv->thread_data[i]->pv = pv;
+        pv->thread_data[i]->arg.taskset = &pv->taskset;
+        pv->thread_data[i]->arg.segment = i;
+        pv->thread_data[i]->line = malloc(HQDN3D_ROWS * init->geometry.width * sizeof(uint16_t));
+        if (pv->thread_data[i]->line == NULL)
+        {
+            hb_error("denoise: malloc failed");
+            return -1;
+        }
+    }
+    if (pv->threads > 1)
+    {
+        hb_log("hqdn3d using %d threads", pv->threads);
+    }
+
     pv->output = *init;
 
     return 0;
@@ -295,25 +612,25 @@ static void hb_denoise_close(hb_filter_object_t * filter)
         av_freep(&pv->hqdn3d_coef[i]);
     }
 
-	if (pv->hqdn3d_line)
-    {
-        free(pv->hqdn3d_line);
-        pv->hqdn3d_line = NULL;
-    }
-	if (pv->hqdn3d_frame[0])
-    {
-        free(pv->hqdn3d_frame[0]);
-        pv->hqdn3d_frame[0] = NULL;
-    }
-	if (pv->hqdn3d_frame[1])
+    if (pv->thread_data != NULL)
     {
-        free(pv->hqdn3d_frame[1]);
-        pv->hqdn3d_frame[1] = NULL;
+        taskset_fini(&pv->taskset);
+        for (i = 0; i < pv->threads; i++)
+        {
+            if (pv->thread_data[i] != NULL)
+            {
+                free(pv->thread_data[i]->line);
+            }
+        }
+        free(pv->thread_data);
     }
-	if (pv->hqdn3d_frame[2])
+
+    for (i = 0; i < 3; i++)
     {
-        free(pv->hqdn3d_frame[2]);
-        pv->hqdn3d_frame[2] = NULL;
+        free(pv->hqdn3d_line[i]);
+        free(pv->hqdn3d_frame[i]);
+        free(pv->progress[i]);
+        free(pv->carry[i]);
     }
 
     free(pv);
@@ -341,27 +658,38 @@ static int hb_denoise_work(hb_filter_object_t *filter,
     out->f.color_range     = pv->output.color_range;
     out->f.chroma_location = pv->output.chroma_location;
 
-    if (!pv->hqdn3d_line)
+    pv->hqdn3d_frame_init = pv->hqdn3d_frame[0] == NULL;
+
+    for (int c = 0; c < 3; c++)
     {
-        pv->hqdn3d_line = malloc(in->plane[0].stride * sizeof(uint16_t));
-    }
+        const int w = AV_CEIL_RSHIFT(in->f.width,  (!!c * pv->hsub));
+        const int h = AV_CEIL_RSHIFT(in->f.height, (!!c * pv->vsub));
 
-    int c, coef_index;
+        if (pv->hqdn3d_frame_init)
+        {
+            pv->strips[c]       = MAX(1, MIN(pv->threads, w / HQDN3D_STRIP_MIN));
+            pv->hqdn3d_line[c]  = malloc(w * sizeof(uint16_t));
+            pv->hqdn3d_frame[c] = malloc(w * h * sizeof(uint16_t));
+            pv->progress[c]     = calloc(pv->strips[c], sizeof(int));
+            pv->carry[c]        = malloc(pv->strips[c] * h * sizeof(uint32_t));
+        }
+        for (int strip = 0; strip < pv->strips[c]; strip++)
+        {
+            pv->progress[c][strip] = 0;
+        }
+    }
 
-    for (c = 0; c < 3; c++)
+    pv->src = in;
+    pv->dst = out;
+    if (pv->threads > 1)
+    {
+        taskset_cycle(&pv->taskset);
+    }
+    else
     {
-        coef_index = c * 2;
-        hqdn3d_denoise(in->plane[c].data,
-                       out->plane[c].data,
-                       pv->hqdn3d_line,
-                       &pv->hqdn3d_frame[c],
-                       AV_CEIL_RSHIFT(in->f.width, (!!c * pv->hsub)),
-                       AV_CEIL_RSHIFT(in->f.height, (!!c * pv->vsub)),
-                       in->plane[c].stride,
-                       out->plane[c].stride,
-                       pv->hqdn3d_coef[coef_index],
-                       pv->hqdn3d_coef[coef_index+1]);
+        hqdn3d_denoise_work(pv->thread_data[0]);
     }
+    pv->hqdn3d_frame_init = 0;
 
     hb_buffer_copy_props(out, in);
     *buf_out = out;
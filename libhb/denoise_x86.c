@@ -0,0 +1,76 @@
+/* denoise_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/denoise.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// The coefficients are gathered as 32 bit values at 16 bit offsets, which
+// reads one coefficient past the looked up one. The tables are allocated
+// with a spare entry at the end for this.
+static TARGET_AVX2 void hqdn3d_lowpass_row_avx2(uint16_t *prev,
+                                          const uint16_t *curr,
+                                          const int16_t  *coef,
+                                                int       shift,
+                                                int       w)
+{
+    const __m128i v_shift = _mm_cvtsi32_si128(shift);
+    const __m256i low16   = _mm256_set1_epi32(0xffff);
+    int x;
+
+    for (x = 0; x + 16 <= w; x += 16)
+    {
+        __m256i p_lo, p_hi, c_lo, c_hi, d_lo, d_hi;
+
+        p_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(prev + x)));
+        p_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(prev + x + 8)));
+        c_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(curr + x)));
+        c_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(curr + x + 8)));
+
+        d_lo = _mm256_sra_epi32(_mm256_sub_epi32(p_lo, c_lo), v_shift);
+        d_hi = _mm256_sra_epi32(_mm256_sub_epi32(p_hi, c_hi), v_shift);
+        d_lo = _mm256_i32gather_epi32((const int *)coef, d_lo, 2);
+        d_hi = _mm256_i32gather_epi32((const int *)coef, d_hi, 2);
+
+        // Sign extend the coefficients, add and keep 16 bits like the
+        // scalar store does
+        d_lo = _mm256_srai_epi32(_mm256_slli_epi32(d_lo, 16), 16);
+        d_hi = _mm256_srai_epi32(_mm256_slli_epi32(d_hi, 16), 16);
+        d_lo = _mm256_and_si256(_mm256_add_epi32(c_lo, d_lo), low16);
+        d_hi = _mm256_and_si256(_mm256_add_epi32(c_hi, d_hi), low16);
+
+        _mm256_storeu_si256((__m256i *)(prev + x),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi32(d_lo, d_hi), 0xd8));
+    }
+
+    for (; x < w; x++)
+    {
+        prev[x] = curr[x] + coef[(prev[x] - curr[x]) >> shift];
+    }
+}
+
+void hqdn3d_init_x86(HQDN3DFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->lowpass_row = hqdn3d_lowpass_row_avx2;
+        hb_log("hqdn3d using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
@@ -9,6 +9,8 @@
 
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
+#include "handbrake/taskset.h"
+#include "handbrake/detelecine.h"
 
 /*
  *
@@ -24,6 +26,9 @@
 
 #define PULLUP_ABS( a ) (((a)^((a)>>31))-((a)>>31))
 
+/* Metrics of the fields of a frame, computed together before deciding */
+#define PULLUP_MAX_METRICS   9
+
 #ifndef PIC_FLAG_REPEAT_FIRST_FIELD
 #define PIC_FLAG_REPEAT_FIRST_FIELD 256
 #endif
@@ -48,6 +53,20 @@ struct pullup_field
     struct pullup_field *prev, *next;
 };
 
+/* A metric of a submitted field, waiting to be computed */
+struct pullup_metric
+{
+    uint8_t *a, *b;
+    void (*func)(const void *, const void *, int, int, int *);
+    int *dest;
+};
+
+typedef struct pullup_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    struct pullup_context *c;
+} pullup_thread_arg_t;
+
 struct pullup_frame
 {
     int lock;
@@ -74,14 +93,20 @@ struct pullup_context
     int strict_breaks;
     int strict_pairs;
     int parity;
+    int threads;
+    taskset_budget_t *budget;
     /* Internal data */
     struct pullup_field *first, *last, *head;
     struct pullup_buffer *buffers;
     int nbuffers;
-    int (*diff)(void *, void *, int);
-    int (*comb)(void *, void *, int);
-    int (*var)(void *, void *, int);
+    DetelecineFunctions functions;
+    void (*diff)(const void *, const void *, int, int, int *);
+    void (*comb)(const void *, const void *, int, int, int *);
+    void (*var)(const void *, const void *, int, int, int *);
     int metric_w, metric_h, metric_len, metric_offset;
+    struct pullup_metric metrics[PULLUP_MAX_METRICS];
+    int nmetrics;
+    taskset_t metric_taskset;   // one segment per band of block rows
     struct pullup_frame *frame;
 };
 
@@ -114,7 +139,7 @@ static const char detelecine_template[] =
     "skip-left=^"HB_INT_REG"$:skip-right=^"HB_INT_REG"$:"
     "skip-top=^"HB_INT_REG"$:skip-bottom=^"HB_INT_REG"$:"
     "strict-breaks=^"HB_BOOL_REG"$:plane=^([012])$:parity=^([01])$:"
-    "disable=^"HB_BOOL_REG"$";
+    "disable=^"HB_BOOL_REG"$:threads=^"HB_INT_REG"$";
 
 hb_filter_object_t hb_filter_detelecine =
 {
@@ -215,6 +240,27 @@ DEF_LICOMB_Y_FUNC(16)
 DEF_VAR_Y_FUNC(8)
 DEF_VAR_Y_FUNC(16)
 
+#define DEF_METRIC_ROW_FUNC(name, nbits)                                    \
+static void name##_row##_##nbits(const void *a_in, const void *b_in,       \
+                                 int s, int count, int *dest)               \
+{                                                                           \
+    const uint##nbits##_t *a = (const uint##nbits##_t *)a_in;               \
+    const uint##nbits##_t *b = (const uint##nbits##_t *)b_in;               \
+    for (int i = 0; i < count; i++)                                         \
+    {                                                                       \
+        dest[i] = name##_##nbits((void *)(a + 8 * i), (void *)(b + 8 * i), s); \
+    }                                                                       \
+}                                                                           \
+
+DEF_METRIC_ROW_FUNC(pullup_diff_y, 8)
+DEF_METRIC_ROW_FUNC(pullup_diff_y, 16)
+
+DEF_METRIC_ROW_FUNC(pullup_licomb_y, 8)
+DEF_METRIC_ROW_FUNC(pullup_licomb_y, 16)
+
+DEF_METRIC_ROW_FUNC(pullup_var_y, 8)
+DEF_METRIC_ROW_FUNC(pullup_var_y, 16)
+
 DEF_INIT_BACKGROUND_LINE_FUNC(8)
 DEF_INIT_BACKGROUND_LINE_FUNC(16)
 
@@ -226,41 +272,92 @@ static void pullup_alloc_metrics( struct pullup_context * c,
     f->var   = calloc( c->metric_len, sizeof(int) );
 }
 
+/* Computes the rows of blocks y_start to y_stop of the queued metrics */
+static void pullup_compute_metric_rows( struct pullup_context * c,
+                                        int y_start, int y_stop )
+{
+    int mp    = c->metric_plane;
+    int ystep = c->stride[mp] << 3;
+    int s     = c->stride[mp] << c->field_stride_shift; /* field stride */
+    int i, y;
+
+    for( i = 0; i < c->nmetrics; i++ )
+    {
+        struct pullup_metric * m = &c->metrics[i];
+        int * dest = m->dest + y_start * c->metric_w;
+
+        if( !m->a )
+        {
+            memset( dest, 0, (y_stop - y_start) * c->metric_w * sizeof(int) );
+            continue;
+        }
+
+        uint8_t * a = m->a + y_start * ystep;
+        uint8_t * b = m->b + y_start * ystep;
+        for( y = y_start; y < y_stop; y++ )
+        {
+            m->func( a, b, s, c->metric_w, dest );
+            dest += c->metric_w;
+            a += ystep; b += ystep;
+        }
+    }
+}
+
+static void pullup_metric_work( void * thread_args_v )
+{
+    pullup_thread_arg_t * thread_args = thread_args_v;
+    struct pullup_context * c = thread_args->c;
+    int segment = thread_args->arg.segment;
+
+    pullup_compute_metric_rows( c, c->metric_h * segment / c->threads,
+                                   c->metric_h * (segment + 1) / c->threads );
+}
+
+static void pullup_compute_pending_metrics( struct pullup_context * c )
+{
+    if( !c->nmetrics ) return;
+
+    if( c->threads > 1 )
+    {
+        taskset_cycle( &c->metric_taskset );
+    }
+    else
+    {
+        pullup_compute_metric_rows( c, 0, c->metric_h );
+    }
+    c->nmetrics = 0;
+}
+
 static void pullup_compute_metric( struct pullup_context * c,
                                    struct pullup_field * fa, int pa,
                                    struct pullup_field * fb, int pb,
-                                   int (* func)( void *,
-                                                 void *, int),
+                                   void (* func)( const void *, const void *,
+                                                  int, int, int * ),
                                    int * dest )
 {
-    uint8_t *a, *b;
-    int x, y;
-    int mp    = c->metric_plane;
-    int xstep = c->bpp[mp];
-    int ystep = c->stride[mp] << 3;
-    int s     = c->stride[mp] << c->field_stride_shift; /* field stride */
-    int w     = c->metric_w*xstep;
+    int mp = c->metric_plane;
 
     if( !fa->buffer || !fb->buffer ) return;
 
+    /* Queued and computed with the other metrics of the frame, the
+       buffers of the fields are locked until then */
+    if( c->nmetrics == PULLUP_MAX_METRICS )
+    {
+        pullup_compute_pending_metrics( c );
+    }
+    struct pullup_metric * m = &c->metrics[c->nmetrics++];
+    m->func = func;
+    m->dest = dest;
+
     /* Shortcut for duplicate fields (e.g. from RFF flag) */
     if( fa->buffer == fb->buffer && pa == pb )
     {
-        memset( dest, 0, c->metric_len * sizeof(int) );
+        m->a = m->b = NULL;
         return;
     }
 
-    a = fa->buffer->planes[mp] + pa * c->stride[mp] + c->metric_offset;
-    b = fb->buffer->planes[mp] + pb * c->stride[mp] + c->metric_offset;
-
-    for( y = c->metric_h; y; y-- )
-    {
-        for( x = 0; x < w; x += xstep )
-        {
-            *dest++ = func( a + x, b + x, s );
-        }
-        a += ystep; b += ystep;
-    }
+    m->a = fa->buffer->planes[mp] + pa * c->stride[mp] + c->metric_offset;
+    m->b = fb->buffer->planes[mp] + pb * c->stride[mp] + c->metric_offset;
 }
 
 static struct pullup_field * pullup_make_field_queue( struct pullup_context * c,
@@ -600,6 +697,37 @@ int pullup_preinit_context(struct pullup_context *c)
 int pullup_init_context(struct pullup_context *c)
 {
     int mp = c->metric_plane;
+
+    c->metric_w      = (c->w[mp] - ((c->junk_left + c->junk_right) << 3)) >> 3;
+    c->metric_h      = (c->h[mp] - ((c->junk_top + c->junk_bottom) << 1)) >> 3;
+    c->metric_offset = c->junk_left*c->bpp[mp] + (c->junk_top<<1)*c->stride[mp];
+    c->metric_len    = c->metric_w * c->metric_h;
+
+    // The metrics are computed in bands of block rows
+    if (c->threads < 1)
+    {
+        c->threads = hb_get_cpu_count();
+    }
+    c->threads = MAX(1, MIN(c->threads, c->metric_h));
+    if (c->threads > 1)
+    {
+        if (taskset_init(&c->metric_taskset, "detelecine_metric_segment", c->threads,
+                         sizeof(pullup_thread_arg_t), pullup_metric_work) == 0)
+        {
+            c->threads = 1;
+            return -1;
+        }
+        taskset_set_budget(&c->metric_taskset, c->budget);
+        for (int i = 0; i < c->threads; i++)
+        {
+            pullup_thread_arg_t *thread_args = taskset_thread_args(&c->metric_taskset, i);
+            thread_args->c = c;
+            thread_args->arg.taskset = &c->metric_taskset;
+            thread_args->arg.segment = i;
+        }
+        hb_log("detelecine using %d threads", c->threads);
+    }
+
     if ( c->nbuffers < 10 )
     {
         c->nbuffers = 10;
@@ -611,11 +739,6 @@ int pullup_init_context(struct pullup_context *c)
         return -1;
     }
 
-    c->metric_w      = (c->w[mp] - ((c->junk_left + c->junk_right) << 3)) >> 3;
-    c->metric_h      = (c->h[mp] - ((c->junk_top + c->junk_bottom) << 1)) >> 3;
-    c->metric_offset = c->junk_left*c->bpp[mp] + (c->junk_top<<1)*c->stride[mp];
-    c->metric_len    = c->metric_w * c->metric_h;
-
     c->head = pullup_make_field_queue( c, 8 );
 
     if (c->head == NULL)
@@ -647,20 +770,30 @@ int pullup_init_context(struct pullup_context *c)
         return -1;
     }
 
+    c->functions.diff_row_8  = pullup_diff_y_row_8;
+    c->functions.diff_row_16 = pullup_diff_y_row_16;
+    c->functions.comb_row_8  = pullup_licomb_y_row_8;
+    c->functions.comb_row_16 = pullup_licomb_y_row_16;
+    c->functions.var_row_8   = pullup_var_y_row_8;
+    c->functions.var_row_16  = pullup_var_y_row_16;
+#if defined(ARCH_X86)
+    detelecine_init_x86(&c->functions);
+#endif
+
     if (c->format == PULLUP_FMT_Y)
     {
         switch (c->depth)
         {
             case 8:
-                c->diff = pullup_diff_y_8;
-                c->comb = pullup_licomb_y_8;
-                c->var  = pullup_var_y_8;
+                c->diff = c->functions.diff_row_8;
+                c->comb = c->functions.comb_row_8;
+                c->var  = c->functions.var_row_8;
                 break;
 
             default:
-                c->diff = pullup_diff_y_16;
-                c->comb = pullup_licomb_y_16;
-                c->var  = pullup_var_y_16;
+                c->diff = c->functions.diff_row_16;
+                c->comb = c->functions.comb_row_16;
+                c->var  = c->functions.var_row_16;
                 break;
         }
     }
@@ -670,6 +803,11 @@ int pullup_init_context(struct pullup_context *c)
 
 void pullup_free_context( struct pullup_context * c )
 {
+    if (c->threads > 1)
+    {
+        taskset_fini(&c->metric_taskset);
+    }
+
     for (int i = 0; i < c->nbuffers; i++)
     {
         struct pullup_buffer *b = &c->buffers[i];
@@ -851,7 +989,10 @@ struct pullup_frame * pullup_get_frame( struct pullup_context * c )
 {
     int i;
     struct pullup_frame * fr = c->frame;
-    int n = pullup_decide_frame_length( c );
+    int n;
+
+    pullup_compute_pending_metrics( c );
+    n = pullup_decide_frame_length( c );
     int aff = c->first->next->affinity;
 
     if ( !n ) return 0;
@@ -994,6 +1135,7 @@ void pullup_flush_fields( struct pullup_context * c )
         f->buffer = 0;
     }
     c->first = c->last = 0;
+    c->nmetrics = 0;
 }
 
 /*
@@ -1020,6 +1162,7 @@ static int hb_detelecine_init( hb_filter_object_t * filter,
 
     // "Skip" array [top, bottom, left, right]
     int top, bottom, left, right;
+    int threads = 0;
 
     left = right = ctx->junk_left = ctx->junk_right  = 1;
     top = bottom = ctx->junk_top  = ctx->junk_bottom = 4;
@@ -1040,6 +1183,7 @@ static int hb_detelecine_init( hb_filter_object_t * filter,
     hb_dict_extract_int(&ctx->strict_breaks, filter->settings, "strict-breaks");
     hb_dict_extract_int(&ctx->metric_plane, filter->settings, "plane");
     hb_dict_extract_int(&ctx->parity, filter->settings, "parity");
+    hb_dict_extract_int(&threads, filter->settings, "threads");
 
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(init->pix_fmt);
 
@@ -1075,6 +1219,8 @@ static int hb_detelecine_init( hb_filter_object_t * filter,
         ctx->metric_plane = 0;
     }
 
+    ctx->threads = threads;
+    ctx->budget = init->job != NULL ? init->job->filter_budget : NULL;
     if (pullup_init_context(ctx))
     {
         hb_error("detelecine: pullup_init_context failed");
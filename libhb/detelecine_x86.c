@@ -0,0 +1,331 @@
+/* detelecine_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/detelecine.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// The metrics are sums of absolute differences of blocks of 8 pixels by
+// 4 field rows. All the intermediate sums are exact, so the results are
+// identical to the scalar code.
+
+static av_always_inline __m128i abs_epi16_sse2(__m128i v)
+{
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+static av_always_inline __m128i abs_epi32_sse2(__m128i v)
+{
+    const __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+// Sum of the 4 epi32 lanes of a and of b in the lanes 0 and 1
+static av_always_inline __m128i hsum2_epi32_sse2(__m128i a, __m128i b)
+{
+    const __m128i s = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    return _mm_add_epi32(s, _mm_unpackhi_epi64(s, s));
+}
+
+static void diff_row_8_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    const uint8_t *b = b_in;
+    int i = 0;
+
+    // Two blocks at a time, psadbw sums each half of the register
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 4; y++)
+        {
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + y * s + 8 * i)),
+                                                  _mm_loadu_si128((const __m128i *)(b + y * s + 8 * i))));
+        }
+        dest[i]     = _mm_cvtsi128_si32(sum);
+        dest[i + 1] = _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+    }
+    for (; i < count; i++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 4; y++)
+        {
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadl_epi64((const __m128i *)(a + y * s + 8 * i)),
+                                                  _mm_loadl_epi64((const __m128i *)(b + y * s + 8 * i))));
+        }
+        dest[i] = _mm_cvtsi128_si32(sum);
+    }
+}
+
+static void var_row_8_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 3; y++)
+        {
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + y * s + 8 * i)),
+                                                  _mm_loadu_si128((const __m128i *)(a + (y + 1) * s + 8 * i))));
+        }
+        dest[i]     = 4 * _mm_cvtsi128_si32(sum);
+        dest[i + 1] = 4 * _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+    }
+    for (; i < count; i++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 3; y++)
+        {
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadl_epi64((const __m128i *)(a + y * s + 8 * i)),
+                                                  _mm_loadl_epi64((const __m128i *)(a + (y + 1) * s + 8 * i))));
+        }
+        dest[i] = 4 * _mm_cvtsi128_si32(sum);
+    }
+}
+
+// abs(2a - b[-s] - b) + abs(2b - a - a[s]) of 8 pixels in epi16 lanes,
+// at most 1020 per lane and row
+static av_always_inline __m128i licomb8_sse2(__m128i a, __m128i an, __m128i b, __m128i bp)
+{
+    const __m128i ca = _mm_sub_epi16(_mm_add_epi16(a, a), _mm_add_epi16(bp, b));
+    const __m128i cb = _mm_sub_epi16(_mm_add_epi16(b, b), _mm_add_epi16(a, an));
+    return _mm_add_epi16(abs_epi16_sse2(ca), abs_epi16_sse2(cb));
+}
+
+static void comb_row_8_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    const uint8_t *b = b_in;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i sum0 = zero, sum1 = zero;
+        for (int y = 0; y < 4; y++)
+        {
+            const __m128i a0  = _mm_loadu_si128((const __m128i *)(a + y * s + 8 * i));
+            const __m128i an0 = _mm_loadu_si128((const __m128i *)(a + (y + 1) * s + 8 * i));
+            const __m128i b0  = _mm_loadu_si128((const __m128i *)(b + y * s + 8 * i));
+            const __m128i bp0 = _mm_loadu_si128((const __m128i *)(b + (y - 1) * s + 8 * i));
+            sum0 = _mm_add_epi16(sum0, licomb8_sse2(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(an0, zero),
+                                                    _mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(bp0, zero)));
+            sum1 = _mm_add_epi16(sum1, licomb8_sse2(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(an0, zero),
+                                                    _mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(bp0, zero)));
+        }
+        const __m128i sum = hsum2_epi32_sse2(_mm_madd_epi16(sum0, ones), _mm_madd_epi16(sum1, ones));
+        dest[i]     = _mm_cvtsi128_si32(sum);
+        dest[i + 1] = _mm_cvtsi128_si32(_mm_srli_si128(sum, 4));
+    }
+    for (; i < count; i++)
+    {
+        __m128i sum0 = zero;
+        for (int y = 0; y < 4; y++)
+        {
+            const __m128i a0  = _mm_loadl_epi64((const __m128i *)(a + y * s + 8 * i));
+            const __m128i an0 = _mm_loadl_epi64((const __m128i *)(a + (y + 1) * s + 8 * i));
+            const __m128i b0  = _mm_loadl_epi64((const __m128i *)(b + y * s + 8 * i));
+            const __m128i bp0 = _mm_loadl_epi64((const __m128i *)(b + (y - 1) * s + 8 * i));
+            sum0 = _mm_add_epi16(sum0, licomb8_sse2(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(an0, zero),
+                                                    _mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(bp0, zero)));
+        }
+        dest[i] = _mm_cvtsi128_si32(hsum2_epi32_sse2(_mm_madd_epi16(sum0, ones), zero));
+    }
+}
+
+// 16 bit pixels don't fit signed 16 bit arithmetic, they are widened to epi32
+static av_always_inline void load_epi32_sse2(const uint16_t *src, __m128i *lo, __m128i *hi)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)src);
+    *lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    *hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+}
+
+static void diff_row_16_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint16_t *a = a_in;
+    const uint16_t *b = b_in;
+
+    for (int i = 0; i < count; i++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 4; y++)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i *)(a + y * s + 8 * i));
+            const __m128i vb = _mm_loadu_si128((const __m128i *)(b + y * s + 8 * i));
+            const __m128i d  = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+            sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(d, _mm_setzero_si128()));
+            sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(d, _mm_setzero_si128()));
+        }
+        dest[i] = _mm_cvtsi128_si32(hsum2_epi32_sse2(sum, sum));
+    }
+}
+
+static void var_row_16_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint16_t *a = a_in;
+
+    for (int i = 0; i < count; i++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 3; y++)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i *)(a + y * s + 8 * i));
+            const __m128i vn = _mm_loadu_si128((const __m128i *)(a + (y + 1) * s + 8 * i));
+            const __m128i d  = _mm_or_si128(_mm_subs_epu16(va, vn), _mm_subs_epu16(vn, va));
+            sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(d, _mm_setzero_si128()));
+            sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(d, _mm_setzero_si128()));
+        }
+        dest[i] = 4 * _mm_cvtsi128_si32(hsum2_epi32_sse2(sum, sum));
+    }
+}
+
+static av_always_inline __m128i licomb16_sse2(__m128i a, __m128i an, __m128i b, __m128i bp)
+{
+    const __m128i ca = _mm_sub_epi32(_mm_add_epi32(a, a), _mm_add_epi32(bp, b));
+    const __m128i cb = _mm_sub_epi32(_mm_add_epi32(b, b), _mm_add_epi32(a, an));
+    return _mm_add_epi32(abs_epi32_sse2(ca), abs_epi32_sse2(cb));
+}
+
+static void comb_row_16_sse2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint16_t *a = a_in;
+    const uint16_t *b = b_in;
+
+    for (int i = 0; i < count; i++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int y = 0; y < 4; y++)
+        {
+            __m128i a_lo, a_hi, an_lo, an_hi, b_lo, b_hi, bp_lo, bp_hi;
+            load_epi32_sse2(a + y * s + 8 * i, &a_lo, &a_hi);
+            load_epi32_sse2(a + (y + 1) * s + 8 * i, &an_lo, &an_hi);
+            load_epi32_sse2(b + y * s + 8 * i, &b_lo, &b_hi);
+            load_epi32_sse2(b + (y - 1) * s + 8 * i, &bp_lo, &bp_hi);
+            sum = _mm_add_epi32(sum, licomb16_sse2(a_lo, an_lo, b_lo, bp_lo));
+            sum = _mm_add_epi32(sum, licomb16_sse2(a_hi, an_hi, b_hi, bp_hi));
+        }
+        dest[i] = _mm_cvtsi128_si32(hsum2_epi32_sse2(sum, sum));
+    }
+}
+
+// Stores the 4 block sums of psadbw, shifted left by shift
+static av_always_inline TARGET_AVX2 void store4_sad(int *dest, __m256i sum, int shift)
+{
+    const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m128i s = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(sum, order));
+    _mm_storeu_si128((__m128i *)dest, _mm_slli_epi32(s, shift));
+}
+
+static TARGET_AVX2 void diff_row_8_avx2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    const uint8_t *b = b_in;
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (int y = 0; y < 4; y++)
+        {
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a + y * s + 8 * i)),
+                                                        _mm256_loadu_si256((const __m256i *)(b + y * s + 8 * i))));
+        }
+        store4_sad(dest + i, sum, 0);
+    }
+    diff_row_8_sse2(a + 8 * i, b + 8 * i, s, count - i, dest + i);
+}
+
+static TARGET_AVX2 void var_row_8_avx2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    const uint8_t *b = b_in;
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (int y = 0; y < 3; y++)
+        {
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(a + y * s + 8 * i)),
+                                                        _mm256_loadu_si256((const __m256i *)(a + (y + 1) * s + 8 * i))));
+        }
+        store4_sad(dest + i, sum, 2);
+    }
+    var_row_8_sse2(a + 8 * i, b + 8 * i, s, count - i, dest + i);
+}
+
+static av_always_inline TARGET_AVX2 __m256i load16_epi16(const uint8_t *src)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)src));
+}
+
+static TARGET_AVX2 void comb_row_8_avx2(const void *a_in, const void *b_in, int s, int count, int *dest)
+{
+    const uint8_t *a = a_in;
+    const uint8_t *b = b_in;
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (int y = 0; y < 4; y++)
+        {
+            const __m256i va  = load16_epi16(a + y * s + 8 * i);
+            const __m256i van = load16_epi16(a + (y + 1) * s + 8 * i);
+            const __m256i vb  = load16_epi16(b + y * s + 8 * i);
+            const __m256i vbp = load16_epi16(b + (y - 1) * s + 8 * i);
+            const __m256i ca  = _mm256_sub_epi16(_mm256_add_epi16(va, va), _mm256_add_epi16(vbp, vb));
+            const __m256i cb  = _mm256_sub_epi16(_mm256_add_epi16(vb, vb), _mm256_add_epi16(va, van));
+            sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_abs_epi16(ca), _mm256_abs_epi16(cb)));
+        }
+        // Each 128 bit lane holds a block
+        sum = _mm256_madd_epi16(sum, _mm256_set1_epi16(1));
+        sum = _mm256_hadd_epi32(sum, sum);
+        sum = _mm256_hadd_epi32(sum, sum);
+        dest[i]     = _mm_cvtsi128_si32(_mm256_castsi256_si128(sum));
+        dest[i + 1] = _mm_cvtsi128_si32(_mm256_extracti128_si256(sum, 1));
+    }
+    comb_row_8_sse2(a + 8 * i, b + 8 * i, s, count - i, dest + i);
+}
+
+void detelecine_init_x86(DetelecineFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2)
+    {
+        functions->diff_row_8  = diff_row_8_sse2;
+        functions->diff_row_16 = diff_row_16_sse2;
+        functions->comb_row_8  = comb_row_8_sse2;
+        functions->comb_row_16 = comb_row_16_sse2;
+        functions->var_row_8   = var_row_8_sse2;
+        functions->var_row_16  = var_row_16_sse2;
+        hb_log("detelecine using SSE2 optimizations");
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->diff_row_8  = diff_row_8_avx2;
+        functions->comb_row_8  = comb_row_8_avx2;
+        functions->var_row_8   = var_row_8_avx2;
+        hb_log("detelecine using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
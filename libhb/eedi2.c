@@ -79,6 +79,21 @@ void eedi2_sort_metrics( int *order, const int length )
     }
 }
 
+/**
+ * Finds where a loop over the rows first, first + step, ... enters a band of rows
+ * @param first First row of the loop
+ * @param step Step of the loop
+ * @param y_start First row of the band
+ */
+static inline int eedi2_first_row(const int first, const int step, const int y_start)
+{
+    if (y_start <= first)
+    {
+        return first;
+    }
+    return first + (y_start - first + step - 1) / step * step;
+}
+
 #define BIT_DEPTH 8
 #include "templates/eedi2_template.c"
 #undef BIT_DEPTH
@@ -86,3 +101,13 @@ void eedi2_sort_metrics( int *order, const int length )
 #define BIT_DEPTH 16
 #include "templates/eedi2_template.c"
 #undef BIT_DEPTH
+
+void eedi2_init_functions(EEDI2Functions *functions)
+{
+    functions->search_directions_8  = eedi2_search_directions_8;
+    functions->search_directions_16 = eedi2_search_directions_16;
+
+#if defined(ARCH_X86)
+    eedi2_init_x86(functions);
+#endif
+}
@@ -0,0 +1,228 @@
+/* eedi2_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/eedi2.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static av_always_inline int pixel_at(const void *src, int x, int bps)
+{
+    return bps == 1 ? ((const uint8_t *)src)[x] : ((const uint16_t *)src)[x];
+}
+
+static av_always_inline TARGET_AVX2 __m256i load8_epi32(const void *src, int x, int bps)
+{
+    if (bps == 1)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)((const uint8_t *)src + x)));
+    }
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)((const uint16_t *)src + x)));
+}
+
+// Lane i holds src[x - i]
+static av_always_inline TARGET_AVX2 __m256i load8_reversed_epi32(const void *src, int x, int bps)
+{
+    return _mm256_permutevar8x32_epi32(load8_epi32(src, x - 7, bps),
+                                       _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// Sum of abs(a[x + k] - b[x + k + u]) for k = -1 .. 1 and the directions u .. u + 7
+static av_always_inline TARGET_AVX2 __m256i sad3_forward(const void *a, const void *b,
+                                                         int x, int u, int bps)
+{
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = -1; k <= 1; k++)
+    {
+        const __m256i va = _mm256_set1_epi32(pixel_at(a, x + k, bps));
+        const __m256i vb = load8_epi32(b, x + k + u, bps);
+        sum = _mm256_add_epi32(sum, _mm256_abs_epi32(_mm256_sub_epi32(va, vb)));
+    }
+    return sum;
+}
+
+// Sum of abs(a[x + k] - b[x + k - u]) for k = -1 .. 1 and the directions u .. u + 7
+static av_always_inline TARGET_AVX2 __m256i sad3_backward(const void *a, const void *b,
+                                                          int x, int u, int bps)
+{
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = -1; k <= 1; k++)
+    {
+        const __m256i va = _mm256_set1_epi32(pixel_at(a, x + k, bps));
+        const __m256i vb = load8_reversed_epi32(b, x + k - u, bps);
+        sum = _mm256_add_epi32(sum, _mm256_abs_epi32(_mm256_sub_epi32(va, vb)));
+    }
+    return sum;
+}
+
+static av_always_inline TARGET_AVX2 void update_min(__m256i *min, __m256i *dir,
+                                                    __m256i diff, __m256i u,
+                                                    __m256i valid)
+{
+    const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi32(*min, diff), valid);
+    *min = _mm256_blendv_epi8(*min, diff, lower);
+    *dir = _mm256_blendv_epi8(*dir, u, lower);
+}
+
+static av_always_inline TARGET_AVX2 int hmin_epi32(__m256i v)
+{
+    __m128i m = _mm_min_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(m);
+}
+
+// Every lane checks its directions in increasing order and keeps the first
+// one with its smallest metric, like the scalar code does. Of the lanes
+// with the overall smallest metric the one with the smallest direction
+// wins, so the result is identical to the scalar search.
+static av_always_inline TARGET_AVX2 void search_directions_avx2(const void *src2p, const void *srcpp,
+                                                                const void *srcp,
+                                                                const void *srcpn, const void *src2n,
+                                                                const void *mskpp, const void *mskpn,
+                                                                int x, int startu, int stopu,
+                                                                int top, int bottom, int peak,
+                                                                int min[5], int dir[5], int bps)
+{
+    const __m256i v_peak = _mm256_set1_epi32(peak);
+    const __m256i lanes  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i vmin[5], vdir[5];
+    int u;
+
+    for (int i = 0; i < 5; i++)
+    {
+        vmin[i] = _mm256_set1_epi32(min[i]);
+        vdir[i] = _mm256_set1_epi32(dir[i]);
+    }
+
+    for (u = startu; u + 7 <= stopu; u += 8)
+    {
+        const __m256i vu = _mm256_add_epi32(_mm256_set1_epi32(u), lanes);
+        __m256i valid = _mm256_set1_epi32(-1);
+
+        if (!top)
+        {
+            __m256i edge = _mm256_cmpeq_epi32(load8_epi32(mskpp, x - 1 + u, bps), v_peak);
+            edge = _mm256_or_si256(edge, _mm256_cmpeq_epi32(load8_epi32(mskpp, x + u, bps), v_peak));
+            edge = _mm256_or_si256(edge, _mm256_cmpeq_epi32(load8_epi32(mskpp, x + 1 + u, bps), v_peak));
+            valid = edge;
+        }
+        if (!bottom)
+        {
+            __m256i edge = _mm256_cmpeq_epi32(load8_reversed_epi32(mskpn, x - 1 - u, bps), v_peak);
+            edge = _mm256_or_si256(edge, _mm256_cmpeq_epi32(load8_reversed_epi32(mskpn, x - u, bps), v_peak));
+            edge = _mm256_or_si256(edge, _mm256_cmpeq_epi32(load8_reversed_epi32(mskpn, x + 1 - u, bps), v_peak));
+            valid = _mm256_and_si256(valid, edge);
+        }
+        if (_mm256_testz_si256(valid, valid))
+        {
+            continue;
+        }
+
+        const __m256i diffsn = sad3_backward(srcp, srcpn, x, u, bps);
+        const __m256i diffsp = sad3_forward(srcp, srcpp, x, u, bps);
+        const __m256i diffps = sad3_backward(srcpp, srcp, x, u, bps);
+        const __m256i diffns = sad3_forward(srcpn, srcp, x, u, bps);
+        const __m256i diff   = _mm256_add_epi32(_mm256_add_epi32(diffsn, diffsp),
+                                                _mm256_add_epi32(diffps, diffns));
+        __m256i diffd = _mm256_add_epi32(diffsp, diffns);
+        __m256i diffe = _mm256_add_epi32(diffsn, diffps);
+
+        update_min(&vmin[1], &vdir[1], diff, vu, valid);
+        if (!top)
+        {
+            const __m256i diff2pp = sad3_backward(src2p, srcpp, x, u, bps);
+            const __m256i diffp2p = sad3_forward(srcpp, src2p, x, u, bps);
+            const __m256i diffa   = _mm256_add_epi32(diff, _mm256_add_epi32(diff2pp, diffp2p));
+            diffd = _mm256_add_epi32(diffd, diffp2p);
+            diffe = _mm256_add_epi32(diffe, diff2pp);
+            update_min(&vmin[0], &vdir[0], diffa, vu, valid);
+        }
+        if (!bottom)
+        {
+            const __m256i diff2nn = sad3_forward(src2n, srcpn, x, u, bps);
+            const __m256i diffn2n = sad3_backward(srcpn, src2n, x, u, bps);
+            const __m256i diffc   = _mm256_add_epi32(diff, _mm256_add_epi32(diff2nn, diffn2n));
+            diffd = _mm256_add_epi32(diffd, diff2nn);
+            diffe = _mm256_add_epi32(diffe, diffn2n);
+            update_min(&vmin[2], &vdir[2], diffc, vu, valid);
+        }
+        update_min(&vmin[3], &vdir[3], diffd, vu, valid);
+        update_min(&vmin[4], &vdir[4], diffe, vu, valid);
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        const int m = hmin_epi32(vmin[i]);
+        if (m < min[i])
+        {
+            const __m256i best = _mm256_cmpeq_epi32(vmin[i], _mm256_set1_epi32(m));
+            min[i] = m;
+            dir[i] = hmin_epi32(_mm256_blendv_epi8(_mm256_set1_epi32(INT32_MAX), vdir[i], best));
+        }
+    }
+
+    if (u <= stopu)
+    {
+        if (bps == 1)
+        {
+            eedi2_search_directions_8(src2p, srcpp, srcp, srcpn, src2n, mskpp, mskpn,
+                                      x, u, stopu, top, bottom, peak, min, dir);
+        }
+        else
+        {
+            eedi2_search_directions_16(src2p, srcpp, srcp, srcpn, src2n, mskpp, mskpn,
+                                       x, u, stopu, top, bottom, peak, min, dir);
+        }
+    }
+}
+
+static TARGET_AVX2 void search_directions_8_avx2(const uint8_t *src2p, const uint8_t *srcpp,
+                                                 const uint8_t *srcp,
+                                                 const uint8_t *srcpn, const uint8_t *src2n,
+                                                 const uint8_t *mskpp, const uint8_t *mskpn,
+                                                 int x, int startu, int stopu,
+                                                 int top, int bottom, int peak,
+                                                 int min[5], int dir[5])
+{
+    search_directions_avx2(src2p, srcpp, srcp, srcpn, src2n, mskpp, mskpn,
+                           x, startu, stopu, top, bottom, peak, min, dir, 1);
+}
+
+static TARGET_AVX2 void search_directions_16_avx2(const uint16_t *src2p, const uint16_t *srcpp,
+                                                  const uint16_t *srcp,
+                                                  const uint16_t *srcpn, const uint16_t *src2n,
+                                                  const uint16_t *mskpp, const uint16_t *mskpn,
+                                                  int x, int startu, int stopu,
+                                                  int top, int bottom, int peak,
+                                                  int min[5], int dir[5])
+{
+    search_directions_avx2(src2p, srcpp, srcp, srcpn, src2n, mskpp, mskpn,
+                           x, startu, stopu, top, bottom, peak, min, dir, 2);
+}
+
+void eedi2_init_x86(EEDI2Functions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->search_directions_8  = search_directions_8_avx2;
+        functions->search_directions_16 = search_directions_16_avx2;
+        hb_log("eedi2 using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
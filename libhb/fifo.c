@@ -27,6 +27,8 @@
 #endif
 
 #define FIFO_TIMEOUT 200
+// Number of polls a lock-free fifo makes before parking on its condvar
+#define FIFO_SPIN_COUNT 512
 //#define HB_FIFO_DEBUG 1
 // defining HB_BUFFER_DEBUG and HB_NO_BUFFER_POOL allows tracking
 // buffer memory leaks using valgrind.  The source of the leak
@@ -50,16 +52,43 @@ struct hb_fifo_s
     uint32_t       capacity;
     uint32_t       thresh;
     uint32_t       size;
+    uint32_t       bytes;
     uint32_t       buffer_size;
     hb_buffer_t  * first;
     hb_buffer_t  * last;
 
+    // Byte budget shared with the other fifos of a job
+    // (see hb_fifo_set_budget). While the budget is exhausted the fifo
+    // reports full as soon as it holds 'reserve' buffers.
+    hb_fifo_budget_t * budget;
+    uint32_t           reserve;
+
+    // Single-producer/single-consumer mode (see hb_fifo_init_spsc).
+    // The queue is an intrusive linked list through hb_buffer_t.next
+    // that always contains at least one node. 'first' is only touched
+    // by the consumer, 'last' is only ever swapped atomically, and
+    // 'stub' is a placeholder node that the consumer re-appends so that
+    // it can unlink the final real buffer.
+    int            spsc;
+    int            spin;
+    hb_buffer_t    stub;
+
 #if defined(HB_FIFO_DEBUG)
     // Fifo list for debugging
     hb_fifo_t    * next;
 #endif
 };
 
+struct hb_fifo_budget_s
+{
+    hb_lock_t    * lock;
+    hb_list_t    * fifos;
+    int64_t        limit;
+    int64_t        bytes;
+    int64_t        peak;
+    int            waiting;
+};
+
 #if defined(HB_FIFO_DEBUG)
 static hb_fifo_t fifo_list =
 {
@@ -80,6 +109,75 @@ static hb_fifo_t fifo_list =
  * A pool of 16 elements will avoid 94% of the malloc/free calls without wasting
  * too much memory. */
 #define BUFFER_POOL_MAX_ELEMENTS 32
+/* each thread keeps a small stack ("magazine") of free buffers per pool in
+ * front of the shared pools, so the common alloc/free path takes no lock.
+ * only the owning thread touches its magazines. they exchange half their
+ * depth with the shared pool at a time, the depth shrinks for large buffer
+ * sizes so that idle threads do not hoard frame sized buffers.
+ *
+ * all magazines are registered so that other threads can read their
+ * statistics, which the owner keeps with relaxed atomic stores. the
+ * magazines of threads that never exit, like the taskset pool workers,
+ * can not be emptied by another thread. hb_buffer_pool_free() flags them
+ * instead, and the owner returns its buffers on its next alloc or free. */
+#define BUFFER_MAG_MAX_ELEMENTS 16
+#define BUFFER_MAG_MIN_ELEMENTS 2
+#define BUFFER_MAG_MAX_BYTES    (1 << 22)
+
+typedef struct
+{
+    hb_buffer_t * stack;
+    int           count;
+    int           depth;
+} buffer_mag_t;
+
+/* uncompressed frames are recycled by a separate pool keyed by their
+ * geometry. the data is allocated to the exact frame size instead of the
+ * next power of 2, and a recycled buffer is restored from a template with
+ * its planes already laid out. the frames are tagged with the id of their
+ * pool (hb_buffer_t.frame_pool) so that hb_buffer_close() can return them.
+ * the number of frames kept per geometry shrinks with the frame size, and
+ * FRAME_POOL_MAX_BYTES caps the frames kept by all geometries together.
+ *
+ * each geometry has its own lock. its key can be matched without a lock,
+ * buffers.frame_lock is only taken to set up a new geometry. */
+#define FRAME_POOL_CLASSES      8
+#define FRAME_POOL_MAX_ELEMENTS 32
+#define FRAME_POOL_MAX_BYTES    (1 << 28)
+
+typedef struct
+{
+    hb_lock_t   * lock;
+    // see frame_pool_key(), 0 == unused. written with both the pool lock
+    // and buffers.frame_lock held.
+    uint64_t      key;
+    int           id;       // tag of the frames, changes with the geometry
+    uint64_t      last_use;
+
+    int           alloc;
+    int           depth;
+    hb_buffer_t   proto;    // a freshly initialized frame, without data
+    int           offset[4];
+    hb_buffer_t * stack;
+    int           count;
+
+    // Statistics not yet folded into the global counters
+    uint64_t      allocs;
+    uint64_t      hits;
+} frame_pool_t;
+
+typedef struct buffer_mags_s buffer_mags_t;
+struct buffer_mags_s
+{
+    buffer_mag_t    mag[MAX_BUFFER_POOLS];
+    int             drain;  // set by other threads, see buffer_mags_check()
+    // Statistics of this thread, folded into buffers.stats when it exits.
+    // Only the allocator statistics are used.
+    hb_buffer_pool_stats_t stats;
+    // Registry of all magazines, protected by buffers.mags_lock
+    buffer_mags_t * prev;
+    buffer_mags_t * next;
+};
 
 struct hb_buffer_pools_s
 {
@@ -87,6 +185,16 @@ struct hb_buffer_pools_s
     hb_lock_t *lock;
 #if !defined(HB_NO_BUFFER_POOL)
     hb_fifo_t *pool[MAX_BUFFER_POOLS];
+    hb_tls_key_t *mags_key;
+    hb_lock_t *mags_lock;
+    buffer_mags_t *mags_list;
+    hb_buffer_pool_stats_t stats;
+    hb_buffer_pool_stats_t mags_base;   // registered magazines at the last reset
+    hb_lock_t *frame_lock;
+    frame_pool_t frame_pool[FRAME_POOL_CLASSES];
+    int frame_serial;
+    uint64_t frame_clock;
+    int64_t frame_bytes;    // held by all frame pools
 #endif
 #if defined(HB_BUFFER_DEBUG)
     hb_list_t *alloc_list;
@@ -98,6 +206,18 @@ struct hb_buffer_pools_s
 static int hb_fifo_contains( hb_fifo_t *f, hb_buffer_t *b );
 #endif
 
+#if !defined(HB_NO_BUFFER_POOL)
+static void buffer_mags_drain( buffer_mags_t * mags );
+static void buffer_mags_drain_all( void );
+static void buffer_mags_sum_stats( hb_buffer_pool_stats_t * stats,
+                                   int64_t * cached );
+static void buffer_mags_add_stats( hb_buffer_pool_stats_t * dst,
+                                   const hb_buffer_pool_stats_t * src,
+                                   int sign );
+static void buffer_mags_close( void * _mags );
+static hb_buffer_t * frame_pool_reset( frame_pool_t * pool );
+#endif
+
 void hb_buffer_pool_init( void )
 {
     buffers.lock = hb_lock_init();
@@ -131,6 +251,14 @@ void hb_buffer_pool_init( void )
         buffers.pool[i] = hb_fifo_init(BUFFER_POOL_MAX_ELEMENTS, 1);
         buffers.pool[i]->buffer_size = 1 << i;
     }
+
+    buffers.mags_key = hb_tls_key_init(buffer_mags_close);
+    buffers.mags_lock = hb_lock_init();
+    buffers.frame_lock = hb_lock_init();
+    for ( i = 0; i < FRAME_POOL_CLASSES; ++i )
+    {
+        buffers.frame_pool[i].lock = hb_lock_init();
+    }
 #endif
 }
 
@@ -280,7 +408,15 @@ void fifo_list_validate( void )
 void hb_buffer_pool_free( void )
 {
     int i;
-    int64_t freed = 0;
+    int64_t freed = 0, cached = 0;
+
+#if !defined(HB_NO_BUFFER_POOL)
+    hb_buffer_pool_stats_t live, stats;
+
+    // Buffers cached by other threads stay allocated until they drain
+    buffer_mags_drain_all();
+    hb_lock( buffers.mags_lock );
+#endif
 
     hb_lock(buffers.lock);
 
@@ -316,6 +452,35 @@ void hb_buffer_pool_free( void )
                     buffers.pool[i]->buffer_size);
         }
     }
+
+    hb_lock(buffers.frame_lock);
+    for (i = 0; i < FRAME_POOL_CLASSES; i++)
+    {
+        frame_pool_t * pool = &buffers.frame_pool[i];
+
+        hb_lock(pool->lock);
+        if (pool->count)
+        {
+            hb_deep_log( 2, "Freed %d frames of %dx%d format %d",
+                         pool->count, pool->proto.f.width,
+                         pool->proto.f.height, pool->proto.f.fmt);
+        }
+        buffers.stats.frame_allocs += pool->allocs;
+        buffers.stats.frame_hits   += pool->hits;
+        pool->allocs = pool->hits = 0;
+        b = frame_pool_reset(pool);
+        hb_unlock(pool->lock);
+
+        while (b != NULL)
+        {
+            hb_buffer_t * next = b->next;
+            freed += b->alloc;
+            av_free(b->data);
+            free(b);
+            b = next;
+        }
+    }
+    hb_unlock(buffers.frame_lock);
 #endif
 
 #if defined(HB_BUFFER_DEBUG) && defined(HB_NO_BUFFER_POOL)
@@ -327,32 +492,672 @@ void hb_buffer_pool_free( void )
         hb_buffer_t *b = hb_list_item(buffers.alloc_list, i);
         hb_list_rem(buffers.alloc_list, b);
     }
-#endif
+#endif
+
+#if !defined(HB_NO_BUFFER_POOL)
+    buffer_mags_sum_stats( &live, &cached );
+#endif
+
+    hb_deep_log( 2, "Allocated %"PRId64" bytes of buffers on this pass and Freed %"PRId64" bytes, "
+           "%"PRId64" bytes cached by threads, %"PRId64" bytes leaked",
+           buffers.allocated, freed, cached, buffers.allocated - freed - cached);
+    buffers.allocated = cached;
+
+#if !defined(HB_NO_BUFFER_POOL)
+    stats = buffers.stats;
+    buffer_mags_add_stats( &stats, &live, 1 );
+    buffer_mags_add_stats( &stats, &buffers.mags_base, -1 );
+    if ( stats.allocs )
+    {
+        hb_deep_log( 2, "Buffer magazines: %"PRIu64" allocations, %.1f%% from magazines, "
+               "%"PRIu64" refills, %"PRIu64" spills, %"PRIu64" mallocs, "
+               "%"PRIu64" freed on spill", stats.allocs,
+               100. * stats.hits / stats.allocs,
+               stats.refills, stats.spills,
+               stats.mallocs, stats.freed);
+    }
+    if ( stats.frame_allocs )
+    {
+        hb_deep_log( 2, "Frame pool: %"PRIu64" allocations, %.1f%% recycled",
+               stats.frame_allocs,
+               100. * stats.frame_hits / stats.frame_allocs);
+    }
+    // The next pass counts from here
+    memset(&buffers.stats, 0, sizeof(buffers.stats));
+    buffers.mags_base = live;
+#endif
+    hb_unlock(buffers.lock);
+#if !defined(HB_NO_BUFFER_POOL)
+    hb_unlock( buffers.mags_lock );
+#endif
+}
+
+static int size_to_pool_index( int size )
+{
+#if !defined(HB_NO_BUFFER_POOL)
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    int i;
+    for ( i = BUFFER_POOL_FIRST; i <= BUFFER_POOL_LAST; ++i )
+    {
+        if ( size <= (1 << i) )
+        {
+            return i;
+        }
+    }
+#endif
+    return -1;
+}
+
+static hb_fifo_t *size_to_pool( int size )
+{
+#if !defined(HB_NO_BUFFER_POOL)
+    int i = size_to_pool_index( size );
+    if ( i >= 0 )
+    {
+        return buffers.pool[i];
+    }
+#endif
+    return NULL;
+}
+
+// Releases a buffer that is not going back to a pool
+static void buffer_free( hb_buffer_t * b )
+{
+    if (b->data && b->storage_type == STANDARD)
+    {
+        av_free(b->data);
+        hb_lock(buffers.lock);
+        buffers.allocated -= b->alloc;
+        hb_unlock(buffers.lock);
+    }
+    free( b );
+}
+
+#if !defined(HB_NO_BUFFER_POOL)
+static buffer_mags_t * buffer_mags_get( void )
+{
+    buffer_mags_t * mags = hb_tls_get( buffers.mags_key );
+
+    if ( mags == NULL )
+    {
+        mags = calloc( sizeof( buffer_mags_t ), 1 );
+        if ( mags == NULL )
+        {
+            return NULL;
+        }
+
+        int i, depth;
+        mags->mag[0].depth = BUFFER_MAG_MAX_ELEMENTS;
+        for ( i = BUFFER_POOL_FIRST; i <= BUFFER_POOL_LAST; ++i )
+        {
+            depth = BUFFER_MAG_MAX_BYTES >> i;
+            mags->mag[i].depth = MIN(MAX(depth, BUFFER_MAG_MIN_ELEMENTS),
+                                     BUFFER_MAG_MAX_ELEMENTS);
+        }
+
+        hb_lock( buffers.mags_lock );
+        mags->next = buffers.mags_list;
+        if ( mags->next != NULL )
+        {
+            mags->next->prev = mags;
+        }
+        buffers.mags_list = mags;
+        hb_unlock( buffers.mags_lock );
+
+        hb_tls_set( buffers.mags_key, mags );
+    }
+    return mags;
+}
+
+// Counts into a statistic or magazine count of the calling thread.
+// Other threads read them with hb_atomic_load_relaxed().
+#define MAGS_COUNT(field, n) \
+    hb_atomic_store_relaxed( &(field), (field) + (n) )
+
+// Moves up to count buffers from the shared pool into the magazine
+static void buffer_mag_refill( buffer_mag_t * mag, hb_fifo_t * pool, int count )
+{
+    hb_buffer_t * b;
+
+    hb_lock( pool->lock );
+    while ( count-- > 0 && pool->size > 0 )
+    {
+        b           = pool->first;
+        pool->first = b->next;
+        pool->size -= 1;
+        b->next     = mag->stack;
+        mag->stack  = b;
+        MAGS_COUNT( mag->count, 1 );
+    }
+    hb_unlock( pool->lock );
+}
+
+// Moves up to count buffers from the magazine to the shared pool.
+// Whatever does not fit in the pool is freed.  Returns the number
+// of buffers freed.
+static int buffer_mag_spill( buffer_mag_t * mag, hb_fifo_t * pool, int count )
+{
+    hb_buffer_t * b, * excess = NULL;
+    int           freed = 0;
+
+    hb_lock( pool->lock );
+    while ( count-- > 0 && mag->stack != NULL )
+    {
+        b           = mag->stack;
+        mag->stack  = b->next;
+        MAGS_COUNT( mag->count, -1 );
+        if ( pool->size < pool->capacity )
+        {
+            b->next = pool->first;
+            if ( pool->size == 0 )
+            {
+                pool->last = b;
+            }
+            pool->first = b;
+            pool->size += 1;
+        }
+        else
+        {
+            b->next = excess;
+            excess  = b;
+        }
+    }
+    hb_unlock( pool->lock );
+
+    while ( excess != NULL )
+    {
+        b      = excess;
+        excess = b->next;
+        buffer_free( b );
+        freed++;
+    }
+    return freed;
+}
+
+// Returns everything cached by the calling thread to the shared pools
+static void buffer_mags_drain( buffer_mags_t * mags )
+{
+    int i;
+
+    for ( i = 0; i < MAX_BUFFER_POOLS; ++i )
+    {
+        if ( mags->mag[i].count > 0 )
+        {
+            MAGS_COUNT( mags->stats.freed,
+                        buffer_mag_spill( &mags->mag[i], buffers.pool[i],
+                                          mags->mag[i].count ) );
+        }
+    }
+}
+
+// Drains the magazines of the calling thread if another thread asked for it
+static inline void buffer_mags_check( buffer_mags_t * mags )
+{
+    if ( hb_atomic_load_relaxed( &mags->drain ) &&
+         hb_atomic_exchange( &mags->drain, 0 ) )
+    {
+        buffer_mags_drain( mags );
+    }
+}
+
+static hb_buffer_t * buffer_mag_get( int pool_index )
+{
+    buffer_mags_t * mags = buffer_mags_get();
+    buffer_mag_t  * mag;
+    hb_buffer_t   * b;
+
+    if ( mags == NULL )
+    {
+        return hb_fifo_get( buffers.pool[pool_index] );
+    }
+    buffer_mags_check( mags );
+
+    mag = &mags->mag[pool_index];
+    MAGS_COUNT( mags->stats.allocs, 1 );
+    if ( mag->stack == NULL )
+    {
+        buffer_mag_refill( mag, buffers.pool[pool_index], mag->depth / 2 );
+        MAGS_COUNT( mags->stats.refills, 1 );
+    }
+    else
+    {
+        MAGS_COUNT( mags->stats.hits, 1 );
+    }
+
+    b = mag->stack;
+    if ( b != NULL )
+    {
+        mag->stack  = b->next;
+        MAGS_COUNT( mag->count, -1 );
+        b->next     = NULL;
+    }
+    else
+    {
+        MAGS_COUNT( mags->stats.mallocs, 1 );
+    }
+    return b;
+}
+
+static void buffer_mag_put( int pool_index, hb_buffer_t * b )
+{
+    buffer_mags_t * mags = buffer_mags_get();
+    buffer_mag_t  * mag;
+
+    if ( mags == NULL )
+    {
+        buffer_mag_t tmp = { .stack = b, .count = 1 };
+        int          freed;
+
+        b->next = NULL;
+        freed   = buffer_mag_spill( &tmp, buffers.pool[pool_index], 1 );
+        hb_lock(buffers.lock);
+        buffers.stats.freed += freed;
+        hb_unlock(buffers.lock);
+        return;
+    }
+    buffer_mags_check( mags );
+
+    mag = &mags->mag[pool_index];
+    if ( mag->count >= mag->depth )
+    {
+        MAGS_COUNT( mags->stats.freed,
+                    buffer_mag_spill( mag, buffers.pool[pool_index],
+                                      mag->depth / 2 ) );
+        MAGS_COUNT( mags->stats.spills, 1 );
+    }
+    b->next     = mag->stack;
+    mag->stack  = b;
+    MAGS_COUNT( mag->count, 1 );
+}
+
+// Returns the buffers cached by the calling thread to the shared pools
+// and asks all other threads to do the same on their next alloc or free
+static void buffer_mags_drain_all( void )
+{
+    buffer_mags_t * self = hb_tls_get( buffers.mags_key );
+    buffer_mags_t * mags;
+
+    hb_lock( buffers.mags_lock );
+    for ( mags = buffers.mags_list; mags != NULL; mags = mags->next )
+    {
+        if ( mags != self )
+        {
+            hb_atomic_store( &mags->drain, 1 );
+        }
+    }
+    hb_unlock( buffers.mags_lock );
+
+    if ( self != NULL )
+    {
+        buffer_mags_drain( self );
+    }
+}
+
+// Adds up the allocator statistics of all registered magazines, and the
+// bytes they cache.  Called with buffers.mags_lock held.
+static void buffer_mags_sum_stats( hb_buffer_pool_stats_t * stats,
+                                   int64_t * cached )
+{
+    buffer_mags_t * mags;
+    int             i;
+
+    memset( stats, 0, sizeof( *stats ) );
+    if ( cached != NULL )
+    {
+        *cached = 0;
+    }
+    for ( mags = buffers.mags_list; mags != NULL; mags = mags->next )
+    {
+        stats->allocs  += hb_atomic_load_relaxed( &mags->stats.allocs );
+        stats->hits    += hb_atomic_load_relaxed( &mags->stats.hits );
+        stats->refills += hb_atomic_load_relaxed( &mags->stats.refills );
+        stats->spills  += hb_atomic_load_relaxed( &mags->stats.spills );
+        stats->mallocs += hb_atomic_load_relaxed( &mags->stats.mallocs );
+        stats->freed   += hb_atomic_load_relaxed( &mags->stats.freed );
+        for ( i = 0; cached != NULL && i <= BUFFER_POOL_LAST; ++i )
+        {
+            *cached += (int64_t)hb_atomic_load_relaxed( &mags->mag[i].count ) *
+                       buffers.pool[i]->buffer_size;
+        }
+    }
+}
+
+// Adds (sign 1) or subtracts (sign -1) allocator statistics
+static void buffer_mags_add_stats( hb_buffer_pool_stats_t * dst,
+                                   const hb_buffer_pool_stats_t * src,
+                                   int sign )
+{
+    dst->allocs  += sign * src->allocs;
+    dst->hits    += sign * src->hits;
+    dst->refills += sign * src->refills;
+    dst->spills  += sign * src->spills;
+    dst->mallocs += sign * src->mallocs;
+    dst->freed   += sign * src->freed;
+}
+
+// Thread exit destructor for buffers.mags_key
+static void buffer_mags_close( void * _mags )
+{
+    buffer_mags_t * mags = _mags;
+
+    buffer_mags_drain( mags );
+
+    hb_lock( buffers.mags_lock );
+    if ( mags->prev != NULL )
+    {
+        mags->prev->next = mags->next;
+    }
+    else
+    {
+        buffers.mags_list = mags->next;
+    }
+    if ( mags->next != NULL )
+    {
+        mags->next->prev = mags->prev;
+    }
+    // Keep the statistics of the thread
+    hb_lock(buffers.lock);
+    buffer_mags_add_stats( &buffers.stats, &mags->stats, 1 );
+    hb_unlock(buffers.lock);
+    hb_unlock( buffers.mags_lock );
+
+    free( mags );
+}
+
+// Empties a frame pool and returns the frames it held.
+// Called with the pool lock and buffers.frame_lock held.
+static hb_buffer_t * frame_pool_reset( frame_pool_t * pool )
+{
+    hb_buffer_t * stack = pool->stack;
+
+    hb_atomic_sub(&buffers.frame_bytes, (int64_t)pool->count * pool->alloc);
+    hb_atomic_store(&pool->key, 0);
+    pool->id    = 0;
+    pool->alloc = 0;
+    pool->depth = 0;
+    pool->stack = NULL;
+    pool->count = 0;
+    return stack;
+}
+
+// Packs a geometry into a frame pool key, 0 if it does not fit
+static uint64_t frame_pool_key( int pix_fmt, int width, int height )
+{
+    if (pix_fmt < 0 || pix_fmt >= 0xffff ||
+        width  <= 0 || width   >  0xffff ||
+        height <= 0 || height  >  0xffff)
+    {
+        return 0;
+    }
+    return ((uint64_t)(pix_fmt + 1) << 32) | ((uint64_t)width << 16) | height;
+}
+
+// Lays out a frame of the given geometry into the pool's template.
+static int frame_pool_setup( frame_pool_t * pool,
+                             int pix_fmt, int width, int height )
+{
+    const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(pix_fmt);
+    hb_buffer_t              * proto = &pool->proto;
+    int                        pp, size;
+
+    if (desc == NULL)
+    {
+        return -1;
+    }
+
+    memset(proto, 0, sizeof(*proto));
+    proto->s.type         = FRAME_BUF;
+    proto->s.start        = AV_NOPTS_VALUE;
+    proto->s.stop         = AV_NOPTS_VALUE;
+    proto->s.renderOffset = AV_NOPTS_VALUE;
+    proto->s.scr_sequence = -1;
+    proto->f.width        = width;
+    proto->f.height       = height;
+    proto->f.fmt          = pix_fmt;
+    for (pp = 0; pp < desc->nb_components; pp++)
+    {
+        proto->f.max_plane = MAX(proto->f.max_plane, desc->comp[pp].plane);
+    }
+
+    // Same layout as hb_buffer_init_planes()
+    size = 0;
+    for (pp = 0; pp <= proto->f.max_plane; pp++)
+    {
+        proto->plane[pp].stride = hb_image_stride(pix_fmt, width, pp);
+        proto->plane[pp].width  = hb_image_width(pix_fmt, width, pp);
+        proto->plane[pp].height = hb_image_height(pix_fmt, height, pp);
+        proto->plane[pp].size   = proto->plane[pp].stride *
+                                  proto->plane[pp].height;
+        pool->offset[pp]        = size;
+        size                   += proto->plane[pp].size;
+    }
+    proto->size = size;
+
+    // Exact size plus padding, see hb_buffer_init_internal()
+    pool->alloc = MULTIPLE_MOD_UP(size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                  HB_IMAGE_STRIDE_ALIGN);
+    pool->depth = MIN(FRAME_POOL_MAX_BYTES / pool->alloc,
+                      FRAME_POOL_MAX_ELEMENTS);
+    if (pool->depth == 0)
+    {
+        // Too large to keep any
+        return -1;
+    }
+    proto->alloc = pool->alloc;
+
+    return 0;
+}
+
+// Returns the pool for a geometry with its lock held, or NULL.
+// The frames of a geometry that had to make room are returned in
+// *evicted, to be freed once the lock is released.
+static frame_pool_t * frame_pool_lookup( int pix_fmt, int width, int height,
+                                         hb_buffer_t ** evicted )
+{
+    const uint64_t key = frame_pool_key(pix_fmt, width, height);
+    frame_pool_t * pool, * victim = NULL;
+    frame_pool_t   fresh;
+    int            ii;
+
+    if (key == 0)
+    {
+        return NULL;
+    }
+
+    for (ii = 0; ii < FRAME_POOL_CLASSES; ii++)
+    {
+        pool = &buffers.frame_pool[ii];
+        if (hb_atomic_load(&pool->key) == key)
+        {
+            hb_lock(pool->lock);
+            if (pool->key == key)
+            {
+                return pool;
+            }
+            // Replaced in the meantime
+            hb_unlock(pool->lock);
+        }
+    }
+
+    // A new geometry replaces the least recently used one
+    memset(&fresh, 0, sizeof(fresh));
+    if (frame_pool_setup(&fresh, pix_fmt, width, height) < 0)
+    {
+        return NULL;
+    }
+
+    hb_lock(buffers.frame_lock);
+    for (ii = 0; ii < FRAME_POOL_CLASSES; ii++)
+    {
+        pool = &buffers.frame_pool[ii];
+        if (pool->key == key)
+        {
+            // Set up by another thread in the meantime
+            hb_lock(pool->lock);
+            hb_unlock(buffers.frame_lock);
+            return pool;
+        }
+        if (victim == NULL || hb_atomic_load_relaxed(&pool->last_use) <
+                              hb_atomic_load_relaxed(&victim->last_use))
+        {
+            victim = pool;
+        }
+    }
+    pool = victim;
+    hb_lock(pool->lock);
+    *evicted = frame_pool_reset(pool);
+    pool->alloc = fresh.alloc;
+    pool->depth = fresh.depth;
+    pool->proto = fresh.proto;
+    memcpy(pool->offset, fresh.offset, sizeof(pool->offset));
+
+    // The id also tells which pool a frame belongs to
+    pool->id = ++buffers.frame_serial * FRAME_POOL_CLASSES +
+               (int)(pool - buffers.frame_pool);
+    pool->proto.frame_pool = pool->id;
+    hb_atomic_store(&pool->key, key);
+    hb_unlock(buffers.frame_lock);
+
+    return pool;
+}
+
+static hb_buffer_t * frame_pool_get( int pix_fmt, int width, int height )
+{
+    frame_pool_t * pool;
+    hb_buffer_t  * b, * evicted = NULL;
+    hb_buffer_t    proto;
+    int            offset[4];
+    int            ii;
+
+    pool = frame_pool_lookup(pix_fmt, width, height, &evicted);
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    hb_atomic_store(&pool->last_use, hb_atomic_add(&buffers.frame_clock, 1));
+    pool->allocs++;
+
+    b = pool->stack;
+    if (b != NULL)
+    {
+        pool->stack = b->next;
+        pool->count--;
+        pool->hits++;
+        hb_atomic_sub(&buffers.frame_bytes, pool->alloc);
+    }
+    proto = pool->proto;
+    memcpy(offset, pool->offset, sizeof(offset));
+    hb_unlock(pool->lock);
+
+    while (evicted != NULL)
+    {
+        hb_buffer_t * next = evicted->next;
+        buffer_free(evicted);
+        evicted = next;
+    }
+
+    if (b != NULL)
+    {
+        // Recycled, only the template needs to be restored
+        uint8_t * data = b->data;
+        *b = proto;
+        b->data = data;
+    }
+    else
+    {
+        b = malloc(sizeof(hb_buffer_t));
+        if (b == NULL)
+        {
+            hb_error( "out of memory" );
+            return NULL;
+        }
+        *b = proto;
+        b->data = av_malloc(b->alloc);
+        if (b->data == NULL)
+        {
+            hb_error( "out of memory" );
+            free(b);
+            return NULL;
+        }
+        hb_lock(buffers.lock);
+        buffers.allocated += b->alloc;
+        hb_unlock(buffers.lock);
+    }
+    for (ii = 0; ii <= b->f.max_plane; ii++)
+    {
+        b->plane[ii].data = b->data + offset[ii];
+    }
+
+#if defined(HB_BUFFER_DEBUG)
+    hb_lock(buffers.lock);
+    hb_list_add(buffers.alloc_list, b);
+    hb_unlock(buffers.lock);
+#endif
+    return b;
+}
+
+// Keeps a frame for reuse.  Returns 0 if its pool is gone or full,
+// or the frame pools hold FRAME_POOL_MAX_BYTES already.
+static int frame_pool_put( hb_buffer_t * b )
+{
+    frame_pool_t * pool = &buffers.frame_pool[b->frame_pool % FRAME_POOL_CLASSES];
+    int            kept = 0;
+
+    hb_lock(pool->lock);
+    if (pool->id == b->frame_pool && pool->count < pool->depth)
+    {
+        if (hb_atomic_add(&buffers.frame_bytes, pool->alloc) <=
+            FRAME_POOL_MAX_BYTES)
+        {
+            b->next     = pool->stack;
+            pool->stack = b;
+            pool->count++;
+            kept = 1;
+        }
+        else
+        {
+            hb_atomic_sub(&buffers.frame_bytes, pool->alloc);
+        }
+    }
+    hb_unlock(pool->lock);
 
-    hb_deep_log( 2, "Allocated %"PRId64" bytes of buffers on this pass and Freed %"PRId64" bytes, "
-           "%"PRId64" bytes leaked", buffers.allocated, freed, buffers.allocated - freed);
-    buffers.allocated = 0;
-    hb_unlock(buffers.lock);
+    return kept;
 }
+#endif
 
-static hb_fifo_t *size_to_pool( int size )
+void hb_buffer_pool_get_stats( hb_buffer_pool_stats_t * stats )
 {
 #if !defined(HB_NO_BUFFER_POOL)
-    if (size == 0)
-    {
-        return buffers.pool[0];
-    }
+    hb_buffer_pool_stats_t live;
+
+    // The threads that still run keep their statistics themselves
+    hb_lock( buffers.mags_lock );
+    hb_lock(buffers.lock);
+    buffer_mags_sum_stats( &live, NULL );
+    *stats = buffers.stats;
+    buffer_mags_add_stats( stats, &live, 1 );
+    buffer_mags_add_stats( stats, &buffers.mags_base, -1 );
+    hb_unlock(buffers.lock);
+    hb_unlock( buffers.mags_lock );
 
     int i;
-    for ( i = BUFFER_POOL_FIRST; i <= BUFFER_POOL_LAST; ++i )
+    for (i = 0; i < FRAME_POOL_CLASSES; i++)
     {
-        if ( size <= (1 << i) )
-        {
-            return buffers.pool[i];
-        }
+        frame_pool_t * pool = &buffers.frame_pool[i];
+
+        hb_lock(pool->lock);
+        stats->frame_allocs += pool->allocs;
+        stats->frame_hits   += pool->hits;
+        hb_unlock(pool->lock);
     }
+#else
+    memset( stats, 0, sizeof( *stats ) );
 #endif
-    return NULL;
 }
 
 hb_buffer_t * hb_buffer_init_internal( int size )
@@ -364,11 +1169,16 @@ hb_buffer_t * hb_buffer_init_internal( int size )
     // sometimes we feed data to these libraries starting from arbitrary
     // points within the buffer.
     int alloc = size ? size + AV_INPUT_BUFFER_PADDING_SIZE : 0;
+    int pool_index = size_to_pool_index( alloc );
     hb_fifo_t *buffer_pool = size_to_pool( alloc );
 
     if( buffer_pool )
     {
+#if !defined(HB_NO_BUFFER_POOL)
+        b = buffer_mag_get( pool_index );
+#else
         b = hb_fifo_get( buffer_pool );
+#endif
 
         if( b )
         {
@@ -481,6 +1291,8 @@ void hb_buffer_realloc( hb_buffer_t * b, int size )
         }
         b->data  = tmp;
         b->alloc = size;
+        // The data is no longer the frame pool's
+        b->frame_pool = 0;
 
         hb_lock(buffers.lock);
         buffers.allocated += size - orig;
@@ -848,6 +1660,14 @@ hb_buffer_t * hb_frame_buffer_init( int pix_fmt, int width, int height )
         return NULL;
     }
 
+#if !defined(HB_NO_BUFFER_POOL)
+    buf = frame_pool_get(pix_fmt, width, height);
+    if (buf != NULL)
+    {
+        return buf;
+    }
+#endif
+
     int size = 0;
     for (ii = 0; ii < desc->nb_components; ii++)
     {
@@ -998,19 +1818,21 @@ void hb_video_buffer_realloc( hb_buffer_t * buf, int width, int height )
 }
 
 // this routine 'moves' data from src to dst by interchanging 'data',
-// 'size' & 'alloc' between them and copying the rest of the fields
-// from src to dst.
+// 'size', 'alloc' & 'frame_pool' between them and copying the rest of
+// the fields from src to dst.
 void hb_buffer_swap_copy( hb_buffer_t *src, hb_buffer_t *dst )
 {
-    uint8_t *data  = dst->data;
-    int      size  = dst->size;
-    int      alloc = dst->alloc;
+    uint8_t *data       = dst->data;
+    int      size       = dst->size;
+    int      alloc      = dst->alloc;
+    int      frame_pool = dst->frame_pool;
 
     *dst = *src;
 
-    src->data  = data;
-    src->size  = size;
-    src->alloc = alloc;
+    src->data       = data;
+    src->size       = size;
+    src->alloc      = alloc;
+    src->frame_pool = frame_pool;
 }
 
 static void free_buffer_resources(hb_buffer_t *b)
@@ -1041,6 +1863,7 @@ void hb_buffer_close( hb_buffer_t ** _b )
     while( b )
     {
         hb_buffer_t * next = b->next;
+        int pool_index = size_to_pool_index( b->alloc );
         hb_fifo_t *buffer_pool = size_to_pool( b->alloc );
 
         b->next = NULL;
@@ -1053,7 +1876,21 @@ void hb_buffer_close( hb_buffer_t ** _b )
 
         free_buffer_resources(b);
 
-        if (buffer_pool && !hb_fifo_is_full(buffer_pool))
+#if !defined(HB_NO_BUFFER_POOL)
+        // Exact sized frames from hb_frame_buffer_init()
+        if (b->frame_pool != 0 && b->storage_type == STANDARD &&
+            b->data != NULL)
+        {
+            if (!frame_pool_put(b))
+            {
+                buffer_free(b);
+            }
+            b = next;
+            continue;
+        }
+#endif
+
+        if (buffer_pool)
         {
 #if defined(HB_BUFFER_DEBUG)
             if (hb_fifo_contains(buffer_pool, b))
@@ -1062,20 +1899,15 @@ void hb_buffer_close( hb_buffer_t ** _b )
                 assert(0);
             }
 #endif
-            hb_fifo_push_head( buffer_pool, b );
+#if !defined(HB_NO_BUFFER_POOL)
+            // The magazine frees the buffer if the shared pool is full
+            buffer_mag_put( pool_index, b );
             b = next;
             continue;
+#endif
         }
-        // either the pool is full or this size doesn't use a pool
-        // free the buf
-        if (b->data && b->storage_type == STANDARD)
-        {
-            av_free(b->data);
-            hb_lock(buffers.lock);
-            buffers.allocated -= b->alloc;
-            hb_unlock(buffers.lock);
-        }
-        free( b );
+        // this size doesn't use a pool, free the buf
+        buffer_free( b );
         b = next;
     }
 
@@ -1191,6 +2023,140 @@ void hb_image_close(hb_image_t **_image)
     }
 }
 
+// Creates a byte budget that limits the total size of the buffers
+// queued in every fifo attached to it with hb_fifo_set_budget.
+hb_fifo_budget_t * hb_fifo_budget_init( int64_t limit )
+{
+    hb_fifo_budget_t * budget = calloc( 1, sizeof( hb_fifo_budget_t ) );
+
+    budget->lock  = hb_lock_init();
+    budget->fifos = hb_list_init();
+    budget->limit = limit;
+
+    return budget;
+}
+
+void hb_fifo_budget_close( hb_fifo_budget_t ** _budget )
+{
+    hb_fifo_budget_t * budget = *_budget;
+
+    if ( budget == NULL )
+    {
+        return;
+    }
+
+    hb_log( "fifo budget: %"PRId64" MiB, peak %.1f MiB in flight",
+            budget->limit >> 20, (double)budget->peak / ( 1 << 20 ) );
+
+    hb_list_close( &budget->fifos );
+    hb_lock_close( &budget->lock );
+    free( budget );
+
+    *_budget = NULL;
+}
+
+// Attaches f to budget. Buffers pushed to f are charged to the budget,
+// and once the budget is exhausted f refuses buffers beyond the first
+// 'reserve' ones. The reserve guarantees that every stage can keep
+// making progress, so a stage never waits on bytes held by another
+// stage that is in turn waiting on it. Must be called before the fifo
+// is used.
+void hb_fifo_set_budget( hb_fifo_t * f, hb_fifo_budget_t * budget, int reserve )
+{
+    if ( f == NULL || budget == NULL )
+    {
+        return;
+    }
+
+    f->budget  = budget;
+    f->reserve = reserve;
+
+    hb_lock( budget->lock );
+    hb_list_add( budget->fifos, f );
+    hb_unlock( budget->lock );
+}
+
+// Returns whether f is full when it holds 'size' buffers
+static inline int fifo_full( hb_fifo_t * f, uint32_t size )
+{
+    return size >= f->capacity ||
+           ( f->budget != NULL && size >= f->reserve &&
+             hb_atomic_load( &f->budget->bytes ) >= f->budget->limit );
+}
+
+static void budget_charge( hb_fifo_budget_t * budget, int64_t bytes )
+{
+    int64_t total, peak;
+
+    if ( budget == NULL || bytes == 0 )
+    {
+        return;
+    }
+
+    total = hb_atomic_add( &budget->bytes, bytes );
+    peak  = hb_atomic_load_relaxed( &budget->peak );
+    while ( total > peak && !hb_atomic_cas( &budget->peak, &peak, total ) )
+    {
+    }
+}
+
+static void budget_release( hb_fifo_budget_t * budget, int64_t bytes )
+{
+    int64_t total;
+    int     ii;
+
+    if ( budget == NULL || bytes == 0 )
+    {
+        return;
+    }
+
+    total = hb_atomic_sub( &budget->bytes, bytes );
+
+    // Wake fifos that are waiting on the budget when it drops below
+    // the limit. Waiters register in 'waiting' before they test the
+    // budget, so either they see the new total or we see them.
+    if ( total < budget->limit && total + bytes >= budget->limit &&
+         hb_atomic_load( &budget->waiting ) )
+    {
+        hb_lock( budget->lock );
+        for ( ii = 0; ii < hb_list_count( budget->fifos ); ii++ )
+        {
+            hb_fifo_t * f = hb_list_item( budget->fifos, ii );
+
+            hb_lock( f->lock );
+            if ( hb_atomic_load( &f->wait_full ) )
+            {
+                hb_atomic_store( &f->wait_full, 0 );
+                hb_cond_signal( f->cond_full );
+            }
+            hb_unlock( f->lock );
+        }
+        hb_unlock( budget->lock );
+    }
+}
+
+// Parks the producer until f has room. Called with f->lock held.
+static void fifo_wait_full( hb_fifo_t * f )
+{
+    hb_fifo_budget_t * budget = f->budget;
+
+    if ( budget != NULL )
+    {
+        hb_atomic_add( &budget->waiting, 1 );
+    }
+    hb_atomic_store( &f->wait_full, 1 );
+    hb_atomic_fence();
+    if ( fifo_full( f, hb_atomic_load( &f->size ) ) )
+    {
+        hb_cond_timedwait( f->cond_full, f->lock, FIFO_TIMEOUT );
+    }
+    hb_atomic_store( &f->wait_full, 0 );
+    if ( budget != NULL )
+    {
+        hb_atomic_sub( &budget->waiting, 1 );
+    }
+}
+
 hb_fifo_t * hb_fifo_init( int capacity, int thresh )
 {
     hb_fifo_t * f;
@@ -1209,6 +2175,183 @@ hb_fifo_t * hb_fifo_init( int capacity, int thresh )
     return f;
 }
 
+// Creates a fifo that is fed by exactly one thread and drained by exactly
+// one other thread. Buffers are handed over without taking the fifo lock,
+// which is only used to park a side that has been spinning for a while.
+// hb_fifo_see(), hb_fifo_see2() and hb_fifo_push_head() may only be
+// called by the consumer.
+hb_fifo_t * hb_fifo_init_spsc( int capacity, int thresh )
+{
+    hb_fifo_t * f = hb_fifo_init( capacity, thresh );
+
+    f->spsc  = 1;
+    // Spinning only pays off when the other side can run concurrently
+    f->spin  = hb_get_cpu_count() > 1 ? FIFO_SPIN_COUNT : 0;
+    f->first = &f->stub;
+    f->last  = &f->stub;
+
+    return f;
+}
+
+// Appends the list first..last (count buffers) to the producer end
+static void spsc_link( hb_fifo_t * f, hb_buffer_t * first,
+                       hb_buffer_t * last, uint32_t count, uint32_t bytes )
+{
+    hb_buffer_t * prev;
+
+    // Account before publishing so the consumer never sees size underflow
+    hb_atomic_add( &f->size, count );
+    hb_atomic_add( &f->bytes, bytes );
+
+    last->next = NULL;
+    prev = hb_atomic_exchange( &f->last, last );
+    hb_atomic_store( &prev->next, first );
+}
+
+// Returns the oldest buffer without removing it
+static hb_buffer_t * spsc_see( hb_fifo_t * f )
+{
+    hb_buffer_t * b    = f->first;
+    hb_buffer_t * next = hb_atomic_load( &b->next );
+
+    if ( b == &f->stub )
+    {
+        if ( next == NULL )
+        {
+            return NULL;
+        }
+        f->first = next;
+        b        = next;
+    }
+    return b;
+}
+
+static hb_buffer_t * spsc_pop( hb_fifo_t * f )
+{
+    hb_buffer_t * b, * next;
+    uint32_t      size;
+
+    b = spsc_see( f );
+    if ( b == NULL )
+    {
+        return NULL;
+    }
+    next = hb_atomic_load( &b->next );
+    if ( next == NULL )
+    {
+        // b is the only linked buffer. If the producer has already
+        // swapped 'last' but not linked its buffer yet, report empty
+        // and let the caller poll again.
+        if ( b != hb_atomic_load( &f->last ) )
+        {
+            return NULL;
+        }
+        // Re-insert the stub behind b so that b can be unlinked
+        spsc_link( f, &f->stub, &f->stub, 0, 0 );
+        next = hb_atomic_load( &b->next );
+        if ( next == NULL )
+        {
+            return NULL;
+        }
+    }
+    f->first = next;
+    b->next  = NULL;
+
+    hb_atomic_sub( &f->bytes, b->size );
+    size = hb_atomic_sub( &f->size, 1 );
+    if ( ( size <= f->capacity - f->thresh || size < f->reserve ) &&
+         hb_atomic_load( &f->wait_full ) )
+    {
+        hb_lock( f->lock );
+        hb_atomic_store( &f->wait_full, 0 );
+        hb_cond_signal( f->cond_full );
+        hb_unlock( f->lock );
+    }
+    budget_release( f->budget, b->size );
+    return b;
+}
+
+// Spin on the queue for a while, then park on cond_empty. The producer
+// only takes the lock when it sees wait_empty, so hand-offs to a busy
+// consumer never touch the lock.
+static hb_buffer_t * spsc_wait( hb_fifo_t * f, hb_buffer_t * (*get)( hb_fifo_t * ) )
+{
+    hb_buffer_t * b;
+    int           ii;
+
+    for ( ii = 0; ii <= f->spin; ii++ )
+    {
+        if ( ( b = get( f ) ) != NULL )
+        {
+            return b;
+        }
+        hb_cpu_relax();
+    }
+
+    // get() may need f->lock to wake the producer, so only peek here
+    hb_lock( f->lock );
+    hb_atomic_store( &f->wait_empty, 1 );
+    hb_atomic_fence();
+    if ( spsc_see( f ) == NULL )
+    {
+        hb_cond_timedwait( f->cond_empty, f->lock, FIFO_TIMEOUT );
+    }
+    hb_atomic_store( &f->wait_empty, 0 );
+    hb_unlock( f->lock );
+
+    return get( f );
+}
+
+static int spsc_full_wait( hb_fifo_t * f )
+{
+    int ii;
+
+    for ( ii = 0; ii < f->spin; ii++ )
+    {
+        if ( !fifo_full( f, hb_atomic_load( &f->size ) ) )
+        {
+            return 1;
+        }
+        hb_cpu_relax();
+    }
+
+    hb_lock( f->lock );
+    fifo_wait_full( f );
+    hb_unlock( f->lock );
+
+    return !fifo_full( f, hb_atomic_load( &f->size ) );
+}
+
+static void spsc_push( hb_fifo_t * f, hb_buffer_t * b )
+{
+    hb_buffer_t * last  = b;
+    uint32_t      count = 1;
+    uint32_t      bytes = b->size;
+
+    if ( f->cond_alert_full != NULL &&
+         fifo_full( f, hb_atomic_load( &f->size ) ) )
+    {
+        hb_cond_broadcast( f->cond_alert_full );
+    }
+    while ( last->next )
+    {
+        last   = last->next;
+        count += 1;
+        bytes += last->size;
+    }
+    spsc_link( f, b, last, count, bytes );
+    budget_charge( f->budget, bytes );
+
+    hb_atomic_fence();
+    if ( hb_atomic_load( &f->wait_empty ) )
+    {
+        hb_lock( f->lock );
+        hb_atomic_store( &f->wait_empty, 0 );
+        hb_cond_signal( f->cond_empty );
+        hb_unlock( f->lock );
+    }
+}
+
 void hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c )
 {
     f->cond_alert_full = c;
@@ -1216,16 +2359,15 @@ void hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c )
 
 int hb_fifo_size_bytes( hb_fifo_t * f )
 {
-    int ret = 0;
-    hb_buffer_t * link;
+    int ret;
 
-    hb_lock( f->lock );
-    link = f->first;
-    while ( link )
+    if ( f->spsc )
     {
-        ret += link->size;
-        link = link->next;
+        return hb_atomic_load( &f->bytes );
     }
+
+    hb_lock( f->lock );
+    ret = f->bytes;
     hb_unlock( f->lock );
 
     return ret;
@@ -1235,6 +2377,11 @@ int hb_fifo_size( hb_fifo_t * f )
 {
     int ret;
 
+    if ( f->spsc )
+    {
+        return hb_atomic_load( &f->size );
+    }
+
     hb_lock( f->lock );
     ret = f->size;
     hb_unlock( f->lock );
@@ -1246,8 +2393,13 @@ int hb_fifo_is_full( hb_fifo_t * f )
 {
     int ret;
 
+    if ( f->spsc )
+    {
+        return fifo_full( f, hb_atomic_load( &f->size ) );
+    }
+
     hb_lock( f->lock );
-    ret = ( f->size >= f->capacity );
+    ret = fifo_full( f, f->size );
     hb_unlock( f->lock );
 
     return ret;
@@ -1257,6 +2409,11 @@ float hb_fifo_percent_full( hb_fifo_t * f )
 {
     float ret;
 
+    if ( f->spsc )
+    {
+        return hb_atomic_load( &f->size ) / f->capacity;
+    }
+
     hb_lock( f->lock );
     ret = f->size / f->capacity;
     hb_unlock( f->lock );
@@ -1270,6 +2427,11 @@ hb_buffer_t * hb_fifo_get_wait( hb_fifo_t * f )
 {
     hb_buffer_t * b;
 
+    if ( f->spsc )
+    {
+        return spsc_wait( f, spsc_pop );
+    }
+
     hb_lock( f->lock );
     if( f->size < 1 )
     {
@@ -1285,12 +2447,15 @@ hb_buffer_t * hb_fifo_get_wait( hb_fifo_t * f )
     f->first  = b->next;
     b->next   = NULL;
     f->size  -= 1;
-    if( f->wait_full && f->size == f->capacity - f->thresh )
+    f->bytes -= b->size;
+    if( f->wait_full && ( f->size == f->capacity - f->thresh ||
+                          f->size < f->reserve ) )
     {
         f->wait_full = 0;
         hb_cond_signal( f->cond_full );
     }
     hb_unlock( f->lock );
+    budget_release( f->budget, b->size );
 
     return b;
 }
@@ -1300,6 +2465,11 @@ hb_buffer_t * hb_fifo_get( hb_fifo_t * f )
 {
     hb_buffer_t * b;
 
+    if ( f->spsc )
+    {
+        return spsc_pop( f );
+    }
+
     hb_lock( f->lock );
     if( f->size < 1 )
     {
@@ -1310,12 +2480,15 @@ hb_buffer_t * hb_fifo_get( hb_fifo_t * f )
     f->first  = b->next;
     b->next   = NULL;
     f->size  -= 1;
-    if( f->wait_full && f->size == f->capacity - f->thresh )
+    f->bytes -= b->size;
+    if( f->wait_full && ( f->size == f->capacity - f->thresh ||
+                          f->size < f->reserve ) )
     {
         f->wait_full = 0;
         hb_cond_signal( f->cond_full );
     }
     hb_unlock( f->lock );
+    budget_release( f->budget, b->size );
 
     return b;
 }
@@ -1324,6 +2497,11 @@ hb_buffer_t * hb_fifo_see_wait( hb_fifo_t * f )
 {
     hb_buffer_t * b;
 
+    if ( f->spsc )
+    {
+        return spsc_wait( f, spsc_see );
+    }
+
     hb_lock( f->lock );
     if( f->size < 1 )
     {
@@ -1347,6 +2525,11 @@ hb_buffer_t * hb_fifo_see( hb_fifo_t * f )
 {
     hb_buffer_t * b;
 
+    if ( f->spsc )
+    {
+        return spsc_see( f );
+    }
+
     hb_lock( f->lock );
     if( f->size < 1 )
     {
@@ -1363,6 +2546,20 @@ hb_buffer_t * hb_fifo_see2( hb_fifo_t * f )
 {
     hb_buffer_t * b;
 
+    if ( f->spsc )
+    {
+        b = spsc_see( f );
+        if ( b != NULL )
+        {
+            b = hb_atomic_load( &b->next );
+            if ( b == &f->stub )
+            {
+                b = hb_atomic_load( &b->next );
+            }
+        }
+        return b;
+    }
+
     hb_lock( f->lock );
     if( f->size < 2 )
     {
@@ -1381,13 +2578,17 @@ int hb_fifo_full_wait( hb_fifo_t * f )
 {
     int result;
 
+    if ( f->spsc )
+    {
+        return spsc_full_wait( f );
+    }
+
     hb_lock( f->lock );
-    if( f->size >= f->capacity )
+    if( fifo_full( f, f->size ) )
     {
-        f->wait_full = 1;
-        hb_cond_timedwait( f->cond_full, f->lock, FIFO_TIMEOUT );
+        fifo_wait_full( f );
     }
-    result = ( f->size < f->capacity );
+    result = !fifo_full( f, f->size );
     hb_unlock( f->lock );
     return result;
 }
@@ -1396,18 +2597,31 @@ int hb_fifo_full_wait( hb_fifo_t * f )
 // blocking until the FIFO has space available.
 void hb_fifo_push_wait( hb_fifo_t * f, hb_buffer_t * b )
 {
+    uint32_t bytes;
+
     if( !b )
     {
         return;
     }
 
+    if ( f->spsc )
+    {
+        if ( fifo_full( f, hb_atomic_load( &f->size ) ) )
+        {
+            if (f->cond_alert_full != NULL)
+                hb_cond_broadcast( f->cond_alert_full );
+            spsc_full_wait( f );
+        }
+        spsc_push( f, b );
+        return;
+    }
+
     hb_lock( f->lock );
-    if( f->size >= f->capacity )
+    if( fifo_full( f, f->size ) )
     {
-        f->wait_full = 1;
         if (f->cond_alert_full != NULL)
             hb_cond_broadcast( f->cond_alert_full );
-        hb_cond_timedwait( f->cond_full, f->lock, FIFO_TIMEOUT );
+        fifo_wait_full( f );
     }
     if( f->size > 0 )
     {
@@ -1419,29 +2633,41 @@ void hb_fifo_push_wait( hb_fifo_t * f, hb_buffer_t * b )
     }
     f->last  = b;
     f->size += 1;
+    bytes    = b->size;
     while( f->last->next )
     {
         f->size += 1;
         f->last  = f->last->next;
+        bytes   += f->last->size;
     }
+    f->bytes += bytes;
     if( f->wait_empty && f->size >= 1 )
     {
         f->wait_empty = 0;
         hb_cond_signal( f->cond_empty );
     }
     hb_unlock( f->lock );
+    budget_charge( f->budget, bytes );
 }
 
 // Appends the specified packet list to the end of the specified FIFO.
 void hb_fifo_push( hb_fifo_t * f, hb_buffer_t * b )
 {
+    uint32_t bytes;
+
     if( !b )
     {
         return;
     }
 
+    if ( f->spsc )
+    {
+        spsc_push( f, b );
+        return;
+    }
+
     hb_lock( f->lock );
-    if (f->size >= f->capacity &&
+    if (fifo_full( f, f->size ) &&
         f->cond_alert_full != NULL)
     {
         hb_cond_broadcast( f->cond_alert_full );
@@ -1456,17 +2682,21 @@ void hb_fifo_push( hb_fifo_t * f, hb_buffer_t * b )
     }
     f->last  = b;
     f->size += 1;
+    bytes    = b->size;
     while( f->last->next )
     {
         f->size += 1;
         f->last  = f->last->next;
+        bytes   += f->last->size;
     }
+    f->bytes += bytes;
     if( f->wait_empty && f->size >= 1 )
     {
         f->wait_empty = 0;
         hb_cond_signal( f->cond_empty );
     }
     hb_unlock( f->lock );
+    budget_charge( f->budget, bytes );
 }
 
 // Prepends the specified packet list to the start of the specified FIFO.
@@ -1474,14 +2704,35 @@ void hb_fifo_push_head( hb_fifo_t * f, hb_buffer_t * b )
 {
     hb_buffer_t * tmp;
     uint32_t      size = 0;
+    uint32_t      bytes;
 
     if( !b )
     {
         return;
     }
 
+    if ( f->spsc )
+    {
+        // 'first' belongs to the consumer, so the chain can simply
+        // be spliced in front of it.
+        bytes = b->size;
+        tmp   = b;
+        while( tmp->next )
+        {
+            tmp    = tmp->next;
+            size  += 1;
+            bytes += tmp->size;
+        }
+        hb_atomic_add( &f->size, size + 1 );
+        hb_atomic_add( &f->bytes, bytes );
+        tmp->next = f->first;
+        f->first  = b;
+        budget_charge( f->budget, bytes );
+        return;
+    }
+
     hb_lock( f->lock );
-    if (f->size >= f->capacity &&
+    if (fifo_full( f, f->size ) &&
         f->cond_alert_full != NULL)
     {
         hb_cond_broadcast( f->cond_alert_full );
@@ -1490,11 +2741,13 @@ void hb_fifo_push_head( hb_fifo_t * f, hb_buffer_t * b )
     /*
      * If there are a chain of buffers prepend the lot
      */
-    tmp = b;
+    tmp   = b;
+    bytes = b->size;
     while( tmp->next )
     {
         tmp = tmp->next;
         size += 1;
+        bytes += tmp->size;
     }
 
     if( f->size > 0 )
@@ -1506,10 +2759,12 @@ void hb_fifo_push_head( hb_fifo_t * f, hb_buffer_t * b )
         f->last = tmp;
     }
 
-    f->first = b;
-    f->size += ( size + 1 );
+    f->first  = b;
+    f->size  += ( size + 1 );
+    f->bytes += bytes;
 
     hb_unlock( f->lock );
+    budget_charge( f->budget, bytes );
 }
 
 void hb_fifo_close( hb_fifo_t ** _f )
@@ -1526,6 +2781,15 @@ void hb_fifo_close( hb_fifo_t ** _f )
         hb_buffer_close( &b );
     }
 
+    if ( f->budget != NULL )
+    {
+        hb_lock( f->budget->lock );
+        hb_list_rem( f->budget->fifos, f );
+        hb_unlock( f->budget->lock );
+        // Buffers that were resized while queued leave a remainder
+        budget_release( f->budget, (int32_t)f->bytes );
+    }
+
     hb_lock_close( &f->lock );
     hb_cond_close( &f->cond_empty );
     hb_cond_close( &f->cond_full );
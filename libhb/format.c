@@ -21,6 +21,7 @@ hb_filter_object_t hb_filter_format =
     .id                = HB_FILTER_FORMAT,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Format",
     .settings          = NULL,
     .init              = format_init,
@@ -20,6 +20,7 @@ hb_filter_object_t hb_filter_grayscale =
     .id                = HB_FILTER_GRAYSCALE,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Grayscale",
     .settings          = NULL,
     .init              = grayscale_init,
@@ -0,0 +1,53 @@
+/* blend.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_BLEND_H
+#define HANDBRAKE_BLEND_H
+
+typedef struct
+{
+    // Blend count overlay pixels into dst, with alpha = a[x * alpha_step]:
+    // dst = (dst * (255 - alpha) + src * alpha + bias) / 255
+    // The uv variants blend into interleaved chroma, u and v share alpha.
+    void (*blend_row_8)(uint8_t *dst, const uint8_t *src,
+                        const uint8_t *a, int alpha_step,
+                        int count, int bias);
+    void (*blend_row_uv_8)(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                           const uint8_t *a, int alpha_step,
+                           int count, int bias);
+
+    // Same for deeper destinations, with max = (256 << shift) - 1,
+    // alpha = a[x * alpha_step] << shift and src scaled by src_shift:
+    // dst = (dst * (max - alpha) + (src << src_shift) * alpha + bias) / max
+    void (*blend_row_16)(uint16_t *dst, const uint8_t *src,
+                         const uint8_t *a, int alpha_step,
+                         int count, int shift, int src_shift, int bias);
+    void (*blend_row_uv_16)(uint16_t *dst, const uint8_t *src_u, const uint8_t *src_v,
+                            const uint8_t *a, int alpha_step,
+                            int count, int shift, int src_shift, int bias);
+
+    // Blend count chroma samples of a horizontally subsampled destination.
+    // Each sample covers 2 overlay pixels on each of rows rows, which are
+    // blended one by one, rounded, and averaged with the chroma smoothing
+    // coefficients. The u, v and a row pointers start at the overlay
+    // pixel of the first sample. dst_step is 2 for interleaved chroma.
+    void (*blend_subsample_row_8)(uint8_t *dst_u, uint8_t *dst_v, int dst_step,
+                                  const uint8_t *const u[2], const uint8_t *const v[2],
+                                  const uint8_t *const a[2], int rows, int count,
+                                  const unsigned coeffs[2][4]);
+    void (*blend_subsample_row_16)(uint16_t *dst_u, uint16_t *dst_v, int dst_step,
+                                   const uint8_t *const u[2], const uint8_t *const v[2],
+                                   const uint8_t *const a[2], int rows, int count,
+                                   const unsigned coeffs[2][4],
+                                   int shift, int src_shift);
+} BlendFunctions;
+
+void blend_init_x86(BlendFunctions *functions);
+
+#endif // HANDBRAKE_BLEND_H
@@ -0,0 +1,67 @@
+/* comb_detect.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_COMB_DETECT_H
+#define HANDBRAKE_COMB_DETECT_H
+
+typedef struct
+{
+    int          spatial_metric;
+    int          motion_threshold;
+    int          spatial_threshold;
+    int          spatial_threshold_squared;
+    int          spatial_threshold6;
+    int          comb32detect_min;
+    int          comb32detect_max;
+    float        gamma_motion_threshold;
+    float        gamma_spatial_threshold;
+    float        gamma_spatial_threshold6;
+    const float *gamma_lut;
+    int          force_exaustive_check;
+} CombDetectParams;
+
+typedef struct
+{
+    // Sets mask[x] to 1 where row cur is combed and to 0 elsewhere.
+    // Strides are in pixels, two rows above and below must be readable.
+    void (*detect_combed_row_8)(uint8_t *mask,
+                          const uint8_t *prev, const uint8_t *cur, const uint8_t *next,
+                                int stride_prev, int stride_cur, int stride_next,
+                                int width, const CombDetectParams *params);
+    void (*detect_combed_row_16)(uint8_t *mask,
+                           const uint16_t *prev, const uint16_t *cur, const uint16_t *next,
+                                 int stride_prev, int stride_cur, int stride_next,
+                                 int width, const CombDetectParams *params);
+    void (*detect_gamma_combed_row_8)(uint8_t *mask,
+                                const uint8_t *prev, const uint8_t *cur, const uint8_t *next,
+                                      int stride_prev, int stride_cur, int stride_next,
+                                      int width, const CombDetectParams *params);
+    void (*detect_gamma_combed_row_16)(uint8_t *mask,
+                                 const uint16_t *prev, const uint16_t *cur, const uint16_t *next,
+                                       int stride_prev, int stride_cur, int stride_next,
+                                       int width, const CombDetectParams *params);
+
+    // Mask filters, for x = 1 .. width - 2 of a row and the rows around it
+    void (*mask_filter_row)(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                            const uint8_t *curn, int width, int classic);
+    void (*mask_dilate_row)(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                            const uint8_t *curn, int width);
+    void (*mask_erode_row)(uint8_t *dst, const uint8_t *curp, const uint8_t *cur,
+                           const uint8_t *curn, int width);
+
+    // Sums the mask of a block. Unless filtered, a pixel only counts when
+    // its horizontal neighbours are set too, left_edge tells that the
+    // block starts at the left edge of the mask.
+    int (*block_score)(const uint8_t *mask, int stride, int block_width,
+                       int block_height, int left_edge, int filtered);
+} CombDetectFunctions;
+
+void comb_detect_init_x86(CombDetectFunctions *functions);
+
+#endif // HANDBRAKE_COMB_DETECT_H
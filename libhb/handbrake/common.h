@@ -941,6 +941,18 @@ struct hb_job_s
     void           *hw_device_ctx;
     hb_hwaccel_t   *hw_accel;
     int             hw_pix_fmt;
+
+    int             filter_threads;   // Pool workers shared by all filters, 0 = all
+    struct hb_taskset_budget_s * filter_budget;
+    int             filter_frame_window; // Frames in flight in frame
+                                         //  threaded filters, 0 = auto
+    int             memory_budget;    // MiB of buffers in flight between
+                                      //  work objects, 0 = count limits only
+    struct hb_fifo_budget_s * fifo_budget;
+    int             filter_fuse;      // Run consecutive light filters on
+                                      //  one thread, 0 = on, -1 = off
+    int             read_ahead;       // MiB the reader may read ahead of
+                                      //  the demuxer, 0 = default, -1 = off
 #endif
 };
 
@@ -1494,6 +1506,8 @@ struct hb_work_object_s
     hb_work_object_t  * next;
 
     hb_handle_t       * h;
+
+    struct hb_stage_stats_s * stats;
 #endif
 };
 
@@ -1596,6 +1610,16 @@ struct hb_filter_object_s
     int64_t               chapter_time;
 
     hb_filter_object_t  * sub_filter;
+
+    struct hb_stage_stats_s * stats;
+
+    // Filters that output each frame as soon as it is input and are
+    // cheap enough to share a thread with their neighbours.
+    // Consecutive fuse filters are run back to back on each frame by
+    // the thread of the first one (see filter_chain_loop in work.c).
+    int                   fuse;
+    hb_filter_object_t  * chain_next;
+    int                   chained;
 #endif
 };
 
@@ -1668,6 +1692,7 @@ char               * hb_filter_settings_string_json(int filter_id,
 struct hb_motion_metric_object_s
 {
     char                * name;
+    hb_dict_t           * settings;
 
 #ifdef __LIBHB__
     int                (* init)       ( hb_motion_metric_object_t *, hb_filter_init_t * );
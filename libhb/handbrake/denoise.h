@@ -0,0 +1,26 @@
+/* denoise.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_DENOISE_H
+#define HANDBRAKE_DENOISE_H
+
+typedef struct
+{
+    // Low pass filters a row of prev towards curr, in place:
+    // prev[x] = curr[x] + coef[(prev[x] - curr[x]) >> shift]
+    void (*lowpass_row)(uint16_t *prev,
+                  const uint16_t *curr,
+                  const int16_t  *coef,
+                        int       shift,
+                        int       w);
+} HQDN3DFunctions;
+
+void hqdn3d_init_x86(HQDN3DFunctions *functions);
+
+#endif // HANDBRAKE_DENOISE_H
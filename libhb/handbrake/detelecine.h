@@ -0,0 +1,29 @@
+/* detelecine.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_DETELECINE_H
+#define HANDBRAKE_DETELECINE_H
+
+typedef struct
+{
+    // Pullup metrics of 'count' consecutive blocks of 8 pixels by 4 field
+    // rows, one int per block in dest. s is the field stride in pixels.
+    // diff compares the fields a and b, comb the field a with the field
+    // b of the other parity and var measures the vertical variance of a.
+    void (*diff_row_8)(const void *a, const void *b, int s, int count, int *dest);
+    void (*diff_row_16)(const void *a, const void *b, int s, int count, int *dest);
+    void (*comb_row_8)(const void *a, const void *b, int s, int count, int *dest);
+    void (*comb_row_16)(const void *a, const void *b, int s, int count, int *dest);
+    void (*var_row_8)(const void *a, const void *b, int s, int count, int *dest);
+    void (*var_row_16)(const void *a, const void *b, int s, int count, int *dest);
+} DetelecineFunctions;
+
+void detelecine_init_x86(DetelecineFunctions *functions);
+
+#endif // HANDBRAKE_DETELECINE_H
@@ -118,6 +118,23 @@ void          hb_stop( hb_handle_t * );
 void          hb_system_sleep_allow(hb_handle_t*);
 void          hb_system_sleep_prevent(hb_handle_t*);
 
+/* hb_set_pipeline_stats()
+   Profile the work and filter threads of the following jobs.
+   Statistics are returned by hb_get_pipeline_stats_json(). */
+void          hb_set_pipeline_stats( hb_handle_t *, int enable,
+                                     const char * trace_prefix );
+
+/* hb_set_preview_store_size()
+   Caps the memory used by the scan previews, the rest is written to
+   temporary files. 0 keeps every preview on disk. */
+void          hb_set_preview_store_size( hb_handle_t *, int64_t max_size );
+
+/* hb_set_scan_threads()
+   Sets how many files of a directory or file list scan are probed and
+   decoded concurrently. 0 picks a count from the number of CPUs, 1
+   scans one title at a time. */
+void          hb_set_scan_threads( hb_handle_t *, int threads );
+
 /* Persistent data between jobs. */
 typedef struct hb_interjob_s
 {
@@ -136,11 +153,29 @@ typedef struct hb_interjob_s
 hb_interjob_t * hb_interjob_get( hb_handle_t * );
 
 /* hb_get_state()
-   Should be regularly called by the UI (like 5 or 10 times a second).
+   Should be called by the UI when the state changes, see hb_state_wait()
+   and hb_state_subscribe(), or regularly (like 5 or 10 times a second).
    Look at test/test.c to see how to use it. */
 void hb_get_state( hb_handle_t *, hb_state_t * );
 void hb_get_state2( hb_handle_t *, hb_state_t * );
 
+/* hb_state_wait()
+   Blocks until the state has changed since the call that returned
+   'serial' (pass 0 on the first call), or until timeout_ms elapses
+   (negative waits forever). Copies the state to s like hb_get_state2()
+   if s is not NULL, and returns the serial to pass to the next call. */
+int  hb_state_wait( hb_handle_t *, int serial, int timeout_ms, hb_state_t * s );
+
+/* hb_state_subscribe()
+   Calls callback from the libhb thread after each state change. Changes
+   that follow each other closely may be reported once, with the latest
+   state. The callback must return quickly and must not call
+   hb_state_subscribe(), hb_state_unsubscribe() or hb_close(). */
+typedef void (hb_state_callback_t)( hb_handle_t *, const hb_state_t *,
+                                    void * opaque );
+void hb_state_subscribe( hb_handle_t *, hb_state_callback_t *, void * opaque );
+void hb_state_unsubscribe( hb_handle_t *, hb_state_callback_t *, void * opaque );
+
 /* hb_close()
    Aborts all current jobs if any, frees memory. */
 void          hb_close( hb_handle_t ** );
@@ -132,6 +132,7 @@ struct hb_buffer_s
 {
     int           size;     // size of this packet
     int           alloc;    // used internally by the packet allocator (hb_buffer_init)
+    int           frame_pool; // used internally by the frame allocator (hb_frame_buffer_init)
     uint8_t *     data;     // packet data
     int           offset;   // used internally by packet lists (hb_list_t)
 
@@ -162,8 +163,22 @@ struct hb_buffer_s
     hb_buffer_t * next;
 };
 
+// Buffer allocator statistics, reset by hb_buffer_pool_free()
+typedef struct
+{
+    uint64_t allocs;    // pooled allocations
+    uint64_t hits;      // allocations served from a thread magazine
+    uint64_t refills;   // batched transfers from the shared pools to a magazine
+    uint64_t spills;    // batched transfers from a magazine to the shared pools
+    uint64_t mallocs;   // pooled allocations that found no free buffer at all
+    uint64_t freed;     // buffers released because their shared pool was full
+    uint64_t frame_allocs; // hb_frame_buffer_init allocations
+    uint64_t frame_hits;   // frame allocations recycled from the frame pool
+} hb_buffer_pool_stats_t;
+
 void hb_buffer_pool_init( void );
 void hb_buffer_pool_free( void );
+void hb_buffer_pool_get_stats( hb_buffer_pool_stats_t * stats );
 
 hb_buffer_t * hb_buffer_wrapper_init();
 hb_buffer_t * hb_buffer_init( int size );
@@ -197,7 +212,12 @@ void          hb_buffer_copy_props(hb_buffer_t *dst, const hb_buffer_t *src);
 
 int           hb_buffer_is_writable(const hb_buffer_t *buf);
 
+typedef struct hb_fifo_budget_s hb_fifo_budget_t;
+
 hb_fifo_t   * hb_fifo_init( int capacity, int thresh );
+hb_fifo_t   * hb_fifo_init_spsc( int capacity, int thresh );
+void          hb_fifo_set_budget( hb_fifo_t * f, hb_fifo_budget_t * budget,
+                                  int reserve );
 void          hb_fifo_register_full_cond( hb_fifo_t * f, hb_cond_t * c );
 int           hb_fifo_size( hb_fifo_t * );
 int           hb_fifo_size_bytes( hb_fifo_t * );
@@ -215,13 +235,18 @@ void          hb_fifo_push_head( hb_fifo_t *, hb_buffer_t * );
 void          hb_fifo_close( hb_fifo_t ** );
 void          hb_fifo_flush( hb_fifo_t * f );
 
+hb_fifo_budget_t * hb_fifo_budget_init( int64_t limit );
+void               hb_fifo_budget_close( hb_fifo_budget_t ** );
+
+// Make buffer SIMD friendly.
+// Zscale requires stride aligned to 64 bytes
+#define HB_IMAGE_STRIDE_ALIGN 64
+
 static inline int hb_image_stride( int pix_fmt, int width, int plane )
 {
     int linesize = av_image_get_linesize( pix_fmt, width, plane );
 
-    // Make buffer SIMD friendly.
-    // Zscale requires stride aligned to 64 bytes
-    linesize = MULTIPLE_MOD_UP(linesize, 64);
+    linesize = MULTIPLE_MOD_UP(linesize, HB_IMAGE_STRIDE_ALIGN);
     return linesize;
 }
 
@@ -282,6 +307,7 @@ hb_thread_t * hb_scan_init( hb_handle_t *, volatile int * die,
                             int store_previews, uint64_t min_duration, uint64_t max_duration,
                             int crop_auto_switch_threshold, int crop_median_threshold,
                             hb_list_t * exclude_extensions, int hw_decode, int keep_duplicate_titles);
+int           hb_get_scan_threads( hb_handle_t * );
 hb_thread_t * hb_work_init( hb_list_t * jobs,
                             volatile int * die, hb_error_code * error, hb_job_t ** job );
 void ReadLoop( void * _w );
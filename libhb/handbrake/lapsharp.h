@@ -0,0 +1,31 @@
+/* lapsharp.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_LAPSHARP_H
+#define HANDBRAKE_LAPSHARP_H
+
+typedef struct
+{
+    // Sharpens 'width' pixels of a row with a size x size kernel. The
+    // kernel neighbourhood of every pixel must be readable, the stride
+    // is in pixels.
+    void (*sharpen_row_8)(uint8_t  *dst, const uint8_t  *src, int stride,
+                          int width, const int *kernel, int size,
+                          double coef, double strength, int max_value);
+    void (*sharpen_row_16)(uint16_t *dst, const uint16_t *src, int stride,
+                           int width, const int *kernel, int size,
+                           double coef, double strength, int max_value);
+} LapsharpFunctions;
+
+// Sets the best available kernels
+void lapsharp_init_functions(LapsharpFunctions *functions);
+void lapsharp_init_x86(LapsharpFunctions *functions);
+void lapsharp_init_neon(LapsharpFunctions *functions);
+
+#endif // HANDBRAKE_LAPSHARP_H
@@ -0,0 +1,36 @@
+/* motion_metric.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_MOTION_METRIC_H
+#define HANDBRAKE_MOTION_METRIC_H
+
+typedef struct
+{
+    // Sum of the squared differences of the gamma adjusted pixels of
+    // the 16x16 blocks a and b. Strides are in pixels.
+    unsigned (*sse_block16_8)(const unsigned *gamma_lut,
+                              const uint8_t *a, const uint8_t *b,
+                              int stride_a, int stride_b);
+    unsigned (*sse_block16_16)(const unsigned *gamma_lut,
+                               const uint16_t *a, const uint16_t *b,
+                               int stride_a, int stride_b);
+
+    // Downsample by 4 in both directions, width and height are those
+    // of dest. Strides are in pixels.
+    void (*approximate_frame_data_8)(const uint8_t *source, uint8_t *dest,
+                                     int source_stride, int dest_stride,
+                                     int width, int height);
+    void (*approximate_frame_data_16)(const uint16_t *source, uint16_t *dest,
+                                      int source_stride, int dest_stride,
+                                      int width, int height);
+} MotionMetricFunctions;
+
+void motion_metric_init_x86(MotionMetricFunctions *functions);
+
+#endif // HANDBRAKE_MOTION_METRIC_H
@@ -11,6 +11,26 @@
 #ifndef HANDBRAKE_NLMEANS_H
 #define HANDBRAKE_NLMEANS_H
 
+struct PixelSum
+{
+    float weight_sum;
+    float pixel_sum;
+};
+
+#define NLMEANS_EXPSIZE     128
+
+// Per channel parameters of fast mode
+typedef struct
+{
+    int      sq_shift;      // squared differences are rounded >> sq_shift so
+                            // that patch sums fit the 16-bit integral image
+    uint32_t fact;          // patch difference to exp table index, Q16
+    uint32_t diff_max;      // patch differences at or above add nothing
+    uint32_t origin;        // origin patch weight
+    uint32_t exptable[NLMEANS_EXPSIZE]; // weights, Q weight_bits
+    int      weight_bits;
+} NLMeansFixed;
+
 typedef struct
 {
     void (*build_integral)(uint32_t *integral,
@@ -26,8 +46,41 @@ typedef struct
                            int    dx,
                            int    dy,
                            int    n);
+    // Adds the weighted compare pixels of one row of a displacement
+    void (*accumulate)(struct PixelSum *sums,
+                 const uint32_t *integral_ptr1,
+                 const uint32_t *integral_ptr2,
+                 const void  *compare,
+                       int    n,
+                       int    w,
+                 const float *exptable,
+                 const float  weight_fact_table,
+                 const int    diff_max);
+
+    // Fast mode counterparts of the above
+    void (*build_integral_fast)(uint16_t *integral,
+                                int       integral_stride,
+                          const void     *src_pre,
+                          const void     *compare_pre,
+                                int       bw,
+                                int       dst_w,
+                                int       dst_h,
+                                int       dx,
+                                int       dy,
+                                int       n,
+                                int       sq_shift);
+    void (*accumulate_fast)(uint32_t *weight_sum,
+                            uint32_t *pixel_sum,
+                      const uint16_t *integral_ptr1,
+                      const uint16_t *integral_ptr2,
+                      const void     *compare,
+                            int       n,
+                            int       w,
+                      const NLMeansFixed *fixed);
 } NLMeansFunctions;
 
-void nlmeans_init_x86(NLMeansFunctions *functions);
+// Sets the best available kernels for the bit depth
+void nlmeans_init_functions(NLMeansFunctions *functions, int depth);
+void nlmeans_init_x86(NLMeansFunctions *functions, int depth);
 
 #endif // HANDBRAKE_NLMEANS_H
@@ -0,0 +1,55 @@
+/* pipeline_stats.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_PIPELINE_STATS_H
+#define HANDBRAKE_PIPELINE_STATS_H
+
+/*
+ * Optional per-stage profiling of the work object and filter threads.
+ * Enabled per handle with hb_set_pipeline_stats().
+ */
+
+// Input fifo occupancy is binned by powers of 2:
+// 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+
+#define HB_STAGE_OCCUPANCY_BINS 8
+
+enum
+{
+    HB_STAGE_BUSY = 0,  // in the work function
+    HB_STAGE_STARVED,   // waiting for input
+    HB_STAGE_BLOCKED,   // waiting for room in the output fifo
+    HB_STAGE_TIME_COUNT
+};
+
+typedef struct hb_pipeline_stats_s hb_pipeline_stats_t;
+typedef struct hb_stage_stats_s    hb_stage_stats_t;
+
+hb_pipeline_stats_t * hb_pipeline_stats_init( void );
+void                  hb_pipeline_stats_close( hb_pipeline_stats_t ** );
+void                  hb_pipeline_stats_set( hb_pipeline_stats_t *, int enable,
+                                             const char * trace_prefix );
+int                   hb_pipeline_stats_start( hb_pipeline_stats_t *, hb_job_t * );
+hb_stage_stats_t    * hb_pipeline_stats_add_stage( hb_pipeline_stats_t *,
+                                                   const char * name,
+                                                   const char * type );
+void                  hb_pipeline_stats_stop( hb_pipeline_stats_t * );
+hb_dict_t           * hb_pipeline_stats_to_dict( hb_pipeline_stats_t * );
+
+hb_pipeline_stats_t * hb_get_pipeline_stats( hb_handle_t * );
+
+/*
+ * Called from the stage's own thread.  hb_stage_stats_mark() accounts
+ * the time since 'start' to 'what' and returns the current time.
+ */
+uint64_t hb_stage_stats_mark( hb_stage_stats_t *, int what, uint64_t start );
+void     hb_stage_stats_frames( hb_stage_stats_t *, hb_buffer_t * in,
+                                hb_buffer_t * out );
+void     hb_stage_stats_occupancy( hb_stage_stats_t *, hb_fifo_t * fifo );
+
+#endif // HANDBRAKE_PIPELINE_STATS_H
@@ -201,6 +201,45 @@ void        hb_cond_signal( hb_cond_t * );
 void        hb_cond_broadcast( hb_cond_t * c );
 void        hb_cond_close( hb_cond_t ** );
 
+// Broadcasts the condition when the thread exits
+void        hb_thread_notify_exit( hb_thread_t *, hb_lock_t *, hb_cond_t * );
+
+/************************************************************************
+ * Thread local storage
+ ***********************************************************************/
+typedef struct hb_tls_key_s hb_tls_key_t;
+
+hb_tls_key_t * hb_tls_key_init( void (*destructor)(void *) );
+void           hb_tls_key_close( hb_tls_key_t ** );
+void         * hb_tls_get( hb_tls_key_t * );
+void           hb_tls_set( hb_tls_key_t *, void * );
+
+/************************************************************************
+ * Atomics
+ ************************************************************************
+ * Thin wrappers around the gcc/clang __atomic builtins, which every
+ * supported toolchain (gcc, clang, mingw) provides.
+ ***********************************************************************/
+#define hb_atomic_load(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define hb_atomic_load_relaxed(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define hb_atomic_store(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define hb_atomic_store_relaxed(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define hb_atomic_exchange(p, v)  __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define hb_atomic_add(p, v)       __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define hb_atomic_sub(p, v)       __atomic_sub_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define hb_atomic_cas(p, e, v)    __atomic_compare_exchange_n((p), (e), (v), 0, \
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define hb_atomic_fence()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// Hint to the cpu that we are in a spin-wait loop
+#if defined(__i386__) || defined(__x86_64__)
+#define hb_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define hb_cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define hb_cpu_relax() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+
 /************************************************************************
  * Network
  ***********************************************************************/
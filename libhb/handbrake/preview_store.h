@@ -0,0 +1,53 @@
+/* preview_store.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_PREVIEW_STORE_H
+#define HANDBRAKE_PREVIEW_STORE_H
+
+/*
+ * In-memory store of the raw YUV 4:2:0 previews of a scan, keyed by
+ * title index and preview number.  The store is capped to max_size
+ * bytes; the least recently used previews are evicted to make room and
+ * handed to the spill callback, which writes them to disk.
+ */
+
+// Default memory cap, about 80 1080p previews
+#define HB_PREVIEW_STORE_DEFAULT_SIZE ((int64_t)256 << 20)
+
+typedef struct hb_preview_store_s hb_preview_store_t;
+
+// Writes an evicted preview to disk, buf is closed by the store
+typedef void hb_preview_spill_f( void * opaque, int title, int preview,
+                                 hb_buffer_t * buf, int format );
+
+hb_preview_store_t * hb_preview_store_init( int64_t max_size,
+                                            hb_preview_spill_f * spill,
+                                            void * opaque );
+void                 hb_preview_store_close( hb_preview_store_t ** );
+void                 hb_preview_store_set_max_size( hb_preview_store_t *,
+                                                    int64_t max_size );
+
+/*
+ * Stores a copy of buf, replacing any previous preview with the same
+ * key.  format is the file format used if the preview gets spilled.
+ * Returns -1 if the preview was not stored, e.g. when it alone is
+ * larger than the cap, so the caller must write it to disk itself.
+ */
+int                  hb_preview_store_put( hb_preview_store_t *, int title,
+                                           int preview, const hb_buffer_t * buf,
+                                           int format );
+
+// Returns a copy of the preview, or NULL if it is not in the store
+hb_buffer_t        * hb_preview_store_get( hb_preview_store_t *, int title,
+                                           int preview );
+
+// Removes every preview, spilled previews must be removed separately
+void                 hb_preview_store_clear( hb_preview_store_t * );
+
+#endif // HANDBRAKE_PREVIEW_STORE_H
@@ -12,15 +12,26 @@
 
 #define TASKSET_POSIX_COMPLIANT 1
 
-typedef struct hb_tasket_thread_t {
-    hb_thread_t      * thread;
-    hb_lock_t        * lock;
-    hb_cond_t        * begin_cond;
-    hb_cond_t        * complete_cond;
-    int                begin;
-    int                complete;
-    int                stop;
-} taskset_thread_t;
+/*
+ * A taskset splits one unit of work into thread_count segments.
+ * The segments of every taskset in the process are executed by a
+ * single shared pool of worker threads, one per cpu, so thread_count
+ * is the number of segments, not the number of threads that get
+ * created.
+ *
+ * Segments can also be run individually and asynchronously with
+ * taskset_post(), then collected with taskset_wait().  A taskset must
+ * not be cycled while any of its segments are posted.
+ *
+ * A taskset_budget_t limits how many pool workers may work at once on
+ * all the tasksets that share it, e.g. to honor the thread count of a
+ * job across all of its filters without resizing the pool that other
+ * jobs use.
+ */
+typedef struct hb_taskset_budget_s {
+    int                max;         // workers allowed at once, 0 == no limit
+    int                busy;        // tickets queued or held
+} taskset_budget_t;
 
 typedef struct hb_taskset_s {
     int                thread_count;
@@ -28,8 +39,15 @@ typedef struct hb_taskset_s {
     int                arg_size;
     const char       * task_descr;
     uint8_t          * task_threads_args;
-    int                task_thread_started;
-    taskset_thread_t * task_threads;
+
+    hb_lock_t        * lock;
+    hb_cond_t        * complete_cond;
+    int                next;        // next segment to be claimed
+    int                done;        // segments completed this cycle
+    int                busy;        // pool workers referencing the taskset
+    int                posted;      // segments posted and not yet claimed
+    taskset_budget_t * budget;      // shared worker limit, may be NULL
+    int              * state;       // state of each posted segment
 } taskset_t;
 
 typedef struct hb_taskset_thread_arg_s {
@@ -40,6 +58,17 @@ typedef struct hb_taskset_thread_arg_s {
 int taskset_init( taskset_t *, const char* /* descr */, int /*thread_count*/, size_t /*user_arg_size*/, thread_func_t *);
 void taskset_cycle( taskset_t * );
 void taskset_fini( taskset_t * );
+void taskset_set_budget( taskset_t *, taskset_budget_t * );
+
+void taskset_post( taskset_t *, int /*segment*/ );
+int  taskset_done( taskset_t *, int /*segment*/ );
+void taskset_wait( taskset_t *, int /*segment*/ );
+
+taskset_budget_t * taskset_budget_init( int /*max*/ );
+void taskset_budget_close( taskset_budget_t ** );
+
+int  taskset_pool_get_threads( void );
+void taskset_pool_close( void );
 
 static inline void *taskset_thread_args( taskset_t *, int );
 
@@ -0,0 +1,49 @@
+/* unsharp.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#ifndef HANDBRAKE_UNSHARP_H
+#define HANDBRAKE_UNSHARP_H
+
+// Parameters of the final blend of the source with its blur
+typedef struct
+{
+    int      amount;
+    int      scalebits;
+    uint32_t halfscale;
+    int      min_value;
+    int      max_value;
+    int      smooth;    // subtract the difference to the blur instead of adding it
+} UnsharpMix;
+
+// Row kernels of the binomial blur shared by unsharp and chroma smooth.
+// All sums are kept modulo 2^32 so any kernel gives identical results.
+typedef struct
+{
+    // Extends a source row by 'steps' edge pixels on both sides into
+    // 'row' and blurs it horizontally, in place
+    void (*blur_row_8)(uint32_t *row, const uint8_t  *src, int width, int steps);
+    void (*blur_row_16)(uint32_t *row, const uint16_t *src, int width, int steps);
+
+    // Blurs 'width' values of a horizontally blurred row vertically,
+    // SC holding the 2 * steps partial sums of the previous rows
+    void (*blur_column)(uint32_t *row, uint32_t **SC, int width, int steps);
+
+    // Blends a source row with its blur
+    void (*mix_row_8)(uint8_t  *dst, const uint8_t  *src, const uint32_t *blur,
+                      int width, const UnsharpMix *mix);
+    void (*mix_row_16)(uint16_t *dst, const uint16_t *src, const uint32_t *blur,
+                       int width, const UnsharpMix *mix);
+} UnsharpFunctions;
+
+// Sets the best available kernels, the name is used for logging
+void unsharp_init_functions(UnsharpFunctions *functions, const char *name);
+void unsharp_init_x86(UnsharpFunctions *functions, const char *name);
+void unsharp_init_neon(UnsharpFunctions *functions, const char *name);
+
+#endif // HANDBRAKE_UNSHARP_H
@@ -11,6 +11,9 @@
 #include "handbrake/hbffmpeg.h"
 #include "handbrake/hbavfilter.h"
 #include "handbrake/encx264.h"
+#include "handbrake/taskset.h"
+#include "handbrake/pipeline_stats.h"
+#include "handbrake/preview_store.h"
 #include "libavfilter/avfilter.h"
 #include <stdio.h>
 #include <unistd.h>
@@ -52,8 +55,15 @@ struct hb_handle_s
     hb_thread_t  * work_thread;
 
     hb_lock_t    * state_lock;
+    hb_cond_t    * state_cond;    // broadcast on every state change
+    int            state_serial;  // incremented on every state change
+    uint64_t       state_date;    // last broadcast of state_cond
     hb_state_t     state;
 
+    /* Callbacks registered with hb_state_subscribe() */
+    hb_lock_t    * observer_lock;
+    hb_list_t    * observers;
+
     int            paused;
     hb_lock_t    * pause_lock;
     int64_t        pause_date;
@@ -68,6 +78,15 @@ struct hb_handle_s
 
     // power management opaque pointer
     void         * system_sleep_opaque;
+
+    // per stage profiling of jobs, see hb_set_pipeline_stats()
+    hb_pipeline_stats_t * pipeline_stats;
+
+    // scan previews kept in memory, see hb_set_preview_store_size()
+    hb_preview_store_t  * preview_store;
+
+    // titles scanned concurrently, see hb_set_scan_threads()
+    int                   scan_threads;
 };
 
 hb_work_object_t * hb_objects = NULL;
@@ -75,6 +94,73 @@ int hb_instance_counter = 0;
 int disable_hardware = 0;
 
 static void thread_func( void * );
+static void spill_preview( void * opaque, int title, int preview,
+                           hb_buffer_t * buf, int format );
+
+typedef struct
+{
+    hb_state_callback_t * callback;
+    void                * opaque;
+} hb_state_observer_t;
+
+// Progress updates arrive with every frame, so waiters are woken for
+// them at most this often (ms). Changes of state.state wake them at once.
+// See state_wait() for how the updates in between are delivered.
+#define HB_STATE_PROGRESS_INTERVAL 200
+
+// Wakes hb_state_wait() callers and the libhb thread.
+// Called with state_lock held.
+static void state_changed( hb_handle_t * h )
+{
+    h->state_serial++;
+    h->state_date = hb_get_date();
+    hb_cond_broadcast( h->state_cond );
+}
+
+static void state_progress( hb_handle_t * h )
+{
+    h->state_serial++;
+    if ( hb_get_date() >= h->state_date + HB_STATE_PROGRESS_INTERVAL )
+    {
+        h->state_date = hb_get_date();
+        hb_cond_broadcast( h->state_cond );
+    }
+}
+
+// Waits on state_cond for at most timeout_ms, negative waits forever.
+// A progress update within HB_STATE_PROGRESS_INTERVAL of the last
+// broadcast does not broadcast itself, so until the interval is over the
+// wait is cut short to pick it up. Updates after that broadcast at once.
+// Called with state_lock held.
+static void state_wait( hb_handle_t * h, int64_t timeout_ms )
+{
+    uint64_t now   = hb_get_date();
+    uint64_t quiet = h->state_date + HB_STATE_PROGRESS_INTERVAL;
+
+    if ( now < quiet && ( timeout_ms < 0 || quiet - now < timeout_ms ) )
+    {
+        timeout_ms = quiet - now;
+    }
+    if ( timeout_ms < 0 )
+    {
+        hb_cond_wait( h->state_cond, h->state_lock );
+    }
+    else
+    {
+        hb_cond_timedwait( h->state_cond, h->state_lock, timeout_ms );
+    }
+}
+
+// Called with state_lock held
+static void copy_state( hb_handle_t * h, hb_state_t * s )
+{
+    memcpy( s, &h->state, sizeof( hb_state_t ) );
+    if ( h->paused && h->pause_date != -1 && s->state == HB_STATE_PAUSED )
+    {
+        s->param.working.paused = h->pause_duration +
+                                  hb_get_date() - h->pause_date;
+    }
+}
 
 int hb_avcodec_open(AVCodecContext *avctx, const AVCodec *codec,
                     AVDictionary **av_opts, int thread_count)
@@ -218,14 +304,24 @@ hb_handle_t * hb_init( int verbose )
 	h->title_set.list_title = hb_list_init();
     h->jobs       = hb_list_init();
 
-    h->state_lock  = hb_lock_init();
-    h->state.state = HB_STATE_IDLE;
+    h->state_lock   = hb_lock_init();
+    h->state_cond   = hb_cond_init();
+    h->state_serial = 1;
+    h->state.state  = HB_STATE_IDLE;
+
+    h->observer_lock = hb_lock_init();
+    h->observers     = hb_list_init();
 
     h->pause_lock = hb_lock_init();
     h->pause_date = -1;
 
     h->interjob = calloc( sizeof( hb_interjob_t ), 1 );
 
+    h->pipeline_stats = hb_pipeline_stats_init();
+
+    h->preview_store = hb_preview_store_init(HB_PREVIEW_STORE_DEFAULT_SIZE,
+                                             spill_preview, h);
+
     /* Start library thread */
     hb_log( "hb_init: starting libhb thread" );
     h->die         = 0;
@@ -322,6 +418,8 @@ void hb_remove_previews( hb_handle_t * h )
     DIR           * dir;
     struct dirent * entry;
 
+    hb_preview_store_clear( h->preview_store );
+
     dirname = hb_get_temporary_directory();
     dir = opendir( dirname );
     if (dir == NULL)
@@ -412,6 +510,7 @@ void hb_scan( hb_handle_t * h, hb_list_t * paths, int title_index,
                     // Title has already been scanned.
                     hb_lock( h->state_lock );
                     h->state.state = HB_STATE_SCANDONE;
+                    state_changed( h );
                     hb_unlock( h->state_lock );
                     return;
                 }
@@ -465,6 +564,7 @@ void hb_scan( hb_handle_t * h, hb_list_t * paths, int title_index,
                                    store_previews, min_duration, max_duration,
                                    crop_threshold_frames, crop_threshold_pixels,
                                    exclude_extensions, hw_decode, keep_duplicate_titles);
+    hb_thread_notify_exit( h->scan_thread, h->state_lock, h->state_cond );
 }
 
 void hb_force_rescan( hb_handle_t * h )
@@ -501,7 +601,8 @@ hb_list_t * hb_get_title_coverarts( hb_handle_t * h, int title )
     return emptyList;
 }
 
-int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf, int format )
+static int write_preview_file( hb_handle_t * h, int title, int preview,
+                               const hb_buffer_t *buf, int format )
 {
     FILE    * file;
     char    * filename;
@@ -519,7 +620,7 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
             strncpy(format_string, "jpg", format_chars);
             break;
         default:
-            hb_error("hb_save_preview: Unsupported preview format %d", format);
+            hb_error("write_preview_file: Unsupported preview format %d", format);
             return -1;
     }
 
@@ -533,7 +634,7 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
         {
             strcpy(reason, "unknown -- strerror_r() failed");
         }
-        hb_error("hb_save_preview: Failed to open %s (reason: %s)",
+        hb_error("write_preview_file: Failed to open %s (reason: %s)",
                  filename, reason);
         free(filename);
         return -1;
@@ -559,7 +660,7 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
                         {
                             strcpy(reason, "unknown -- strerror_r() failed");
                         }
-                        hb_error("hb_save_preview: Failed to write line %d to %s "
+                        hb_error("write_preview_file: Failed to write line %d to %s "
                                  "(reason: %s). Preview will be incomplete.",
                                  hh, filename, reason);
                         goto done;
@@ -603,13 +704,13 @@ int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf,
                 {
                     strcpy(reason, "unknown -- strerror_r() failed");
                 }
-                hb_error("hb_save_preview: Failed to write to %s "
+                hb_error("write_preview_file: Failed to write to %s "
                          "(reason: %s).", filename, reason);
             }
         }
         else
         {
-            hb_error("hb_save_preview: JPEG compression failed for "
+            hb_error("write_preview_file: JPEG compression failed for "
                      "preview image %s", filename);
         }
 
@@ -624,6 +725,26 @@ done:
     return 0;
 }
 
+static void spill_preview( void * opaque, int title, int preview,
+                           hb_buffer_t * buf, int format )
+{
+    write_preview_file(opaque, title, preview, buf, format);
+}
+
+/**
+ * Saves a preview of the title, in memory while the preview store has
+ * room and in a temporary file otherwise.
+ * @param format File format, HB_PREVIEW_FORMAT_YUV or HB_PREVIEW_FORMAT_JPG
+ */
+int hb_save_preview( hb_handle_t * h, int title, int preview, hb_buffer_t *buf, int format )
+{
+    if (hb_preview_store_put(h->preview_store, title, preview, buf, format) == 0)
+    {
+        return 0;
+    }
+    return write_preview_file(h, title, preview, buf, format);
+}
+
 hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, int format)
 {
     FILE    * file = NULL;
@@ -634,6 +755,17 @@ hb_buffer_t * hb_read_preview(hb_handle_t * h, hb_title_t *title, int preview, i
     char      format_string[format_chars];
 
     hb_buffer_t * buf;
+    buf = hb_preview_store_get(h->preview_store, title->index, preview);
+    if (buf != NULL)
+    {
+        buf->f.color_prim      = title->color_prim;
+        buf->f.color_transfer  = title->color_transfer;
+        buf->f.color_matrix    = title->color_matrix;
+        buf->f.color_range     = AVCOL_RANGE_MPEG;
+        buf->f.chroma_location = title->chroma_location;
+        return buf;
+    }
+
     buf = hb_frame_buffer_init(AV_PIX_FMT_YUV420P,
                                title->geometry.width, title->geometry.height);
     buf->f.color_prim      = title->color_prim;
@@ -815,6 +947,8 @@ hb_image_t * hb_get_preview(hb_handle_t * h, hb_dict_t * job_dict,
     hb_filter_init_t   init;
     int                ii;
 
+    job->filter_budget = taskset_budget_init(job->filter_threads);
+
     memset(&init, 0, sizeof(init));
     init.time_base.num = 1;
     init.time_base.den = 90000;
@@ -1003,6 +1137,7 @@ hb_image_t * hb_get_preview(hb_handle_t * h, hb_dict_t * job_dict,
         filter = hb_list_item(list_filter, ii);
         filter->close(filter);
     }
+    taskset_budget_close(&job->filter_budget);
 
     // Close fifos
     hb_fifo_close(&fifo_first);
@@ -1998,6 +2133,7 @@ void hb_start( hb_handle_t * h )
     p.seconds      = -1;
     p.paused       = 0;
 #undef p
+    state_changed( h );
     hb_unlock( h->state_lock );
 
     h->paused         = 0;
@@ -2006,6 +2142,7 @@ void hb_start( hb_handle_t * h )
     h->work_die       = 0;
     h->work_error     = HB_ERROR_NONE;
     h->work_thread    = hb_work_init( h->jobs, &h->work_die, &h->work_error, &h->current_job );
+    hb_thread_notify_exit( h->work_thread, h->state_lock, h->state_cond );
 }
 
 /**
@@ -2023,6 +2160,7 @@ void hb_pause( hb_handle_t * h )
 
         hb_lock( h->state_lock );
         h->state.state = HB_STATE_PAUSED;
+        state_changed( h );
         hb_unlock( h->state_lock );
     }
 }
@@ -2082,7 +2220,7 @@ void hb_get_state( hb_handle_t * h, hb_state_t * s )
 {
     hb_lock( h->state_lock );
 
-    memcpy( s, &h->state, sizeof( hb_state_t ) );
+    copy_state( h, s );
     if ( h->state.state == HB_STATE_SCANDONE || h->state.state == HB_STATE_WORKDONE )
         h->state.state = HB_STATE_IDLE;
 
@@ -2093,9 +2231,153 @@ void hb_get_state2( hb_handle_t * h, hb_state_t * s )
 {
     hb_lock( h->state_lock );
 
-    memcpy( s, &h->state, sizeof( hb_state_t ) );
+    copy_state( h, s );
+
+    hb_unlock( h->state_lock );
+}
 
+/**
+ * Waits for the state to change.
+ * @param h Handle to hb_handle_t
+ * @param serial Value returned by the previous call, 0 on the first call
+ * @param timeout_ms Maximum wait in milliseconds, negative to wait forever
+ * @param s Handle to hb_state_t which to copy the state data, may be NULL
+ * @return The serial of the current state
+ */
+int hb_state_wait( hb_handle_t * h, int serial, int timeout_ms, hb_state_t * s )
+{
+    uint64_t deadline = hb_get_date() + ( timeout_ms > 0 ? timeout_ms : 0 );
+
+    hb_lock( h->state_lock );
+    while ( h->state_serial == serial && timeout_ms != 0 )
+    {
+        if ( timeout_ms < 0 )
+        {
+            state_wait( h, -1 );
+            continue;
+        }
+
+        uint64_t now = hb_get_date();
+        if ( now >= deadline )
+        {
+            break;
+        }
+        state_wait( h, deadline - now );
+    }
+    serial = h->state_serial;
+    if ( s != NULL )
+    {
+        copy_state( h, s );
+    }
     hb_unlock( h->state_lock );
+
+    return serial;
+}
+
+/**
+ * Registers a callback that the libhb thread calls after state changes.
+ * @param h Handle to hb_handle_t
+ * @param callback Function to call with the new state
+ * @param opaque Passed to callback
+ */
+void hb_state_subscribe( hb_handle_t * h, hb_state_callback_t * callback,
+                         void * opaque )
+{
+    hb_state_observer_t * observer = calloc( 1, sizeof( hb_state_observer_t ) );
+
+    observer->callback = callback;
+    observer->opaque   = opaque;
+
+    hb_lock( h->observer_lock );
+    hb_list_add( h->observers, observer );
+    hb_unlock( h->observer_lock );
+}
+
+/**
+ * Removes a callback registered with hb_state_subscribe.
+ * The callback is not running and will not be called when this returns.
+ * @param h Handle to hb_handle_t
+ * @param callback Function passed to hb_state_subscribe
+ * @param opaque Value passed to hb_state_subscribe
+ */
+void hb_state_unsubscribe( hb_handle_t * h, hb_state_callback_t * callback,
+                           void * opaque )
+{
+    int ii;
+
+    hb_lock( h->observer_lock );
+    for ( ii = 0; ii < hb_list_count( h->observers ); ii++ )
+    {
+        hb_state_observer_t * observer = hb_list_item( h->observers, ii );
+        if ( observer->callback == callback && observer->opaque == opaque )
+        {
+            hb_list_rem( h->observers, observer );
+            free( observer );
+            break;
+        }
+    }
+    hb_unlock( h->observer_lock );
+}
+
+static void notify_observers( hb_handle_t * h, const hb_state_t * s )
+{
+    int ii;
+
+    hb_lock( h->observer_lock );
+    for ( ii = 0; ii < hb_list_count( h->observers ); ii++ )
+    {
+        hb_state_observer_t * observer = hb_list_item( h->observers, ii );
+        observer->callback( h, s, observer->opaque );
+    }
+    hb_unlock( h->observer_lock );
+}
+
+/**
+ * Enables per stage profiling of the following jobs.
+ * @param h Handle to hb_handle_t
+ * @param enable 1 to record stage statistics, see hb_get_pipeline_stats_json()
+ * @param trace_prefix If not NULL, a Chrome trace-event file named
+ *                     <trace_prefix>-<sequence id>-<pass>.json is written
+ *                     at the end of each job
+ */
+void hb_set_pipeline_stats( hb_handle_t * h, int enable, const char * trace_prefix )
+{
+    hb_pipeline_stats_set( h->pipeline_stats, enable, trace_prefix );
+}
+
+hb_pipeline_stats_t * hb_get_pipeline_stats( hb_handle_t * h )
+{
+    return h->pipeline_stats;
+}
+
+/**
+ * Sets the memory cap of the scan previews kept in memory.  Previews
+ * that do not fit are written to temporary files, as are the least
+ * recently used ones when the cap is lowered.
+ * @param h Handle to hb_handle_t
+ * @param max_size Cap in bytes, 0 keeps every preview on disk
+ */
+void hb_set_preview_store_size( hb_handle_t * h, int64_t max_size )
+{
+    hb_preview_store_set_max_size( h->preview_store, max_size );
+}
+
+/**
+ * Sets the number of titles scanned concurrently when scanning a
+ * directory or a list of files.  Disc titles are always scanned one
+ * at a time.
+ * @param h Handle to hb_handle_t
+ * @param threads 0 to pick a count from the number of CPUs, 1 to scan
+ *                one title at a time
+ */
+void hb_set_scan_threads( hb_handle_t * h, int threads )
+{
+    h->scan_threads = threads;
+}
+
+int hb_get_scan_threads( hb_handle_t * h )
+{
+    return h->scan_threads;
 }
 
 /**
@@ -2106,8 +2388,12 @@ void hb_close( hb_handle_t ** _h )
 {
     hb_handle_t * h = *_h;
     hb_title_t * title;
+    hb_state_observer_t * observer;
 
+    hb_lock( h->state_lock );
     h->die = 1;
+    hb_cond_broadcast( h->state_cond );
+    hb_unlock( h->state_lock );
 
     hb_thread_close( &h->main_thread );
 
@@ -2122,12 +2408,24 @@ void hb_close( hb_handle_t ** _h )
 
     hb_list_close( &h->jobs );
     hb_lock_close( &h->state_lock );
+    hb_cond_close( &h->state_cond );
     hb_lock_close( &h->pause_lock );
 
+    while( ( observer = hb_list_item( h->observers, 0 ) ) )
+    {
+        hb_list_rem( h->observers, observer );
+        free( observer );
+    }
+    hb_list_close( &h->observers );
+    hb_lock_close( &h->observer_lock );
+
     hb_system_sleep_opaque_close(&h->system_sleep_opaque);
 
     free( h->interjob );
 
+    hb_pipeline_stats_close( &h->pipeline_stats );
+    hb_preview_store_close( &h->preview_store );
+
     free( h );
     *_h = NULL;
 }
@@ -2210,6 +2508,7 @@ void hb_global_close()
     struct dirent * entry;
 
     hb_presets_free();
+    taskset_pool_close();
 
     /* Find and remove temp folder */
     dirname = hb_get_temporary_directory();
@@ -2233,16 +2532,25 @@ void hb_global_close()
     }
 }
 
+static int thread_exited( hb_thread_t * t )
+{
+    return t != NULL && hb_thread_has_exited( t );
+}
+
 /**
  * Monitors the state of the update, scan, and work threads.
  * Sets scan done state when scan thread exits.
  * Sets work done state when work thread exits.
+ * Reports state changes to hb_state_subscribe() callbacks.
+ * Sleeps until the state changes or one of the threads exits.
  * @param _h Handle to hb_handle_t
  */
 static void thread_func( void * _h )
 {
     hb_handle_t * h = (hb_handle_t *) _h;
     const char * dirname;
+    hb_state_t   state;
+    int          serial = 0;
 
     h->pid = getpid();
 
@@ -2254,8 +2562,7 @@ static void thread_func( void * _h )
     while( !h->die )
     {
         /* Check if the scan thread is done */
-        if( h->scan_thread &&
-            hb_thread_has_exited( h->scan_thread ) )
+        if( thread_exited( h->scan_thread ) )
         {
             hb_thread_close( &h->scan_thread );
 
@@ -2279,12 +2586,12 @@ static void thread_func( void * _h )
             }
             hb_lock( h->state_lock );
             h->state.state = HB_STATE_SCANDONE;
+            state_changed( h );
             hb_unlock( h->state_lock );
         }
 
         /* Check if the work thread is done */
-        if( h->work_thread &&
-            hb_thread_has_exited( h->work_thread ) )
+        if( thread_exited( h->work_thread ) )
         {
             hb_thread_close( &h->work_thread );
 
@@ -2292,16 +2599,27 @@ static void thread_func( void * _h )
             hb_lock( h->state_lock );
             h->state.state               = HB_STATE_WORKDONE;
             h->state.param.working.error = h->work_error;
-
+            state_changed( h );
             hb_unlock( h->state_lock );
         }
 
-        if (h->paused)
+        hb_lock( h->state_lock );
+        if ( serial != h->state_serial )
+        {
+            serial = h->state_serial;
+            copy_state( h, &state );
+            hb_unlock( h->state_lock );
+
+            notify_observers( h, &state );
+            continue;
+        }
+        if ( !h->die &&
+             !thread_exited( h->scan_thread ) &&
+             !thread_exited( h->work_thread ) )
         {
-            h->state.param.working.paused = h->pause_duration +
-                                            hb_get_date() - h->pause_date;
+            state_wait( h, -1 );
         }
-        hb_snooze( 50 );
+        hb_unlock( h->state_lock );
     }
 
     if( h->scan_thread )
@@ -2372,8 +2690,11 @@ int hb_get_instance_id( hb_handle_t * h )
  */
 void hb_set_state( hb_handle_t * h, hb_state_t * s )
 {
+    int transition;
+
     hb_lock( h->pause_lock );
     hb_lock( h->state_lock );
+    transition = h->state.state != s->state;
     memcpy( &h->state, s, sizeof( hb_state_t ) );
     if( h->state.state == HB_STATE_WORKING ||
         h->state.state == HB_STATE_SEARCHING )
@@ -2382,6 +2703,14 @@ void hb_set_state( hb_handle_t * h, hb_state_t * s )
         if (h->current_job)
             h->state.sequence_id = h->current_job->sequence_id;
     }
+    if ( transition )
+    {
+        state_changed( h );
+    }
+    else
+    {
+        state_progress( h );
+    }
     hb_unlock( h->state_lock );
     hb_unlock( h->pause_lock );
 }
@@ -10,6 +10,7 @@
 #include <jansson.h>
 #include "handbrake/handbrake.h"
 #include "handbrake/hb_json.h"
+#include "handbrake/pipeline_stats.h"
 #include "libavutil/base64.h"
 
 /**
@@ -166,6 +167,20 @@ char* hb_get_state_json( hb_handle_t * h )
     return json_state;
 }
 
+/**
+ * Get the per stage statistics of the current or last profiled job
+ * @param h - Pointer to an hb_handle_t hb instance
+ */
+char* hb_get_pipeline_stats_json( hb_handle_t * h )
+{
+    hb_dict_t *dict = hb_pipeline_stats_to_dict(hb_get_pipeline_stats(h));
+
+    char *json_stats = hb_value_get_json(dict);
+    hb_value_free(&dict);
+
+    return json_stats;
+}
+
 hb_dict_t * hb_audio_attributes_to_dict(uint32_t attributes)
 {
     json_error_t error;
@@ -604,11 +619,13 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
     "{"
     // SequenceID
     "s:o,"
+    // MemoryBudget
+    "s:o,"
     // Destination {Mux, InlineParameterSets, AlignAVStart,
     //              ChapterMarkers, ChapterList}
     "s:{s:o, s:o, s:o, s:o, s:[]},"
-    // Source {Path, Title, Angle, HWDecode, KeepDuplicateTitles}
-    "s:{s:o, s:o, s:o, s:o, s:o},"
+    // Source {Path, Title, Angle, HWDecode, KeepDuplicateTitles, ReadAhead}
+    "s:{s:o, s:o, s:o, s:o, s:o, s:o},"
     // PAR {Num, Den}
     "s:{s:o, s:o},"
     // Video {Encoder, HardwareDecode, AdapterIndex, AsyncDepth}
@@ -619,10 +636,11 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
     "s:{s:{s:o, s:o, s:o, s:o}, s:[]},"
     // Metadata
     "s:o,"
-    // Filters {FilterList []}
-    "s:{s:[]}"
+    // Filters {Threads, FrameWindow, Fuse, FilterList []}
+    "s:{s:o, s:o, s:o, s:[]}"
     "}",
         "SequenceID",           hb_value_int(job->sequence_id),
+        "MemoryBudget",         hb_value_int(job->memory_budget),
         "Destination",
             "Mux",              hb_value_int(job->mux),
             "InlineParameterSets", hb_value_bool(job->inline_parameter_sets),
@@ -635,6 +653,7 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
             "Angle",            hb_value_int(job->angle),
             "HWDecode",         hb_value_int(job->hw_decode),
             "KeepDuplicateTitles", hb_value_bool(job->keep_duplicate_titles),
+            "ReadAhead",        hb_value_int(job->read_ahead),
         "PAR",
             "Num",              hb_value_int(job->par.num),
             "Den",              hb_value_int(job->par.den),
@@ -656,6 +675,9 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
             "SubtitleList",
         "Metadata",             hb_value_dup(job->metadata->dict),
         "Filters",
+            "Threads",          hb_value_int(job->filter_threads),
+            "FrameWindow",      hb_value_int(job->filter_frame_window),
+            "Fuse",             hb_value_int(job->filter_fuse),
             "FilterList"
     );
     if (dict == NULL)
@@ -1086,11 +1108,10 @@ void hb_json_job_scan( hb_handle_t * h, const char * json_job )
 
     // Wait for scan to complete
     hb_state_t state;
-    hb_get_state2(h, &state);
+    int serial = hb_state_wait(h, 0, 0, &state);
     while (state.state == HB_STATE_SCANNING)
     {
-        hb_snooze(50);
-        hb_get_state2(h, &state);
+        serial = hb_state_wait(h, serial, 1000, &state);
     }
     hb_value_free(&dict);
 }
@@ -1172,12 +1193,15 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "{"
     // SequenceID
     "s:i,"
+    // MemoryBudget
+    "s?i,"
     // Destination {File, Mux, InlineParameterSets, AlignAVStart,
     //              ChapterMarkers, ChapterList,
     //              Options {Optimize, IpodAtom}}
     "s:{s?s, s:o, s?b, s?b, s:b, s?o s?{s?b, s?b}},"
-    // Source {Angle, KeepDuplicateTitles, Range {Type, Start, End, SeekPoints}}
-    "s:{s?i, s?b, s?{s:s, s?I, s?I, s?I}},"
+    // Source {Angle, KeepDuplicateTitles, ReadAhead,
+    //         Range {Type, Start, End, SeekPoints}}
+    "s:{s?i, s?b, s?i, s?{s:s, s?I, s?I, s?I}},"
     // PAR {Num, Den}
     "s?{s:i, s:i},"
     // Video {Codec, Quality, Bitrate, Preset, Tune, Profile, Level, Options
@@ -1206,10 +1230,11 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "s?o,"
     // Cover arts
     "s?o,"
-    // Filters {FilterList}
-    "s?{s?o}"
+    // Filters {Threads, FrameWindow, Fuse, FilterList}
+    "s?{s?i, s?i, s?i, s?o}"
     "}",
         "SequenceID",               unpack_i(&job->sequence_id),
+        "MemoryBudget",             unpack_i(&job->memory_budget),
         "Destination",
             "File",                 unpack_s(&destfile),
             "Mux",                  unpack_o(&mux),
@@ -1223,6 +1248,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
         "Source",
             "Angle",                unpack_i(&job->angle),
             "KeepDuplicateTitles",  unpack_b(&job->keep_duplicate_titles),
+            "ReadAhead",            unpack_i(&job->read_ahead),
             "Range",
                 "Type",             unpack_s(&range_type),
                 "Start",            unpack_I(&range_start),
@@ -1274,6 +1300,9 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
         "Metadata",                 unpack_o(&meta_dict),
         "CoverArts",                unpack_o(&art_array),
         "Filters",
+            "Threads",              unpack_i(&job->filter_threads),
+            "FrameWindow",          unpack_i(&job->filter_frame_window),
+            "Fuse",                 unpack_i(&job->filter_fuse),
             "FilterList",           unpack_o(&filter_list)
     );
     if (result < 0)
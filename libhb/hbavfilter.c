@@ -328,6 +328,9 @@ void hb_avfilter_combine( hb_list_t * list)
                 hb_filter_private_t * avpv = NULL;
                 avfilter = hb_filter_init(HB_FILTER_AVFILTER);
                 avfilter->aliased = 1;
+                // The graph can share a thread with its neighbours
+                // only if none of the filters it replaces delays frames
+                avfilter->fuse = 1;
 
                 avpv = calloc(1, sizeof(struct hb_filter_private_s));
                 avfilter->private_data = avpv;
@@ -337,6 +340,7 @@ void hb_avfilter_combine( hb_list_t * list)
                 hb_list_insert(list, ii, avfilter);
                 ii++;
             }
+            avfilter->fuse &= filter->fuse;
 
 #if HB_PROJECT_FEATURE_QSV
             // Concat qsv settings as one vpp_qsv filter to optimize pipeline
@@ -8,6 +8,7 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/lapsharp.h"
 
 #define LAPSHARP_STRENGTH_LUMA_DEFAULT   0.2
 #define LAPSHARP_STRENGTH_CHROMA_DEFAULT 0.2
@@ -89,6 +90,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    LapsharpFunctions        functions;
     lapsharp_plane_context_t plane_ctx[3];
 
     hb_filter_init_t         input;
@@ -122,71 +124,101 @@ hb_filter_object_t hb_filter_lapsharp =
 };
 
 #define DEF_LAPSHARP_FUNC(name, nbits, pixelbits)                                                \
-static void name##_##nbits(const uint8_t *frame_src,                                             \
-                                 uint8_t *frame_dst,                                             \
-                           const int width,                                                      \
-                           const int height,                                                     \
-                           int stride_src,                                                       \
-                           int stride_dst,                                                       \
-                           lapsharp_plane_context_t *ctx)                                        \
+static void name##_row_##nbits(uint##nbits##_t *dst,                                             \
+                         const uint##nbits##_t *src,                                             \
+                               int    stride,                                                    \
+                               int    width,                                                     \
+                         const int   *kernel,                                                    \
+                               int    size,                                                      \
+                               double coef,                                                      \
+                               double strength,                                                  \
+                               int    max_value)                                                 \
 {                                                                                                \
-    const kernel_t *kernel = &kernels[ctx->kernel];                                              \
-                                                                                                 \
-    const uint##nbits##_t *src = (const uint##nbits##_t *)frame_src;                             \
-    uint##nbits##_t       *dst = (uint##nbits##_t *)frame_dst;                                   \
-                                                                                                 \
-    stride_src /= ctx->bps;                                                                      \
-    stride_dst /= ctx->bps;                                                                      \
-                                                                                                 \
-    /* Sharpen using selected kernel */                                                          \
-    const int offset_min    = -((kernel->size - 1) / 2);                                         \
-    const int offset_max    =   (kernel->size + 1) / 2;                                          \
-    const int stride_border =   (stride_src - width) / 2;                                        \
-    const int max_value     = ctx->max_value;                                                    \
+    const int offset_min = -((size - 1) / 2);                                                    \
+    const int offset_max =   (size + 1) / 2;                                                     \
                                                                                                  \
     int##pixelbits##_t pixel;                                                                    \
                                                                                                  \
-    for (int y = 0; y < height; y++)                                                             \
+    for (int x = 0; x < width; x++)                                                              \
     {                                                                                            \
-        for (int x = 0; x < width; x++)                                                          \
+        pixel = 0;                                                                               \
+        for (int k = offset_min; k < offset_max; k++)                                            \
         {                                                                                        \
-            if ((y < offset_max) ||                                                              \
-                (y > height - offset_max) ||                                                     \
-                (x < stride_border + offset_max) ||                                              \
-                (x > width + stride_border - offset_max))                                        \
+            for (int j = offset_min; j < offset_max; j++)                                        \
             {                                                                                    \
-                *(dst + stride_dst*y + x) = *(src + stride_src*y + x);                           \
-                continue;                                                                        \
+                pixel += kernel[((j - offset_min) * size) + k - offset_min] *                    \
+                         *(src + stride*j + (x + k));                                            \
             }                                                                                    \
-                                                                                                 \
-            pixel = 0;                                                                           \
-            for (int k = offset_min; k < offset_max; k++)                                        \
-            {                                                                                    \
-                for (int j = offset_min; j < offset_max; j++)                                    \
-                {                                                                                \
-                    pixel += kernel->mem[((j - offset_min) * kernel->size) +                     \
-                             k - offset_min] * *(src + stride_src*(y + j) + (x + k));            \
-                }                                                                                \
-            }                                                                                    \
-            pixel = (int##pixelbits##_t)(((pixel * kernel->coef) - *(src + stride_src*y + x)) *  \
-                        ctx->strength) + *(src + stride_src*y + x);                              \
-            pixel = pixel < 0 ? 0 : pixel;                                                       \
-            pixel = pixel > max_value ? max_value : pixel;                                       \
-            *(dst + stride_dst*y + x) = (uint##nbits##_t)(pixel);                                \
         }                                                                                        \
+        pixel = (int##pixelbits##_t)(((pixel * coef) - *(src + x)) * strength) + *(src + x);    \
+        pixel = pixel < 0 ? 0 : pixel;                                                           \
+        pixel = pixel > max_value ? max_value : pixel;                                           \
+        *(dst + x) = (uint##nbits##_t)(pixel);                                                   \
     }                                                                                            \
 }                                                                                                \
 
 DEF_LAPSHARP_FUNC(lapsharp, 16, 32)
 DEF_LAPSHARP_FUNC(lapsharp, 8, 16)
 
-#define hb_lapsharp(...)                               \
-    switch (pv->depth)                                 \
-    {                                                  \
-        case  8: lapsharp_8(__VA_ARGS__); break;       \
-        default: lapsharp_16(__VA_ARGS__); break;      \
-    }                                                  \
+void lapsharp_init_functions(LapsharpFunctions *functions)
+{
+    functions->sharpen_row_8  = lapsharp_row_8;
+    functions->sharpen_row_16 = lapsharp_row_16;
+
+#if defined(ARCH_X86)
+    lapsharp_init_x86(functions);
+#elif defined(__aarch64__)
+    lapsharp_init_neon(functions);
+#endif
+}
+
+static void hb_lapsharp(const LapsharpFunctions *functions,
+                        const uint8_t *frame_src,
+                              uint8_t *frame_dst,
+                        const int width,
+                        const int height,
+                        const int stride_src,
+                        const int stride_dst,
+                        lapsharp_plane_context_t *ctx)
+{
+    const kernel_t *kernel = &kernels[ctx->kernel];
+    const int bps          = ctx->bps;
 
+    /* Sharpen using selected kernel */
+    const int offset_max    = (kernel->size + 1) / 2;
+    const int stride_border = (stride_src / bps - width) / 2;
+    const int x0            = stride_border + offset_max;
+    const int x1            = MIN(width - 1, width + stride_border - offset_max);
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t *src = frame_src + stride_src * y;
+        uint8_t       *dst = frame_dst + stride_dst * y;
+
+        // Pixels without a full neighbourhood are copied
+        if ((y < offset_max) || (y > height - offset_max) || (x1 < x0))
+        {
+            memcpy(dst, src, width * bps);
+            continue;
+        }
+        memcpy(dst, src, x0 * bps);
+        memcpy(dst + (x1 + 1) * bps, src + (x1 + 1) * bps, (width - x1 - 1) * bps);
+
+        if (bps == 1)
+        {
+            functions->sharpen_row_8(dst + x0, src + x0, stride_src, x1 - x0 + 1,
+                                     kernel->mem, kernel->size, kernel->coef,
+                                     ctx->strength, ctx->max_value);
+        }
+        else
+        {
+            functions->sharpen_row_16((uint16_t *)dst + x0, (const uint16_t *)src + x0,
+                                      stride_src / 2, x1 - x0 + 1,
+                                      kernel->mem, kernel->size, kernel->coef,
+                                      ctx->strength, ctx->max_value);
+        }
+    }
+}
 
 static int hb_lapsharp_init(hb_filter_object_t *filter,
                             hb_filter_init_t   *init)
@@ -297,6 +329,9 @@ static int hb_lapsharp_init(hb_filter_object_t *filter,
             ctx->kernel = c ? LAPSHARP_KERNEL_CHROMA_DEFAULT : LAPSHARP_KERNEL_LUMA_DEFAULT;
         }
     }
+
+    lapsharp_init_functions(&pv->functions);
+
     pv->output = *init;
 
     return 0;
@@ -341,7 +376,8 @@ static int hb_lapsharp_work(hb_filter_object_t *filter,
     for (c = 0; c < 3; c++)
     {
         lapsharp_plane_context_t * ctx = &pv->plane_ctx[c];
-        hb_lapsharp(in->plane[c].data,
+        hb_lapsharp(&pv->functions,
+                    in->plane[c].data,
                     out->plane[c].data,
                     in->plane[c].width,
                     in->plane[c].height,
@@ -0,0 +1,168 @@
+/* lapsharp_neon.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/lapsharp.h"
+
+#define LAPSHARP_TAPS_MAX 25
+
+static av_always_inline void load8_s32(const void *src, int bps,
+                                       int32x4_t *lo, int32x4_t *hi)
+{
+    uint16x8_t v = bps == 1 ? vmovl_u8(vld1_u8((const uint8_t *)src)) :
+                              vld1q_u16((const uint16_t *)src);
+    *lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+    *hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+}
+
+// Same double precision operations as the scalar code, two lanes at a time
+static av_always_inline int32x2_t sharpen2_neon(int32x2_t sum, int32x2_t center,
+                                                float64x2_t coef,
+                                                float64x2_t strength)
+{
+    float64x2_t p = vcvtq_f64_s64(vmovl_s32(sum));
+    float64x2_t c = vcvtq_f64_s64(vmovl_s32(center));
+    p = vmulq_f64(p, coef);
+    p = vsubq_f64(p, c);
+    p = vmulq_f64(p, strength);
+    return vadd_s32(vmovn_s64(vcvtq_s64_f64(p)), center);
+}
+
+static av_always_inline void sharpen_row_neon(void *in_dst,
+                                              const void *in_src,
+                                              int stride,
+                                              int width,
+                                              const int *kernel,
+                                              int size,
+                                              double coef,
+                                              double strength,
+                                              int max_value,
+                                              int bps)
+{
+    uint8_t        *dst8  = in_dst;
+    uint16_t       *dst16 = in_dst;
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    const int offset_min  = -((size - 1) / 2);
+    const int offset_max  =   (size + 1) / 2;
+
+    const float64x2_t v_coef     = vdupq_n_f64(coef);
+    const float64x2_t v_strength = vdupq_n_f64(strength);
+
+    // Only the non zero taps are visited
+    int tap_offset[LAPSHARP_TAPS_MAX];
+    int tap_weight[LAPSHARP_TAPS_MAX];
+    int taps = 0;
+    for (int j = offset_min; j < offset_max; j++)
+    {
+        for (int k = offset_min; k < offset_max; k++)
+        {
+            const int weight = kernel[((j - offset_min) * size) + k - offset_min];
+            if (weight)
+            {
+                tap_offset[taps] = (stride * j + k) * bps;
+                tap_weight[taps] = weight;
+                taps++;
+            }
+        }
+    }
+
+    int x;
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        const uint8_t *s = src8 + x * bps;
+        int32x4_t sum_lo = vdupq_n_s32(0), sum_hi = vdupq_n_s32(0);
+        int32x4_t lo, hi;
+        for (int t = 0; t < taps; t++)
+        {
+            load8_s32(s + tap_offset[t], bps, &lo, &hi);
+            sum_lo = vmlaq_n_s32(sum_lo, lo, tap_weight[t]);
+            sum_hi = vmlaq_n_s32(sum_hi, hi, tap_weight[t]);
+        }
+
+        load8_s32(s, bps, &lo, &hi);
+        lo = vcombine_s32(sharpen2_neon(vget_low_s32(sum_lo),  vget_low_s32(lo),  v_coef, v_strength),
+                          sharpen2_neon(vget_high_s32(sum_lo), vget_high_s32(lo), v_coef, v_strength));
+        hi = vcombine_s32(sharpen2_neon(vget_low_s32(sum_hi),  vget_low_s32(hi),  v_coef, v_strength),
+                          sharpen2_neon(vget_high_s32(sum_hi), vget_high_s32(hi), v_coef, v_strength));
+
+        uint16x8_t p = vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi));
+        p = vminq_u16(p, vdupq_n_u16(max_value));
+        if (bps == 1)
+        {
+            vst1_u8(dst8 + x, vmovn_u16(p));
+        }
+        else
+        {
+            vst1q_u16(dst16 + x, p);
+        }
+    }
+
+    for (; x < width; x++)
+    {
+        const uint8_t *s = src8 + x * bps;
+        const int center = bps == 1 ? src8[x] : src16[x];
+        int pixel = 0;
+        for (int t = 0; t < taps; t++)
+        {
+            pixel += tap_weight[t] *
+                     (bps == 1 ? *(s + tap_offset[t]) :
+                                 *(const uint16_t *)(s + tap_offset[t]));
+        }
+        pixel = (int)(((pixel * coef) - center) * strength) + center;
+        pixel = pixel < 0 ? 0 : pixel;
+        pixel = pixel > max_value ? max_value : pixel;
+        if (bps == 1)
+        {
+            dst8[x] = pixel;
+        }
+        else
+        {
+            dst16[x] = pixel;
+        }
+    }
+}
+
+static void sharpen_row_8_neon(uint8_t *dst, const uint8_t *src,
+                               int stride, int width,
+                               const int *kernel, int size,
+                               double coef, double strength,
+                               int max_value)
+{
+    sharpen_row_neon(dst, src, stride, width, kernel, size,
+                     coef, strength, max_value, 1);
+}
+
+static void sharpen_row_16_neon(uint16_t *dst, const uint16_t *src,
+                                int stride, int width,
+                                const int *kernel, int size,
+                                double coef, double strength,
+                                int max_value)
+{
+    sharpen_row_neon(dst, src, stride, width, kernel, size,
+                     coef, strength, max_value, 2);
+}
+
+void lapsharp_init_neon(LapsharpFunctions *functions)
+{
+    if (av_get_cpu_flags() & AV_CPU_FLAG_NEON)
+    {
+        functions->sharpen_row_8  = sharpen_row_8_neon;
+        functions->sharpen_row_16 = sharpen_row_16_neon;
+        hb_log("lapsharp using NEON optimizations");
+    }
+}
+
+#endif // __aarch64__
@@ -0,0 +1,168 @@
+/* lapsharp_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/lapsharp.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define LAPSHARP_TAPS_MAX 25
+
+static av_always_inline TARGET_AVX2 __m256i load8_epi32(const void *src, int bps)
+{
+    if (bps == 1)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+    }
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)src));
+}
+
+// The sharpened value is computed in double precision with the same
+// operations as the scalar code so that the results are identical
+static av_always_inline TARGET_AVX2 void sharpen_row_avx2(void *in_dst,
+                                                          const void *in_src,
+                                                          int stride,
+                                                          int width,
+                                                          const int *kernel,
+                                                          int size,
+                                                          double coef,
+                                                          double strength,
+                                                          int max_value,
+                                                          int bps)
+{
+    uint8_t        *dst8  = in_dst;
+    uint16_t       *dst16 = in_dst;
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    const int offset_min  = -((size - 1) / 2);
+    const int offset_max  =   (size + 1) / 2;
+
+    const __m256d v_coef      = _mm256_set1_pd(coef);
+    const __m256d v_strength  = _mm256_set1_pd(strength);
+    const __m256i v_max_value = _mm256_set1_epi32(max_value);
+    const __m256i zero        = _mm256_setzero_si256();
+
+    // Only the non zero taps are visited
+    int tap_offset[LAPSHARP_TAPS_MAX];
+    __m256i tap_weight[LAPSHARP_TAPS_MAX];
+    int taps = 0;
+    for (int j = offset_min; j < offset_max; j++)
+    {
+        for (int k = offset_min; k < offset_max; k++)
+        {
+            const int weight = kernel[((j - offset_min) * size) + k - offset_min];
+            if (weight)
+            {
+                tap_offset[taps] = (stride * j + k) * bps;
+                tap_weight[taps] = _mm256_set1_epi32(weight);
+                taps++;
+            }
+        }
+    }
+
+    int x;
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        const uint8_t *s = src8 + x * bps;
+        __m256i sum = zero;
+        for (int t = 0; t < taps; t++)
+        {
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(load8_epi32(s + tap_offset[t], bps),
+                                                           tap_weight[t]));
+        }
+
+        __m256i center = load8_epi32(s, bps);
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(sum));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(sum, 1));
+        __m256d c_lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(center));
+        __m256d c_hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(center, 1));
+        lo = _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(lo, v_coef), c_lo), v_strength);
+        hi = _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(hi, v_coef), c_hi), v_strength);
+
+        __m256i pixel = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(lo)),
+                                                _mm256_cvttpd_epi32(hi), 1);
+        pixel = _mm256_add_epi32(pixel, center);
+        pixel = _mm256_min_epi32(_mm256_max_epi32(pixel, zero), v_max_value);
+
+        __m128i p = _mm_packus_epi32(_mm256_castsi256_si128(pixel),
+                                     _mm256_extracti128_si256(pixel, 1));
+        if (bps == 1)
+        {
+            _mm_storel_epi64((__m128i *)(dst8 + x), _mm_packus_epi16(p, p));
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i *)(dst16 + x), p);
+        }
+    }
+
+    for (; x < width; x++)
+    {
+        const uint8_t *s = src8 + x * bps;
+        const int center = bps == 1 ? src8[x] : src16[x];
+        int pixel = 0;
+        for (int t = 0; t < taps; t++)
+        {
+            pixel += _mm256_cvtsi256_si32(tap_weight[t]) *
+                     (bps == 1 ? *(s + tap_offset[t]) :
+                                 *(const uint16_t *)(s + tap_offset[t]));
+        }
+        pixel = (int)(((pixel * coef) - center) * strength) + center;
+        pixel = pixel < 0 ? 0 : pixel;
+        pixel = pixel > max_value ? max_value : pixel;
+        if (bps == 1)
+        {
+            dst8[x] = pixel;
+        }
+        else
+        {
+            dst16[x] = pixel;
+        }
+    }
+}
+
+static TARGET_AVX2 void sharpen_row_8_avx2(uint8_t *dst, const uint8_t *src,
+                                           int stride, int width,
+                                           const int *kernel, int size,
+                                           double coef, double strength,
+                                           int max_value)
+{
+    sharpen_row_avx2(dst, src, stride, width, kernel, size,
+                     coef, strength, max_value, 1);
+}
+
+static TARGET_AVX2 void sharpen_row_16_avx2(uint16_t *dst, const uint16_t *src,
+                                            int stride, int width,
+                                            const int *kernel, int size,
+                                            double coef, double strength,
+                                            int max_value)
+{
+    sharpen_row_avx2(dst, src, stride, width, kernel, size,
+                     coef, strength, max_value, 2);
+}
+
+void lapsharp_init_x86(LapsharpFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->sharpen_row_8  = sharpen_row_8_avx2;
+        functions->sharpen_row_16 = sharpen_row_16_avx2;
+        hb_log("lapsharp using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
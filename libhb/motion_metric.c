@@ -8,11 +8,16 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/motion_metric.h"
 
 #if defined (__aarch64__) && !defined(__APPLE__)
     #include <arm_neon.h>
 #endif
 
+#define RESOLUTION_AUTO   0 // Downsample frames of 1080p and up
+#define RESOLUTION_FULL   1
+#define RESOLUTION_COARSE 2 // Always downsample
+
 struct hb_motion_metric_private_s
 {
     unsigned *gamma_lut;
@@ -23,6 +28,11 @@ struct hb_motion_metric_private_s
     uint8_t *approx_buf_a;
     uint8_t *approx_buf_b;
 
+    // Plane the downsample in approx_buf_b was made from
+    const uint8_t *approx_src_b;
+
+    MotionMetricFunctions functions;
+
     float (*motion_metric)(hb_motion_metric_private_t *pv,
                            int width, int height,
                            int stride_a, int stride_b,
@@ -139,7 +149,7 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
 #else
 
 #define DEF_SSE_BLOCK16(nbits)                                                         \
-static inline unsigned sse_block16##_##nbits(unsigned *gamma_lut,                      \
+static inline unsigned sse_block16##_##nbits(const unsigned *gamma_lut,                \
                                    const uint##nbits##_t *a, const uint##nbits##_t *b, \
                                    int stride_a, int stride_b)                         \
 {                                                                                      \
@@ -182,7 +192,7 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
     {                                                                                       \
         for (int x = 0; x < bw; x++)                                                        \
         {                                                                                   \
-            sum += sse_block16##_##nbits(pv->gamma_lut,                                     \
+            sum += pv->functions.sse_block16##_##nbits(pv->gamma_lut,                       \
                         buf_a + y * 16 * stride_a + x * 16,                                 \
                         buf_b + y * 16 * stride_b + x * 16,                                 \
                         stride_a, stride_b);                                                \
@@ -196,6 +206,8 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
 DEF_MOTION_METRIC(8)
 DEF_MOTION_METRIC(16)
 
+// The frames are compared in sequence, so the downsample of the
+// previous b is usually the one of the next a and is reused
 #define DEF_MOTION_METRIC_FAST(nbits)                                                       \
 static float motion_metric_fast##_##nbits(hb_motion_metric_private_t *pv,                   \
                                      int width, int height,                                 \
@@ -208,13 +220,24 @@ static float motion_metric_fast##_##nbits(hb_motion_metric_private_t *pv,
     height /= 4;                                                                            \
     stride_buf_a = width;                                                                   \
     stride_buf_b = width;                                                                   \
-    buf_a = (uint##nbits##_t *)pv->approx_buf_a;                                            \
-    buf_b = (uint##nbits##_t *)pv->approx_buf_b;                                            \
                                                                                             \
-    approximate_frame_data##_##nbits((const uint##nbits##_t *)a, buf_a,                     \
-                                     stride_a / pv->bps, stride_buf_a, width, height);      \
-    approximate_frame_data##_##nbits((const uint##nbits##_t *)b, buf_b,                     \
-                                     stride_b / pv->bps, stride_buf_b, width, height);      \
+    if (a == pv->approx_src_b)                                                              \
+    {                                                                                       \
+        uint8_t *tmp     = pv->approx_buf_a;                                                \
+        pv->approx_buf_a = pv->approx_buf_b;                                                \
+        pv->approx_buf_b = tmp;                                                             \
+        buf_a = (uint##nbits##_t *)pv->approx_buf_a;                                        \
+    }                                                                                       \
+    else                                                                                    \
+    {                                                                                       \
+        buf_a = (uint##nbits##_t *)pv->approx_buf_a;                                        \
+        pv->functions.approximate_frame_data##_##nbits((const uint##nbits##_t *)a, buf_a,   \
+                                stride_a / pv->bps, stride_buf_a, width, height);           \
+    }                                                                                       \
+    buf_b = (uint##nbits##_t *)pv->approx_buf_b;                                            \
+    pv->functions.approximate_frame_data##_##nbits((const uint##nbits##_t *)b, buf_b,       \
+                                stride_b / pv->bps, stride_buf_b, width, height);           \
+    pv->approx_src_b = b;                                                                   \
                                                                                             \
     return motion_metric##_##nbits(pv, width, height,                                       \
                                    stride_buf_a, stride_buf_b,                              \
@@ -248,8 +271,13 @@ static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
     }
     build_gamma_lut(pv);
 
+    int resolution = RESOLUTION_AUTO;
+    hb_dict_extract_int(&resolution, metric->settings, "metric-resolution");
+
     int fast = 0;
-    if (init->geometry.width >= 1920 || init->geometry.height >= 1080)
+    if (resolution == RESOLUTION_COARSE ||
+        (resolution == RESOLUTION_AUTO &&
+         (init->geometry.width >= 1920 || init->geometry.height >= 1080)))
     {
         fast = 1;
         int approx_height = init->geometry.height / 4;
@@ -264,6 +292,16 @@ static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
         }
     }
 
+    pv->functions.approximate_frame_data_8  = approximate_frame_data_8;
+    pv->functions.approximate_frame_data_16 = approximate_frame_data_16;
+#if !defined (__aarch64__) || defined(__APPLE__)
+    pv->functions.sse_block16_8  = sse_block16_8;
+    pv->functions.sse_block16_16 = sse_block16_16;
+#endif
+#if defined(ARCH_X86)
+    motion_metric_init_x86(&pv->functions);
+#endif
+
     switch (pv->depth)
     {
         case 8:
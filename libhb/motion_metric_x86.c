@@ -0,0 +1,229 @@
+/* motion_metric_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/motion_metric.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// The gamma lookup table values are below 4131 for every bit depth,
+// so the differences fit in 16 bits and pmaddwd squares and sums
+// them in pairs. Without a gather the lookups dominate, so only
+// AVX2 is worth it. The block sum wraps modulo 2^32 like the scalar
+// unsigned sum does, so the results are identical.
+
+static av_always_inline int pixel_at(const void *src, int x, int bps)
+{
+    return bps == 1 ? ((const uint8_t *)src)[x] : ((const uint16_t *)src)[x];
+}
+
+static av_always_inline unsigned hsum_epi32_sse2(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_unpackhi_epi64(v, v));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static av_always_inline TARGET_AVX2 __m256i gamma8_epi32_avx2(const unsigned *gamma_lut,
+                                                              const void *src, int bps)
+{
+    __m256i index;
+    if (bps == 1)
+    {
+        index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+    }
+    else
+    {
+        index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)src));
+    }
+    return _mm256_i32gather_epi32((const int *)gamma_lut, index, 4);
+}
+
+static av_always_inline TARGET_AVX2 unsigned sse_block16_avx2(const unsigned *gamma_lut,
+                                                              const void *a, const void *b,
+                                                              int stride_a, int stride_b, int bps)
+{
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int y = 0; y < 16; y++)
+    {
+        const uint8_t *ra = a, *rb = b;
+        const __m256i diff0 = _mm256_sub_epi32(gamma8_epi32_avx2(gamma_lut, ra, bps),
+                                               gamma8_epi32_avx2(gamma_lut, rb, bps));
+        const __m256i diff1 = _mm256_sub_epi32(gamma8_epi32_avx2(gamma_lut, ra + 8 * bps, bps),
+                                               gamma8_epi32_avx2(gamma_lut, rb + 8 * bps, bps));
+        // The pixel order does not matter for the sum
+        const __m256i diff  = _mm256_packs_epi32(diff0, diff1);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff, diff));
+
+        a = ra + stride_a * bps;
+        b = rb + stride_b * bps;
+    }
+
+    return hsum_epi32_sse2(_mm_add_epi32(_mm256_castsi256_si128(sum),
+                                         _mm256_extracti128_si256(sum, 1)));
+}
+
+static TARGET_AVX2 unsigned sse_block16_8_avx2(const unsigned *gamma_lut,
+                                               const uint8_t *a, const uint8_t *b,
+                                               int stride_a, int stride_b)
+{
+    return sse_block16_avx2(gamma_lut, a, b, stride_a, stride_b, 1);
+}
+
+static TARGET_AVX2 unsigned sse_block16_16_avx2(const unsigned *gamma_lut,
+                                                const uint16_t *a, const uint16_t *b,
+                                                int stride_a, int stride_b)
+{
+    return sse_block16_avx2(gamma_lut, a, b, stride_a, stride_b, 2);
+}
+
+// APPROX(a, b, c, d) is avg(avg(a, b), avg(c, d)) with the rounding of
+// pavgb and pavgw, so the downsample is computed exactly by averaging
+// the row pairs and then the even and odd columns twice.
+
+static av_always_inline int avg(int a, int b)
+{
+    return (a + b + 1) >> 1;
+}
+
+static av_always_inline __m128i avg_epu(__m128i a, __m128i b, int bps)
+{
+    return bps == 1 ? _mm_avg_epu8(a, b) : _mm_avg_epu16(a, b);
+}
+
+// Average of the even and the odd pixels of a followed by those of b
+static av_always_inline __m128i avg_pairs(__m128i a, __m128i b, int bps)
+{
+    __m128i even, odd;
+    if (bps == 1)
+    {
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        odd  = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    }
+    else
+    {
+        // Move the even pixels to the low and the odd ones to the high half
+        a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shufflehi_epi16(b, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+        even = _mm_unpacklo_epi64(a, b);
+        odd  = _mm_unpackhi_epi64(a, b);
+    }
+    return avg_epu(even, odd, bps);
+}
+
+static av_always_inline __m128i load_si128(const void *src, int x, int bps)
+{
+    return _mm_loadu_si128((const __m128i *)((const uint8_t *)src + x * bps));
+}
+
+static av_always_inline void approximate_frame_data_sse2(const void *source, void *dest,
+                                                         int source_stride, int dest_stride,
+                                                         int width, int height, int bps)
+{
+    // Pixels per vector
+    const int n = 16 / bps;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t *r0 = (const uint8_t *)source + 4 * y * source_stride * bps;
+        const uint8_t *r1 = r0 + source_stride * bps;
+        const uint8_t *r2 = r1 + source_stride * bps;
+        const uint8_t *r3 = r2 + source_stride * bps;
+        uint8_t *dst = (uint8_t *)dest + y * dest_stride * bps;
+        int x;
+
+        for (x = 0; x + n <= width; x += n)
+        {
+            __m128i top[2], bottom[2];
+            for (int k = 0; k < 2; k++)
+            {
+                const int xx = 4 * x + 2 * k * n;
+                top[k]    = avg_pairs(avg_epu(load_si128(r0, xx, bps),     load_si128(r1, xx, bps), bps),
+                                      avg_epu(load_si128(r0, xx + n, bps), load_si128(r1, xx + n, bps), bps),
+                                      bps);
+                bottom[k] = avg_pairs(avg_epu(load_si128(r2, xx, bps),     load_si128(r3, xx, bps), bps),
+                                      avg_epu(load_si128(r2, xx + n, bps), load_si128(r3, xx + n, bps), bps),
+                                      bps);
+            }
+            const __m128i d = avg_epu(avg_pairs(top[0], top[1], bps),
+                                      avg_pairs(bottom[0], bottom[1], bps), bps);
+            _mm_storeu_si128((__m128i *)(dst + x * bps), d);
+        }
+        for (; x < width; x++)
+        {
+            int p[4][4];
+            for (int k = 0; k < 4; k++)
+            {
+                p[0][k] = pixel_at(r0, 4 * x + k, bps);
+                p[1][k] = pixel_at(r1, 4 * x + k, bps);
+                p[2][k] = pixel_at(r2, 4 * x + k, bps);
+                p[3][k] = pixel_at(r3, 4 * x + k, bps);
+            }
+            const int top_left     = avg(avg(p[0][0], p[1][0]), avg(p[0][1], p[1][1]));
+            const int top_right    = avg(avg(p[0][2], p[1][2]), avg(p[0][3], p[1][3]));
+            const int bottom_left  = avg(avg(p[2][0], p[3][0]), avg(p[2][1], p[3][1]));
+            const int bottom_right = avg(avg(p[2][2], p[3][2]), avg(p[2][3], p[3][3]));
+            const int value = avg(avg(top_left, top_right), avg(bottom_left, bottom_right));
+            if (bps == 1)
+            {
+                dst[x] = value;
+            }
+            else
+            {
+                ((uint16_t *)dst)[x] = value;
+            }
+        }
+    }
+}
+
+static void approximate_frame_data_8_sse2(const uint8_t *source, uint8_t *dest,
+                                          int source_stride, int dest_stride,
+                                          int width, int height)
+{
+    approximate_frame_data_sse2(source, dest, source_stride, dest_stride, width, height, 1);
+}
+
+static void approximate_frame_data_16_sse2(const uint16_t *source, uint16_t *dest,
+                                           int source_stride, int dest_stride,
+                                           int width, int height)
+{
+    approximate_frame_data_sse2(source, dest, source_stride, dest_stride, width, height, 2);
+}
+
+void motion_metric_init_x86(MotionMetricFunctions *functions)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_SSE2)
+    {
+        functions->approximate_frame_data_8  = approximate_frame_data_8_sse2;
+        functions->approximate_frame_data_16 = approximate_frame_data_16_sse2;
+        hb_log("motion metric using SSE2 optimizations");
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->sse_block16_8  = sse_block16_8_avx2;
+        functions->sse_block16_16 = sse_block16_16_avx2;
+        hb_log("motion metric using AVX2 optimizations");
+    }
+}
+
+#endif // ARCH_X86
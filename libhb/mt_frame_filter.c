@@ -15,20 +15,28 @@
 #include "handbrake/handbrake.h"
 #include "handbrake/taskset.h"
 
+/* Frames are handed to the shared taskset workers as they arrive and
+ * collected in input order.  At most 'window' frames are in flight,
+ * each one in its own slot of the taskset. */
+
+#define MT_FRAME_WINDOW_DEFAULT_MAX 16
+#define MT_FRAME_WINDOW_MAX         64
+
 typedef struct
 {
     taskset_thread_arg_t arg;
     hb_filter_private_t *pv;
+    hb_buffer_t *in;
     hb_buffer_t *out;
 } mt_frame_thread_arg_t;
 
 struct hb_filter_private_s
 {
     hb_filter_object_t     * sub_filter;
-    hb_buffer_t           ** buf;
-    int                      frame_count;
     taskset_t                taskset;
-    int                      thread_count;
+    int                      window;
+    int                      head;  // oldest slot in flight
+    int                      count; // slots in flight
     mt_frame_thread_arg_t ** thread_data;
 };
 
@@ -68,26 +76,41 @@ static int mt_frame_init(hb_filter_object_t * filter,
     pv->sub_filter = filter->sub_filter;
     pv->sub_filter->init(pv->sub_filter, init);
 
-    pv->thread_count = hb_get_cpu_count();
-    pv->buf = calloc(pv->thread_count, sizeof(hb_buffer_t *));
-    if (pv->buf == NULL)
+    // The job can limit the pool workers its filters use
+    int max_workers = init->job != NULL ? init->job->filter_threads : 0;
+    int workers     = taskset_pool_get_threads();
+    if (max_workers > 0)
     {
-        goto fail;
+        workers = MIN(workers, max_workers);
+    }
+
+    // Enough frames in flight to keep every worker busy, plus one that
+    // is being collected.  The window does not need to follow the
+    // worker count, so it can also be set explicitly.
+    if (init->job != NULL && init->job->filter_frame_window > 0)
+    {
+        pv->window = MIN(init->job->filter_frame_window, MT_FRAME_WINDOW_MAX);
+    }
+    else
+    {
+        pv->window = MIN(workers + 1, MT_FRAME_WINDOW_DEFAULT_MAX);
     }
+    pv->window = MAX(pv->window, 1);
 
-    pv->thread_data = malloc(pv->thread_count * sizeof(mt_frame_thread_arg_t *));
+    pv->thread_data = malloc(pv->window * sizeof(mt_frame_thread_arg_t *));
     if (pv->thread_data == NULL)
     {
         goto fail;
     }
-    if (taskset_init(&pv->taskset, "mt_frame_filter", pv->thread_count,
+    if (taskset_init(&pv->taskset, "mt_frame_filter", pv->window,
                      sizeof(mt_frame_thread_arg_t), mt_frame_filter_work) == 0)
     {
         hb_error("MTFrame could not initialize taskset");
         goto fail;
     }
+    taskset_set_budget(&pv->taskset, init->job != NULL ? init->job->filter_budget : NULL);
 
-    for (int ii = 0; ii < pv->thread_count; ii++)
+    for (int ii = 0; ii < pv->window; ii++)
     {
         pv->thread_data[ii] = taskset_thread_args(&pv->taskset, ii);
         if (pv->thread_data[ii] == NULL)
@@ -101,13 +124,16 @@ static int mt_frame_init(hb_filter_object_t * filter,
         pv->thread_data[ii]->arg.segment = ii;
     }
 
+    // Each slot has its own sub-filter thread context
     if (pv->sub_filter->init_thread != NULL)
     {
-        if (pv->sub_filter->init_thread(pv->sub_filter, pv->thread_count) < 0)
+        if (pv->sub_filter->init_thread(pv->sub_filter, pv->window) < 0)
         {
             goto fail;
         }
     }
+    hb_log("mt_frame: %s, %d frames in flight", pv->sub_filter->name,
+           pv->window);
 
     return 0;
 
@@ -115,9 +141,26 @@ fail:
     taskset_fini(&pv->taskset);
     free(pv->thread_data);
     free(pv);
+    filter->private_data = NULL;
     return -1;
 }
 
+// Collect the oldest frame in flight
+static hb_buffer_t * mt_frame_collect(hb_filter_private_t *pv)
+{
+    mt_frame_thread_arg_t *thread_data = pv->thread_data[pv->head];
+    hb_buffer_t *out;
+
+    taskset_wait(&pv->taskset, pv->head);
+    out = thread_data->out;
+    thread_data->out = NULL;
+
+    pv->head = (pv->head + 1) % pv->window;
+    pv->count--;
+
+    return out;
+}
+
 static void mt_frame_close(hb_filter_object_t *filter)
 {
     hb_filter_private_t *pv = filter->private_data;
@@ -127,19 +170,17 @@ static void mt_frame_close(hb_filter_object_t *filter)
         return;
     }
 
-    pv->sub_filter->close(pv->sub_filter);
-    taskset_fini(&pv->taskset);
-
-    for (int f = 0; f < pv->frame_count; f++)
+    // Frames still in flight when the job is canceled
+    while (pv->count > 0)
     {
-        if (pv->buf[f] != NULL)
-        {
-            hb_buffer_close(&pv->buf[f]);
-        }
+        hb_buffer_t *out = mt_frame_collect(pv);
+        hb_buffer_close(&out);
     }
 
+    pv->sub_filter->close(pv->sub_filter);
+    taskset_fini(&pv->taskset);
+
     free(pv->thread_data);
-    free(pv->buf);
     free(pv);
     filter->private_data = NULL;
 }
@@ -150,38 +191,45 @@ static void mt_frame_filter_work(void *thread_args_v)
     hb_filter_private_t *pv = thread_data->pv;
     int segment = thread_data->arg.segment;
 
+    thread_data->out = NULL;
     if (pv->sub_filter->work_thread != NULL)
     {
         pv->sub_filter->work_thread(pv->sub_filter,
-                             &pv->buf[segment], &thread_data->out, segment);
+                             &thread_data->in, &thread_data->out, segment);
     }
     else
     {
         pv->sub_filter->work(pv->sub_filter,
-                             &pv->buf[segment], &thread_data->out);
+                             &thread_data->in, &thread_data->out);
     }
-    if (pv->buf[segment] != NULL)
+    if (thread_data->in != NULL)
     {
-        hb_buffer_close(&pv->buf[segment]);
+        hb_buffer_close(&thread_data->in);
     }
 }
 
-static hb_buffer_t * mt_frame_filter(hb_filter_private_t *pv)
+static hb_buffer_t * mt_frame_filter(hb_filter_private_t *pv, hb_buffer_t *in)
 {
-    if (pv->frame_count < pv->thread_count)
+    hb_buffer_list_t list;
+    int slot;
+
+    hb_buffer_list_clear(&list);
+
+    // Make room for the new frame
+    if (pv->count == pv->window)
     {
-        return NULL;
+        hb_buffer_list_append(&list, mt_frame_collect(pv));
     }
 
-    taskset_cycle(&pv->taskset);
-    pv->frame_count = 0;
+    slot = (pv->head + pv->count) % pv->window;
+    pv->thread_data[slot]->in = in;
+    pv->count++;
+    taskset_post(&pv->taskset, slot);
 
-    // Collect results from taskset
-    hb_buffer_list_t list;
-    hb_buffer_list_clear(&list);
-    for (int t = 0; t < pv->thread_count; t++)
+    // Release whatever has completed, in order
+    while (pv->count > 0 && taskset_done(&pv->taskset, pv->head))
     {
-        hb_buffer_list_append(&list, pv->thread_data[t]->out);
+        hb_buffer_list_append(&list, mt_frame_collect(pv));
     }
     return hb_buffer_list_clear(&list);
 }
@@ -191,18 +239,10 @@ static hb_buffer_t * mt_frame_filter_flush(hb_filter_private_t *pv)
     hb_buffer_list_t list;
 
     hb_buffer_list_clear(&list);
-    for (int f = 0; f < pv->frame_count; f++)
+    while (pv->count > 0)
     {
-        hb_buffer_t * out;
-        pv->sub_filter->work(pv->sub_filter, &pv->buf[f], &out);
-
-        if (pv->buf[f] != NULL)
-        {
-            hb_buffer_close(&pv->buf[f]);
-        }
-        hb_buffer_list_append(&list, out);
+        hb_buffer_list_append(&list, mt_frame_collect(pv));
     }
-    pv->frame_count = 0;
     return hb_buffer_list_clear(&list);
 }
 
@@ -230,8 +270,7 @@ static int mt_frame_work(hb_filter_object_t  * filter,
         return HB_FILTER_DONE;
     }
 
-    pv->buf[pv->frame_count++] = in;
-    *buf_out = mt_frame_filter(pv);
+    *buf_out = mt_frame_filter(pv, in);
 
     return HB_FILTER_OK;
 }
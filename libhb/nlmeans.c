@@ -48,6 +48,17 @@
  *        etc...
  *  3329: Mean 3x3 reduced by 25% plus edge boost, passthru
  *        etc...
+ *
+ * Fast mode (fast=1) replaces the floating point weights and sums with
+ * fixed point ones and builds 16-bit integral images from rounded down
+ * squared differences. It trades a small loss of precision in the patch
+ * comparisons for throughput.
+ *
+ * Tile mode (tiles=1) filters one frame at a time and splits each plane
+ * into horizontal bands, one per thread, instead of giving every thread
+ * a frame of its own. Memory then stays roughly constant as the thread
+ * count grows. The output is identical. It is on by default for frames
+ * larger than 1080p.
  */
 
 #include "handbrake/handbrake.h"
@@ -85,7 +96,6 @@
 #define NLMEANS_SWAP(a,b) { a = (a ^ b); b = (a ^ b); a = (b ^ a); }
 
 #define NLMEANS_FRAMES_MAX  32
-#define NLMEANS_EXPSIZE     128
 
 typedef struct
 {
@@ -109,12 +119,6 @@ typedef struct
     hb_buffer_t *buf;        // input buf sidedata
 } Frame;
 
-struct PixelSum
-{
-    float weight_sum;
-    float pixel_sum;
-};
-
 typedef struct
 {
     taskset_thread_arg_t arg;
@@ -135,10 +139,14 @@ struct hb_filter_private_s
     int    nframes[3];     // temporal search depth in frames
     int    prefilter[3];   // prefilter mode, can improve weight analysis
     int    threads;        // number of frame threads to use, 0 == auto
+    int    fast;           // fixed point weights and 16-bit integral images
+    int    tiles;          // split frames into bands instead of frame threads
+    int    frame_threads;  // number of frames filtered per cycle
 
     float  exptable[3][NLMEANS_EXPSIZE];
     float  weight_fact_table[3];
     int    diff_max[3];
+    NLMeansFixed fixed[3];
 
     NLMeansFunctions functions;
 
@@ -167,10 +175,25 @@ struct hb_filter_private_s
                               const float *exptable,
                               const float  weight_fact_table,
                               const int    diff_max);
+    void (*nlmeans_plane_fast)(NLMeansFunctions *functions,
+                               Frame *frame,
+                               int prefilter,
+                               int plane,
+                               int nframes,
+                               void *dst,
+                               int dst_w,
+                               int dst_s,
+                               int dst_h,
+                               int n,
+                               int r,
+                         const NLMeansFixed *fixed);
 
     Frame      *frame;
     int         next_frame;
     int         max_frames;
+    hb_buffer_t *band_out;  // output of the frame being filtered in tile mode
+    int         band_frame; // and its index in frame
+    int         band_avail; // frames available to it
 
     taskset_t   taskset;
     nlmeans_thread_arg_t ** thread_data;
@@ -197,7 +220,8 @@ static const char nlmeans_template[] =
     "cr-strength=^"HB_FLOAT_REG"$:cr-origin-tune=^"HB_FLOAT_REG"$:"
     "cr-patch-size=^"HB_INT_REG"$:cr-range=^"HB_INT_REG"$:"
     "cr-frame-count=^"HB_INT_REG"$:cr-prefilter=^"HB_INT_REG"$:"
-    "threads=^"HB_INT_REG"$";
+    "threads=^"HB_INT_REG"$:fast=^"HB_BOOL_REG"$:"
+    "tiles=^"HB_BOOL_REG"$";
 
 hb_filter_object_t hb_filter_nlmeans =
 {
@@ -219,6 +243,68 @@ hb_filter_object_t hb_filter_nlmeans =
 #include "templates/nlmeans_template.c"
 #undef BIT_DEPTH
 
+// Derives the fixed point parameters of channel c from its floating
+// point exp table and limits. Fails when the weights would be too coarse.
+static int nlmeans_init_fixed(hb_filter_private_t *pv, int c)
+{
+    NLMeansFixed *fixed = &pv->fixed[c];
+    const int n = pv->patch_size[c];
+    const int r = pv->range[c];
+
+    // Smallest shift that keeps the largest patch sum within 16 bits
+    const uint64_t sq_max = (uint64_t)pv->max_value * pv->max_value;
+    fixed->sq_shift = 0;
+    while (n * n * ((sq_max + ((1 << fixed->sq_shift) >> 1)) >> fixed->sq_shift) > UINT16_MAX)
+    {
+        fixed->sq_shift++;
+    }
+
+    // Largest weight precision that cannot overflow the 32-bit pixel sums
+    const uint64_t terms   = (uint64_t)pv->nframes[c] * r * r;
+    const uint64_t sum_max = UINT32_MAX / pv->max_value;
+    fixed->weight_bits = 15;
+    while (fixed->weight_bits > 0 && (terms << fixed->weight_bits) > sum_max)
+    {
+        fixed->weight_bits--;
+    }
+    if (fixed->weight_bits < 8)
+    {
+        return -1;
+    }
+
+    const double one = 1 << fixed->weight_bits;
+    for (int i = 0; i < NLMEANS_EXPSIZE; i++)
+    {
+        fixed->exptable[i] = lrint(pv->exptable[c][i] * one);
+    }
+    fixed->origin   = lrint(pv->origin_tune[c] * one);
+    fixed->fact     = lrint(pv->weight_fact_table[c] * (1 << fixed->sq_shift) * 65536.);
+    fixed->diff_max = MIN(pv->diff_max[c] >> fixed->sq_shift, UINT16_MAX + 1);
+
+    return 0;
+}
+
+void nlmeans_init_functions(NLMeansFunctions *functions, int depth)
+{
+    if (depth > 8)
+    {
+        functions->build_integral      = build_integral_scalar_16;
+        functions->accumulate          = nlmeans_accumulate_scalar_16;
+        functions->build_integral_fast = build_integral_fast_scalar_16;
+        functions->accumulate_fast     = nlmeans_accumulate_fast_scalar_16;
+    }
+    else
+    {
+        functions->build_integral      = build_integral_scalar_8;
+        functions->accumulate          = nlmeans_accumulate_scalar_8;
+        functions->build_integral_fast = build_integral_fast_scalar_8;
+        functions->accumulate_fast     = nlmeans_accumulate_fast_scalar_8;
+    }
+#if defined(ARCH_X86)
+    nlmeans_init_x86(functions, depth);
+#endif
+}
+
 static int nlmeans_init(hb_filter_object_t *filter,
                            hb_filter_init_t *init)
 {
@@ -229,7 +315,6 @@ static int nlmeans_init(hb_filter_object_t *filter,
         return -1;
     }
     hb_filter_private_t *pv = filter->private_data;
-    NLMeansFunctions *functions = &pv->functions;
 
     pv->input = *init;
 
@@ -241,26 +326,23 @@ static int nlmeans_init(hb_filter_object_t *filter,
     switch (pv->depth)
     {
         case 8:
-            functions->build_integral = build_integral_scalar_8;
             pv->nlmeans_alloc         = nlmeans_alloc_8;
             pv->nlmeans_prefilter     = nlmeans_prefilter_8;
             pv->nlmeans_deborder      = nlmeans_deborder_8;
             pv->nlmeans_plane         = nlmeans_plane_8;
-        #if defined(ARCH_X86)
-            nlmeans_init_x86(functions);
-        #endif
+            pv->nlmeans_plane_fast    = nlmeans_plane_fast_8;
             break;
 
         case 16:
         default:
-            functions->build_integral = build_integral_scalar_16;
             pv->nlmeans_alloc         = nlmeans_alloc_16;
             pv->nlmeans_prefilter     = nlmeans_prefilter_16;
             pv->nlmeans_deborder      = nlmeans_deborder_16;
             pv->nlmeans_plane         = nlmeans_plane_16;
+            pv->nlmeans_plane_fast    = nlmeans_plane_fast_16;
             break;
     }
-
+    nlmeans_init_functions(&pv->functions, pv->depth);
 
     // Mark parameters unset
     for (int c = 0; c < 3; c++)
@@ -273,6 +355,7 @@ static int nlmeans_init(hb_filter_object_t *filter,
         pv->prefilter[c]   = -1;
     }
     pv->threads = -1;
+    pv->tiles   = -1;
 
     // Read user parameters
     if (filter->settings != NULL)
@@ -300,6 +383,8 @@ static int nlmeans_init(hb_filter_object_t *filter,
         hb_dict_extract_int(&pv->prefilter[2],      dict, "cr-prefilter");
 
         hb_dict_extract_int(&pv->threads,           dict, "threads");
+        hb_dict_extract_bool(&pv->fast,             dict, "fast");
+        hb_dict_extract_bool(&pv->tiles,            dict, "tiles");
     }
 
     // Cascade values
@@ -355,6 +440,17 @@ static int nlmeans_init(hb_filter_object_t *filter,
             exptable[i] = exp(-i/stretch);
         }
         exptable[NLMEANS_EXPSIZE-1] = 0;
+
+        if (pv->fast && nlmeans_init_fixed(pv, c) < 0)
+        {
+            hb_log("NLMeans fast mode does not fit %d frames of range %d, disabled",
+                   pv->nframes[c], pv->range[c]);
+            pv->fast = 0;
+        }
+    }
+    if (pv->fast)
+    {
+        hb_log("NLMeans using fast mode");
     }
 
     // Threads
@@ -370,15 +466,21 @@ static int nlmeans_init(hb_filter_object_t *filter,
             pv->threads = (pv->threads / 4) * 3;
         }
     }
-    hb_log("NLMeans using %i threads", pv->threads);
+    // Tiles
+    if (pv->tiles < 0)
+    {
+        pv->tiles = init->geometry.width * init->geometry.height > 1920 * 1088;
+    }
+    pv->frame_threads = pv->tiles ? 1 : pv->threads;
+    hb_log("NLMeans using %i threads%s", pv->threads, pv->tiles ? " on bands of each frame" : "");
 
-    pv->frame = calloc(pv->threads + pv->max_frames, sizeof(Frame));
+    pv->frame = calloc(pv->frame_threads + pv->max_frames, sizeof(Frame));
     if (pv->frame == NULL)
     {
         hb_error("nlmeans: calloc failed");
         goto fail;
     }
-    for (int ii = 0; ii < pv->threads + pv->max_frames; ii++)
+    for (int ii = 0; ii < pv->frame_threads + pv->max_frames; ii++)
     {
         for (int c = 0; c < 3; c++)
         {
@@ -393,6 +495,8 @@ static int nlmeans_init(hb_filter_object_t *filter,
         hb_error("NLMeans could not initialize taskset");
         goto fail;
     }
+    taskset_set_budget(&pv->taskset,
+                       init->job != NULL ? init->job->filter_budget : NULL);
 
     for (int ii = 0; ii < pv->threads; ii++)
     {
@@ -446,7 +550,7 @@ static void nlmeans_close(hb_filter_object_t *filter)
         }
     }
 
-    for (int ii = 0; ii < pv->threads + pv->max_frames; ii++)
+    for (int ii = 0; ii < pv->frame_threads + pv->max_frames; ii++)
     {
         for (int c = 0; c < 3; c++)
         {
@@ -460,53 +564,92 @@ static void nlmeans_close(hb_filter_object_t *filter)
     filter->private_data = NULL;
 }
 
-static void nlmeans_filter_work(void *thread_args_v)
+// Returns a view of rows y and below of a plane, sharing its memory
+static BorderedPlane nlmeans_band_plane(const BorderedPlane *plane, int y, int bps)
 {
-    nlmeans_thread_arg_t *thread_data = thread_args_v;
-    hb_filter_private_t *pv = thread_data->pv;
-    int segment = thread_data->arg.segment;
-    Frame *frame = &pv->frame[segment];
+    BorderedPlane band = *plane;
+    const int offset = y * (plane->w + 2 * plane->border) * bps;
 
-    hb_buffer_t *buf;
-    buf = hb_frame_buffer_init(pv->output.pix_fmt,
-                               frame->width, frame->height);
-    buf->f.color_prim      = pv->output.color_prim;
-    buf->f.color_transfer  = pv->output.color_transfer;
-    buf->f.color_matrix    = pv->output.color_matrix;
-    buf->f.color_range     = pv->output.color_range ;
-    buf->f.chroma_location = pv->output.chroma_location;
+    band.mem       = (uint8_t *)plane->mem       + offset;
+    band.mem_pre   = (uint8_t *)plane->mem_pre   + offset;
+    band.image     = (uint8_t *)plane->image     + offset;
+    band.image_pre = (uint8_t *)plane->image_pre + offset;
+    band.h         = plane->h - y;
 
+    return band;
+}
 
-    NLMeansFunctions *functions = &pv->functions;
-
+// Filters band number 'band' out of 'bands' of the planes of frame into buf.
+// Pixels only depend on the patches around them, so the bands can be
+// filtered independently as long as they share the frame borders.
+static void nlmeans_filter_band(hb_filter_private_t *pv, Frame *frame,
+                                int avail_frames, hb_buffer_t *buf,
+                                int band, int bands)
+{
     for (int c = 0; c < 3; c++)
     {
+        const int height = buf->plane[c].height;
+        const int y0     = height *  band      / bands;
+        const int y1     = height * (band + 1) / bands;
+        const int stride = buf->plane[c].stride;
+        uint8_t  *dst    = buf->plane[c].data + y0 * stride;
+        const int nframes = MIN(pv->nframes[c], avail_frames);
+
+        if (y0 == y1)
+        {
+            continue;
+        }
+
+        // The prefilter works on whole planes, apply it before taking views
         if (pv->prefilter[c] & NLMEANS_PREFILTER_MODE_PASSTHRU)
         {
             pv->nlmeans_prefilter(&frame->plane[c], pv->prefilter[c]);
-            pv->nlmeans_deborder(&frame->plane[c], buf->plane[c].data,
-                                 buf->plane[c].width, buf->plane[c].stride / pv->bps,
-                                 buf->plane[c].height);
+            BorderedPlane view = nlmeans_band_plane(&frame->plane[c], y0, pv->bps);
+            pv->nlmeans_deborder(&view, dst, buf->plane[c].width,
+                                 stride / pv->bps, y1 - y0);
             continue;
         }
         if (pv->strength[c] == 0)
         {
-            pv->nlmeans_deborder(&frame->plane[c], buf->plane[c].data,
-                                 buf->plane[c].width, buf->plane[c].stride / pv->bps,
-                                 buf->plane[c].height);
+            BorderedPlane view = nlmeans_band_plane(&frame->plane[c], y0, pv->bps);
+            pv->nlmeans_deborder(&view, dst, buf->plane[c].width,
+                                 stride / pv->bps, y1 - y0);
             continue;
         }
 
+        Frame view[NLMEANS_FRAMES_MAX];
+        for (int f = 0; f < nframes; f++)
+        {
+            pv->nlmeans_prefilter(&frame[f].plane[c], pv->prefilter[c]);
+            view[f].plane[c] = nlmeans_band_plane(&frame[f].plane[c], y0, pv->bps);
+        }
+
         // Process current plane
-        pv->nlmeans_plane(functions,
-                          frame,
+        if (pv->fast)
+        {
+            pv->nlmeans_plane_fast(&pv->functions,
+                                   view,
+                                   pv->prefilter[c],
+                                   c,
+                                   nframes,
+                                   dst,
+                                   buf->plane[c].width,
+                                   stride / pv->bps,
+                                   y1 - y0,
+                                   pv->patch_size[c],
+                                   pv->range[c],
+                                   &pv->fixed[c]);
+            continue;
+        }
+        pv->nlmeans_plane(&pv->functions,
+                          view,
                           pv->prefilter[c],
                           c,
-                          pv->nframes[c],
-                          buf->plane[c].data,
+                          nframes,
+                          dst,
                           buf->plane[c].width,
-                          buf->plane[c].stride / pv->bps,
-                          buf->plane[c].height,
+                          stride / pv->bps,
+                          y1 - y0,
                           pv->strength[c],
                           pv->origin_tune[c],
                           pv->patch_size[c],
@@ -515,6 +658,41 @@ static void nlmeans_filter_work(void *thread_args_v)
                           pv->weight_fact_table[c],
                           pv->diff_max[c]);
     }
+}
+
+static hb_buffer_t * nlmeans_output_init(hb_filter_private_t *pv, Frame *frame)
+{
+    hb_buffer_t *buf;
+    buf = hb_frame_buffer_init(pv->output.pix_fmt,
+                               frame->width, frame->height);
+    buf->f.color_prim      = pv->output.color_prim;
+    buf->f.color_transfer  = pv->output.color_transfer;
+    buf->f.color_matrix    = pv->output.color_matrix;
+    buf->f.color_range     = pv->output.color_range;
+    buf->f.chroma_location = pv->output.chroma_location;
+
+    return buf;
+}
+
+static void nlmeans_filter_work(void *thread_args_v)
+{
+    nlmeans_thread_arg_t *thread_data = thread_args_v;
+    hb_filter_private_t *pv = thread_data->pv;
+    int segment = thread_data->arg.segment;
+
+    if (pv->tiles)
+    {
+        // Every thread filters a band of the same frame
+        nlmeans_filter_band(pv, &pv->frame[pv->band_frame], pv->band_avail,
+                            pv->band_out, segment, pv->threads);
+        return;
+    }
+
+    Frame *frame = &pv->frame[segment];
+    hb_buffer_t *buf = nlmeans_output_init(pv, frame);
+
+    nlmeans_filter_band(pv, frame, NLMEANS_FRAMES_MAX, buf, 0, 1);
+
     hb_buffer_copy_props(buf, pv->frame[segment].buf);
     hb_buffer_close(&pv->frame[segment].buf);
     thread_data->out = buf;
@@ -544,17 +722,31 @@ static void nlmeans_add_frame(hb_filter_private_t *pv, hb_buffer_t *buf)
 
 static hb_buffer_t * nlmeans_filter(hb_filter_private_t *pv)
 {
-    if (pv->next_frame < pv->max_frames + pv->threads)
+    if (pv->next_frame < pv->max_frames + pv->frame_threads)
     {
         return NULL;
     }
 
+    hb_buffer_t *band_out = NULL;
+    if (pv->tiles)
+    {
+        band_out = nlmeans_output_init(pv, &pv->frame[0]);
+        pv->band_out   = band_out;
+        pv->band_frame = 0;
+        pv->band_avail = NLMEANS_FRAMES_MAX;
+    }
     taskset_cycle(&pv->taskset);
+    if (pv->tiles)
+    {
+        pv->band_out = NULL;
+        hb_buffer_copy_props(band_out, pv->frame[0].buf);
+        hb_buffer_close(&pv->frame[0].buf);
+    }
 
     // Free buffers that are not needed for next taskset cycle
     for (int c = 0; c < 3; c++)
     {
-        for (int t = 0; t < pv->threads; t++)
+        for (int t = 0; t < pv->frame_threads; t++)
         {
             // Release last frame in buffer
             if (pv->frame[t].plane[c].mem_pre != NULL &&
@@ -575,15 +767,20 @@ static hb_buffer_t * nlmeans_filter(hb_filter_private_t *pv)
     {
         // Don't move the mutex!
         Frame frame = pv->frame[f];
-        pv->frame[f] = pv->frame[f+pv->threads];
+        pv->frame[f] = pv->frame[f+pv->frame_threads];
         for (int c = 0; c < 3; c++)
         {
             pv->frame[f].plane[c].mutex = frame.plane[c].mutex;
-            pv->frame[f+pv->threads].plane[c].mem_pre = NULL;
-            pv->frame[f+pv->threads].plane[c].mem = NULL;
+            pv->frame[f+pv->frame_threads].plane[c].mem_pre = NULL;
+            pv->frame[f+pv->frame_threads].plane[c].mem = NULL;
         }
     }
-    pv->next_frame -= pv->threads;
+    pv->next_frame -= pv->frame_threads;
+
+    if (pv->tiles)
+    {
+        return band_out;
+    }
 
     // Collect results from taskset
     hb_buffer_list_t list;
@@ -603,57 +800,19 @@ static hb_buffer_t * nlmeans_filter_flush(hb_filter_private_t *pv)
     for (int f = 0; f < pv->next_frame; f++)
     {
         Frame *frame = &pv->frame[f];
-        hb_buffer_t *buf;
-        buf = hb_frame_buffer_init(pv->output.pix_fmt,
-                                   frame->width, frame->height);
-        buf->f.color_prim      = pv->output.color_prim;
-        buf->f.color_transfer  = pv->output.color_transfer;
-        buf->f.color_matrix    = pv->output.color_matrix;
-        buf->f.color_range     = pv->output.color_range;
-        buf->f.chroma_location = pv->output.chroma_location;
+        hb_buffer_t *buf = nlmeans_output_init(pv, frame);
 
-        NLMeansFunctions *functions = &pv->functions;
-
-        for (int c = 0; c < 3; c++)
+        if (pv->tiles)
         {
-            if (pv->prefilter[c] & NLMEANS_PREFILTER_MODE_PASSTHRU)
-            {
-                pv->nlmeans_prefilter(&frame->plane[c], pv->prefilter[c]);
-                pv->nlmeans_deborder(&frame->plane[c], buf->plane[c].data,
-                                       buf->plane[c].width, buf->plane[c].stride / pv->bps,
-                                       buf->plane[c].height);
-                continue;
-            }
-            if (pv->strength[c] == 0)
-            {
-                pv->nlmeans_deborder(&frame->plane[c], buf->plane[c].data,
-                                     buf->plane[c].width, buf->plane[c].stride / pv->bps,
-                                     buf->plane[c].height);
-                continue;
-            }
-
-            int nframes = pv->next_frame - f;
-            if (pv->nframes[c] < nframes)
-            {
-                nframes = pv->nframes[c];
-            }
-            // Process current plane
-            pv->nlmeans_plane(functions,
-                              frame,
-                              pv->prefilter[c],
-                              c,
-                              nframes,
-                              buf->plane[c].data,
-                              buf->plane[c].width,
-                              buf->plane[c].stride / pv->bps,
-                              buf->plane[c].height,
-                              pv->strength[c],
-                              pv->origin_tune[c],
-                              pv->patch_size[c],
-                              pv->range[c],
-                              pv->exptable[c],
-                              pv->weight_fact_table[c],
-                              pv->diff_max[c]);
+            pv->band_out   = buf;
+            pv->band_frame = f;
+            pv->band_avail = pv->next_frame - f;
+            taskset_cycle(&pv->taskset);
+            pv->band_out   = NULL;
+        }
+        else
+        {
+            nlmeans_filter_band(pv, frame, pv->next_frame - f, buf, 0, 1);
         }
         hb_buffer_copy_props(buf, frame->buf);
         hb_buffer_close(&frame->buf);
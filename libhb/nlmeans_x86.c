@@ -13,10 +13,17 @@
 #if defined(ARCH_X86)
 
 #include <emmintrin.h>
+#include <immintrin.h>
 
 #include "libavutil/cpu.h"
 #include "handbrake/nlmeans.h"
 
+// The AVX2 and AVX-512 kernels are compiled for their instruction sets
+// on a per function basis so that the rest of libhb keeps the baseline
+// target. They are only called when the cpu reports support.
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
 static void build_integral_sse2(uint32_t *integral,
                                 int       integral_stride,
                           const void  *in_src,
@@ -148,9 +155,109 @@ static void build_integral_sse2(uint32_t *integral,
     }
 }
 
-void nlmeans_init_x86(NLMeansFunctions *functions)
+// Running sum of the 8 elements of v, plus carry
+static inline TARGET_AVX2 __m256i prefix_sum_avx2(__m256i v, __m256i carry)
+{
+    __m256i low;
+
+    // Sum within each 128 bit lane
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+
+    // Carry the total of the low lane into the high lane
+    low = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(3));
+    low = _mm256_blend_epi32(_mm256_setzero_si256(), low, 0xf0);
+    v   = _mm256_add_epi32(v, low);
+
+    return _mm256_add_epi32(v, carry);
+}
+
+// Running sum of the 16 16-bit elements of v, plus carry, wrapping around
+static inline TARGET_AVX2 __m256i prefix_sum_epi16_avx2(__m256i v, __m256i carry)
+{
+    __m256i low;
+
+    // Sum within each 128 bit lane
+    v = _mm256_add_epi16(v, _mm256_slli_si256(v, 2));
+    v = _mm256_add_epi16(v, _mm256_slli_si256(v, 4));
+    v = _mm256_add_epi16(v, _mm256_slli_si256(v, 8));
+
+    // Carry the total of the low lane into the high lane
+    low = _mm256_permute2x128_si256(v, v, 0x08);
+    low = _mm256_shuffle_epi8(low, _mm256_set1_epi16(0x0f0e));
+    v   = _mm256_add_epi16(v, low);
+
+    return _mm256_add_epi16(v, carry);
+}
+
+// Running sum of the 16 elements of v, plus carry
+static inline TARGET_AVX512 __m512i prefix_sum_avx512(__m512i v, __m512i carry)
+{
+    const __m512i zero = _mm512_setzero_si512();
+
+    // Shift in zeros by 1, 2, 4 and 8 elements and add
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 15));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 14));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 12));
+    v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 8));
+
+    return _mm512_add_epi32(v, carry);
+}
+
+#define BIT_DEPTH 8
+#include "templates/nlmeans_x86_template.c"
+#undef BIT_DEPTH
+
+#define BIT_DEPTH 16
+#include "templates/nlmeans_x86_template.c"
+#undef BIT_DEPTH
+
+void nlmeans_init_x86(NLMeansFunctions *functions, int depth)
 {
-    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX512)
+    {
+        if (depth > 8)
+        {
+            functions->build_integral = build_integral_avx512_16;
+            functions->accumulate     = nlmeans_accumulate_avx512_16;
+        }
+        else
+        {
+            functions->build_integral = build_integral_avx512_8;
+            functions->accumulate     = nlmeans_accumulate_avx512_8;
+        }
+        hb_log("NLMeans using AVX-512 optimizations");
+    }
+    else if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        if (depth > 8)
+        {
+            functions->build_integral = build_integral_avx2_16;
+            functions->accumulate     = nlmeans_accumulate_avx2_16;
+        }
+        else
+        {
+            functions->build_integral = build_integral_avx2_8;
+            functions->accumulate     = nlmeans_accumulate_avx2_8;
+        }
+        hb_log("NLMeans using AVX2 optimizations");
+    }
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        if (depth > 8)
+        {
+            functions->build_integral_fast = build_integral_fast_avx2_16;
+            functions->accumulate_fast     = nlmeans_accumulate_fast_avx2_16;
+        }
+        else
+        {
+            functions->build_integral_fast = build_integral_fast_avx2_8;
+            functions->accumulate_fast     = nlmeans_accumulate_fast_avx2_8;
+        }
+    }
+    else if ((cpu_flags & AV_CPU_FLAG_SSE2) && depth == 8)
     {
         functions->build_integral = build_integral_sse2;
         hb_log("NLMeans using SSE2 optimizations");
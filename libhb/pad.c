@@ -24,6 +24,7 @@ hb_filter_object_t hb_filter_pad =
     .id                = HB_FILTER_PAD,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Pad",
     .settings          = NULL,
     .init              = pad_init,
@@ -0,0 +1,400 @@
+/* pipeline_stats.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/pipeline_stats.h"
+
+/*
+ * Each work object and filter thread of a job gets a stage.  The stage
+ * thread accounts the time it spends in its work function, waiting for
+ * input and waiting for room in its output fifo.  The counters can be
+ * read at any time with hb_pipeline_stats_to_dict().
+ *
+ * When a trace prefix is set, every interval is also recorded and
+ * written as a Chrome trace-event file (chrome://tracing, Perfetto)
+ * when the job ends.
+ */
+
+// Upper limit of recorded intervals per stage, 16 bytes each
+#define STAGE_TRACE_MAX     (1 << 18)
+
+typedef struct
+{
+    uint64_t    start;
+    uint32_t    duration;
+    uint32_t    what;
+} stage_event_t;
+
+struct hb_stage_stats_s
+{
+    char          * name;
+    const char    * type;
+    int             index;
+
+    uint64_t        time[HB_STAGE_TIME_COUNT];
+    uint64_t        frames_in;
+    uint64_t        frames_out;
+    uint64_t        occupancy[HB_STAGE_OCCUPANCY_BINS];
+
+    int             trace;
+    stage_event_t * events;
+    int             event_count;
+    int             event_alloc;
+    uint64_t        events_dropped;
+};
+
+struct hb_pipeline_stats_s
+{
+    hb_lock_t     * lock;
+    int             enable;
+    char          * trace_prefix;
+
+    int             running;
+    int             sequence_id;
+    int             pass_id;
+    uint64_t        start;
+    uint64_t        stop;
+    hb_list_t     * stages;
+};
+
+static const char * stage_time_names[HB_STAGE_TIME_COUNT] =
+{
+    "Busy", "Starved", "Blocked"
+};
+
+static void stage_close( hb_stage_stats_t ** _s )
+{
+    hb_stage_stats_t * s = *_s;
+
+    if (s == NULL)
+    {
+        return;
+    }
+    free(s->name);
+    free(s->events);
+    free(s);
+    *_s = NULL;
+}
+
+static void stages_clear( hb_pipeline_stats_t * ps )
+{
+    hb_stage_stats_t * s;
+
+    while ((s = hb_list_item(ps->stages, 0)) != NULL)
+    {
+        hb_list_rem(ps->stages, s);
+        stage_close(&s);
+    }
+}
+
+hb_pipeline_stats_t * hb_pipeline_stats_init( void )
+{
+    hb_pipeline_stats_t * ps = calloc(1, sizeof(hb_pipeline_stats_t));
+
+    if (ps == NULL)
+    {
+        return NULL;
+    }
+    ps->lock   = hb_lock_init();
+    ps->stages = hb_list_init();
+
+    return ps;
+}
+
+void hb_pipeline_stats_close( hb_pipeline_stats_t ** _ps )
+{
+    hb_pipeline_stats_t * ps = *_ps;
+
+    if (ps == NULL)
+    {
+        return;
+    }
+    stages_clear(ps);
+    hb_list_close(&ps->stages);
+    hb_lock_close(&ps->lock);
+    free(ps->trace_prefix);
+    free(ps);
+    *_ps = NULL;
+}
+
+void hb_pipeline_stats_set( hb_pipeline_stats_t * ps, int enable,
+                            const char * trace_prefix )
+{
+    hb_lock(ps->lock);
+    ps->enable = enable;
+    free(ps->trace_prefix);
+    ps->trace_prefix = NULL;
+    if (enable && trace_prefix != NULL && trace_prefix[0] != 0)
+    {
+        ps->trace_prefix = strdup(trace_prefix);
+    }
+    hb_unlock(ps->lock);
+}
+
+/*
+ * Drops the stages of the previous job.  Returns 1 if the new job
+ * is to be profiled.
+ */
+int hb_pipeline_stats_start( hb_pipeline_stats_t * ps, hb_job_t * job )
+{
+    int enable;
+
+    hb_lock(ps->lock);
+    stages_clear(ps);
+    enable          = ps->enable;
+    ps->running     = enable;
+    ps->sequence_id = job->sequence_id;
+    ps->pass_id     = job->pass_id;
+    ps->start       = hb_get_time_us();
+    ps->stop        = 0;
+    hb_unlock(ps->lock);
+
+    return enable;
+}
+
+hb_stage_stats_t * hb_pipeline_stats_add_stage( hb_pipeline_stats_t * ps,
+                                                const char * name,
+                                                const char * type )
+{
+    hb_stage_stats_t * s = calloc(1, sizeof(hb_stage_stats_t));
+
+    if (s == NULL)
+    {
+        return NULL;
+    }
+    s->name = strdup(name != NULL ? name : "unknown");
+    s->type = type;
+
+    hb_lock(ps->lock);
+    s->index = hb_list_count(ps->stages);
+    s->trace = ps->trace_prefix != NULL;
+    hb_list_add(ps->stages, s);
+    hb_unlock(ps->lock);
+
+    return s;
+}
+
+uint64_t hb_stage_stats_mark( hb_stage_stats_t * s, int what, uint64_t start )
+{
+    uint64_t now = hb_get_time_us();
+    uint64_t duration = now - start;
+
+    hb_atomic_add(&s->time[what], duration);
+
+    if (s->trace && duration > 0)
+    {
+        if (s->event_count == s->event_alloc)
+        {
+            stage_event_t * events = NULL;
+            int             alloc  = s->event_alloc ? s->event_alloc * 2 : 1024;
+
+            if (alloc <= STAGE_TRACE_MAX)
+            {
+                events = realloc(s->events, alloc * sizeof(stage_event_t));
+            }
+            if (events == NULL)
+            {
+                s->events_dropped++;
+                return now;
+            }
+            s->events      = events;
+            s->event_alloc = alloc;
+        }
+        stage_event_t * e = &s->events[s->event_count++];
+        e->start    = start;
+        e->duration = duration > UINT32_MAX ? UINT32_MAX : duration;
+        e->what     = what;
+    }
+    return now;
+}
+
+void hb_stage_stats_frames( hb_stage_stats_t * s, hb_buffer_t * in,
+                            hb_buffer_t * out )
+{
+    int count = 0;
+
+    if (in != NULL)
+    {
+        hb_atomic_add(&s->frames_in, 1);
+    }
+    for (; out != NULL; out = out->next)
+    {
+        count++;
+    }
+    if (count > 0)
+    {
+        hb_atomic_add(&s->frames_out, count);
+    }
+}
+
+void hb_stage_stats_occupancy( hb_stage_stats_t * s, hb_fifo_t * fifo )
+{
+    int size = hb_fifo_size(fifo);
+    int bin  = 0;
+
+    while (size > 0 && bin < HB_STAGE_OCCUPANCY_BINS - 1)
+    {
+        size >>= 1;
+        bin++;
+    }
+    hb_atomic_add(&s->occupancy[bin], 1);
+}
+
+static void write_trace( hb_pipeline_stats_t * ps )
+{
+    static const char * pass_names[] =
+    {
+        "subtitle", "encode", "analysis", "final"
+    };
+    const char * pass = "encode";
+    char       * filename;
+    FILE       * file;
+    int          ii, jj, first = 1;
+
+    if (ps->pass_id >= HB_PASS_SUBTITLE && ps->pass_id <= HB_PASS_ENCODE_FINAL)
+    {
+        pass = pass_names[ps->pass_id + 1];
+    }
+    filename = hb_strdup_printf("%s-%d-%s.json", ps->trace_prefix,
+                                ps->sequence_id, pass);
+    file = hb_fopen(filename, "w");
+    if (file == NULL)
+    {
+        hb_error("pipeline: failed to open trace file %s", filename);
+        free(filename);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (ii = 0; ii < hb_list_count(ps->stages); ii++)
+    {
+        hb_stage_stats_t * s = hb_list_item(ps->stages, ii);
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                      "\"tid\":%d,\"args\":{\"name\":\"%s: %s\"}}",
+                first ? "" : ",\n", s->index, s->type, s->name);
+        first = 0;
+        for (jj = 0; jj < s->event_count; jj++)
+        {
+            stage_event_t * e = &s->events[jj];
+
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                          "\"tid\":%d,\"ts\":%"PRIu64",\"dur\":%u}",
+                    stage_time_names[e->what], s->index,
+                    e->start - ps->start, e->duration);
+        }
+        if (s->events_dropped)
+        {
+            hb_log("pipeline: %s, %"PRIu64" trace events dropped",
+                   s->name, s->events_dropped);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    hb_log("pipeline: trace written to %s", filename);
+    free(filename);
+}
+
+/*
+ * Called once all stage threads have exited.  Logs a summary and
+ * writes the trace.  The counters stay available until the next job.
+ */
+void hb_pipeline_stats_stop( hb_pipeline_stats_t * ps )
+{
+    int ii;
+
+    hb_lock(ps->lock);
+    if (!ps->running)
+    {
+        hb_unlock(ps->lock);
+        return;
+    }
+    ps->running = 0;
+    ps->stop    = hb_get_time_us();
+
+    double elapsed = ps->stop > ps->start ? ps->stop - ps->start : 1;
+    hb_log("pipeline: %-28s %8s %8s %8s %8s", "stage",
+           "frames", "busy", "starved", "blocked");
+    for (ii = 0; ii < hb_list_count(ps->stages); ii++)
+    {
+        hb_stage_stats_t * s = hb_list_item(ps->stages, ii);
+
+        hb_log("pipeline: %-28s %8"PRIu64" %7.1f%% %7.1f%% %7.1f%%",
+               s->name, s->frames_in,
+               100. * s->time[HB_STAGE_BUSY]    / elapsed,
+               100. * s->time[HB_STAGE_STARVED] / elapsed,
+               100. * s->time[HB_STAGE_BLOCKED] / elapsed);
+    }
+
+    if (ps->trace_prefix != NULL)
+    {
+        write_trace(ps);
+    }
+    for (ii = 0; ii < hb_list_count(ps->stages); ii++)
+    {
+        hb_stage_stats_t * s = hb_list_item(ps->stages, ii);
+        free(s->events);
+        s->events      = NULL;
+        s->event_count = s->event_alloc = 0;
+    }
+    hb_unlock(ps->lock);
+}
+
+hb_dict_t * hb_pipeline_stats_to_dict( hb_pipeline_stats_t * ps )
+{
+    hb_dict_t        * dict = hb_dict_init();
+    hb_value_array_t * stages = hb_value_array_init();
+    uint64_t           now;
+    int                ii, jj;
+
+    hb_lock(ps->lock);
+    now = ps->running ? hb_get_time_us() : ps->stop;
+
+    hb_dict_set_bool(dict, "Enabled", ps->enable);
+    hb_dict_set_bool(dict, "Running", ps->running);
+    hb_dict_set_int(dict, "SequenceID", ps->sequence_id);
+    hb_dict_set_int(dict, "PassID", ps->pass_id);
+    hb_dict_set_int(dict, "ElapsedUS",
+                    hb_list_count(ps->stages) && now > ps->start ?
+                    now - ps->start : 0);
+
+    for (ii = 0; ii < hb_list_count(ps->stages); ii++)
+    {
+        hb_stage_stats_t * s = hb_list_item(ps->stages, ii);
+        hb_dict_t        * stage = hb_dict_init();
+        hb_value_array_t * occupancy = hb_value_array_init();
+
+        hb_dict_set_string(stage, "Name", s->name);
+        hb_dict_set_string(stage, "Type", s->type);
+        hb_dict_set_int(stage, "FramesIn",
+                        hb_atomic_load_relaxed(&s->frames_in));
+        hb_dict_set_int(stage, "FramesOut",
+                        hb_atomic_load_relaxed(&s->frames_out));
+        for (jj = 0; jj < HB_STAGE_TIME_COUNT; jj++)
+        {
+            char key[16];
+
+            snprintf(key, sizeof(key), "%sUS", stage_time_names[jj]);
+            hb_dict_set_int(stage, key, hb_atomic_load_relaxed(&s->time[jj]));
+        }
+        for (jj = 0; jj < HB_STAGE_OCCUPANCY_BINS; jj++)
+        {
+            hb_value_array_append(occupancy, hb_value_int(
+                hb_atomic_load_relaxed(&s->occupancy[jj])));
+        }
+        hb_dict_set(stage, "InputOccupancy", occupancy);
+        hb_value_array_append(stages, stage);
+    }
+    hb_unlock(ps->lock);
+
+    hb_dict_set(dict, "Stages", stages);
+
+    return dict;
+}
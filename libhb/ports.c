@@ -845,6 +845,10 @@ struct hb_thread_s
     hb_lock_t     * lock;
     int             exited;
     pthread_t       thread;
+
+    // Broadcast when the thread routine returns, see hb_thread_notify_exit()
+    hb_lock_t     * exit_lock;
+    hb_cond_t     * exit_cond;
 };
 
 /* Get a unique identifier to thread and represent as 64-bit unsigned.
@@ -901,9 +905,21 @@ static void attribute_align_thread hb_thread_func( void * _t )
 
     /* Inform that the thread can be joined now */
     hb_deep_log( 2, "thread %"PRIx64" exited (\"%s\")", hb_thread_to_integer( t ), t->name );
+    hb_lock_t * exit_lock;
+    hb_cond_t * exit_cond;
+
     hb_lock( t->lock );
     t->exited = 1;
+    exit_lock = t->exit_lock;
+    exit_cond = t->exit_cond;
     hb_unlock( t->lock );
+
+    if ( exit_cond != NULL )
+    {
+        hb_lock( exit_lock );
+        hb_cond_broadcast( exit_cond );
+        hb_unlock( exit_lock );
+    }
 }
 
 /************************************************************************
@@ -934,6 +950,31 @@ hb_thread_t * hb_thread_init( const char * name, void (* function)(void *),
     return t;
 }
 
+/************************************************************************
+ * hb_thread_notify_exit()
+ ************************************************************************
+ * Broadcasts cond while holding lock once the thread routine returns,
+ * or right away if it already has. lock and cond must outlive the
+ * thread.
+ ***********************************************************************/
+void hb_thread_notify_exit( hb_thread_t * t, hb_lock_t * lock, hb_cond_t * cond )
+{
+    int exited;
+
+    hb_lock( t->lock );
+    t->exit_lock = lock;
+    t->exit_cond = cond;
+    exited       = t->exited;
+    hb_unlock( t->lock );
+
+    if ( exited )
+    {
+        hb_lock( lock );
+        hb_cond_broadcast( cond );
+        hb_unlock( lock );
+    }
+}
+
 /************************************************************************
  * hb_thread_close()
  ************************************************************************
@@ -1109,6 +1150,62 @@ void hb_cond_broadcast( hb_cond_t * c )
     pthread_cond_broadcast( &c->cond );
 }
 
+/************************************************************************
+ * Portable thread local storage implementation
+ ***********************************************************************/
+struct hb_tls_key_s
+{
+    pthread_key_t key;
+};
+
+/************************************************************************
+ * hb_tls_key_init()
+ * hb_tls_key_close()
+ * hb_tls_get()
+ * hb_tls_set()
+ ************************************************************************
+ * destructor is called with the thread's value when a thread that set
+ * a non-NULL value exits.
+ ***********************************************************************/
+hb_tls_key_t * hb_tls_key_init( void (*destructor)(void *) )
+{
+    hb_tls_key_t * k = calloc( sizeof( hb_tls_key_t ), 1 );
+
+    if( k == NULL )
+        return NULL;
+
+    if( pthread_key_create( &k->key, destructor ) )
+    {
+        free( k );
+        return NULL;
+    }
+    return k;
+}
+
+void hb_tls_key_close( hb_tls_key_t ** _k )
+{
+    hb_tls_key_t * k = *_k;
+
+    if (k == NULL)
+    {
+        return;
+    }
+    pthread_key_delete( k->key );
+    free( k );
+
+    *_k = NULL;
+}
+
+void * hb_tls_get( hb_tls_key_t * k )
+{
+    return pthread_getspecific( k->key );
+}
+
+void hb_tls_set( hb_tls_key_t * k, void * value )
+{
+    pthread_setspecific( k->key, value );
+}
+
 /************************************************************************
  * Network
  ***********************************************************************/
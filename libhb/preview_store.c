@@ -0,0 +1,294 @@
+/* preview_store.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/preview_store.h"
+
+/*
+ * Previews are written by the scan thread and read by the frontends
+ * from their own threads, so every access takes the store lock.  The
+ * previews are copied in and out, callers never share a buffer with
+ * the store.
+ */
+
+typedef struct
+{
+    int           title;
+    int           preview;
+    int           format;
+    uint64_t      last_use;
+    hb_buffer_t * buf;
+} preview_entry_t;
+
+struct hb_preview_store_s
+{
+    hb_lock_t          * lock;
+    hb_list_t          * entries;
+    int64_t              size;
+    int64_t              max_size;
+    uint64_t             use_count;
+
+    hb_preview_spill_f * spill;
+    void               * opaque;
+
+    uint64_t             hits;
+    uint64_t             misses;
+    uint64_t             spills;
+};
+
+hb_preview_store_t * hb_preview_store_init( int64_t max_size,
+                                            hb_preview_spill_f * spill,
+                                            void * opaque )
+{
+    hb_preview_store_t * store = calloc(1, sizeof(hb_preview_store_t));
+    if (store == NULL)
+    {
+        hb_error("hb_preview_store_init: calloc failed");
+        return NULL;
+    }
+    store->lock     = hb_lock_init();
+    store->entries  = hb_list_init();
+    store->max_size = max_size;
+    store->spill    = spill;
+    store->opaque   = opaque;
+
+    return store;
+}
+
+static void entry_close( preview_entry_t ** _e )
+{
+    preview_entry_t * e = *_e;
+
+    if (e == NULL)
+    {
+        return;
+    }
+    hb_buffer_close(&e->buf);
+    free(e);
+    *_e = NULL;
+}
+
+static preview_entry_t * store_find( hb_preview_store_t * store,
+                                     int title, int preview )
+{
+    for (int ii = 0; ii < hb_list_count(store->entries); ii++)
+    {
+        preview_entry_t * e = hb_list_item(store->entries, ii);
+        if (e->title == title && e->preview == preview)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void store_remove( hb_preview_store_t * store, preview_entry_t * e )
+{
+    hb_list_rem(store->entries, e);
+    store->size -= e->buf->alloc;
+}
+
+// Spills the least recently used previews until the store fits in
+// size bytes.  This is done with the lock held so that a preview is
+// always either in memory or on disk.
+static void store_evict( hb_preview_store_t * store, int64_t size )
+{
+    while (store->size > size && hb_list_count(store->entries) > 0)
+    {
+        preview_entry_t * lru = hb_list_item(store->entries, 0);
+        for (int ii = 1; ii < hb_list_count(store->entries); ii++)
+        {
+            preview_entry_t * e = hb_list_item(store->entries, ii);
+            if (e->last_use < lru->last_use)
+            {
+                lru = e;
+            }
+        }
+        store_remove(store, lru);
+        if (store->spill != NULL)
+        {
+            store->spill(store->opaque, lru->title, lru->preview, lru->buf, lru->format);
+        }
+        entry_close(&lru);
+        store->spills++;
+    }
+}
+
+void hb_preview_store_set_max_size( hb_preview_store_t * store, int64_t max_size )
+{
+    if (store == NULL)
+    {
+        return;
+    }
+
+    hb_lock(store->lock);
+    store->max_size = max_size;
+    store_evict(store, max_size);
+    hb_unlock(store->lock);
+}
+
+// Drops the preview of title/preview, if any, so that a stale copy is
+// never read back once a newer one was saved elsewhere.
+// Called with the lock held.
+static void store_drop( hb_preview_store_t * store, int title, int preview )
+{
+    preview_entry_t * old = store_find(store, title, preview);
+    if (old != NULL)
+    {
+        store_remove(store, old);
+        entry_close(&old);
+    }
+}
+
+// Copies the visible part of the planes into a new frame buffer,
+// hb_read_preview() sets the frame properties from the title
+static hb_buffer_t * preview_copy( const hb_buffer_t * src )
+{
+    hb_buffer_t * buf = hb_frame_buffer_init(src->f.fmt, src->f.width, src->f.height);
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+
+    for (int pp = 0; pp < 3; pp++)
+    {
+        const uint8_t * src_data = src->plane[pp].data;
+        uint8_t       * dst_data = buf->plane[pp].data;
+        const int       width    = MIN(src->plane[pp].width,  buf->plane[pp].width);
+        const int       height   = MIN(src->plane[pp].height, buf->plane[pp].height);
+
+        for (int yy = 0; yy < height; yy++)
+        {
+            memcpy(dst_data, src_data, width);
+            src_data += src->plane[pp].stride;
+            dst_data += buf->plane[pp].stride;
+        }
+    }
+
+    return buf;
+}
+
+int hb_preview_store_put( hb_preview_store_t * store, int title, int preview,
+                          const hb_buffer_t * buf, int format )
+{
+    if (store == NULL)
+    {
+        return -1;
+    }
+
+    preview_entry_t * e = NULL;
+    if (buf->f.fmt == AV_PIX_FMT_YUV420P)
+    {
+        e = calloc(1, sizeof(preview_entry_t));
+    }
+    if (e != NULL)
+    {
+        e->title   = title;
+        e->preview = preview;
+        e->format  = format;
+        e->buf     = preview_copy(buf);
+        if (e->buf == NULL)
+        {
+            free(e);
+            e = NULL;
+        }
+    }
+
+    hb_lock(store->lock);
+    // Drop the previous preview first, also when the new one can not be
+    // kept and goes to disk instead
+    store_drop(store, title, preview);
+    if (e == NULL)
+    {
+        hb_unlock(store->lock);
+        return -1;
+    }
+    if (e->buf->alloc > store->max_size)
+    {
+        hb_unlock(store->lock);
+        entry_close(&e);
+        return -1;
+    }
+    store_evict(store, store->max_size - e->buf->alloc);
+
+    e->last_use = ++store->use_count;
+    hb_list_add(store->entries, e);
+    store->size += e->buf->alloc;
+    hb_unlock(store->lock);
+
+    return 0;
+}
+
+hb_buffer_t * hb_preview_store_get( hb_preview_store_t * store, int title,
+                                    int preview )
+{
+    hb_buffer_t * buf = NULL;
+
+    if (store == NULL)
+    {
+        return NULL;
+    }
+
+    hb_lock(store->lock);
+    preview_entry_t * e = store_find(store, title, preview);
+    if (e != NULL)
+    {
+        e->last_use = ++store->use_count;
+        buf = preview_copy(e->buf);
+        store->hits++;
+    }
+    else
+    {
+        store->misses++;
+    }
+    hb_unlock(store->lock);
+
+    return buf;
+}
+
+void hb_preview_store_clear( hb_preview_store_t * store )
+{
+    preview_entry_t * e;
+
+    if (store == NULL)
+    {
+        return;
+    }
+
+    hb_lock(store->lock);
+    while ((e = hb_list_item(store->entries, 0)) != NULL)
+    {
+        store_remove(store, e);
+        entry_close(&e);
+    }
+    hb_unlock(store->lock);
+}
+
+void hb_preview_store_close( hb_preview_store_t ** _store )
+{
+    hb_preview_store_t * store = *_store;
+
+    if (store == NULL)
+    {
+        return;
+    }
+
+    if (store->hits + store->misses + store->spills)
+    {
+        hb_log("preview store: %"PRIu64" reads from memory, %"PRIu64" from disk, "
+               "%"PRIu64" previews spilled to disk",
+               store->hits, store->misses, store->spills);
+    }
+
+    hb_preview_store_clear(store);
+    hb_list_close(&store->entries);
+    hb_lock_close(&store->lock);
+    free(store);
+    *_store = NULL;
+}
@@ -60,14 +60,31 @@ struct hb_work_private_s
 
     buffer_splice_list_t * splice_list;
     int                    splice_list_size;
+
+    // Read ahead (see read_ahead_thread)
+    int64_t                ra_window;
+    hb_thread_t          * ra_thread;
+    hb_fifo_t            * ra_fifo;
+    hb_fifo_budget_t     * ra_budget;
+    volatile int           ra_stop;
+    uint64_t               ra_hits;
+    uint64_t               ra_misses;
+    uint64_t               ra_wait_us;
 };
 
+// Default read ahead window in MiB
+#define READ_AHEAD_DEFAULT  16
+// Upper bound on the number of buffers queued in the read ahead fifo.
+// The window is what normally limits it.
+#define READ_AHEAD_BUFFERS  16384
+
 /***********************************************************************
  * Local prototypes
  **********************************************************************/
 static hb_fifo_t ** GetFifoForId( hb_work_private_t * r, int id );
 static hb_buffer_list_t * get_splice_list(hb_work_private_t * r, int id);
 static void UpdateState( hb_work_private_t  * r );
+static void read_ahead_thread( void * _r );
 
 /***********************************************************************
  * reader_init
@@ -331,6 +348,15 @@ static int reader_init( hb_work_object_t * w, hb_job_t * job )
     {
         return 1;
     }
+
+    // The read ahead thread is started by the first reader_work call,
+    // once every other work object has been initialized.
+    if (job->read_ahead >= 0)
+    {
+        int window = job->read_ahead > 0 ? job->read_ahead :
+                                           READ_AHEAD_DEFAULT;
+        r->ra_window = (int64_t)window << 20;
+    }
     return 0;
 }
 
@@ -343,6 +369,20 @@ static void reader_close( hb_work_object_t * w )
     {
         return;
     }
+    if (r->ra_thread != NULL)
+    {
+        r->ra_stop = 1;
+        hb_thread_close(&r->ra_thread);
+
+        uint64_t reads = r->ra_hits + r->ra_misses;
+        hb_log("reader: read ahead %"PRId64" MiB, %"PRIu64" hits, "
+               "%"PRIu64" misses (%.1f%%), %.3f s waiting for input",
+               r->ra_window >> 20, r->ra_hits, r->ra_misses,
+               reads ? 100. * r->ra_misses / reads : 0.,
+               r->ra_wait_us / 1000000.);
+    }
+    hb_fifo_close(&r->ra_fifo);
+    hb_fifo_budget_close(&r->ra_budget);
     if (r->bd)
     {
         hb_bd_stop( r->bd );
@@ -449,16 +489,11 @@ static void reader_send_eof( hb_work_private_t * r )
     hb_log("reader: done. %d scr changes", r->demux.scr_changes);
 }
 
-static int reader_work( hb_work_object_t * w, hb_buffer_t ** buf_in,
-                        hb_buffer_t ** buf_out)
+// Reads the next buffer from the source, or returns NULL when the end
+// of the title or of the last chapter of the job has been reached.
+static hb_buffer_t * reader_read( hb_work_private_t * r )
 {
-    hb_work_private_t  * r = w->private_data;
-    hb_fifo_t         ** fifos;
-    hb_buffer_t        * buf;
-    hb_buffer_list_t     list;
-    int                  ii, chapter = -1;
-
-    hb_buffer_list_clear(&list);
+    int chapter = -1;
 
     if (r->bd)
         chapter = hb_bd_chapter( r->bd );
@@ -470,45 +505,133 @@ static int reader_work( hb_work_object_t * w, hb_buffer_t ** buf_in,
     if( chapter < 0 )
     {
         hb_log( "reader: end of the title reached" );
-        reader_send_eof(r);
-        return HB_WORK_DONE;
+        return NULL;
     }
     if( chapter > r->chapter_end )
     {
         hb_log("reader: end of chapter %d (media %d) reached at media chapter %d",
                 r->job->chapter_end, r->chapter_end, chapter);
-        reader_send_eof(r);
-        return HB_WORK_DONE;
+        return NULL;
     }
 
     if (r->bd)
     {
-        if( (buf = hb_bd_read( r->bd )) == NULL )
-        {
-            reader_send_eof(r);
-            return HB_WORK_DONE;
-        }
+        return hb_bd_read( r->bd );
     }
     else if (r->dvd)
     {
-        if( (buf = hb_dvd_read( r->dvd )) == NULL )
+        return hb_dvd_read( r->dvd );
+    }
+    else if (r->stream)
+    {
+        return hb_stream_read( r->stream );
+    }
+
+    // This should never happen
+    hb_error("Stream not initialized");
+    return NULL;
+}
+
+/***********************************************************************
+ * read_ahead_thread
+ ***********************************************************************
+ * Reads the source into ra_fifo so that disc and file i/o overlaps
+ * with demuxing and with the rest of the pipeline. The fifo is bounded
+ * by a byte budget of ra_window bytes. The source is only ever touched
+ * by this thread once it is running, which keeps the chapter checks in
+ * reader_read in step with the buffers read. The end of input is
+ * signalled with an eof buffer.
+ **********************************************************************/
+static void read_ahead_thread( void * _r )
+{
+    hb_work_private_t * r = _r;
+    hb_buffer_t       * buf;
+    int                 eof;
+
+    while (!r->ra_stop && !*r->die && !r->job->done)
+    {
+        buf = reader_read(r);
+        eof = buf == NULL;
+        if (eof)
+        {
+            buf = hb_buffer_eof_init();
+        }
+        while (!r->ra_stop && !*r->die && !r->job->done &&
+               !hb_fifo_full_wait(r->ra_fifo))
         {
-            reader_send_eof(r);
-            return HB_WORK_DONE;
+        }
+        if (r->ra_stop || *r->die || r->job->done)
+        {
+            hb_buffer_close(&buf);
+            break;
+        }
+        hb_fifo_push(r->ra_fifo, buf);
+        if (eof)
+        {
+            break;
         }
     }
-    else if (r->stream)
+}
+
+// Takes the next buffer from the read ahead thread. Returns NULL at
+// the end of input or when the job is stopped.
+static hb_buffer_t * read_ahead_get( hb_work_private_t * r )
+{
+    hb_buffer_t * buf;
+
+    if (r->ra_thread == NULL)
+    {
+        r->ra_fifo   = hb_fifo_init_spsc(READ_AHEAD_BUFFERS, 1);
+        r->ra_budget = hb_fifo_budget_init(r->ra_window);
+        hb_fifo_set_budget(r->ra_fifo, r->ra_budget, 1);
+        r->ra_thread = hb_thread_init("reader read ahead", read_ahead_thread,
+                                      r, HB_NORMAL_PRIORITY);
+    }
+
+    buf = hb_fifo_get(r->ra_fifo);
+    if (buf != NULL)
     {
-        if ( (buf = hb_stream_read( r->stream )) == NULL )
+        r->ra_hits++;
+    }
+    else
+    {
+        uint64_t start = hb_get_time_us();
+
+        r->ra_misses++;
+        while (buf == NULL && !*r->die && !r->job->done)
         {
-            reader_send_eof(r);
-            return HB_WORK_DONE;
+            buf = hb_fifo_get_wait(r->ra_fifo);
         }
+        r->ra_wait_us += hb_get_time_us() - start;
+    }
+    if (buf != NULL && (buf->s.flags & HB_BUF_FLAG_EOF))
+    {
+        hb_buffer_close(&buf);
+    }
+    return buf;
+}
+
+static int reader_work( hb_work_object_t * w, hb_buffer_t ** buf_in,
+                        hb_buffer_t ** buf_out)
+{
+    hb_work_private_t  * r = w->private_data;
+    hb_fifo_t         ** fifos;
+    hb_buffer_t        * buf;
+    hb_buffer_list_t     list;
+    int                  ii;
+
+    hb_buffer_list_clear(&list);
+
+    if (r->ra_window > 0)
+    {
+        buf = read_ahead_get(r);
     }
     else
     {
-        // This should never happen
-        hb_error("Stream not initialized");
+        buf = reader_read(r);
+    }
+    if (buf == NULL)
+    {
         reader_send_eof(r);
         return HB_WORK_DONE;
     }
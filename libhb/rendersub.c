@@ -10,6 +10,7 @@
 #include "handbrake/handbrake.h"
 #include "handbrake/hbffmpeg.h"
 #include "handbrake/extradata.h"
+#include "handbrake/taskset.h"
 #include <ass/ass.h>
 
 #define ABS(a) ((a) > 0 ? (a) : (-(a)))
@@ -26,6 +27,30 @@ typedef struct hb_box_vec_s
     int size;
 } hb_box_vec_t;
 
+// A composed SSA overlay and the content hash of the ASS_Images in it
+typedef struct hb_ssa_box_s
+{
+    int          x, y, width, height;
+    uint64_t     hash;
+    hb_buffer_t *sub;
+} hb_ssa_box_t;
+
+typedef struct hb_ssa_box_vec_s
+{
+    hb_ssa_box_t *boxes;
+    int count;
+    int size;
+} hb_ssa_box_vec_t;
+
+typedef struct ssa_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    hb_filter_private_t *pv;
+} ssa_thread_arg_t;
+
+// Overlays are composed in parallel when a frame has several new boxes
+#define SSA_MAX_THREADS 8
+
 struct hb_filter_private_s
 {
     // Common
@@ -51,6 +76,13 @@ struct hb_filter_private_s
     uint8_t            script_initialized;
     hb_box_vec_t       boxes;
     hb_csp_convert_f   rgb2yuv_fn;
+    hb_ssa_box_vec_t   ssa_boxes;      // overlays of rendered_sub_list
+    hb_ssa_box_vec_t   ssa_prev_boxes; // overlays of the previous frame
+    const ASS_Image   *ssa_frame_list;
+    int                ssa_threads;
+    taskset_t          ssa_taskset;
+    uint64_t           ssa_hits;
+    uint64_t           ssa_misses;
 
     // SRT
     int                line;
@@ -121,6 +153,7 @@ hb_filter_object_t hb_filter_render_sub =
 {
     .id            = HB_FILTER_RENDER_SUB,
     .enforce_order = 1,
+    .fuse          = 1,
     .name          = "Subtitle renderer",
     .settings      = NULL,
     .init          = hb_rendersub_init,
@@ -484,6 +517,62 @@ static uint8_t inline ssa_alpha(const ASS_Image *frame, const int x, const int y
     return (uint8_t)div255((255 - frame_a) * gliph_a);
 }
 
+static inline int ssa_frame_in_box(const ASS_Image *frame,
+                                   const unsigned width, const unsigned height,
+                                   const unsigned x, const unsigned y)
+{
+    return frame->w && frame->h &&
+           x <= frame->dst_x && x + width >= frame->dst_x + frame->w &&
+           y <= frame->dst_y && y + height >= frame->dst_y + frame->h;
+}
+
+static inline uint64_t ssa_hash_mix(uint64_t hash, uint64_t value)
+{
+    hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 32);
+}
+
+// Hash of everything compose_subsample_ass() reads for the box,
+// equal hashes mean the composed overlay can be reused
+static uint64_t ssa_box_hash(const ASS_Image *frame_list,
+                             const unsigned width, const unsigned height,
+                             const unsigned x, const unsigned y)
+{
+    uint64_t hash = ssa_hash_mix(0, (uint64_t)x << 32 | y);
+    hash = ssa_hash_mix(hash, (uint64_t)width << 32 | height);
+
+    for (const ASS_Image *frame = frame_list; frame; frame = frame->next)
+    {
+        if (!ssa_frame_in_box(frame, width, height, x, y))
+        {
+            continue;
+        }
+        hash = ssa_hash_mix(hash, (uint64_t)frame->dst_x << 32 | frame->dst_y);
+        hash = ssa_hash_mix(hash, (uint64_t)frame->w << 32 | frame->h);
+        hash = ssa_hash_mix(hash, frame->color);
+
+        for (int yy = 0; yy < frame->h; yy++)
+        {
+            const uint8_t *bitmap = frame->bitmap + yy * frame->stride;
+            int xx = 0;
+            for (; xx + 8 <= frame->w; xx += 8)
+            {
+                uint64_t value;
+                memcpy(&value, bitmap + xx, sizeof(value));
+                hash = ssa_hash_mix(hash, value);
+            }
+            uint64_t value = 0;
+            for (; xx < frame->w; xx++)
+            {
+                value = value << 8 | bitmap[xx];
+            }
+            hash = ssa_hash_mix(hash, value);
+        }
+    }
+
+    return hash;
+}
+
 static hb_buffer_t * compose_subsample_ass(hb_filter_private_t *pv, const ASS_Image *frame_list,
                                            const unsigned width, const unsigned height,
                                            const unsigned x, const unsigned y)
@@ -499,9 +588,7 @@ static hb_buffer_t * compose_subsample_ass(hb_filter_private_t *pv, const ASS_Im
 
     while (frame)
     {
-        if (frame->w && frame->h &&
-            x <= frame->dst_x && x + width >= frame->dst_x + frame->w &&
-            y <= frame->dst_y && y + height >= frame->dst_y + frame->h)
+        if (ssa_frame_in_box(frame, width, height, x, y))
         {
             const int yuv = pv->rgb2yuv_fn(frame->color >> 8);
 
@@ -617,6 +704,53 @@ static void clear_ssa_rendered_sub_cache(hb_filter_private_t *pv)
         hb_buffer_list_close(&pv->rendered_sub_list);
         hb_box_vec_clear(&pv->boxes);
     }
+    pv->ssa_boxes.count = 0;
+}
+
+static int hb_ssa_box_vec_resize(hb_ssa_box_vec_t *vec, int size)
+{
+    if (size > vec->size)
+    {
+        hb_ssa_box_t *boxes = realloc(vec->boxes, size * sizeof(hb_ssa_box_t));
+        if (boxes == NULL)
+        {
+            return -1;
+        }
+        vec->boxes = boxes;
+        vec->size  = size;
+    }
+    return 0;
+}
+
+static void compose_ssa_box(hb_filter_private_t *pv, hb_ssa_box_t *box)
+{
+    box->sub = compose_subsample_ass(pv, pv->ssa_frame_list,
+                                     box->width, box->height, box->x, box->y);
+    if (box->sub)
+    {
+        box->sub->f.x += pv->crop[2];
+        box->sub->f.y += pv->crop[0];
+    }
+}
+
+static void compose_ssa_boxes(hb_filter_private_t *pv, int segment, int segments)
+{
+    for (int i = segment; i < pv->ssa_boxes.count; i += segments)
+    {
+        hb_ssa_box_t *box = &pv->ssa_boxes.boxes[i];
+        if (box->sub == NULL)
+        {
+            compose_ssa_box(pv, box);
+        }
+    }
+}
+
+static void compose_ssa_work(void *thread_args_v)
+{
+    ssa_thread_arg_t *thread_args = thread_args_v;
+
+    compose_ssa_boxes(thread_args->pv, thread_args->arg.segment,
+                      thread_args->pv->ssa_threads);
 }
 
 static void render_ssa_subs(hb_filter_private_t *pv, int64_t start)
@@ -630,8 +764,22 @@ static void render_ssa_subs(hb_filter_private_t *pv, int64_t start)
     }
     else if (changed)
     {
-        // Re-use cached overlays, whenever possible
-        clear_ssa_rendered_sub_cache(pv);
+        // Keep the overlays of the previous frame,
+        // the boxes whose content did not change are reused
+        hb_ssa_box_vec_t prev = pv->ssa_boxes;
+        pv->ssa_boxes = pv->ssa_prev_boxes;
+        pv->ssa_prev_boxes = prev;
+        pv->ssa_boxes.count = 0;
+
+        hb_buffer_list_clear(&pv->rendered_sub_list);
+        for (int i = 0; i < prev.count; i++)
+        {
+            if (prev.boxes[i].sub)
+            {
+                prev.boxes[i].sub->next = NULL;
+            }
+        }
+        hb_box_vec_clear(&pv->boxes);
 
         // Find overlay size and pos of non overlapped boxes
         // (faster than composing at the video dimensions)
@@ -642,21 +790,67 @@ static void render_ssa_subs(hb_filter_private_t *pv, int64_t start)
                                frame->w + frame->dst_x, frame->h + frame->dst_y);
         }
 
-        for (int i = 0; i < pv->boxes.count; i++)
+        int compose_count = 0;
+        if (hb_ssa_box_vec_resize(&pv->ssa_boxes, pv->boxes.count) == 0)
+        {
+            for (int i = 0; i < pv->boxes.count; i++)
+            {
+                // Overlay must be aligned to the chroma plane, pad as needed.
+                hb_box_t box = pv->boxes.boxes[i];
+                hb_ssa_box_t *ssa_box = &pv->ssa_boxes.boxes[i];
+                ssa_box->x = box.x1 - ((box.x1 + pv->crop[2]) & ((1 << pv->wshift) - 1));
+                ssa_box->y = box.y1 - ((box.y1 + pv->crop[0]) & ((1 << pv->hshift) - 1));
+                ssa_box->width  = box.x2 - ssa_box->x;
+                ssa_box->height = box.y2 - ssa_box->y;
+                ssa_box->hash   = ssa_box_hash(frame_list, ssa_box->width, ssa_box->height,
+                                               ssa_box->x, ssa_box->y);
+                ssa_box->sub    = NULL;
+
+                for (int j = 0; j < prev.count; j++)
+                {
+                    hb_ssa_box_t *prev_box = &prev.boxes[j];
+                    if (prev_box->sub != NULL && prev_box->hash == ssa_box->hash &&
+                        prev_box->x == ssa_box->x && prev_box->y == ssa_box->y &&
+                        prev_box->width == ssa_box->width && prev_box->height == ssa_box->height)
+                    {
+                        ssa_box->sub  = prev_box->sub;
+                        prev_box->sub = NULL;
+                        break;
+                    }
+                }
+                compose_count += ssa_box->sub == NULL;
+            }
+            pv->ssa_boxes.count = pv->boxes.count;
+        }
+        else
+        {
+            hb_error("rendersub: realloc failed");
+        }
+        pv->ssa_hits   += pv->ssa_boxes.count - compose_count;
+        pv->ssa_misses += compose_count;
+
+        for (int i = 0; i < prev.count; i++)
+        {
+            hb_buffer_close(&prev.boxes[i].sub);
+        }
+        pv->ssa_prev_boxes.count = 0;
+
+        pv->ssa_frame_list = frame_list;
+        if (pv->ssa_threads > 1 && compose_count > 1)
+        {
+            taskset_cycle(&pv->ssa_taskset);
+        }
+        else
+        {
+            compose_ssa_boxes(pv, 0, 1);
+        }
+        pv->ssa_frame_list = NULL;
+
+        for (int i = 0; i < pv->ssa_boxes.count; i++)
         {
-            // Overlay must be aligned to the chroma plane, pad as needed.
-            hb_box_t box = pv->boxes.boxes[i];
-            int x = box.x1 - ((box.x1 + pv->crop[2]) & ((1 << pv->wshift) - 1));
-            int y = box.y1 - ((box.y1 + pv->crop[0]) & ((1 << pv->hshift) - 1));
-            int width  = box.x2 - x;
-            int height = box.y2 - y;
-
-            hb_buffer_t *sub = compose_subsample_ass(pv, frame_list, width, height, x, y);
-            if (sub)
+            if (pv->ssa_boxes.boxes[i].sub)
             {
-                sub->f.x += pv->crop[2];
-                sub->f.y += pv->crop[0];
-                hb_buffer_list_append(&pv->rendered_sub_list, sub);
+                hb_buffer_list_append(&pv->rendered_sub_list, pv->ssa_boxes.boxes[i].sub);
             }
         }
     }
@@ -779,6 +973,26 @@ static int ssa_post_init(hb_filter_object_t *filter, hb_job_t *job)
     ass_set_frame_size(pv->renderer, width, height);
     ass_set_storage_size(pv->renderer, width, height);
 
+    pv->ssa_threads = MIN(hb_get_cpu_count(), SSA_MAX_THREADS);
+    if (pv->ssa_threads > 1)
+    {
+        if (taskset_init(&pv->ssa_taskset, "rendersub_ssa_segment", pv->ssa_threads,
+                         sizeof(ssa_thread_arg_t), compose_ssa_work) == 0)
+        {
+            hb_error("rendersub: taskset_init failed");
+            pv->ssa_threads = 1;
+            return 1;
+        }
+        taskset_set_budget(&pv->ssa_taskset, job->filter_budget);
+        for (int i = 0; i < pv->ssa_threads; i++)
+        {
+            ssa_thread_arg_t *thread_args = taskset_thread_args(&pv->ssa_taskset, i);
+            thread_args->pv = pv;
+            thread_args->arg.taskset = &pv->ssa_taskset;
+            thread_args->arg.segment = i;
+        }
+    }
+
     return 0;
 }
 
@@ -804,6 +1018,19 @@ static void ssa_close(hb_filter_object_t *filter)
         ass_library_done(pv->ssa);
     }
     hb_box_vec_close(&pv->boxes);
+    free(pv->ssa_boxes.boxes);
+    free(pv->ssa_prev_boxes.boxes);
+
+    if (pv->ssa_hits + pv->ssa_misses)
+    {
+        hb_log("rendersub: %"PRIu64" overlays, %.1f%% reused from the previous frame",
+               pv->ssa_hits + pv->ssa_misses,
+               100. * pv->ssa_hits / (pv->ssa_hits + pv->ssa_misses));
+    }
+    if (pv->ssa_threads > 1)
+    {
+        taskset_fini(&pv->ssa_taskset);
+    }
 
     free(pv);
     filter->private_data = NULL;
@@ -20,6 +20,7 @@ hb_filter_object_t hb_filter_rotate =
     .id                = HB_FILTER_ROTATE,
     .enforce_order     = 1,
     .skip              = 1,
+    .fuse              = 1,
     .name              = "Rotate",
     .settings          = NULL,
     .init              = rotate_init,
@@ -63,6 +63,7 @@ hb_filter_object_t hb_filter_rpu =
 {
     .id                = HB_FILTER_RPU,
     .enforce_order     = 1,
+    .fuse              = 1,
     .name              = "RPU converter",
     .settings          = NULL,
     .init              = rpu_init,
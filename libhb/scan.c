@@ -38,14 +38,48 @@ typedef struct
     hb_list_t    * exclude_extensions;
 
     int            hw_decode;
+
+    int            threads;
+    int            parallel;
     
 } hb_scan_t;
 
 #define PREVIEW_READ_THRESH (200)
 #define AUDIO_DECODE_ERROR_LIMIT (10)
+#define SCAN_MAX_THREADS (8)
+
+/*
+ * Titles that come from separate files (a batch directory or a list of
+ * paths) share no reader state, so they are probed and their previews
+ * decoded by up to hb_scan_t.threads threads.  Jobs are handed out in
+ * source order and each one writes to its own result slot; the scan
+ * thread merges the slots afterwards so that the title set does not
+ * depend on which thread finished first.
+ */
+typedef void scan_job_f( hb_scan_t * data, int index, void * results );
+
+typedef struct
+{
+    hb_scan_t  * data;
+    scan_job_f * job;
+    void       * results;
+    void      (* progress)( hb_scan_t * data, int title );
+    hb_lock_t  * lock;
+    int          count;
+    int          next;
+    int          done;
+} scan_jobs_t;
 
 static void ScanFunc( void * );
-static int  DecodePreviews( hb_scan_t *, hb_title_t * title, int flush );
+static void RunScanJobs( hb_scan_t * data, int count, scan_job_f * job,
+                         void * results,
+                         void (* progress)( hb_scan_t *, int ) );
+static int  ProbeTitles( hb_scan_t * data, int count );
+static void ProbeTitleJob( hb_scan_t * data, int index, void * results );
+static void DecodeTitleJob( hb_scan_t * data, int index, void * results );
+static int  ScanPreviews( hb_scan_t * data, hb_title_t * title, int * hw_decode );
+static int  DecodePreviews( hb_scan_t *, hb_title_t * title, int flush,
+                            int hw_decode );
 static hb_audio_t * find_audio_for_id(hb_title_t * title, int id);
 static void LookForAudio(hb_scan_t *scan, hb_title_t *title, hb_audio_t * audio, hb_buffer_t *b);
 static int  AllAudioOK( hb_title_t * title );
@@ -53,7 +87,7 @@ static void UpdateState1(hb_scan_t *scan, int title);
 static void UpdateState2(hb_scan_t *scan, int title);
 static void UpdateState3(hb_scan_t *scan, int preview);
 
-static const char *aspect_to_string(hb_rational_t *dar)
+static const char *aspect_to_string(hb_rational_t *dar, char *arstr, size_t size)
 {
     double aspect = (double)dar->num / dar->den;
     switch ( (int)(aspect * 9.) )
@@ -61,11 +95,10 @@ static const char *aspect_to_string(hb_rational_t *dar)
         case 9 * 4 / 3:    return "4:3";
         case 9 * 16 / 9:   return "16:9";
     }
-    static char arstr[32];
     if (aspect >= 1)
-        snprintf(arstr, sizeof(arstr), "%.2f:1", aspect);
+        snprintf(arstr, size, "%.2f:1", aspect);
     else
-        snprintf(arstr, sizeof(arstr), "1:%.2f", 1. / aspect );
+        snprintf(arstr, size, "1:%.2f", 1. / aspect );
     return arstr;
 }
 
@@ -112,6 +145,12 @@ hb_thread_t * hb_scan_init( hb_handle_t * handle, volatile int * die,
     data->exclude_extensions    = hb_string_list_copy(exclude_extensions);
     data->hw_decode             = hw_decode;
     data->keep_duplicate_titles = keep_duplicate_titles;
+
+    data->threads = hb_get_scan_threads(handle);
+    if (data->threads <= 0)
+    {
+        data->threads = MIN(hb_get_cpu_count(), SCAN_MAX_THREADS);
+    }
     
     // Initialize scan state
     hb_state_t state;
@@ -133,7 +172,7 @@ static void ScanFunc( void * _data )
 {
     hb_scan_t  * data = (hb_scan_t *) _data;
     hb_title_t * title;
-    int          i;
+    int          i, t;
     int          feature = 0;
 
     data->bd = NULL;
@@ -211,21 +250,9 @@ static void ScanFunc( void * _data )
         else
         {
             /* Scan all titles */
-            for( i = 0; i < hb_batch_title_count( data->batch ); i++ )
+            if (ProbeTitles(data, hb_batch_title_count(data->batch)))
             {
-                if (*data->die)
-                {
-                    goto finish;
-                }
-
-                hb_title_t * title;
-
-                UpdateState1(data, i + 1);
-                title = hb_batch_title_scan(data->batch, i + 1);
-                if ( title != NULL )
-                {
-                    hb_list_add( data->title_set->list_title, title );
-                }
+                goto finish;
             }
         }
     }
@@ -257,59 +284,47 @@ static void ScanFunc( void * _data )
     else // We have many file paths to process.
     {
         // If dragging a batch of files, maybe not, but if the UI's implement a recursive folder maybe?
-        for (i = 0; i < hb_list_count( data->paths ); i++)
+        if (ProbeTitles(data, hb_list_count(data->paths)))
         {
-            if (*data->die)
-            {
-                goto finish;
-            }
-
-            char *path = hb_list_item(data->paths, i);
-
-            UpdateState1(data, i + 1);
-
-            if (hb_is_valid_batch_path(path))
-            {
-                title = hb_batch_title_scan_single(data->h, path, (int)i + 1);
-                if (title != NULL)
-                {
-                    hb_list_add(data->title_set->list_title, title);
-                }
-            }
+            goto finish;
         }
     }
 
-    for( i = 0; i < hb_list_count( data->title_set->list_title ); )
+    // Titles read from a disc share its reader, only files can be
+    // decoded concurrently
+    int   title_count    = hb_list_count( data->title_set->list_title );
+    int * title_previews = NULL;
+    if (data->bd == NULL && data->dvd == NULL &&
+        data->threads > 1 && title_count > 1)
+    {
+        title_previews = calloc(title_count, sizeof(int));
+        RunScanJobs(data, title_count, DecodeTitleJob, title_previews,
+                    UpdateState2);
+    }
+
+    for( i = 0, t = 0; i < hb_list_count( data->title_set->list_title ); t++ )
     {
         int j, npreviews;
         hb_audio_t * audio;
 
         if ( *data->die )
         {
+            free(title_previews);
             goto finish;
         }
         title = hb_list_item( data->title_set->list_title, i );
 
-        UpdateState2(data, i + 1);
-
-        /* Decode previews */
-        /* this will also detect more AC3 / DTS information */
-        npreviews = DecodePreviews( data, title, 1 );
-        if (npreviews == 0 && data->hw_decode)
+        if (title_previews != NULL)
         {
-            // Try without the hardware decoder
-            // Some hwaccel implementations don't automatically
-            // fall back to the software encoder
-            data->hw_decode = 0;
-            npreviews = DecodePreviews( data, title, 1 );
+            npreviews = title_previews[t];
         }
-        if (npreviews < 2)
+        else
         {
-            // Try harder to get some valid frames
-            // Allow libav to return "corrupt" frames
-            hb_log("scan: Too few previews (%d), trying harder", npreviews);
-            title->flags |= HBTF_NO_IDR;
-            npreviews = DecodePreviews( data, title, 0 );
+            UpdateState2(data, i + 1);
+
+            /* Decode previews */
+            /* this will also detect more AC3 / DTS information */
+            npreviews = ScanPreviews( data, title, &data->hw_decode );
         }
         if (npreviews == 0)
         {
@@ -369,6 +384,7 @@ static void ScanFunc( void * _data )
         }
         i++;
     }
+    free(title_previews);
 
     data->title_set->feature = feature;
 
@@ -437,6 +453,175 @@ finish:
     hb_buffer_pool_free();
 }
 
+static void ScanJobThread( void * _jobs )
+{
+    scan_jobs_t * jobs = _jobs;
+    int           index;
+
+    for (;;)
+    {
+        hb_lock(jobs->lock);
+        index = jobs->next++;
+        hb_unlock(jobs->lock);
+
+        if (index >= jobs->count || *jobs->data->die)
+        {
+            break;
+        }
+        jobs->job(jobs->data, index, jobs->results);
+
+        hb_lock(jobs->lock);
+        jobs->progress(jobs->data, ++jobs->done);
+        hb_unlock(jobs->lock);
+    }
+}
+
+/***********************************************************************
+ * RunScanJobs
+ ***********************************************************************
+ * Runs job for indices 0 to count - 1 on up to data->threads threads,
+ * the scan thread being one of them.  progress is called with the
+ * number of finished jobs.
+ **********************************************************************/
+static void RunScanJobs( hb_scan_t * data, int count, scan_job_f * job,
+                         void * results,
+                         void (* progress)( hb_scan_t *, int ) )
+{
+    hb_thread_t * threads[SCAN_MAX_THREADS];
+    scan_jobs_t   jobs = { 0 };
+    int           ii, thread_count;
+
+    jobs.data     = data;
+    jobs.job      = job;
+    jobs.results  = results;
+    jobs.progress = progress;
+    jobs.lock     = hb_lock_init();
+    jobs.count    = count;
+
+    thread_count = MIN(MIN(data->threads, SCAN_MAX_THREADS), count);
+    hb_log("scan: scanning %d titles with %d threads", count, thread_count);
+
+    // Per preview progress would be meaningless with several titles
+    // in flight, UpdateState3 is skipped until the jobs are done
+    data->parallel = 1;
+    for (ii = 0; ii < thread_count - 1; ii++)
+    {
+        threads[ii] = hb_thread_init("scan worker", ScanJobThread, &jobs,
+                                     HB_NORMAL_PRIORITY);
+    }
+    ScanJobThread(&jobs);
+    for (ii = 0; ii < thread_count - 1; ii++)
+    {
+        hb_thread_close(&threads[ii]);
+    }
+    data->parallel = 0;
+
+    hb_lock_close(&jobs.lock);
+}
+
+static void ProbeTitleJob( hb_scan_t * data, int index, void * results )
+{
+    hb_title_t ** titles = results;
+
+    if (data->batch)
+    {
+        titles[index] = hb_batch_title_scan(data->batch, index + 1);
+    }
+    else
+    {
+        char *path = hb_list_item(data->paths, index);
+        if (hb_is_valid_batch_path(path))
+        {
+            titles[index] = hb_batch_title_scan_single(data->h, path, index + 1);
+        }
+    }
+}
+
+/***********************************************************************
+ * ProbeTitles
+ ***********************************************************************
+ * Opens the count files of a batch directory or of the path list and
+ * adds their titles to the title set in file order.  Returns 1 if the
+ * scan was cancelled.
+ **********************************************************************/
+static int ProbeTitles( hb_scan_t * data, int count )
+{
+    hb_title_t ** titles;
+    int           ii;
+
+    if (count <= 0)
+    {
+        return 0;
+    }
+    titles = calloc(count, sizeof(hb_title_t *));
+
+    if (data->threads > 1 && count > 1)
+    {
+        RunScanJobs(data, count, ProbeTitleJob, titles, UpdateState1);
+    }
+    else
+    {
+        for (ii = 0; ii < count && !*data->die; ii++)
+        {
+            UpdateState1(data, ii + 1);
+            ProbeTitleJob(data, ii, titles);
+        }
+    }
+
+    for (ii = 0; ii < count; ii++)
+    {
+        if (titles[ii] != NULL)
+        {
+            hb_list_add(data->title_set->list_title, titles[ii]);
+        }
+    }
+    free(titles);
+
+    return *data->die != 0;
+}
+
+static void DecodeTitleJob( hb_scan_t * data, int index, void * results )
+{
+    int        * title_previews = results;
+    hb_title_t * title = hb_list_item(data->title_set->list_title, index);
+
+    // The hardware decoder fallback only applies to this title
+    int hw_decode = data->hw_decode;
+    title_previews[index] = ScanPreviews(data, title, &hw_decode);
+}
+
+/***********************************************************************
+ * ScanPreviews
+ ***********************************************************************
+ * Decodes the previews of title, retrying without the hardware decoder
+ * (clearing *hw_decode) and then accepting corrupt frames if too few
+ * previews could be decoded.  Returns the number of previews.
+ **********************************************************************/
+static int ScanPreviews( hb_scan_t * data, hb_title_t * title, int * hw_decode )
+{
+    int npreviews;
+
+    /* this will also detect more AC3 / DTS information */
+    npreviews = DecodePreviews( data, title, 1, *hw_decode );
+    if (npreviews == 0 && *hw_decode)
+    {
+        // Try without the hardware decoder
+        // Some hwaccel implementations don't automatically
+        // fall back to the software encoder
+        *hw_decode = 0;
+        npreviews = DecodePreviews( data, title, 1, *hw_decode );
+    }
+    if (npreviews < 2)
+    {
+        // Try harder to get some valid frames
+        // Allow libav to return "corrupt" frames
+        hb_log("scan: Too few previews (%d), trying harder", npreviews);
+        title->flags |= HBTF_NO_IDR;
+        npreviews = DecodePreviews( data, title, 0, *hw_decode );
+    }
+    return npreviews;
+}
+
 // -----------------------------------------------
 // stuff related to cropping
 
@@ -641,120 +826,210 @@ static hb_buffer_t * read_buf(hb_scan_t * data, hb_stream_t * stream)
     return NULL;
 }
 
-/***********************************************************************
- * DecodePreviews
- ***********************************************************************
- * Decode 10 pictures for the given title.
- * It assumes that data->reader and data->vts have successfully been
- * DVDOpen()ed and ifoOpen()ed.
- **********************************************************************/
-static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
-{
-    int                i, npreviews = 0, abort = 0;
-    hb_buffer_t      * buf, * buf_es;
-    hb_buffer_list_t   list_es;
-    int                progressive_count = 0;
-    int                pulldown_count = 0;
-    int                doubled_frame_count = 0;
-    int                interlaced_preview_count = 0;
-    int                vid_samples = 0;
-    int                frame_wait = 0;
-    int                cc_wait = 10;
-    int                frames;
-    hb_stream_t      * stream = NULL;
-    info_list_t      * info_list;
-    int                abort_audio = 0;
+/*
+ * The previews of a title read from a file are decoded in segments of
+ * consecutive previews, each with its own stream and decoder, on up to
+ * hb_scan_t.threads threads.  The first segment decodes into the title
+ * itself and is the only one that looks for audio and closed captions,
+ * as the first previews of a sequential scan would.  The others decode
+ * into a private copy of the title without audio or subtitles, since
+ * opening a stream and decoding write to the title, and the metadata
+ * they find is merged back by preview_segment_close().
+ *
+ * Each preview writes its frame info and crop to its own result slot,
+ * DecodePreviews() feeds them to remember_info() and record_crop() in
+ * preview order so the outcome matches a sequential decode.
+ */
+#define PREVIEW_SEGMENT_MIN (3)
 
-    info_list = calloc(data->preview_count+1, sizeof(*info_list));
-    crop_record_t *crops = crop_record_init( data->preview_count );
+typedef struct
+{
+    int            decoded;
+    int            has_crop;
+    int            crop[4];
+    hb_work_info_t info;
+} preview_result_t;
 
-    hb_buffer_list_clear(&list_es);
+typedef struct
+{
+    hb_scan_t        * data;
+    hb_title_t       * title;
+    hb_title_t         title_copy;
+    hb_stream_t      * stream;
+    hb_work_object_t * vid_decoder;
+    void             * hw_device_ctx;
+    int                first;
+    int                last;
+    int                flush;
+    int                cc_wait;
+    int                abort_audio;
+
+    hb_lock_t        * progress_lock;
+    int              * previews_started;
+    preview_result_t * results;
+
+    int                npreviews;
+    int                abort;
+    int                progressive_count;
+    int                pulldown_count;
+    int                doubled_frame_count;
+    int                interlaced_preview_count;
+    int                vid_samples;
+} preview_segment_t;
+
+static hb_work_object_t * preview_decoder_init( hb_scan_t * data,
+                                                hb_title_t * title,
+                                                int hw_decode,
+                                                void ** hw_device_ctx )
+{
+    hb_hwaccel_t *hwaccel = hb_get_hwaccel(hw_decode);
 
-    if( data->batch )
-    {
-        hb_log( "scan: decoding previews for title %d (%s)", title->index, title->path );
-    }
-    else
+    if (hwaccel &&
+        hwaccel->caps & HB_HWACCEL_CAP_SCAN &&
+        hb_hwaccel_is_available(hwaccel, title->video_codec_param))
     {
-        hb_log( "scan: decoding previews for title %d", title->index );
+        hb_hwaccel_hw_device_ctx_init(hwaccel->type, -1, hw_device_ctx);
     }
 
-    if (data->bd)
+    hb_work_object_t *vid_decoder = hb_get_work(data->h, title->video_codec);
+    vid_decoder->codec_param = title->video_codec_param;
+    vid_decoder->hw_device_ctx = *hw_device_ctx;
+    vid_decoder->hw_accel = hwaccel;
+    vid_decoder->title = title;
+
+    if (vid_decoder->init(vid_decoder, NULL))
     {
-        hb_bd_start( data->bd, title );
-        hb_log( "scan: title angle(s) %d", title->angle_count );
+        free( vid_decoder );
+        hb_hwaccel_hw_device_ctx_close(hw_device_ctx);
+        return NULL;
     }
-    else if (data->dvd)
+    return vid_decoder;
+}
+
+// Opens the stream and the decoder of a helper segment
+static int preview_segment_init( preview_segment_t * seg, hb_title_t * title )
+{
+    hb_title_t * copy = &seg->title_copy;
+
+    *copy = *title;
+    copy->list_audio    = hb_list_init();
+    copy->list_subtitle = hb_list_init();
+    copy->opaque_priv   = NULL;
+    copy->initial_rpu   = NULL;
+    copy->hdr_10_plus   = 0;
+    memset(&copy->mastering, 0, sizeof(copy->mastering));
+    memset(&copy->coll,      0, sizeof(copy->coll));
+    memset(&copy->ambient,   0, sizeof(copy->ambient));
+    seg->title = copy;
+
+    seg->stream = hb_stream_open(seg->data->h, title->path, copy, 0);
+    if (seg->stream == NULL)
     {
-        hb_dvd_start( data->dvd, title, 1 );
-        title->angle_count = hb_dvd_angle_count( data->dvd );
-        hb_log( "scan: title angle(s) %d", title->angle_count );
+        return -1;
     }
-    else // data->batch or a single file
+    // Hardware decoding is not split, helpers always decode in software
+    seg->vid_decoder = preview_decoder_init(seg->data, copy, 0,
+                                            &seg->hw_device_ctx);
+    if (seg->vid_decoder == NULL)
     {
-        stream = hb_stream_open(data->h, title->path, title, 0);
+        return -1;
     }
+    return 0;
+}
 
-    if (data->bd == NULL && data->dvd == NULL && stream == NULL)
+// Closes the stream and decoder of a segment and merges the metadata
+// found by a helper segment into title
+static void preview_segment_close( preview_segment_t * seg, hb_title_t * title )
+{
+    hb_subtitle_t * subtitle;
+
+    if (seg->vid_decoder != NULL)
     {
-        hb_error("Can't open stream!");
-        free(info_list);
-        crop_record_free(crops);
-        hb_stream_close(&stream);
-        return 0;
+        seg->vid_decoder->close( seg->vid_decoder );
+        free( seg->vid_decoder );
     }
+    hb_hwaccel_hw_device_ctx_close(&seg->hw_device_ctx);
+    hb_stream_close(&seg->stream);
 
-    if (title->video_codec == WORK_NONE)
+    if (seg->title != &seg->title_copy)
     {
-        hb_error("No video decoder set!");
-        free(info_list);
-        crop_record_free(crops);
-        hb_stream_close(&stream);
-        return 0;
+        return;
     }
 
-    void *hw_device_ctx = NULL;
-    hb_hwaccel_t *hwaccel = hb_get_hwaccel(data->hw_decode);
+    hb_title_t * copy = &seg->title_copy;
 
-    if (hwaccel &&
-        hwaccel->caps & HB_HWACCEL_CAP_SCAN &&
-        hb_hwaccel_is_available(hwaccel, title->video_codec_param))
+    // Helpers decode later previews than the first segment, so they
+    // update what the decoder overwrites on every frame, and only fill
+    // in what it keeps from the first frame
+    if (copy->mastering.has_primaries || copy->mastering.has_luminance)
     {
-        hb_hwaccel_hw_device_ctx_init(hwaccel->type, -1, &hw_device_ctx);
+        title->mastering = copy->mastering;
     }
+    if (copy->coll.max_cll || copy->coll.max_fall)
+    {
+        title->coll = copy->coll;
+    }
+    title->hdr_10_plus |= copy->hdr_10_plus;
+    if (title->ambient.ambient_illuminance.num == 0 &&
+        title->ambient.ambient_illuminance.den == 0)
+    {
+        title->ambient = copy->ambient;
+    }
+    if (title->initial_rpu == NULL && copy->initial_rpu != NULL)
+    {
+        title->initial_rpu      = copy->initial_rpu;
+        title->initial_rpu_type = copy->initial_rpu_type;
+        copy->initial_rpu       = NULL;
+    }
+    hb_data_close(&copy->initial_rpu);
 
-    hb_work_object_t *vid_decoder = hb_get_work(data->h, title->video_codec);
-    vid_decoder->codec_param = title->video_codec_param;
-    vid_decoder->hw_device_ctx = hw_device_ctx;
-    vid_decoder->hw_accel = hwaccel;
-    vid_decoder->title = title;
-
-    if (vid_decoder->init(vid_decoder, NULL))
+    // Closed captions are detected by the first segment
+    while ((subtitle = hb_list_item(copy->list_subtitle, 0)) != NULL)
     {
-        hb_error("Decoder init failed!");
-        free(info_list);
-        crop_record_free(crops);
-        free( vid_decoder );
-        hb_stream_close(&stream);
-        hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
-        return 0;
+        hb_list_rem(copy->list_subtitle, subtitle);
+        hb_subtitle_close(&subtitle);
     }
+    hb_list_close(&copy->list_subtitle);
+    hb_list_close(&copy->list_audio);
+}
 
-    for( i = 0; i < data->preview_count; i++ )
+static void preview_progress( preview_segment_t * seg )
+{
+    hb_lock(seg->progress_lock);
+    UpdateState3(seg->data, ++*seg->previews_started);
+    hb_unlock(seg->progress_lock);
+}
+
+/***********************************************************************
+ * DecodePreviewSegment
+ ***********************************************************************
+ * Decodes previews first to last - 1 of a segment.
+ **********************************************************************/
+static void DecodePreviewSegment( void * _seg )
+{
+    preview_segment_t * seg         = _seg;
+    hb_scan_t         * data        = seg->data;
+    hb_title_t        * title       = seg->title;
+    hb_stream_t       * stream      = seg->stream;
+    hb_work_object_t  * vid_decoder = seg->vid_decoder;
+    int                 i;
+    hb_buffer_t       * buf, * buf_es;
+    hb_buffer_list_t    list_es;
+    int                 frame_wait = 0;
+    int                 frames;
+
+    hb_buffer_list_clear(&list_es);
+
+    for( i = seg->first; i < seg->last; i++ )
     {
+        preview_result_t * result = &seg->results[i];
         int j;
 
-        UpdateState3(data, i + 1);
+        preview_progress(seg);
 
         if ( *data->die )
         {
-            free( info_list );
-            crop_record_free( crops );
-            vid_decoder->close( vid_decoder );
-            free( vid_decoder );
-            hb_stream_close(&stream);
-            hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
-            return 0;
+            break;
         }
         if (data->bd)
         {
@@ -794,11 +1069,11 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
 
         hb_deep_log( 2, "scan: preview %d", i + 1 );
 
-        if (flush && vid_decoder->flush)
+        if (seg->flush && vid_decoder->flush)
             vid_decoder->flush( vid_decoder );
         if (title->flags & HBTF_NO_IDR)
         {
-            if (!flush)
+            if (!seg->flush)
             {
                 // If we are doing the first previews decode attempt,
                 // set this threshold high so that we get the best
@@ -833,7 +1108,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
             {
                 // If we reach EOF and no audio, don't continue looking for
                 // audio
-                abort_audio = 1;
+                seg->abort_audio = 1;
                 if (vid_buf != NULL || last_vid_buf != NULL)
                 {
                     break;
@@ -843,7 +1118,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
 
                 // If we reach EOF and no video, don't continue looking for
                 // video
-                abort = 1;
+                seg->abort = 1;
                 goto skip_preview;
             }
 
@@ -870,7 +1145,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
                     // 2. Some frames do not contain CC data, even though
                     //    CCs are present in the stream.  So we need to decode
                     //    additional frames to find the CCs.
-                    if (vid_buf != NULL && (frame_wait || cc_wait))
+                    if (vid_buf != NULL && (frame_wait || seg->cc_wait))
                     {
                         hb_work_info_t vid_info;
                         if (vid_decoder->info(vid_decoder, &vid_info))
@@ -879,7 +1154,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
                                 (vid_buf->s.flags & PIC_FLAG_REPEAT_FIRST_FIELD))
                             {
                                 /* Potentially soft telecine material */
-                                pulldown_count++;
+                                seg->pulldown_count++;
                             }
 
                             if (vid_buf->s.flags & PIC_FLAG_REPEAT_FRAME)
@@ -887,7 +1162,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
                                 // AVCHD-Lite specifies that all streams are
                                 // 50 or 60 fps.  To produce 25 or 30 fps, camera
                                 // makers are repeating all frames.
-                                doubled_frame_count++;
+                                seg->doubled_frame_count++;
                             }
 
                             if (is_close_to(vid_info.rate.den, 1126125, 100 ))
@@ -897,25 +1172,25 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
                                 // how many are reporting at that speed. When
                                 // enough show up that way, we want to make
                                 // that the overall title FPS.
-                                progressive_count++;
+                                seg->progressive_count++;
                             }
-                            vid_samples++;
+                            seg->vid_samples++;
                         }
 
                         if (frames > 0 && vid_buf->s.frametype == HB_FRAME_I)
                             frame_wait = 0;
-                        if (frame_wait || cc_wait)
+                        if (frame_wait || seg->cc_wait)
                         {
                             hb_buffer_close(&last_vid_buf);
                             last_vid_buf = vid_buf;
                             vid_buf = NULL;
                             if (frame_wait) frame_wait--;
-                            if (cc_wait) cc_wait--;
+                            if (seg->cc_wait) seg->cc_wait--;
                         }
                         frames++;
                     }
                 }
-                else if (!AllAudioOK(title) && !abort_audio)
+                else if (!AllAudioOK(title) && !seg->abort_audio)
                 {
                     hb_audio_t * audio = find_audio_for_id(title, buf_es->s.id);
                     if (audio != NULL && audio->priv.scan_error_count < AUDIO_DECODE_ERROR_LIMIT)
@@ -928,7 +1203,7 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
                     hb_buffer_close( &buf_es );
             }
 
-            if (vid_buf && (abort_audio || AllAudioOK(title)))
+            if (vid_buf && (seg->abort_audio || AllAudioOK(title)))
                 break;
         }
         hb_buffer_list_close(&list_es);
@@ -967,13 +1242,13 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
             hb_buffer_close( &vid_buf );
             continue;
         }
-        remember_info( info_list, &vid_info );
+        result->info = vid_info;
 
         /* Check preview for interlacing artifacts */
         if( hb_detect_comb( vid_buf, 10, 30, 9, 10, 30, 9 ) )
         {
             hb_deep_log( 2, "Interlacing detected in preview frame %i", i+1);
-            interlaced_preview_count++;
+            seg->interlaced_preview_count++;
         }
 
         if( data->store_previews )
@@ -1048,9 +1323,14 @@ static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush )
         // like titles, credits & fade-thru-black transitions.
         if ( top < h4 && bottom < h4 && left < w4 && right < w4 )
         {
-            record_crop( crops, top, bottom, left, right );
+            result->has_crop = 1;
+            result->crop[0]  = top;
+            result->crop[1]  = bottom;
+            result->crop[2]  = left;
+            result->crop[3]  = right;
         }
-        ++npreviews;
+        result->decoded = 1;
+        seg->npreviews++;
 
 skip_preview:
         /* Make sure we found audio rates and bitrates */
@@ -1066,23 +1346,213 @@ skip_preview:
         {
             hb_buffer_close( &vid_buf );
         }
-        if (abort)
+        if (seg->abort)
         {
             break;
         }
     }
-    UpdateState3(data, i);
+    hb_buffer_list_close(&list_es);
+}
+
+/***********************************************************************
+ * DecodePreviews
+ ***********************************************************************
+ * Decode 10 pictures for the given title.
+ * It assumes that data->reader and data->vts have successfully been
+ * DVDOpen()ed and ifoOpen()ed.
+ **********************************************************************/
+static int DecodePreviews( hb_scan_t * data, hb_title_t * title, int flush,
+                           int hw_decode )
+{
+    int                i, npreviews = 0;
+    int                progressive_count = 0;
+    int                pulldown_count = 0;
+    int                doubled_frame_count = 0;
+    int                interlaced_preview_count = 0;
+    int                vid_samples = 0;
+    hb_stream_t      * stream = NULL;
+    info_list_t      * info_list;
+    preview_segment_t  segments[SCAN_MAX_THREADS];
+    hb_thread_t      * threads[SCAN_MAX_THREADS];
+    preview_result_t * results;
+    hb_lock_t        * progress_lock;
+    int                previews_started = 0;
+    int                segment_count, s;
+
+    info_list = calloc(data->preview_count+1, sizeof(*info_list));
+    crop_record_t *crops = crop_record_init( data->preview_count );
+
+    if( data->batch )
+    {
+        hb_log( "scan: decoding previews for title %d (%s)", title->index, title->path );
+    }
+    else
+    {
+        hb_log( "scan: decoding previews for title %d", title->index );
+    }
+
+    if (data->bd)
+    {
+        hb_bd_start( data->bd, title );
+        hb_log( "scan: title angle(s) %d", title->angle_count );
+    }
+    else if (data->dvd)
+    {
+        hb_dvd_start( data->dvd, title, 1 );
+        title->angle_count = hb_dvd_angle_count( data->dvd );
+        hb_log( "scan: title angle(s) %d", title->angle_count );
+    }
+    else // data->batch or a single file
+    {
+        stream = hb_stream_open(data->h, title->path, title, 0);
+    }
 
-    vid_decoder->close( vid_decoder );
-    free( vid_decoder );
+    if (data->bd == NULL && data->dvd == NULL && stream == NULL)
+    {
+        hb_error("Can't open stream!");
+        free(info_list);
+        crop_record_free(crops);
+        hb_stream_close(&stream);
+        return 0;
+    }
 
-    hb_hwaccel_hw_device_ctx_close(&hw_device_ctx);
+    if (title->video_codec == WORK_NONE)
+    {
+        hb_error("No video decoder set!");
+        free(info_list);
+        crop_record_free(crops);
+        hb_stream_close(&stream);
+        return 0;
+    }
 
-    if (stream != NULL)
+    void *hw_device_ctx = NULL;
+    hb_work_object_t *vid_decoder = preview_decoder_init(data, title, hw_decode,
+                                                         &hw_device_ctx);
+    if (vid_decoder == NULL)
     {
+        hb_error("Decoder init failed!");
+        free(info_list);
+        crop_record_free(crops);
         hb_stream_close(&stream);
+        return 0;
     }
 
+    // Discs share a single reader, and titles that are already scanned
+    // concurrently or decoded in hardware are not split further
+    segment_count = 1;
+    if (stream != NULL && hw_device_ctx == NULL && !data->parallel)
+    {
+        segment_count = MIN(MIN(data->threads, SCAN_MAX_THREADS),
+                            data->preview_count / PREVIEW_SEGMENT_MIN);
+        segment_count = MAX(segment_count, 1);
+    }
+
+    results       = calloc(data->preview_count, sizeof(preview_result_t));
+    progress_lock = hb_lock_init();
+    memset(segments, 0, sizeof(segments));
+    for (s = 0; s < segment_count; s++)
+    {
+        preview_segment_t * seg = &segments[s];
+
+        seg->data             = data;
+        seg->first            = s * data->preview_count / segment_count;
+        seg->last             = (s + 1) * data->preview_count / segment_count;
+        seg->flush            = flush;
+        seg->progress_lock    = progress_lock;
+        seg->previews_started = &previews_started;
+        seg->results          = results;
+        if (s == 0)
+        {
+            seg->title         = title;
+            seg->stream        = stream;
+            seg->vid_decoder   = vid_decoder;
+            seg->hw_device_ctx = hw_device_ctx;
+            seg->cc_wait       = 10;
+        }
+        else
+        {
+            seg->abort_audio = 1;
+            if (preview_segment_init(seg, title))
+            {
+                hb_log("scan: could not open a second stream, decoding "
+                       "previews sequentially");
+                for (; s > 0; s--)
+                {
+                    preview_segment_close(&segments[s], title);
+                    memset(&segments[s], 0, sizeof(segments[s]));
+                }
+                segments[0].last = data->preview_count;
+                segment_count = 1;
+                break;
+            }
+        }
+    }
+    if (segment_count > 1)
+    {
+        hb_log("scan: decoding %d previews in %d segments",
+               data->preview_count, segment_count);
+    }
+
+    for (s = 1; s < segment_count; s++)
+    {
+        threads[s] = hb_thread_init("scan previews", DecodePreviewSegment,
+                                    &segments[s], HB_NORMAL_PRIORITY);
+    }
+    DecodePreviewSegment(&segments[0]);
+    for (s = 1; s < segment_count; s++)
+    {
+        hb_thread_close(&threads[s]);
+    }
+    UpdateState3(data, previews_started);
+    hb_lock_close(&progress_lock);
+
+    for (s = 0; s < segment_count; s++)
+    {
+        preview_segment_close(&segments[s], title);
+    }
+
+    if ( *data->die )
+    {
+        free( results );
+        free( info_list );
+        crop_record_free( crops );
+        return 0;
+    }
+
+    // Merge in preview order, up to the first segment that reached the
+    // end of the stream
+    for (s = 0; s < segment_count; s++)
+    {
+        preview_segment_t * seg = &segments[s];
+
+        for (i = seg->first; i < seg->last; i++)
+        {
+            preview_result_t * result = &results[i];
+
+            if (!result->decoded)
+            {
+                continue;
+            }
+            remember_info( info_list, &result->info );
+            if (result->has_crop)
+            {
+                record_crop( crops, result->crop[0], result->crop[1],
+                             result->crop[2], result->crop[3] );
+            }
+        }
+        npreviews                += seg->npreviews;
+        progressive_count        += seg->progressive_count;
+        pulldown_count           += seg->pulldown_count;
+        doubled_frame_count      += seg->doubled_frame_count;
+        interlaced_preview_count += seg->interlaced_preview_count;
+        vid_samples              += seg->vid_samples;
+        if (seg->abort)
+        {
+            break;
+        }
+    }
+    free( results );
+
     if ( npreviews )
     {
         // use the most common frame info for our final title dimensions
@@ -1337,12 +1807,13 @@ skip_preview:
             title->loose_crop[3] = EVEN( crops->r[i] );
         }
 
+        char aspect[32];
         hb_log( "scan: %d previews, %dx%d, %.3f fps, autocrop = %d/%d/%d/%d, "
                 "aspect %s, PAR %d:%d, color profile: %d-%d-%d, chroma location: %s",
                 npreviews, title->geometry.width, title->geometry.height,
                 (float)title->vrate.num / title->vrate.den,
                 title->crop[0], title->crop[1], title->crop[2], title->crop[3],
-                aspect_to_string(&title->dar),
+                aspect_to_string(&title->dar, aspect, sizeof(aspect)),
                 title->geometry.par.num, title->geometry.par.den,
                 title->color_prim, title->color_transfer, title->color_matrix,
                 av_chroma_location_name(title->chroma_location));
@@ -1415,8 +1886,6 @@ skip_preview:
     crop_record_free( crops );
     free( info_list );
 
-    hb_buffer_list_close(&list_es);
-
     if (data->bd)
       hb_bd_stop( data->bd );
     if (data->dvd)
@@ -1871,6 +2340,11 @@ static void UpdateState3(hb_scan_t *scan, int preview)
 {
     hb_state_t state;
 
+    if (scan->parallel)
+    {
+        return;
+    }
+
     hb_get_state2(scan->h, &state);
 #define p state.param.scanning
     p.preview_cur = preview;
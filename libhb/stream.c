@@ -10,6 +10,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <iconv.h>
 
 #include "handbrake/handbrake.h"
@@ -23,6 +24,14 @@
 #define HB_MAX_PROBE_SIZE (1*1024*1024)
 #define HB_MAX_PROBES     3
 
+// Transport and program streams are read in blocks that start small
+// after a seek and double with every sequential read up to the max
+#define STREAM_BLOCK_MIN  (64*1024)
+#define STREAM_BLOCK_MAX  (4*1024*1024)
+
+// Largest gap in a transport stream that sync is re-established across
+#define MAX_HOLE 208*80
+
 /*
  * This table defines how ISO MPEG stream type codes map to HandBrake
  * codecs. It is indexed by the 8 bit stream type and contains the codec
@@ -190,7 +199,6 @@ struct hb_stream_s
         int64_t last_timestamp; // used for discontinuity detection when
                                 // there are no PCRs
 
-        uint8_t *packet;        // buffer for one TS packet
         hb_ts_stream_t *list;
         int count;
         int alloc;
@@ -219,6 +227,20 @@ struct hb_stream_s
 
     char    *path;
     FILE    *file_handle;
+
+    // Block buffer in front of file_handle. data[0..size) holds the file
+    // bytes starting at 'offset' and the next byte read is data[pos].
+    // file_handle is always positioned at offset + size.
+    struct
+    {
+        uint8_t *data;
+        int      alloc;
+        int      size;
+        int      pos;
+        int      chunk;         // size of the next read from file_handle
+        off_t    offset;
+    } in;
+
     hb_stream_type_t hb_stream_type;
     hb_title_t *title;
 
@@ -292,6 +314,166 @@ static void hb_ps_resolve_stream_types(hb_stream_t *stream);
 void hb_ts_stream_reset(hb_stream_t *stream);
 void hb_ps_stream_reset(hb_stream_t *stream);
 
+/*
+ * Block buffered input for transport and program streams.
+ */
+
+// Hints that the file is read front to back so the kernel can read
+// ahead more aggressively. Scans seek around, so they are left alone.
+static void stream_advise_sequential( hb_stream_t *stream )
+{
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if ( !stream->scan && stream->file_handle != NULL )
+    {
+        posix_fadvise( fileno( stream->file_handle ), 0, 0,
+                       POSIX_FADV_SEQUENTIAL );
+    }
+#endif
+}
+
+// Asks the kernel to start reading the block that the next fill wants
+static void stream_advise_willneed( hb_stream_t *stream, off_t off, off_t len )
+{
+#if defined(POSIX_FADV_WILLNEED)
+    if ( !stream->scan && stream->file_handle != NULL )
+    {
+        posix_fadvise( fileno( stream->file_handle ), off, len,
+                       POSIX_FADV_WILLNEED );
+    }
+#endif
+}
+
+// Makes at least 'len' bytes available at stream->in.data + stream->in.pos
+// and returns the number available, which is less than 'len' only at
+// eof or on a read error.
+static int stream_fill( hb_stream_t *stream, int len )
+{
+    int avail = stream->in.size - stream->in.pos;
+
+    if ( avail >= len )
+    {
+        return avail;
+    }
+    if ( stream->in.data == NULL )
+    {
+        stream->in.alloc = STREAM_BLOCK_MAX + MAX_HOLE;
+        stream->in.data  = malloc( stream->in.alloc );
+        if ( stream->in.data == NULL )
+        {
+            return avail;
+        }
+    }
+    if ( stream->in.chunk < STREAM_BLOCK_MIN )
+    {
+        stream->in.chunk = STREAM_BLOCK_MIN;
+    }
+
+    // Move the unread tail to the front of the buffer
+    if ( stream->in.pos > 0 )
+    {
+        memmove( stream->in.data, stream->in.data + stream->in.pos, avail );
+        stream->in.offset += stream->in.pos;
+        stream->in.size    = avail;
+        stream->in.pos     = 0;
+    }
+
+    while ( avail < len )
+    {
+        size_t want = MAX( stream->in.chunk, len - avail );
+        size_t got;
+
+        want = MIN( want, stream->in.alloc - stream->in.size );
+        got  = fread( stream->in.data + stream->in.size, 1, want,
+                      stream->file_handle );
+        stream->in.size += got;
+        avail           += got;
+        if ( got < want )
+        {
+            break;
+        }
+    }
+    stream->in.chunk = MIN( stream->in.chunk * 2, STREAM_BLOCK_MAX );
+    stream_advise_willneed( stream, stream->in.offset + stream->in.size,
+                            stream->in.chunk );
+
+    return avail;
+}
+
+static inline int stream_getc( hb_stream_t *stream )
+{
+    if ( stream->in.pos >= stream->in.size && stream_fill( stream, 1 ) < 1 )
+    {
+        return EOF;
+    }
+    return stream->in.data[stream->in.pos++];
+}
+
+static size_t stream_read( hb_stream_t *stream, void *dst, size_t len )
+{
+    size_t avail = stream_fill( stream, MIN( len, STREAM_BLOCK_MAX ) );
+    size_t done  = 0;
+
+    while ( avail > 0 && done < len )
+    {
+        size_t n = MIN( avail, len - done );
+
+        memcpy( (uint8_t*)dst + done, stream->in.data + stream->in.pos, n );
+        stream->in.pos += n;
+        done           += n;
+        if ( done < len )
+        {
+            avail = stream_fill( stream, MIN( len - done, STREAM_BLOCK_MAX ) );
+        }
+    }
+    return done;
+}
+
+static off_t stream_tell( hb_stream_t *stream )
+{
+    return stream->in.offset + stream->in.pos;
+}
+
+static off_t stream_file_size( hb_stream_t *stream )
+{
+    off_t size;
+
+    fseeko( stream->file_handle, 0, SEEK_END );
+    size = ftello( stream->file_handle );
+    fseeko( stream->file_handle, stream->in.offset + stream->in.size, SEEK_SET );
+
+    return size;
+}
+
+// Seeks within the buffered block when possible, otherwise drops the
+// block and seeks the file. Returns 0 on success and -1 on failure.
+static int stream_seek( hb_stream_t *stream, off_t off, int whence )
+{
+    if ( whence == SEEK_CUR )
+    {
+        off += stream_tell( stream );
+    }
+    else if ( whence == SEEK_END )
+    {
+        off += stream_file_size( stream );
+    }
+
+    if ( off >= stream->in.offset && off <= stream->in.offset + stream->in.size )
+    {
+        stream->in.pos = off - stream->in.offset;
+        return 0;
+    }
+    if ( fseeko( stream->file_handle, off, SEEK_SET ) != 0 )
+    {
+        return -1;
+    }
+    stream->in.offset = off;
+    stream->in.size   = 0;
+    stream->in.pos    = 0;
+    stream->in.chunk  = STREAM_BLOCK_MIN;
+
+    return 0;
+}
+
 /*
  * logging routines.
  * these frontend hb_log because transport streams can have a lot of errors
@@ -554,7 +736,7 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
     uint8_t sc_buf[4];
     int pos = 0;
 
-    fseek(stream->file_handle, 0, SEEK_SET);
+    stream_seek(stream, 0, SEEK_SET);
 
     // program streams should start with a PACK then some other mpeg start
     // code (usually a SYS but that might be missing if we only have a clip).
@@ -562,7 +744,7 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
     {
         int offset;
 
-        if ( fread(buf, 1, sizeof(buf), stream->file_handle) != sizeof(buf) )
+        if ( stream_read(stream, buf, sizeof(buf)) != sizeof(buf) )
             return 0;
 
         for ( offset = 0; offset < 8*1024-27; ++offset )
@@ -592,23 +774,23 @@ static int hb_stream_check_for_ps(hb_stream_t *stream)
                 data_len = (b[4] << 8) + b[5];
                 if ( data_len && sid > 0xba && sid < 0xf9 )
                 {
-                    prev = ftell( stream->file_handle );
+                    prev = stream_tell( stream );
                     pos = prev - ( sizeof(buf) - offset );
                     pos += pes_offset + 6 + data_len;
-                    fseek( stream->file_handle, pos, SEEK_SET );
-                    if ( fread(sc_buf, 1, 4, stream->file_handle) != 4 )
+                    stream_seek( stream, pos, SEEK_SET );
+                    if ( stream_read(stream, sc_buf, 4) != 4 )
                         return 0;
                     if (sc_buf[0] == 0x00 && sc_buf[1] == 0x00 &&
                         sc_buf[2] == 0x01)
                     {
                         return 1;
                     }
-                    fseek( stream->file_handle, prev, SEEK_SET );
+                    stream_seek( stream, prev, SEEK_SET );
                 }
             }
         }
-        fseek( stream->file_handle, -27, SEEK_CUR );
-        pos = ftell( stream->file_handle );
+        stream_seek( stream, -27, SEEK_CUR );
+        pos = stream_tell( stream );
     }
     return 0;
 }
@@ -617,7 +799,7 @@ static int hb_stream_get_type(hb_stream_t *stream)
 {
     uint8_t buf[2048*4];
 
-    if ( fread(buf, 1, sizeof(buf), stream->file_handle) == sizeof(buf) )
+    if ( stream_read(stream, buf, sizeof(buf)) == sizeof(buf) )
     {
         int psize;
         if ( ( psize = hb_stream_check_for_ts(buf) ) != 0 )
@@ -651,14 +833,11 @@ static void hb_stream_delete_dynamic( hb_stream_t *d )
         fclose( d->file_handle );
         d->file_handle = NULL;
     }
+    free( d->in.data );
+    memset( &d->in, 0, sizeof( d->in ) );
 
     int i=0;
 
-    if ( d->ts.packet )
-    {
-        free( d->ts.packet );
-        d->ts.packet = NULL;
-    }
     if ( d->ts.list )
     {
         for (i = 0; i < d->ts.count; i++)
@@ -872,6 +1051,7 @@ hb_stream_open(hb_handle_t *h, const char *path, hb_title_t *title, int scan)
             if( !scan )
             {
                 prune_streams( d );
+                stream_advise_sequential( d );
             }
             // reset to beginning of file and reset some stream
             // state information
@@ -880,6 +1060,8 @@ hb_stream_open(hb_handle_t *h, const char *path, hb_title_t *title, int scan)
         }
         fclose( d->file_handle );
         d->file_handle = NULL;
+        free( d->in.data );
+        memset( &d->in, 0, sizeof( d->in ) );
         if ( ffmpeg_open( d, title, scan ) )
         {
             return d;
@@ -894,6 +1076,7 @@ hb_stream_open(hb_handle_t *h, const char *path, hb_title_t *title, int scan)
         free( d->path );
     }
     hb_log( "hb_stream_open: open %s failed", path );
+    free( d->in.data );
     free( d );
     return NULL;
 }
@@ -962,7 +1145,6 @@ hb_stream_t * hb_bd_stream_open( hb_handle_t *h, hb_title_t *title )
     d->file_handle = NULL;
     d->title = title;
     d->path = NULL;
-    d->ts.packet = NULL;
 
     int pid = title->video_id;
     int stream_type = title->video_stream_type;
@@ -1150,12 +1332,11 @@ hb_title_t * hb_stream_title_scan(hb_stream_t *stream, hb_title_t * title)
  */
 static const uint8_t *next_packet( hb_stream_t *stream )
 {
-    uint8_t *buf = stream->ts.packet + stream->packetsize - 188;
+    const uint8_t *buf;
 
     while ( 1 )
     {
-        if ( fread(stream->ts.packet, 1, stream->packetsize, stream->file_handle) !=
-             stream->packetsize )
+        if ( stream_fill(stream, stream->packetsize) < stream->packetsize )
         {
             int err;
             if ((err = ferror(stream->file_handle)) != 0)
@@ -1165,12 +1346,16 @@ static const uint8_t *next_packet( hb_stream_t *stream )
             }
             return NULL;
         }
+        // The packet is returned in place and stays valid until the
+        // next read from the stream
+        buf = stream->in.data + stream->in.pos + stream->packetsize - 188;
+        stream->in.pos += stream->packetsize;
         if (buf[0] == 0x47)
         {
             return buf;
         }
         // lost sync - back up to where we started then try to re-establish.
-        off_t pos = ftello(stream->file_handle) - stream->packetsize;
+        off_t pos = stream_tell(stream) - stream->packetsize;
         off_t pos2 = align_to_next_packet(stream);
         if ( pos2 == 0 )
         {
@@ -1191,21 +1376,19 @@ static void skip_to_next_pack( hb_stream_t *src_stream )
     uint32_t strt_code = -1;
     int c;
 
-    flockfile( src_stream->file_handle );
-    while ( ( c = getc_unlocked( src_stream->file_handle ) ) != EOF )
+    while ( ( c = stream_getc( src_stream ) ) != EOF )
     {
         strt_code = ( strt_code << 8 ) | c;
         if ( strt_code == 0x000001ba )
             // we found the start of the next pack
             break;
     }
-    funlockfile( src_stream->file_handle );
 
     // if we didn't terminate on an eof back up so the next read
     // starts on the pack boundary.
     if ( c != EOF )
     {
-        fseeko( src_stream->file_handle, -4, SEEK_CUR );
+        stream_seek( src_stream, -4, SEEK_CUR );
     }
 }
 
@@ -1564,7 +1747,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
     {
         const uint8_t *buf;
         int adapt_len;
-        fseeko( stream->file_handle, fpos, SEEK_SET );
+        stream_seek( stream, fpos, SEEK_SET );
         align_to_next_packet( stream );
         int pid = stream->ts.list[ts_index_of_video(stream)].pid;
         buf = hb_ts_stream_getPEStype( stream, pid, &adapt_len );
@@ -1592,7 +1775,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
                 ++stream->has_IDRs;
             }
         }
-        pp.pos = ftello(stream->file_handle);
+        pp.pos = stream_tell(stream);
         if ( !stream->has_IDRs )
         {
             // Scan a little more to see if we will stumble upon one
@@ -1617,7 +1800,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
 
         // round address down to nearest dvd sector start
         fpos &=~ ( HB_DVD_READ_BUFFER_SIZE - 1 );
-        fseeko( stream->file_handle, fpos, SEEK_SET );
+        stream_seek( stream, fpos, SEEK_SET );
         if ( stream->hb_stream_type == program )
         {
             skip_to_next_pack( stream );
@@ -1662,7 +1845,7 @@ static struct pts_pos hb_sample_pts(hb_stream_t *stream, uint64_t fpos)
         }
 
         pp.pts = pes_info.pts;
-        pp.pos = ftello(stream->file_handle);
+        pp.pos = stream_tell(stream);
     }
     return pp;
 }
@@ -1722,8 +1905,7 @@ static void hb_stream_duration(hb_stream_t *stream, hb_title_t *inTitle)
     struct pts_pos *pp = ptspos;
     int i;
 
-    fseeko(stream->file_handle, 0, SEEK_END);
-    uint64_t fsize = ftello(stream->file_handle);
+    uint64_t fsize = stream_file_size(stream);
     uint64_t fincr = fsize / NDURSAMPLES;
     uint64_t fpos = fincr / 2;
     for ( i = NDURSAMPLES; --i >= 0; fpos += fincr )
@@ -1737,7 +1919,7 @@ static void hb_stream_duration(hb_stream_t *stream, hb_title_t *inTitle)
     inTitle->minutes  = ( dur % 3600 ) / 60;
     inTitle->seconds  = dur % 60;
 
-    rewind(stream->file_handle);
+    stream_seek(stream, 0, SEEK_SET);
 }
 
 /***********************************************************************
@@ -1842,16 +2024,15 @@ int hb_stream_seek( hb_stream_t * stream, float f )
     }
     off_t stream_size, cur_pos, new_pos;
     double pos_ratio = f;
-    cur_pos = ftello( stream->file_handle );
-    fseeko( stream->file_handle, 0, SEEK_END );
-    stream_size = ftello( stream->file_handle );
+    cur_pos = stream_tell( stream );
+    stream_size = stream_file_size( stream );
     new_pos = (off_t) ((double) (stream_size) * pos_ratio);
     new_pos &=~ (HB_DVD_READ_BUFFER_SIZE - 1);
 
-    int r = fseeko( stream->file_handle, new_pos, SEEK_SET );
+    int r = stream_seek( stream, new_pos, SEEK_SET );
     if (r == -1)
     {
-        fseeko( stream->file_handle, cur_pos, SEEK_SET );
+        stream_seek( stream, cur_pos, SEEK_SET );
         return 0;
     }
 
@@ -2306,8 +2487,6 @@ static int hb_ts_stream_init(hb_stream_t *stream)
     }
     stream->pes.count = 0;
 
-    stream->ts.packet = malloc( stream->packetsize );
-
     // Find the audio and video pids in the stream
     if (hb_ts_stream_find_pids(stream) < 0)
     {
@@ -2479,29 +2658,29 @@ static void hb_ps_stream_init(hb_stream_t *stream)
     }
 }
 
-#define MAX_HOLE 208*80
 
 static off_t align_to_next_packet(hb_stream_t *stream)
 {
-    uint8_t buf[MAX_HOLE];
     off_t pos = 0;
-    off_t start = ftello(stream->file_handle);
+    off_t start = stream_tell(stream);
     off_t orig;
 
     if ( start >= stream->packetsize ) {
         start -= stream->packetsize;
-        fseeko(stream->file_handle, start, SEEK_SET);
+        stream_seek(stream, start, SEEK_SET);
     }
     orig = start;
 
+    // Search for sync in place in the block buffer
     while (1)
     {
-        if (fread(buf, sizeof(buf), 1, stream->file_handle) == 1)
+        if (stream_fill(stream, MAX_HOLE) >= MAX_HOLE)
         {
+            const uint8_t *buf = stream->in.data + stream->in.pos;
             const uint8_t *bp = buf;
             int i;
 
-            for ( i = sizeof(buf) - 8 * stream->packetsize; --i >= 0; ++bp )
+            for ( i = MAX_HOLE - 8 * stream->packetsize; --i >= 0; ++bp )
             {
                 if ( have_ts_sync( bp, stream->packetsize, 8 ) )
                 {
@@ -2513,8 +2692,8 @@ static off_t align_to_next_packet(hb_stream_t *stream)
                 pos = ( bp - buf ) - stream->packetsize + 188;
                 break;
             }
-            fseeko(stream->file_handle, -8 * stream->packetsize, SEEK_CUR);
-            start = ftello(stream->file_handle);
+            stream->in.pos += MAX_HOLE - 8 * stream->packetsize;
+            start = stream_tell(stream);
         }
         else
         {
@@ -2527,7 +2706,7 @@ static off_t align_to_next_packet(hb_stream_t *stream)
             return 0;
         }
     }
-    fseeko(stream->file_handle, start+pos, SEEK_SET);
+    stream_seek(stream, start+pos, SEEK_SET);
     return start - orig + pos;
 }
 
@@ -3377,8 +3556,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
     int c;
 
 #define cp (b->data)
-    flockfile( stream->file_handle );
-    while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+    while ( ( c = stream_getc( stream ) ) != EOF )
     {
         start_code = ( start_code << 8 ) | c;
         if ( ( start_code >> 8 )== 0x000001 )
@@ -3410,7 +3588,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         }
 
         // There are at least 8 bytes.  More if this is mpeg2 pack.
-        if (fread( cp+pos, 1, 8, stream->file_handle ) < 8)
+        if (stream_read( stream, cp+pos, 8 ) < 8)
             goto done;
 
         int mark = cp[pos] >> 4;
@@ -3419,12 +3597,12 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( mark != 0x02 )
         {
             // mpeg-2 pack,
-            if (fread( cp+pos, 1, 2, stream->file_handle ) == 2)
+            if (stream_read( stream, cp+pos, 2 ) == 2)
             {
                 int len = cp[start+13] & 0x7;
                 pos += 2;
                 if (len > 0 &&
-                    fread( cp+pos, 1, len, stream->file_handle ) == len)
+                    stream_read( stream, cp+pos, len ) == len)
                     pos += len;
                 else
                     goto done;
@@ -3437,11 +3615,11 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
     else if ( stream_id >= 0xbb )
     {
         int len = 0;
-        c = getc_unlocked( stream->file_handle );
+        c = stream_getc( stream );
         if ( c == EOF )
             goto done;
         len = c << 8;
-        c = getc_unlocked( stream->file_handle );
+        c = stream_getc( stream );
         if ( c == EOF )
             goto done;
         len |= c;
@@ -3457,7 +3635,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( len )
         {
             // Length is non-zero, read the packet all at once
-            len = fread( cp+pos, 1, len, stream->file_handle );
+            len = stream_read( stream, cp+pos, len );
             pos += len;
         }
         else
@@ -3465,7 +3643,7 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
             // Length is zero, read bytes till we find a start code.
             // Only video PES packets are allowed to have zero length.
             start_code = -1;
-            while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+            while ( ( c = stream_getc( stream ) ) != EOF )
             {
                 start_code = ( start_code << 8 ) | c;
                 if ( pos  >= b->alloc )
@@ -3484,14 +3662,14 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
             if ( c == EOF )
                 goto done;
             pos -= 4;
-            fseeko( stream->file_handle, -4, SEEK_CUR );
+            stream_seek( stream, -4, SEEK_CUR );
         }
     }
     else
     {
         // Unknown, find next start code
         start_code = -1;
-        while ( ( c = getc_unlocked( stream->file_handle ) ) != EOF )
+        while ( ( c = stream_getc( stream ) ) != EOF )
         {
             start_code = ( start_code << 8 ) | c;
             if ( pos  >= b->alloc )
@@ -3508,12 +3686,11 @@ static int hb_ps_read_packet( hb_stream_t * stream, hb_buffer_t *b )
         if ( c == EOF )
             goto done;
         pos -= 4;
-        fseeko( stream->file_handle, -4, SEEK_CUR );
+        stream_seek( stream, -4, SEEK_CUR );
     }
 
 done:
     // Parse packet for information we might need
-    funlockfile( stream->file_handle );
 
     int err;
     if ((err = ferror(stream->file_handle)) != 0)
@@ -3896,7 +4073,7 @@ static void hb_ps_stream_find_streams(hb_stream_t *stream)
     int ii, jj;
     hb_buffer_t *buf  = hb_buffer_init(HB_DVD_READ_BUFFER_SIZE);
 
-    fseeko( stream->file_handle, 0, SEEK_SET );
+    stream_seek( stream, 0, SEEK_SET );
     // Scan beginning of file, then if no program stream map is found
     // seek to 20% and scan again since there's occasionally no
     // audio at the beginning (particularly for vobs).
@@ -4615,9 +4792,8 @@ static int hb_ts_stream_find_pids(hb_stream_t *stream)
     // changes PMTs (and thus video & audio PIDs) when 'programs' change. Since
     // we may have the tail of the previous program at the beginning of this
     // file, take our PMT from the middle of the file.
-    fseeko(stream->file_handle, 0, SEEK_END);
-    uint64_t fsize = ftello(stream->file_handle);
-    fseeko(stream->file_handle, fsize >> 1, SEEK_SET);
+    uint64_t fsize = stream_file_size(stream);
+    stream_seek(stream, fsize >> 1, SEEK_SET);
     align_to_next_packet(stream);
 
     // Read the Transport Stream Packets (188 bytes each) looking at first for PID 0 (the PAT PID), then decode that
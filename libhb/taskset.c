@@ -11,12 +11,75 @@
 #include "handbrake/ports.h"
 #include "handbrake/taskset.h"
 
-static void taskset_thread_f( void *thread_args_v );
+/*
+ * All tasksets share one process wide pool of worker threads.
+ *
+ * taskset_cycle() hands out "tickets" for the taskset to the workers'
+ * queues.  A worker holding a ticket claims segments of the taskset
+ * until none are left, so a ticket is not tied to a particular segment
+ * and tickets that arrive late simply find nothing left to do.  The
+ * thread that called taskset_cycle() claims segments too, then waits
+ * for the segments claimed by workers to complete.
+ *
+ * Each worker owns a queue.  It takes tickets from the tail of its own
+ * queue and, once that is empty, steals from the head of the other
+ * workers' queues.  Workers beyond the configured count are parked, but
+ * whatever is left in their queues is still stolen by the others.
+ *
+ * taskset_post() hands out one ticket for one segment.  Workers claim
+ * posted segments individually, and taskset_wait() runs the segment
+ * itself if no worker has claimed it yet.
+ *
+ * The tickets that are queued or held for any taskset of a budget count
+ * against the budget's limit.  Segments that no ticket is handed out
+ * for are run by the calling thread, or by a worker that already holds
+ * one.
+ */
+
+#define TASKSET_MAX_WORKERS 64
+#define TASKSET_QUEUE_SIZE  16
+
+enum
+{
+    TASKSET_SEGMENT_IDLE = 0,
+    TASKSET_SEGMENT_POSTED,
+    TASKSET_SEGMENT_RUNNING,
+    TASKSET_SEGMENT_DONE,
+};
+
+typedef struct
+{
+    int             index;
+    hb_thread_t   * thread;
+    hb_lock_t     * lock;
+    taskset_t    ** queue;
+    int             size;
+    int             head;
+    int             count;
+} taskset_worker_t;
+
+static struct
+{
+    hb_lock_t        * lock;
+    hb_cond_t        * work_cond;
+    hb_cond_t        * park_cond;
+    hb_tls_key_t     * self_key;
+    int                configured;
+    int                started;     // worker threads created
+    int                active;      // workers allowed to take tickets
+    int                sleeping;
+    int                queued;      // tickets waiting in the queues
+    int                submit;      // round robin queue selection
+    int                stop;
+    taskset_worker_t   workers[TASKSET_MAX_WORKERS];
+} pool;
+
+static void taskset_worker_f( void *worker_v );
 
 int
 taskset_init( taskset_t *ts, const char *descr, int thread_count, size_t arg_size, thread_func_t *work_func)
 {
-    int init_step, i;
+    int init_step;
 
     init_step = 0;
     memset( ts, 0, sizeof( *ts ) );
@@ -39,28 +102,27 @@ taskset_init( taskset_t *ts, const char *descr, int thread_count, size_t arg_siz
 
     init_step++;
 
-    ts->task_thread_started = 0;
-    ts->task_threads = calloc( ts->thread_count, sizeof( taskset_thread_t) );
-    if( ts->task_threads == NULL )
+    ts->state = calloc( ts->thread_count, sizeof( int ) );
+    if ( ts->state == NULL )
         goto fail;
 
     init_step++;
 
-    for ( i = 0; i < ts->thread_count; i++ ) {
-        taskset_thread_t *thread = &ts->task_threads[i];
+    ts->lock = hb_lock_init();
+    if ( ts->lock == NULL )
+        goto fail;
 
-        thread->lock = hb_lock_init();
-        if ( thread->lock == NULL )
-            goto fail;
+    init_step++;
 
-        thread->begin_cond = hb_cond_init();
-        if ( thread->begin_cond == NULL )
-            goto fail;
+    ts->complete_cond = hb_cond_init();
+    if ( ts->complete_cond == NULL )
+        goto fail;
+
+    /*
+     * Nothing has been handed out yet.
+     */
+    ts->next = ts->done = ts->thread_count;
 
-        thread->complete_cond = hb_cond_init();
-        if ( thread->complete_cond == NULL )
-            goto fail;
-    }
     return (1);
 
 fail:
@@ -68,18 +130,10 @@ fail:
     {
         default:
         case 3:
-            for ( i = 0; i < ts->thread_count; i++ ) {
-                taskset_thread_t *thread = &ts->task_threads[i];
-                if ( thread->begin_cond )
-                    hb_cond_close( &thread->begin_cond );
-                if ( thread->complete_cond )
-                    hb_cond_close( &thread->complete_cond );
-                if ( thread->lock )
-                    hb_lock_close( &thread->lock );
-            }
+            hb_lock_close( &ts->lock );
             /* FALL THROUGH */
         case 2:
-            free( ts->task_threads );
+            free( ts->state );
             /* FALL THROUGH */
         case 1:
             free( ts->task_threads_args );
@@ -90,170 +144,576 @@ fail:
     return (0);
 }
 
-static taskset_thread_t*
-taskset_thread( taskset_t *ts, int thr_idx )
+/*
+ * The pool lock is created on first use.  Tasksets can be initialized
+ * from the work threads of several hb_handle_t at once, so the lock is
+ * published with a compare and swap.
+ */
+static hb_lock_t *
+taskset_pool_lock( void )
 {
-    return &ts->task_threads[thr_idx];
+    hb_lock_t *lock = hb_atomic_load( &pool.lock );
+    if ( lock == NULL )
+    {
+        hb_lock_t *expected = NULL;
+
+        lock = hb_lock_init();
+        if ( !hb_atomic_cas( &pool.lock, &expected, lock ) )
+        {
+            hb_lock_close( &lock );
+            lock = expected;
+        }
+    }
+    return lock;
 }
 
-void
-taskset_cycle( taskset_t *ts )
+/*
+ * Start one worker per cpu.
+ */
+static void
+taskset_pool_configure( void )
 {
-    int i;
-    if ( !ts->task_thread_started ) {
-        for ( i = 0; i < ts->thread_count; i++ ) {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            thread->thread = hb_thread_init( ts->task_descr, taskset_thread_f,
-                                           taskset_thread_args( ts, i ),
-                                            HB_NORMAL_PRIORITY );
+    int i, count;
+
+    hb_lock( taskset_pool_lock() );
+    if ( pool.configured )
+    {
+        hb_unlock( pool.lock );
+        return;
+    }
+    if ( pool.work_cond == NULL )
+    {
+        pool.work_cond = hb_cond_init();
+        pool.park_cond = hb_cond_init();
+        pool.self_key  = hb_tls_key_init( NULL );
+    }
+
+    count = hb_get_cpu_count();
+    if ( count > TASKSET_MAX_WORKERS )
+    {
+        count = TASKSET_MAX_WORKERS;
+    }
+
+    for ( i = pool.started; i < count; i++ )
+    {
+        taskset_worker_t *worker = &pool.workers[i];
+
+        worker->index = i;
+        worker->size  = TASKSET_QUEUE_SIZE;
+        worker->queue = calloc( worker->size, sizeof( taskset_t * ) );
+        worker->lock  = hb_lock_init();
+        if ( worker->queue == NULL || worker->lock == NULL )
+        {
+            free( worker->queue );
+            hb_lock_close( &worker->lock );
+            break;
         }
-        ts->task_thread_started = 1;
+        /*
+         * Publish the worker before it starts so that it is visible
+         * to the thieves in taskset_take().
+         */
+        hb_atomic_store( &pool.started, i + 1 );
+        worker->thread = hb_thread_init( "taskset worker", taskset_worker_f,
+                                         worker, HB_NORMAL_PRIORITY );
     }
+    if ( count > pool.started )
+    {
+        count = pool.started;
+    }
+    if ( count != pool.active )
+    {
+        hb_log( "taskset: %d shared worker threads", count );
+    }
+    hb_atomic_store( &pool.active, count );
+    hb_cond_broadcast( pool.park_cond );
 
-    /*
-     * Signal all threads that their work is available.
-     */
-    for (i = 0; i < ts->thread_count; i++) {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock( thread->lock );
-        thread->begin = 1;
-        hb_cond_signal( thread->begin_cond );
-        hb_unlock( thread->lock );
+    hb_atomic_store( &pool.configured, 1 );
+    hb_unlock( pool.lock );
+}
+
+int
+taskset_pool_get_threads( void )
+{
+    if ( !hb_atomic_load( &pool.configured ) )
+    {
+        taskset_pool_configure();
     }
+    return hb_atomic_load( &pool.active );
+}
 
-    /*
-     * Wait until all threads have completed.  Note that we must
-     * loop here as hb_cond_wait() on some platforms (e.g pthread_cond_wait)
-     * may unblock prematurely.
-     */
-    for ( i = 0; i < ts->thread_count; i++ )
+static int
+taskset_queue_push( taskset_worker_t *worker, taskset_t *ts )
+{
+    hb_lock( worker->lock );
+    if ( worker->count == worker->size )
     {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock( thread->lock );
-        while (!thread->complete) {
-            hb_cond_wait( thread->complete_cond, thread->lock);
+        taskset_t **queue = calloc( worker->size * 2, sizeof( taskset_t * ) );
+        int i;
+
+        if ( queue == NULL )
+        {
+            /*
+             * The caller of taskset_cycle() runs whatever
+             * isn't handed out, so the ticket can be dropped.
+             */
+            hb_unlock( worker->lock );
+            return 0;
+        }
+        for ( i = 0; i < worker->count; i++ )
+        {
+            queue[i] = worker->queue[( worker->head + i ) % worker->size];
         }
-        thread->complete = 0;
-        hb_unlock( thread->lock );
+        free( worker->queue );
+        worker->queue = queue;
+        worker->head  = 0;
+        worker->size *= 2;
     }
+    worker->queue[( worker->head + worker->count ) % worker->size] = ts;
+    hb_atomic_store( &worker->count, worker->count + 1 );
+    hb_atomic_add( &pool.queued, 1 );
+    hb_atomic_add( &ts->busy, 1 );
+    hb_unlock( worker->lock );
+    return 1;
 }
 
 /*
- * Block current thread until work is available for it.
+ * Let go of a ticket.  The budget is released first, the taskset may
+ * be freed once its busy count drops to 0.
  */
 static void
-taskset_thread_wait4start( taskset_thread_t *thread )
+taskset_release( taskset_t *ts )
 {
-    hb_lock( thread->lock );
-    while ( !thread->begin )
+    if ( ts->budget != NULL && ts->budget->max > 0 )
     {
-        hb_cond_wait( thread->begin_cond, thread->lock );
+        hb_atomic_sub( &ts->budget->busy, 1 );
     }
+    hb_atomic_sub( &ts->busy, 1 );
+}
 
-    /*
-     * We've been released for one run.  Insure we block the next
-     * time through the loop.
-     */
-    thread->begin = 0;
-    hb_unlock( thread->lock );
+/*
+ * Remove one ticket from a queue, from the tail when 'own' is set and
+ * from the head otherwise.  Returns 0 if the queue was empty.  *ts is
+ * NULL if the ticket was withdrawn by taskset_fini().
+ */
+static int
+taskset_queue_take( taskset_worker_t *worker, int own, taskset_t **ts )
+{
+    int pos;
+
+    if ( hb_atomic_load_relaxed( &worker->count ) == 0 )
+    {
+        return 0;
+    }
+
+    hb_lock( worker->lock );
+    if ( worker->count == 0 )
+    {
+        hb_unlock( worker->lock );
+        return 0;
+    }
+    if ( own )
+    {
+        pos = ( worker->head + worker->count - 1 ) % worker->size;
+    }
+    else
+    {
+        pos = worker->head;
+        worker->head = ( worker->head + 1 ) % worker->size;
+    }
+    hb_atomic_store( &worker->count, worker->count - 1 );
+    *ts = worker->queue[pos];
+    worker->queue[pos] = NULL;
+    hb_atomic_sub( &pool.queued, 1 );
+    hb_unlock( worker->lock );
+    return 1;
+}
+
+static int
+taskset_take( taskset_worker_t *worker, taskset_t **ts )
+{
+    int i, started = hb_atomic_load( &pool.started );
+
+    if ( taskset_queue_take( worker, 1, ts ) )
+    {
+        return 1;
+    }
+    for ( i = 1; i < started; i++ )
+    {
+        taskset_worker_t *victim = &pool.workers[( worker->index + i ) % started];
+        if ( taskset_queue_take( victim, 0, ts ) )
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+taskset_claim( taskset_t *ts, int segment )
+{
+    int expected = TASKSET_SEGMENT_POSTED;
+
+    if ( hb_atomic_cas( &ts->state[segment], &expected, TASKSET_SEGMENT_RUNNING ) )
+    {
+        hb_atomic_sub( &ts->posted, 1 );
+        return 1;
+    }
+    return 0;
 }
 
 /*
- * Current thread has completed its work.  Indicate completion,
- * and if all threads in this task set have completed, wakeup
- * anyone waiting for this condition.
+ * Claim and run segments of the current cycle and posted segments
+ * until there are none left.
  */
 static void
-taskset_thread_complete( taskset_thread_t *thread )
+taskset_run( taskset_t *ts )
 {
-    hb_lock( thread->lock );
-    thread->complete = 1;
-    hb_cond_signal( thread->complete_cond );
-    hb_unlock( thread->lock );
+    int segment, claimed;
+
+    while ( ( segment = hb_atomic_add( &ts->next, 1 ) - 1 ) < ts->thread_count )
+    {
+        ts->work_func( taskset_thread_args( ts, segment ) );
+
+        if ( hb_atomic_add( &ts->done, 1 ) == ts->thread_count )
+        {
+            hb_lock( ts->lock );
+            hb_cond_broadcast( ts->complete_cond );
+            hb_unlock( ts->lock );
+        }
+    }
+
+    do
+    {
+        claimed = 0;
+        for ( segment = 0; segment < ts->thread_count &&
+                           hb_atomic_load( &ts->posted ) > 0; segment++ )
+        {
+            if ( taskset_claim( ts, segment ) )
+            {
+                ts->work_func( taskset_thread_args( ts, segment ) );
+
+                hb_lock( ts->lock );
+                hb_atomic_store( &ts->state[segment], TASKSET_SEGMENT_DONE );
+                hb_cond_broadcast( ts->complete_cond );
+                hb_unlock( ts->lock );
+                claimed = 1;
+            }
+        }
+    } while ( claimed );
 }
 
+/*
+ * Queue tickets for the taskset and wake up sleeping workers.
+ */
 static void
-taskset_thread_f( void *thread_args_v )
+taskset_hand_out( taskset_t *ts, int tickets )
 {
-    taskset_thread_arg_t *thread_args = thread_args_v;
-    int segment = thread_args->segment;
-    taskset_thread_t *thread = taskset_thread( thread_args->taskset, segment );
+    taskset_budget_t *budget = ts->budget;
+    taskset_worker_t *self;
+    int i, dropped = 0;
 
-    while (1)
+    if ( tickets > hb_atomic_load( &pool.active ) )
+    {
+        tickets = hb_atomic_load( &pool.active );
+    }
+    if ( budget != NULL && budget->max > 0 )
     {
         /*
-         * Wait here until there is work to do.
+         * Reserve the tickets in the budget before queuing them, the
+         * other tasksets of the budget may be handing out concurrently.
          */
-        taskset_thread_wait4start( thread );
+        int busy = hb_atomic_load( &budget->busy );
+        do
+        {
+            if ( tickets > budget->max - busy )
+            {
+                tickets = budget->max - busy;
+            }
+            if ( tickets <= 0 )
+            {
+                return;
+            }
+        } while ( !hb_atomic_cas( &budget->busy, &busy, busy + tickets ) );
+    }
+    if ( tickets <= 0 )
+    {
+        return;
+    }
 
-        if( thread->stop )
+    self = hb_tls_get( pool.self_key );
+    for ( i = 0; i < tickets; i++ )
+    {
+        taskset_worker_t *worker = self;
+        if ( worker == NULL )
         {
-            /*
-             * No more work to do, exit this thread.
-             */
-            break;
+            int active = hb_atomic_load( &pool.active );
+            worker = &pool.workers[hb_atomic_add( &pool.submit, 1 ) % active];
+        }
+        if ( !taskset_queue_push( worker, ts ) )
+        {
+            dropped++;
         }
+    }
+    if ( dropped && budget != NULL && budget->max > 0 )
+    {
+        hb_atomic_sub( &budget->busy, dropped );
+    }
+
+    hb_lock( pool.lock );
+    if ( pool.sleeping )
+    {
+        hb_cond_broadcast( pool.work_cond );
+    }
+    hb_unlock( pool.lock );
+}
 
-        thread_args->taskset->work_func( thread_args_v );
+/*
+ * A budget limits the number of pool workers that work at once on all
+ * the tasksets that share it.  The calling threads of taskset_cycle()
+ * and taskset_wait() come on top.  max 0 means no limit.
+ */
+taskset_budget_t *
+taskset_budget_init( int max )
+{
+    taskset_budget_t *budget = calloc( 1, sizeof( taskset_budget_t ) );
+
+    if ( budget != NULL )
+    {
+        budget->max = max > 0 ? max : 0;
+    }
+    return budget;
+}
+
+/*
+ * Close the budget after all the tasksets that share it.
+ */
+void
+taskset_budget_close( taskset_budget_t **_budget )
+{
+    free( *_budget );
+    *_budget = NULL;
+}
+
+/*
+ * Set the budget of the taskset, NULL for none.  Set it before the
+ * taskset is used.
+ */
+void
+taskset_set_budget( taskset_t *ts, taskset_budget_t *budget )
+{
+    ts->budget = budget;
+}
 
-        taskset_thread_complete( thread );
+void
+taskset_cycle( taskset_t *ts )
+{
+    if ( !hb_atomic_load( &pool.configured ) )
+    {
+        taskset_pool_configure();
     }
 
     /*
-     * Finished this segment, let everyone know.
+     * Open the cycle.  The segment arguments have been filled in by
+     * the caller; the release on 'next' makes them visible to the
+     * workers claiming segments.
+     */
+    hb_atomic_store( &ts->done, 0 );
+    hb_atomic_store( &ts->next, 0 );
+
+    /*
+     * The calling thread works on the taskset too, so one ticket less
+     * than there are segments is enough to keep every segment busy.
+     */
+    taskset_hand_out( ts, ts->thread_count - 1 );
+
+    taskset_run( ts );
+
+    /*
+     * Wait until all segments have completed.  Note that we must
+     * loop here as hb_cond_wait() on some platforms (e.g pthread_cond_wait)
+     * may unblock prematurely.
      */
-    taskset_thread_complete( thread );
+    hb_lock( ts->lock );
+    while ( hb_atomic_load( &ts->done ) < ts->thread_count )
+    {
+        hb_cond_wait( ts->complete_cond, ts->lock );
+    }
+    hb_unlock( ts->lock );
 }
 
+/*
+ * Run one segment asynchronously.  The segment arguments must be
+ * filled in before, and left alone until taskset_wait() returns.
+ */
+void
+taskset_post( taskset_t *ts, int segment )
+{
+    if ( !hb_atomic_load( &pool.configured ) )
+    {
+        taskset_pool_configure();
+    }
+
+    hb_atomic_store( &ts->state[segment], TASKSET_SEGMENT_POSTED );
+    hb_atomic_add( &ts->posted, 1 );
+
+    taskset_hand_out( ts, 1 );
+}
+
+/*
+ * Returns 1 if a posted segment has completed, taskset_wait() will
+ * then return without blocking.
+ */
+int
+taskset_done( taskset_t *ts, int segment )
+{
+    return hb_atomic_load( &ts->state[segment] ) == TASKSET_SEGMENT_DONE;
+}
 
+/*
+ * Wait for a posted segment to complete.  Runs the segment on the
+ * calling thread if no worker got to it yet.
+ */
 void
-taskset_fini( taskset_t *ts )
+taskset_wait( taskset_t *ts, int segment )
 {
-    if (ts == NULL)
+    if ( taskset_claim( ts, segment ) )
     {
-        return;
+        ts->work_func( taskset_thread_args( ts, segment ) );
+    }
+    else
+    {
+        hb_lock( ts->lock );
+        while ( hb_atomic_load( &ts->state[segment] ) != TASKSET_SEGMENT_DONE )
+        {
+            hb_cond_wait( ts->complete_cond, ts->lock );
+        }
+        hb_unlock( ts->lock );
     }
+    hb_atomic_store( &ts->state[segment], TASKSET_SEGMENT_IDLE );
+}
 
-    int i;
-    if ( ts->task_thread_started ) {
-        /*
-         * Tell each thread to stop, and then cleanup.
-         */
-        for ( i = 0; i < ts->thread_count; i++ )
+static void
+taskset_worker_f( void *worker_v )
+{
+    taskset_worker_t *worker = worker_v;
+    taskset_t *ts;
+
+    hb_tls_set( pool.self_key, worker );
+
+    while (1)
+    {
+        if ( worker->index < hb_atomic_load_relaxed( &pool.active ) &&
+             taskset_take( worker, &ts ) )
         {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            hb_lock( thread->lock );
-            thread->begin = 1;
-            thread->stop = 1;
-            hb_cond_signal( thread->begin_cond );
-            while ( !thread->complete ) {
-                hb_cond_wait( thread->complete_cond, thread->lock );
+            if ( ts != NULL )
+            {
+                taskset_run( ts );
+                taskset_release( ts );
             }
-            hb_unlock( thread->lock );
+            continue;
         }
+
         /*
-         * Clean up thread memory.
+         * Block current thread until work is available for it.
          */
-        for( i = 0; i < ts->thread_count; i++ )
+        hb_lock( pool.lock );
+        if ( pool.stop )
+        {
+            hb_unlock( pool.lock );
+            break;
+        }
+        if ( worker->index >= pool.active )
         {
-            taskset_thread_t *thread = taskset_thread( ts, i );
-            hb_thread_close( &thread->thread );
+            hb_cond_wait( pool.park_cond, pool.lock );
         }
+        else if ( hb_atomic_load( &pool.queued ) == 0 )
+        {
+            pool.sleeping++;
+            hb_cond_wait( pool.work_cond, pool.lock );
+            pool.sleeping--;
+        }
+        hb_unlock( pool.lock );
+    }
+}
+
+void
+taskset_fini( taskset_t *ts )
+{
+    if (ts == NULL)
+    {
+        return;
     }
 
+    int i, started = hb_atomic_load( &pool.started );
+
     /*
-     * Clean up taskset memory.
+     * Withdraw the tickets of this taskset that are still queued, then
+     * wait for the workers that already hold one to let go of it.
+     * Those find no segment left to claim, so this is brief.
      */
-    for( i = 0; i < ts->thread_count; i++ )
+    for ( i = 0; i < started; i++ )
+    {
+        taskset_worker_t *worker = &pool.workers[i];
+        int j;
+
+        hb_lock( worker->lock );
+        for ( j = 0; j < worker->count; j++ )
+        {
+            int pos = ( worker->head + j ) % worker->size;
+            if ( worker->queue[pos] == ts )
+            {
+                worker->queue[pos] = NULL;
+                taskset_release( ts );
+            }
+        }
+        hb_unlock( worker->lock );
+    }
+    while ( hb_atomic_load( &ts->busy ) > 0 )
     {
-        taskset_thread_t *thread = taskset_thread( ts, i );
-        hb_lock_close( &thread->lock );
-        hb_cond_close( &thread->begin_cond );
-        hb_cond_close( &thread->complete_cond );
+        hb_yield();
     }
 
-    free( ts->task_threads );
+    /*
+     * Clean up taskset memory.
+     */
+    hb_lock_close( &ts->lock );
+    hb_cond_close( &ts->complete_cond );
+    free( ts->state );
 
     if( ts->task_threads_args != NULL )
         free( ts->task_threads_args );
 }
+
+/*
+ * Stop the shared workers.  Called once no taskset is in use anymore.
+ */
+void
+taskset_pool_close( void )
+{
+    int i;
+
+    if ( hb_atomic_load( &pool.lock ) == NULL )
+    {
+        return;
+    }
+
+    hb_lock( pool.lock );
+    pool.stop = 1;
+    hb_cond_broadcast( pool.work_cond );
+    hb_cond_broadcast( pool.park_cond );
+    hb_unlock( pool.lock );
+
+    for ( i = 0; i < pool.started; i++ )
+    {
+        taskset_worker_t *worker = &pool.workers[i];
+        hb_thread_close( &worker->thread );
+        hb_lock_close( &worker->lock );
+        free( worker->queue );
+    }
+
+    hb_cond_close( &pool.work_cond );
+    hb_cond_close( &pool.park_cond );
+    hb_tls_key_close( &pool.self_key );
+    hb_lock_close( &pool.lock );
+    memset( &pool, 0, sizeof( pool ) );
+}
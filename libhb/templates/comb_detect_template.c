@@ -134,6 +134,102 @@ static void FUNC(apply_mask)(hb_filter_private_t *pv, hb_buffer_t *b)
     }
 }
 
+static void FUNC(detect_gamma_combed_row)(uint8_t *mask,
+                                          const pixel *prev,
+                                          const pixel *cur,
+                                          const pixel *next,
+                                          int stride_prev,
+                                          int stride_cur,
+                                          int stride_next,
+                                          int width,
+                                          const CombDetectParams *params)
+{
+    // A mishmash of various comb detection tricks
+    // picked up from neuron2's Decomb plugin for
+    // AviSynth and tritical's IsCombedT and
+    // IsCombedTIVTC plugins.
+
+    // Comb scoring algorithm
+    const float mthresh  = params->gamma_motion_threshold;
+    const float athresh  = params->gamma_spatial_threshold;
+    const float athresh6 = params->gamma_spatial_threshold6;
+    const float *gamma_lut = params->gamma_lut;
+
+    // These are just to make the buffer locations easier to read.
+    const int up_1_prev    = -1 * stride_prev;
+    const int down_1_prev  =      stride_prev;
+
+    const int up_2    = -2 * stride_cur;
+    const int up_1    = -1 * stride_cur;
+    const int down_1  =      stride_cur;
+    const int down_2  =  2 * stride_cur;
+
+    const int up_1_next    = -1 * stride_next;
+    const int down_1_next =       stride_next;
+
+    // We need to examine a column of 5 pixels
+    // in the prev, cur, and next frames.
+    for (int x = 0; x < width; x++)
+    {
+        mask[0] = 0;
+
+        const float up_diff    = gamma_lut[cur[0]] - gamma_lut[cur[up_1]];
+        const float down_diff  = gamma_lut[cur[0]] - gamma_lut[cur[down_1]];
+
+        if ((up_diff >  athresh && down_diff >  athresh) ||
+            (up_diff < -athresh && down_diff < -athresh))
+        {
+            // The pixel above and below are different,
+            // and they change in the same "direction" too.
+            int motion = 0;
+            if (mthresh > 0)
+            {
+                // Make sure there's sufficient motion between frame t-1 to frame t+1.
+                if (fabs(gamma_lut[prev[0]]     - gamma_lut[cur[0]]           ) > mthresh &&
+                    fabs(gamma_lut[cur[up_1]]   - gamma_lut[next[up_1_next]]  ) > mthresh &&
+                    fabs(gamma_lut[cur[down_1]] - gamma_lut[next[down_1_next]]) > mthresh)
+                {
+                    motion++;
+                }
+                if (fabs(gamma_lut[next[0]]           - gamma_lut[cur[0]]     ) > mthresh &&
+                    fabs(gamma_lut[prev[up_1_prev]]   - gamma_lut[cur[up_1]]  ) > mthresh &&
+                    fabs(gamma_lut[prev[down_1_prev]] - gamma_lut[cur[down_1]]) > mthresh)
+                {
+                    motion++;
+                }
+            }
+            else
+            {
+                // User doesn't want to check for motion,
+                // so move on to the spatial check.
+                motion = 1;
+            }
+
+            if (motion || params->force_exaustive_check)
+            {
+                // Tritical's noise-resistant combing scorer.
+                // The check is done on a bob+blur convolution.
+                float combing = fabs(gamma_lut[cur[up_2]] +
+                                     (4 * gamma_lut[cur[0]]) +
+                                     gamma_lut[cur[down_2]] -
+                                     (3 * (gamma_lut[cur[up_1]] +
+                                           gamma_lut[cur[down_1]])));
+                // If the frame is sufficiently combed,
+                // then mark it down on the mask as 1.
+                if (combing > athresh6)
+                {
+                    mask[0] = 1;
+                }
+            }
+        }
+
+        cur++;
+        prev++;
+        next++;
+        mask++;
+    }
+}
+
 #if defined (__aarch64__) && !defined(__APPLE__)
 static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
                                               int segment_start, int segment_stop)
@@ -288,15 +384,8 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
 static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
                                               int segment_start, int segment_stop)
 {
-    // A mishmash of various comb detection tricks
-    // picked up from neuron2's Decomb plugin for
-    // AviSynth and tritical's IsCombedT and
-    // IsCombedTIVTC plugins.
-
-    // Comb scoring algorithm
-    const float mthresh  = pv->gamma_motion_threshold;
-    const float athresh  = pv->gamma_spatial_threshold;
-    const float athresh6 = pv->gamma_spatial_threshold6;
+    CombDetectParams params;
+    comb_detect_params(pv, &params);
 
     // One pass for Y
     const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
@@ -318,6 +407,43 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
         segment_stop = height - 2;
     }
 
+    for (int y = segment_start; y < segment_stop; y++)
+    {
+        const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
+        const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
+        const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
+        uint8_t *mask = &pv->mask->plane[0].data[y * mask_stride];
+
+        memset(mask + width, 0, mask_stride - width);
+        pv->functions.FUNC(detect_gamma_combed_row)(mask, prev, cur, next,
+                                                    stride_prev, stride_cur, stride_next,
+                                                    width, &params);
+    }
+}
+#endif
+
+static void FUNC(detect_combed_row)(uint8_t *mask,
+                                    const pixel *prev,
+                                    const pixel *cur,
+                                    const pixel *next,
+                                    int stride_prev,
+                                    int stride_cur,
+                                    int stride_next,
+                                    int width,
+                                    const CombDetectParams *params)
+{
+    // A mishmash of various comb detection tricks
+    // picked up from neuron2's Decomb plugin for
+    // AviSynth and tritical's IsCombedT and
+    // IsCombedTIVTC plugins.
+
+    // Comb scoring algorithm
+    const int spatial_metric  = params->spatial_metric;
+    const int mthresh         = params->motion_threshold;
+    const int athresh         = params->spatial_threshold;
+    const int athresh_squared = params->spatial_threshold_squared;
+    const int athresh6        = params->spatial_threshold6;
+
     // These are just to make the buffer locations easier to read.
     const int up_1_prev    = -1 * stride_prev;
     const int down_1_prev  =      stride_prev;
@@ -330,60 +456,80 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
     const int up_1_next    = -1 * stride_next;
     const int down_1_next =       stride_next;
 
-    for (int y = segment_start; y < segment_stop; y++)
+    // We need to examine a column of 5 pixels
+    // in the prev, cur, and next frames.
+    for (int x = 0; x < width; x++)
     {
-        // We need to examine a column of 5 pixels
-        // in the prev, cur, and next frames.
-        const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
-        const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
-        const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
-        uint8_t *mask = &pv->mask->plane[0].data[y * mask_stride];
+        mask[0] = 0;
 
-        memset(mask, 0, mask_stride);
+        const int up_diff = cur[0] - cur[up_1];
+        const int down_diff = cur[0] - cur[down_1];
 
-        for (int x = 0; x < width; x++)
+        if ((up_diff >  athresh && down_diff >  athresh) ||
+            (up_diff < -athresh && down_diff < -athresh))
         {
-            const float up_diff    = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[up_1]];
-            const float down_diff  = pv->gamma_lut[cur[0]] - pv->gamma_lut[cur[down_1]];
+            // The pixel above and below are different,
+            // and they change in the same "direction" too.
+            int motion = 0;
+            if (mthresh > 0)
+            {
+                // Make sure there's sufficient motion between frame t-1 to frame t+1.
+                if (abs(prev[0]     - cur[0]           ) > mthresh &&
+                    abs(cur[up_1]   - next[up_1_next]  ) > mthresh &&
+                    abs(cur[down_1] - next[down_1_next]) > mthresh)
+                {
+                    motion++;
+                }
+                if (abs(next[0]           - cur[0]     ) > mthresh &&
+                    abs(prev[up_1_prev]   - cur[up_1]  ) > mthresh &&
+                    abs(prev[down_1_prev] - cur[down_1]) > mthresh)
+                {
+                    motion++;
+                }
+            }
+            else
+            {
+                // User doesn't want to check for motion,
+                // so move on to the spatial check.
+                motion = 1;
+            }
 
-            if ((up_diff >  athresh && down_diff >  athresh) ||
-                (up_diff < -athresh && down_diff < -athresh))
+            // If motion, or we can't measure motion yet...
+            if (motion || params->force_exaustive_check)
             {
-                // The pixel above and below are different,
-                // and they change in the same "direction" too.
-                int motion = 0;
-                if (mthresh > 0)
+                // That means it's time for the spatial check.
+                // We've got several options here.
+                if (spatial_metric == 0)
                 {
-                    // Make sure there's sufficient motion between frame t-1 to frame t+1.
-                    if (fabs(pv->gamma_lut[prev[0]]     - pv->gamma_lut[cur[0]]           ) > mthresh &&
-                        fabs(pv->gamma_lut[cur[up_1]]   - pv->gamma_lut[next[up_1_next]]  ) > mthresh &&
-                        fabs(pv->gamma_lut[cur[down_1]] - pv->gamma_lut[next[down_1_next]]) > mthresh)
+                    // Simple 32detect style comb detection.
+                    if ((abs(cur[0] - cur[down_2]) < params->comb32detect_min) &&
+                        (abs(cur[0] - cur[down_1]) > params->comb32detect_max))
                     {
-                        motion++;
-                    }
-                    if (fabs(pv->gamma_lut[next[0]]           - pv->gamma_lut[cur[0]]     ) > mthresh &&
-                        fabs(pv->gamma_lut[prev[up_1_prev]]   - pv->gamma_lut[cur[up_1]]  ) > mthresh &&
-                        fabs(pv->gamma_lut[prev[down_1_prev]] - pv->gamma_lut[cur[down_1]]) > mthresh)
-                    {
-                        motion++;
+                        mask[0] = 1;
                     }
                 }
-                else
+                else if (spatial_metric == 1)
                 {
-                    // User doesn't want to check for motion,
-                    // so move on to the spatial check.
-                    motion = 1;
-                }
+                    // This, for comparison, is what IsCombed uses.
+                    // It's better, but still noise sensitive.
+                    const int combing = (cur[up_1] - cur[0]) *
+                                        (cur[down_1] - cur[0]);
 
-                if (motion || pv->force_exaustive_check)
+                    if (combing > athresh_squared)
+                    {
+                        mask[0] = 1;
+                    }
+                }
+                else if (spatial_metric == 2)
                 {
                     // Tritical's noise-resistant combing scorer.
                     // The check is done on a bob+blur convolution.
-                    float combing = fabs(pv->gamma_lut[cur[up_2]] +
-                                         (4 * pv->gamma_lut[cur[0]]) +
-                                         pv->gamma_lut[cur[down_2]] -
-                                         (3 * (pv->gamma_lut[cur[up_1]] +
-                                               pv->gamma_lut[cur[down_1]])));
+                    const int combing = abs( cur[up_2]
+                                        + ( 4 * cur[0] )
+                                        + cur[down_2]
+                                        - ( 3 * ( cur[up_1]
+                                                 + cur[down_1] ) ) );
+
                     // If the frame is sufficiently combed,
                     // then mark it down on the mask as 1.
                     if (combing > athresh6)
@@ -392,15 +538,14 @@ static void FUNC(detect_gamma_combed_segment)(hb_filter_private_t *pv,
                     }
                 }
             }
-
-            cur++;
-            prev++;
-            next++;
-            mask++;
         }
+
+        cur++;
+        prev++;
+        next++;
+        mask++;
     }
 }
-#endif
 
 #if defined (__aarch64__) && !defined(__APPLE__)
 #if BIT_DEPTH > 8
@@ -785,21 +930,11 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
 }
 #endif
 #else
-
 static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
                                         int segment_start, int segment_stop)
 {
-    // A mishmash of various comb detection tricks
-    // picked up from neuron2's Decomb plugin for
-    // AviSynth and tritical's IsCombedT and
-    // IsCombedTIVTC plugins.
-
-    // Comb scoring algorithm
-    const int spatial_metric  = pv->spatial_metric;
-    const int mthresh         = pv->motion_threshold;
-    const int athresh         = pv->spatial_threshold;
-    const int athresh_squared = pv->spatial_threshold_squared;
-    const int athresh6        = pv->spatial_threshold6;
+    CombDetectParams params;
+    comb_detect_params(pv, &params);
 
     // One pass for Y
     const int stride_prev  = pv->ref[0]->plane[0].stride / pv->bps;
@@ -821,114 +956,17 @@ static void FUNC(detect_combed_segment)(hb_filter_private_t *pv,
         segment_stop = height - 2;
     }
 
-    // These are just to make the buffer locations easier to read.
-    const int up_1_prev    = -1 * stride_prev;
-    const int down_1_prev  =      stride_prev;
-
-    const int up_2    = -2 * stride_cur;
-    const int up_1    = -1 * stride_cur;
-    const int down_1  =      stride_cur;
-    const int down_2  =  2 * stride_cur;
-
-    const int up_1_next    = -1 * stride_next;
-    const int down_1_next =       stride_next;
-
     for (int y = segment_start; y < segment_stop; y++)
     {
-        // We need to examine a column of 5 pixels
-        // in the prev, cur, and next frames.
         const pixel *prev = &((const pixel *)pv->ref[0]->plane[0].data)[y * stride_prev];
         const pixel *cur  = &((const pixel *)pv->ref[1]->plane[0].data)[y * stride_cur];
         const pixel *next = &((const pixel *)pv->ref[2]->plane[0].data)[y * stride_next];
         uint8_t *mask = &pv->mask->plane[0].data[y * mask_stride];
 
-        memset(mask, 0, mask_stride);
-
-        for (int x = 0; x < width; x++)
-        {
-            const int up_diff = cur[0] - cur[up_1];
-            const int down_diff = cur[0] - cur[down_1];
-
-            if ((up_diff >  athresh && down_diff >  athresh) ||
-                (up_diff < -athresh && down_diff < -athresh))
-            {
-                // The pixel above and below are different,
-                // and they change in the same "direction" too.
-                int motion = 0;
-                if (mthresh > 0)
-                {
-                    // Make sure there's sufficient motion between frame t-1 to frame t+1.
-                    if (abs(prev[0]     - cur[0]           ) > mthresh &&
-                        abs(cur[up_1]   - next[up_1_next]  ) > mthresh &&
-                        abs(cur[down_1] - next[down_1_next]) > mthresh)
-                    {
-                        motion++;
-                    }
-                    if (abs(next[0]           - cur[0]     ) > mthresh &&
-                        abs(prev[up_1_prev]   - cur[up_1]  ) > mthresh &&
-                        abs(prev[down_1_prev] - cur[down_1]) > mthresh)
-                    {
-                        motion++;
-                    }
-                }
-                else
-                {
-                    // User doesn't want to check for motion,
-                    // so move on to the spatial check.
-                    motion = 1;
-                }
-
-                // If motion, or we can't measure motion yet...
-                if (motion || pv->force_exaustive_check)
-                {
-                    // That means it's time for the spatial check.
-                    // We've got several options here.
-                    if (spatial_metric == 0)
-                    {
-                        // Simple 32detect style comb detection.
-                        if ((abs(cur[0] - cur[down_2]) < pv->comb32detect_min) &&
-                            (abs(cur[0] - cur[down_1]) > pv->comb32detect_max))
-                        {
-                            mask[0] = 1;
-                        }
-                    }
-                    else if (spatial_metric == 1)
-                    {
-                        // This, for comparison, is what IsCombed uses.
-                        // It's better, but still noise sensitive.
-                        const int combing = (cur[up_1] - cur[0]) *
-                                            (cur[down_1] - cur[0]);
-
-                        if (combing > athresh_squared)
-                        {
-                            mask[0] = 1;
-                        }
-                    }
-                    else if (spatial_metric == 2)
-                    {
-                        // Tritical's noise-resistant combing scorer.
-                        // The check is done on a bob+blur convolution.
-                        const int combing = abs( cur[up_2]
-                                            + ( 4 * cur[0] )
-                                            + cur[down_2]
-                                            - ( 3 * ( cur[up_1]
-                                                     + cur[down_1] ) ) );
-
-                        // If the frame is sufficiently combed,
-                        // then mark it down on the mask as 1.
-                        if (combing > athresh6)
-                        {
-                            mask[0] = 1;
-                        }
-                    }
-                }
-            }
-
-            cur++;
-            prev++;
-            next++;
-            mask++;
-        }
+        memset(mask + width, 0, mask_stride - width);
+        pv->functions.FUNC(detect_combed_row)(mask, prev, cur, next,
+                                              stride_prev, stride_cur, stride_next,
+                                              width, &params);
     }
 }
 #endif
@@ -361,9 +361,10 @@ static void FUNC(blend_filter_line)(const filter_param_t *filter,
 }
 #endif
 
-/// This function calls all the eedi2 filters in sequence for a given plane.
-/// It outputs the final interpolated image to pv->eedi_full[DST2PF].
-static void FUNC(eedi2_interpolate_plane)(hb_filter_private_t *pv, int plane)
+/// Runs one of the eedi2 passes on a band of a plane. The passes are run in
+/// sequence, each one filling buffers the next ones read from. The final
+/// interpolated image ends up in pv->eedi_full[DST2PF].
+static void FUNC(eedi2_filter_band)(hb_filter_private_t *pv, int stage, int plane, int band)
 {
     // We need all these pointers. No, seriously.
     // I swear. It's not a joke. They're used.
@@ -377,66 +378,141 @@ static void FUNC(eedi2_interpolate_plane)(hb_filter_private_t *pv, int plane)
     pixel *msk2p  = (pixel *)pv->eedi_full[MSK2PF]->plane[plane].data;
     pixel *tmp2p  = (pixel *)pv->eedi_full[TMP2PF]->plane[plane].data;
     pixel *dst2mp = (pixel *)pv->eedi_full[DST2MPF]->plane[plane].data;
-    int *cx2 = pv->cx2;
-    int *cy2 = pv->cy2;
-    int *cxy = pv->cxy;
-    int *tmpc = pv->tmpc;
+    int *cx2 = pv->cx2[plane];
+    int *cy2 = pv->cy2[plane];
+    int *cxy = pv->cxy[plane];
+    int *tmpc = pv->tmpc[plane];
 
     const int pitch = pv->eedi_full[0]->plane[plane].stride / pv->bps;
     const int height = pv->eedi_full[0]->plane[plane].height;
     const int width = pv->eedi_full[0]->plane[plane].width;
     const int half_height = pv->eedi_half[0]->plane[plane].height;
 
-    // edge mask
-    FUNC(eedi2_build_edge_mask)(mskp, pitch, srcp, pitch,
-                     pv->magnitude_threshold, pv->variance_threshold, pv->laplacian_threshold,
-                     half_height, width, pv->depth);
-    FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_dilate_edge_mask)(tmpp, pitch, mskp, pitch, pv->dilation_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth);
-    FUNC(eedi2_remove_small_gaps)(tmpp, pitch, mskp, pitch, half_height, width, pv->depth);
-
-    // direction mask
-    FUNC(eedi2_calc_directions)(plane, mskp, pitch, srcp, pitch, tmpp, pitch,
-                     pv->maximum_search_distance, pv->noise_threshold,
-                     half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_dir_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_expand_dir_map)(mskp, pitch, dstp, pitch, tmpp, pitch, half_height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth);
-
-    // upscale 2x vertically
-    FUNC(eedi2_upscale_by_2)(srcp, dst2p, half_height, pitch);
-    FUNC(eedi2_upscale_by_2)(dstp, tmp2p2, half_height, pitch);
-    FUNC(eedi2_upscale_by_2)(mskp, msk2p, half_height, pitch);
-
-    // upscale the direction mask
-    FUNC(eedi2_mark_directions_2x)(msk2p, pitch, tmp2p2, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch,  dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth);
-    FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth);
-
-    // interpolate a full-size plane
-    FUNC(eedi2_interpolate_lattice)( plane, tmp2p, pitch, dst2p, pitch, tmp2p2, pitch, pv->tff,
-                         pv->noise_threshold, height, width, pv->depth, pv->eedi_limlut);
-
-    if (pv->post_processing == 1 || pv->post_processing == 3)
+    // Rows of the half-height and of the full-height planes of this band
+    int hs, he, fs, fe;
+    eedi2_band(pv, band, half_height, &hs, &he);
+    eedi2_band(pv, band, height, &fs, &fe);
+
+    switch (stage)
     {
+        case EEDI2_FILL_HALF_HEIGHT:
+        {
+            // Copy the first field from the source to a half-height frame.
+            const int src_pitch = pv->ref[1]->plane[plane].stride / pv->bps;
+            const int start_line = !pv->tff;
+            pixel *src = &((pixel *)pv->ref[1]->plane[plane].data)[src_pitch * start_line];
+
+            eedi2_band(pv, band, (pv->ref[1]->plane[plane].height + 1) / 2, &hs, &he);
+            FUNC(eedi2_fill_half_height_buffer_plane)(src + 2 * hs * src_pitch, srcp + hs * pitch,
+                                                      src_pitch, pitch, 2 * (he - hs));
+        } break;
+
+        // edge mask
+        case EEDI2_BUILD_EDGE_MASK:
+            FUNC(eedi2_build_edge_mask)(mskp, pitch, srcp, pitch,
+                             pv->magnitude_threshold, pv->variance_threshold, pv->laplacian_threshold,
+                             half_height, width, pv->depth, hs, he);
+            break;
+        case EEDI2_ERODE_EDGE_MASK:
+            FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth, hs, he);
+            break;
+        case EEDI2_DILATE_EDGE_MASK:
+            FUNC(eedi2_dilate_edge_mask)(tmpp, pitch, mskp, pitch, pv->dilation_threshold, half_height, width, pv->depth, hs, he);
+            break;
+        case EEDI2_ERODE_EDGE_MASK_2:
+            FUNC(eedi2_erode_edge_mask)(mskp, pitch, tmpp, pitch, pv->erosion_threshold, half_height, width, pv->depth, hs, he);
+            break;
+        case EEDI2_REMOVE_SMALL_GAPS:
+            FUNC(eedi2_remove_small_gaps)(tmpp, pitch, mskp, pitch, half_height, width, pv->depth, hs, he);
+            break;
+
+        // direction mask
+        case EEDI2_CALC_DIRECTIONS:
+            FUNC(eedi2_calc_directions)(&pv->eedi2_functions, plane, mskp, pitch, srcp, pitch, tmpp, pitch,
+                             pv->maximum_search_distance, pv->noise_threshold,
+                             half_height, width, pv->depth, pv->eedi_limlut, hs, he);
+            break;
+        case EEDI2_FILTER_DIR_MAP:
+            FUNC(eedi2_filter_dir_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, pv->eedi_limlut, hs, he);
+            break;
+        case EEDI2_EXPAND_DIR_MAP:
+            FUNC(eedi2_expand_dir_map)(mskp, pitch, dstp, pitch, tmpp, pitch, half_height, width, pv->depth, pv->eedi_limlut, hs, he);
+            break;
+        case EEDI2_FILTER_MAP:
+            FUNC(eedi2_filter_map)(mskp, pitch, tmpp, pitch, dstp, pitch, half_height, width, pv->depth, hs, he);
+            break;
+
+        // upscale 2x vertically
+        case EEDI2_UPSCALE_BY_2:
+            FUNC(eedi2_upscale_by_2)(srcp + hs * pitch, dst2p + 2 * hs * pitch, he - hs, pitch);
+            FUNC(eedi2_upscale_by_2)(dstp + hs * pitch, tmp2p2 + 2 * hs * pitch, he - hs, pitch);
+            FUNC(eedi2_upscale_by_2)(mskp + hs * pitch, msk2p + 2 * hs * pitch, he - hs, pitch);
+            break;
+
+        // upscale the direction mask
+        case EEDI2_MARK_DIRECTIONS_2X:
+            FUNC(eedi2_mark_directions_2x)(msk2p, pitch, tmp2p2, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, fs, fe);
+            break;
+        case EEDI2_FILTER_DIR_MAP_2X:
+        case EEDI2_POST_FILTER_DIR_MAP_2X:
+            FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch,  dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, fs, fe);
+            break;
+        case EEDI2_EXPAND_DIR_MAP_2X:
+        case EEDI2_POST_EXPAND_DIR_MAP_2X:
+            FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, fs, fe);
+            break;
+        case EEDI2_FILL_GAPS_2X:
+            FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth, fs, fe);
+            break;
+        case EEDI2_FILL_GAPS_2X_2:
+            FUNC(eedi2_fill_gaps_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, fs, fe);
+            break;
+
+        // interpolate a full-size plane
+        case EEDI2_INTERPOLATE_LATTICE:
+            FUNC(eedi2_interpolate_lattice)( plane, tmp2p, pitch, dst2p, pitch, tmp2p2, pitch, pv->tff,
+                                 pv->noise_threshold, height, width, pv->depth, pv->eedi_limlut, fs, fe);
+            break;
+
         // make sure the edge directions are consistent
-        FUNC(eedi2_bit_blit)( tmp2p2, pitch, tmp2p, pitch, width, height);
-        FUNC(eedi2_filter_dir_map_2x)(msk2p, pitch, tmp2p, pitch, dst2mp, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-        FUNC(eedi2_expand_dir_map_2x)(msk2p, pitch, dst2mp, pitch, tmp2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-        FUNC(eedi2_post_process)(tmp2p, pitch, tmp2p2, pitch, dst2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut);
-    }
-    if (pv->post_processing == 2 || pv->post_processing == 3)
-    {
+        case EEDI2_POST_BIT_BLIT:
+            FUNC(eedi2_bit_blit)(tmp2p2 + fs * pitch, pitch, tmp2p + fs * pitch, pitch, width, fe - fs);
+            break;
+        case EEDI2_POST_PROCESS:
+            FUNC(eedi2_post_process)(tmp2p, pitch, tmp2p2, pitch, dst2p, pitch, pv->tff, height, width, pv->depth, pv->eedi_limlut, fs, fe);
+            break;
+
         // filter junctions and corners
-        FUNC(eedi2_gaussian_blur1)( srcp, pitch, tmpp, pitch, srcp, pitch, half_height, width );
-        FUNC(eedi2_calc_derivatives)(srcp, pitch, half_height, width, cx2, cy2, cxy, pv->depth);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cx2, tmpc, cx2, pitch, half_height, width);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cy2, tmpc, cy2, pitch, half_height, width);
-        FUNC(eedi2_gaussian_blur_sqrt2)( cxy, tmpc, cxy, pitch, half_height, width);
-        FUNC(eedi2_post_process_corner)(cx2, cy2, cxy, pitch, tmp2p2, pitch, dst2p, pitch, height, width, pv->tff, pv->depth);
+        case EEDI2_BLUR_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur1_horizontal)(srcp, pitch, tmpp, pitch, width, hs, he);
+            break;
+        case EEDI2_BLUR_VERTICAL:
+            FUNC(eedi2_gaussian_blur1_vertical)(tmpp, pitch, srcp, pitch, half_height, width, hs, he);
+            break;
+        case EEDI2_CALC_DERIVATIVES:
+            FUNC(eedi2_calc_derivatives)(srcp, pitch, half_height, width, cx2, cy2, cxy, pv->depth, hs, he);
+            break;
+        case EEDI2_BLUR_X2_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cx2, tmpc, pitch, width, hs, he);
+            break;
+        case EEDI2_BLUR_X2_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cx2, pitch, half_height, width, hs, he);
+            break;
+        case EEDI2_BLUR_Y2_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cy2, tmpc, pitch, width, hs, he);
+            break;
+        case EEDI2_BLUR_Y2_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cy2, pitch, half_height, width, hs, he);
+            break;
+        case EEDI2_BLUR_XY_HORIZONTAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(cxy, tmpc, pitch, width, hs, he);
+            break;
+        case EEDI2_BLUR_XY_VERTICAL:
+            FUNC(eedi2_gaussian_blur_sqrt2_vertical)(tmpc, cxy, pitch, half_height, width, hs, he);
+            break;
+        case EEDI2_POST_PROCESS_CORNER:
+            FUNC(eedi2_post_process_corner)(cx2, cy2, cxy, pitch, tmp2p2, pitch, dst2p, pitch, height, width, pv->tff, pv->depth, fs, fe);
+            break;
     }
 }
 
@@ -444,32 +520,33 @@ static void FUNC(eedi2_filter_work)(void *thread_args_v)
 {
     eedi2_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
-    int plane = thread_args->arg.segment;
+    int band = thread_args->arg.segment;
 
-    //Process plane
-    FUNC(eedi2_interpolate_plane)(pv, plane);
+    // Process the band of each plane
+    for (int plane = 0; plane < 3; plane++)
+    {
+        FUNC(eedi2_filter_band)(pv, pv->eedi2_stage, plane, band);
+    }
 }
 
-/// Sets up the input field planes for EEDI2 in pv->eedi_half[SRCPF]
-/// and then runs eedi2_filter_thread for each plane.
+/// Runs the eedi2 passes on all the planes, each pass starting
+/// once the eedi2 threads are done with the previous one.
 static void FUNC(eedi2_planer)(hb_filter_private_t *pv)
 {
-    // Copy the first field from the source to a half-height frame.
-    for (int pp = 0;  pp < 3; pp++)
+    for (int stage = 0; stage < EEDI2_STAGE_COUNT; stage++)
     {
-        const int src_pitch = pv->ref[1]->plane[pp].stride / pv->bps;
-        const int dst_pitch = pv->eedi_half[SRCPF]->plane[pp].stride / pv->bps;
-        const int height = pv->ref[1]->plane[pp].height;
-        const int start_line = !pv->tff;
+        if ((stage >= EEDI2_POST_BIT_BLIT && stage <= EEDI2_POST_PROCESS &&
+             pv->post_processing != 1 && pv->post_processing != 3) ||
+            (stage >= EEDI2_BLUR_HORIZONTAL && stage <= EEDI2_POST_PROCESS_CORNER &&
+             pv->post_processing != 2 && pv->post_processing != 3))
+        {
+            continue;
+        }
 
-        FUNC(eedi2_fill_half_height_buffer_plane)(&((pixel *)pv->ref[1]->plane[pp].data)[src_pitch * start_line],
-                                                  (pixel *)pv->eedi_half[SRCPF]->plane[pp].data,
-                                                  src_pitch, dst_pitch, height);
+        // Fire off the threads and wait for their completion.
+        pv->eedi2_stage = stage;
+        taskset_cycle(&pv->eedi2_taskset);
     }
-
-    // Now that all data is ready for our threads, fire them off
-    // and wait for their completion.
-    taskset_cycle(&pv->eedi2_taskset);
 }
 
 /// EDDI: Edge Directed Deinterlacing Interpolation
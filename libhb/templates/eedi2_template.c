@@ -118,9 +118,11 @@ void FUNC(eedi2_upscale_by_2)(const pixel *srcp, pixel *dstp, const int height,
  * @param lthresh Laplacian threshold, ensures edges are still prominent in the 2nd spatial derivative of the srcp plane (20 is a good default value)
  * @param height Height of half-height single-field frame
  * @param width Width of srcp bitmap rows, as opposed to the padded stride in src_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *srcp, const int src_pitch,
-                                 int mthresh, const int lthresh, int vthresh, const int height, const int width, const int depth)
+                                 int mthresh, const int lthresh, int vthresh, const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
     const pixel shift = depth - 8;
@@ -129,13 +131,20 @@ void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *
     mthresh = mthresh * 10;
     vthresh = vthresh * 81;
 
-    memset(dstp, 0, (height / 2) * dst_pitch * BPS);
+    // Only the rows of the top half are cleared
+    const int clear_stop = MIN(height / 2, y_stop);
+    if (clear_stop > y_start)
+    {
+        memset(dstp + y_start * dst_pitch, 0, (clear_stop - y_start) * dst_pitch * BPS);
+    }
 
-    srcp += src_pitch;
-    dstp += dst_pitch;
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+    srcp += src_pitch * y_first;
+    dstp += dst_pitch * y_first;
     const pixel *srcpp = srcp-src_pitch;
     const pixel *srcpn = srcp+src_pitch;
-    for (int y = 1; y < height - 1; ++y )
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width-1; ++x )
         {
@@ -203,19 +212,24 @@ void FUNC(eedi2_build_edge_mask)(pixel *dstp, const int dst_pitch, const pixel *
  * @param dstr Dilation threshold, ensures a pixel is only retained as an edge in dstp if this number of adjacent pixels or greater are also edges in mskp (4 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_dilate_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                  const int dstr, const int height, const int width, const int depth)
+                                  const int dstr, const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, mskp, msk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch, width, y_stop - y_start);
 
-    mskp += msk_pitch;
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+
+    mskp += msk_pitch * y_first;
     const pixel *mskpp = mskp - msk_pitch;
     const pixel *mskpn = mskp + msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -255,19 +269,24 @@ void FUNC(eedi2_dilate_edge_mask)(const pixel *mskp, const int msk_pitch, pixel
  * @param estr Erosion threshold, ensures a pixel isn't retained as an edge in dstp if fewer than this number of adjacent pixels are also edges in mskp (2 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_erode_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                 const int estr, const int height, const int width, const int depth)
+                                 const int estr, const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, mskp, msk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch, width, y_stop - y_start);
+
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
 
-    mskp += msk_pitch;
+    mskp += msk_pitch * y_first;
     const pixel *mskpp = mskp - msk_pitch;
     const pixel *mskpn = mskp + msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -304,17 +323,22 @@ void FUNC(eedi2_erode_edge_mask)(const pixel *mskp, const int msk_pitch, pixel *
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_remove_small_gaps)(const pixel *mskp, const int msk_pitch, pixel *dstp, const int dst_pitch,
-                                   const int height, const int width, const int depth)
+                                   const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel peak = (1 << depth) - 1;
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, mskp, msk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, mskp + y_start * msk_pitch, msk_pitch, width, y_stop - y_start);
 
-    mskp += msk_pitch;
-    dstp += dst_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+
+    mskp += msk_pitch * y_first;
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 3; x < width - 3; ++x)
         {
@@ -341,8 +365,118 @@ void FUNC(eedi2_remove_small_gaps)(const pixel *mskp, const int msk_pitch, pixel
     }
 }
 
+/**
+ * Searches the directions of an edge pixel for eedi2_calc_directions, from startu to stopu
+ * @param src2p Pointer to the row two rows above the pixel, only read when top is 0
+ * @param srcpp Pointer to the row above the pixel
+ * @param srcp Pointer to the row of the pixel
+ * @param srcpn Pointer to the row below the pixel
+ * @param src2n Pointer to the row two rows below the pixel, only read when bottom is 0
+ * @param mskpp Pointer to the edge mask row above the pixel
+ * @param mskpn Pointer to the edge mask row below the pixel
+ * @param x Column of the pixel
+ * @param startu First direction to check
+ * @param stopu Last direction to check
+ * @param top Whether the pixel is on the second row of the frame
+ * @param bottom Whether the pixel is on the second to last row of the frame
+ * @param peak Maximum pixel value, marks the edges in the mask
+ * @param min Smallest metrics a to e found so far, updated with the ones of the checked directions
+ * @param dir Directions of the smallest metrics, -5000 when none was found
+ */
+void FUNC(eedi2_search_directions)(const pixel *src2p, const pixel *srcpp, const pixel *srcp, const pixel *srcpn, const pixel *src2n,
+                                   const pixel *mskpp, const pixel *mskpn, const int x, const int startu, const int stopu,
+                                   const int top, const int bottom, const int peak, int min[5], int dir[5])
+{
+    int mina = min[0], minb = min[1], minc = min[2], mind = min[3], mine = min[4];
+    int dira = dir[0], dirb = dir[1], dirc = dir[2], dird = dir[3], dire = dir[4];
+
+    for (int u = startu; u <= stopu; ++u )
+    {
+        if (top ||
+              mskpp[x-1+u] == peak || mskpp[x+u] == peak || mskpp[x+1+u] == peak )
+        {
+            if( bottom ||
+                mskpn[x-1-u] == peak || mskpn[x-u] == peak || mskpn[x+1-u] == peak )
+            {
+                const int diffsn = abs(  srcp[x-1] - srcpn[x-1-u] ) +
+                                   abs(  srcp[x]   - srcpn[x-u] )   +
+                                   abs(  srcp[x+1] - srcpn[x+1-u] );
+
+                const int diffsp = abs(  srcp[x-1] - srcpp[x-1+u] ) +
+                                   abs(  srcp[x]   - srcpp[x+u] )   +
+                                   abs(  srcp[x+1] - srcpp[x+1+u] );
+
+                const int diffps = abs( srcpp[x-1] -  srcp[x-1-u] ) +
+                                   abs( srcpp[x]   -  srcp[x-u] )   +
+                                   abs( srcpp[x+1] -  srcp[x+1-u] );
+
+                const int diffns = abs( srcpn[x-1] -  srcp[x-1+u] ) +
+                                   abs( srcpn[x]   -  srcp[x+u] )   +
+                                   abs( srcpn[x+1] -  srcp[x+1+u] );
+
+                const int diff = diffsn + diffsp + diffps + diffns;
+                int diffd = diffsp + diffns;
+                int diffe = diffsn + diffps;
+                if( diff < minb )
+                {
+                    dirb = u;
+                    minb = diff;
+                }
+                if( __builtin_expect( !top, 1) )
+                {
+                    const int diff2pp = abs( src2p[x-1] - srcpp[x-1-u] ) +
+                                    abs( src2p[x]   - srcpp[x-u] )   +
+                                    abs( src2p[x+1] - srcpp[x+1-u] );
+                    const int diffp2p = abs( srcpp[x-1] - src2p[x-1+u] ) +
+                                    abs( srcpp[x]   - src2p[x+u] )   +
+                                    abs( srcpp[x+1] - src2p[x+1+u] );
+                    const int diffa = diff + diff2pp + diffp2p;
+                    diffd += diffp2p;
+                    diffe += diff2pp;
+                    if( diffa < mina )
+                    {
+                        dira = u;
+                        mina = diffa;
+                    }
+                }
+                if( __builtin_expect( !bottom, 1) )
+                {
+                    const int diff2nn = abs( src2n[x-1] - srcpn[x-1+u] ) +
+                                        abs( src2n[x]   - srcpn[x+u] )   +
+                                        abs( src2n[x+1] - srcpn[x+1+u] );
+                    const int diffn2n = abs( srcpn[x-1] - src2n[x-1-u] ) +
+                                        abs( srcpn[x]   - src2n[x-u] )   +
+                                        abs( srcpn[x+1] - src2n[x+1-u] );
+                    const int diffc = diff + diff2nn + diffn2n;
+                    diffd += diff2nn;
+                    diffe += diffn2n;
+                    if( diffc < minc )
+                    {
+                        dirc = u;
+                        minc = diffc;
+                    }
+                }
+                if( diffd < mind )
+                {
+                    dird = u;
+                    mind = diffd;
+                }
+                if( diffe < mine )
+                {
+                    dire = u;
+                    mine = diffe;
+                }
+            }
+        }
+    }
+
+    min[0] = mina; min[1] = minb; min[2] = minc; min[3] = mind; min[4] = mine;
+    dir[0] = dira; dir[1] = dirb; dir[2] = dirc; dir[3] = dird; dir[4] = dire;
+}
+
 /**
  * Calculates spatial direction vectors for the edges. This is EEDI2's timesink, and can be thought of as YADIF_CHECK on steroids, as both try to discern which angle a given edge follows
+ * @param functions Kernels searching the directions of a pixel
  * @param plane The plane of the image being processed, to know to reduce maxd for chroma planes (HandBrake only works with YUV420 video so it is assumed they are half-height)
  * @param mskp Pointer to the source edge mask being read from
  * @param msk_pitch Stride of mskp
@@ -354,9 +488,11 @@ void FUNC(eedi2_remove_small_gaps)(const pixel *mskp, const int msk_pitch, pixel
  * @param nt Noise threshold (50 is a good default value)
  * @param height Height of half-height field-sized frame
  * @param width Width of srcp bitmap rows, as opposed to the pdded stride in src_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
-void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int msk_pitch, const pixel *srcp, const int src_pitch,
-                                 pixel *dstp, const int dst_pitch, const int maxd, const int nt, const int height, const int width, const int depth, const pixel limlut[33])
+void FUNC(eedi2_calc_directions)(const EEDI2Functions *functions, const int plane, const pixel *mskp, const int msk_pitch, const pixel *srcp, const int src_pitch,
+                                 pixel *dstp, const int dst_pitch, const int maxd, const int nt, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -366,18 +502,21 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
 
     if (depth == 8)
     {
-        memset(dstp, 255, dst_pitch * height);
+        memset(dstp + y_start * dst_pitch, 255, dst_pitch * (y_stop - y_start));
     }
     else
     {
-        for (int i = 0; i < dst_pitch * height; i++)
+        for (int i = y_start * dst_pitch; i < dst_pitch * y_stop; i++)
         {
             dstp[i] = peak;
         }
     }
-    mskp += msk_pitch;
-    dstp += dst_pitch;
-    srcp += src_pitch;
+
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+    mskp += msk_pitch * y_first;
+    dstp += dst_pitch * y_first;
+    srcp += src_pitch * y_first;
     const pixel *src2p = srcp - src_pitch * 2;
     const pixel *srcpp = srcp - src_pitch;
     const pixel *srcpn = srcp + src_pitch;
@@ -386,7 +525,7 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
     const pixel *mskpn = mskp + msk_pitch;
     const int maxdt = plane == 0 ? maxd : ( maxd >> 1 );
 
-    for (int y = 1; y < height - 1; ++y )
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x )
         {
@@ -394,95 +533,17 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
                 continue;
             const int startu = MAX( -x + 1, -maxdt );
             const int stopu = MIN( width - 2 - x, maxdt );
-            int minb = MIN( nt13,
-                            ( abs( srcp[x] - srcpn[x] ) +
-                              abs( srcp[x] - srcpp[x] ) ) * 6 );
-            int mina = MIN( nt19,
-                            ( abs( srcp[x] - srcpn[x] ) +
-                              abs( srcp[x] - srcpp[x] ) ) * 9 );
-            int minc = mina;
-            int mind = minb;
-            int mine = minb;
-            int dira = -5000, dirb = -5000, dirc = -5000, dird = -5000, dire = -5000;
-            for (int u = startu; u <= stopu; ++u )
-            {
-                if (y == 1 ||
-                      mskpp[x-1+u] == peak || mskpp[x+u] == peak || mskpp[x+1+u] == peak )
-                {
-                    if( y == height - 2 ||
-                        mskpn[x-1-u] == peak || mskpn[x-u] == peak || mskpn[x+1-u] == peak )
-                    {
-                        const int diffsn = abs(  srcp[x-1] - srcpn[x-1-u] ) +
-                                           abs(  srcp[x]   - srcpn[x-u] )   +
-                                           abs(  srcp[x+1] - srcpn[x+1-u] );
-
-                        const int diffsp = abs(  srcp[x-1] - srcpp[x-1+u] ) +
-                                           abs(  srcp[x]   - srcpp[x+u] )   +
-                                           abs(  srcp[x+1] - srcpp[x+1+u] );
-
-                        const int diffps = abs( srcpp[x-1] -  srcp[x-1-u] ) +
-                                           abs( srcpp[x]   -  srcp[x-u] )   +
-                                           abs( srcpp[x+1] -  srcp[x+1-u] );
-
-                        const int diffns = abs( srcpn[x-1] -  srcp[x-1+u] ) +
-                                           abs( srcpn[x]   -  srcp[x+u] )   +
-                                           abs( srcpn[x+1] -  srcp[x+1+u] );
-
-                        const int diff = diffsn + diffsp + diffps + diffns;
-                        int diffd = diffsp + diffns;
-                        int diffe = diffsn + diffps;
-                        if( diff < minb )
-                        {
-                            dirb = u;
-                            minb = diff;
-                        }
-                        if( __builtin_expect( y > 1, 1) )
-                        {
-                            const int diff2pp = abs( src2p[x-1] - srcpp[x-1-u] ) +
-                                            abs( src2p[x]   - srcpp[x-u] )   +
-                                            abs( src2p[x+1] - srcpp[x+1-u] );
-                            const int diffp2p = abs( srcpp[x-1] - src2p[x-1+u] ) +
-                                            abs( srcpp[x]   - src2p[x+u] )   +
-                                            abs( srcpp[x+1] - src2p[x+1+u] );
-                            const int diffa = diff + diff2pp + diffp2p;
-                            diffd += diffp2p;
-                            diffe += diff2pp;
-                            if( diffa < mina )
-                            {
-                                dira = u;
-                                mina = diffa;
-                            }
-                        }
-                        if( __builtin_expect( y < height-2, 1) )
-                        {
-                            const int diff2nn = abs( src2n[x-1] - srcpn[x-1+u] ) +
-                                                abs( src2n[x]   - srcpn[x+u] )   +
-                                                abs( src2n[x+1] - srcpn[x+1+u] );
-                            const int diffn2n = abs( srcpn[x-1] - src2n[x-1-u] ) +
-                                                abs( srcpn[x]   - src2n[x-u] )   +
-                                                abs( srcpn[x+1] - src2n[x+1-u] );
-                            const int diffc = diff + diff2nn + diffn2n;
-                            diffd += diff2nn;
-                            diffe += diffn2n;
-                            if( diffc < minc )
-                            {
-                                dirc = u;
-                                minc = diffc;
-                            }
-                        }
-                        if( diffd < mind )
-                        {
-                            dird = u;
-                            mind = diffd;
-                        }
-                        if( diffe < mine )
-                        {
-                            dire = u;
-                            mine = diffe;
-                        }
-                    }
-                }
-            }
+            const int minb = MIN( nt13,
+                                  ( abs( srcp[x] - srcpn[x] ) +
+                                    abs( srcp[x] - srcpp[x] ) ) * 6 );
+            const int mina = MIN( nt19,
+                                  ( abs( srcp[x] - srcpn[x] ) +
+                                    abs( srcp[x] - srcpp[x] ) ) * 9 );
+            int min[5] = { mina, minb, mina, minb, minb };
+            int dir[5] = { -5000, -5000, -5000, -5000, -5000 };
+            functions->FUNC(search_directions)(src2p, srcpp, srcp, srcpn, src2n, mskpp, mskpn,
+                                               x, startu, stopu, y == 1, y == height - 2, peak, min, dir);
+            const int dira = dir[0], dirb = dir[1], dirc = dir[2], dird = dir[3], dire = dir[4];
             int order[5], k=0;
             if( dira != -5000 ) order[k++] = dira;
             if( dirb != -5000 ) order[k++] = dirb;
@@ -534,25 +595,30 @@ void FUNC(eedi2_calc_directions)(const int plane, const pixel *mskp, const int m
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of mskp bitmap rows, as opposed to the pdded stride in msk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_filter_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, int dmsk_pitch,
-                            pixel *dstp, const int dst_pitch, const int height, const int width, const int depth)
+                            pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift = 2 + (depth - 8);
     const int twelve = 12 << shift;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
 
-    mskp += msk_pitch;
-    dmskp += dmsk_pitch;
-    dstp += dst_pitch;
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+
+    mskp += msk_pitch * y_first;
+    dmskp += dmsk_pitch * y_first;
+    dstp += dst_pitch * y_first;
 
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
 
-    for (int y = 1; y < height - 1; ++y)
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -645,22 +711,27 @@ void FUNC(eedi2_filter_map)(const pixel *mskp, const int msk_pitch, const pixel
  * @param dst_pitch Stride of dstp
  * @param height Height of half_height field-sized frame
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_filter_dir_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33])
+                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, dmskp, dmsk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
+
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
 
-    dmskp += dmsk_pitch;
+    dmskp += dmsk_pitch * y_first;
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
-    dstp += dst_pitch;
-    mskp += msk_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y_first;
+    mskp += msk_pitch * y_first;
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -718,22 +789,27 @@ void FUNC(eedi2_filter_dir_map)(const pixel *mskp, const int msk_pitch, const pi
  * @param dst_pitch Stride of dstp
  * @param height Height of half-height field-sized frame
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_expand_dir_map)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33])
+                                 pixel *dstp, const int dst_pitch, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
+
+    const int y_first = MAX(1, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
 
-    dmskp += dmsk_pitch;
+    dmskp += dmsk_pitch * y_first;
     const pixel *dmskpp = dmskp - dmsk_pitch;
     const pixel *dmskpn = dmskp + dmsk_pitch;
-    dstp += dst_pitch;
-    mskp += msk_pitch;
-    for (int y = 1; y < height - 1; ++y)
+    dstp += dst_pitch * y_first;
+    mskp += msk_pitch * y_first;
+    for (int y = y_first; y < y_last; ++y)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -783,9 +859,11 @@ void FUNC(eedi2_expand_dir_map)(const pixel *mskp, const int msk_pitch, const pi
  * @param tff Whether or not the frame parity is Top Field First
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_mark_directions_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                     pixel *dstp, const int dst_pitch, const int tff, const int height, const int width, const int depth, const pixel limlut[33])
+                                     pixel *dstp, const int dst_pitch, const int tff, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -793,21 +871,24 @@ void FUNC(eedi2_mark_directions_2x)(const pixel *mskp, const int msk_pitch, cons
 
     if (depth == 8)
     {
-        memset(dstp, 255, dst_pitch * height);
+        memset(dstp + y_start * dst_pitch, 255, dst_pitch * (y_stop - y_start));
     }
     else
     {
-        for (int i = 0; i < dst_pitch * height; i++)
+        for (int i = y_start * dst_pitch; i < dst_pitch * y_stop; i++)
         {
             dstp[i] = peak;
         }
     }
-    dstp  += dst_pitch  * ( 2 - tff );
-    dmskp += dmsk_pitch * ( 1 - tff );
-    mskp  += msk_pitch  * ( 1 - tff );
+
+    const int y_first = eedi2_first_row(2 - tff, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+    dstp  += dst_pitch  * y_first;
+    dmskp += dmsk_pitch * ( y_first - 1 );
+    mskp  += msk_pitch  * ( y_first - 1 );
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
     const pixel *mskpn = mskp + msk_pitch * 2;
-    for (int y = 2 - tff; y < height - 1; y += 2)
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -868,23 +949,28 @@ void FUNC(eedi2_mark_directions_2x)(const pixel *mskp, const int msk_pitch, cons
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_filter_dir_map_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, int dmsk_pitch,
-                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)(dstp, dst_pitch, dmskp, dmsk_pitch, width, height);
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
+
+    const int y_first = eedi2_first_row(2 - field, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    dmskp += dmsk_pitch * y_first;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y_first - 1 );
     const pixel *mskpn = mskp + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -949,23 +1035,28 @@ void FUNC(eedi2_filter_dir_map_2x)(const pixel *mskp, const int msk_pitch, const
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_expand_dir_map_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                                   pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
+
+    const int y_first = eedi2_first_row(2 - field, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    dmskp += dmsk_pitch * y_first;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y_first - 1 );
     const pixel *mskpn = mskp + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -1021,9 +1112,11 @@ void FUNC(eedi2_expand_dir_map_2x)(const pixel *mskp, const int msk_pitch, const
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dmskp bitmap rows, as opposed to the pdded stride in dmsk_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixel *dmskp, const int dmsk_pitch,
-                              pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth)
+                              pixel *dstp, const int dst_pitch, const int field, const int height, const int width, const int depth, const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -1033,17 +1126,20 @@ void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixe
     const int twenty = 20 << shift;
     const int fiveHundred = 500 << shift;
 
-    FUNC(eedi2_bit_blit)( dstp, dst_pitch, dmskp, dmsk_pitch, width, height );
+    FUNC(eedi2_bit_blit)(dstp + y_start * dst_pitch, dst_pitch, dmskp + y_start * dmsk_pitch, dmsk_pitch, width, y_stop - y_start);
 
-    dmskp += dmsk_pitch * ( 2 - field );
+    const int y_first = eedi2_first_row(2 - field, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+
+    dmskp += dmsk_pitch * y_first;
     const pixel *dmskpp = dmskp - dmsk_pitch * 2;
     const pixel *dmskpn = dmskp + dmsk_pitch * 2;
-    mskp += msk_pitch * ( 1 - field );
+    mskp += msk_pitch * ( y_first - 1 );
     const pixel *mskpp = mskp - msk_pitch * 2;
     const pixel *mskpn = mskp + msk_pitch * 2;
     const pixel *mskpnn = mskpn + msk_pitch * 2;
-    dstp += dst_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dstp += dst_pitch * y_first;
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 1; x < width - 1; ++x)
         {
@@ -1144,10 +1240,12 @@ void FUNC(eedi2_fill_gaps_2x)(const pixel *mskp, const int msk_pitch, const pixe
  * @nt Noise threshold, (50 is a good default value)
  * @param height Height of the full-frame output
  * @param width Width of dstp bitmap rows, as opposed to the pdded stride in dst_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int dmsk_pitch, pixel *dstp,
                                       const int dst_pitch, pixel *omskp, const int omsk_pitch, const int field, const int nt,
-                                      const int height, const int width, const int depth, const pixel limlut[33])
+                                      const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
@@ -1159,7 +1257,7 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
     const pixel nt7 = (nt << (depth - 8)) * 7;
     const pixel nt8 = (nt << (depth - 8)) * 8;
 
-    if (field == 1)
+    if (field == 1 && y_start <= height - 1 && height - 1 < y_stop)
     {
         FUNC(eedi2_bit_blit)( dstp + ( height - 1 ) * dst_pitch,
                   dst_pitch,
@@ -1168,7 +1266,7 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
                   width,
                   1 );
     }
-    else
+    else if (field == 0 && y_start == 0)
     {
         FUNC(eedi2_bit_blit)( dstp,
                   dst_pitch,
@@ -1178,13 +1276,15 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
                   1 );
     }
 
-    dstp += dst_pitch * ( 1 - field );
-    omskp += omsk_pitch * ( 1 - field );
+    const int y_first = eedi2_first_row(2 - field, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+    dstp += dst_pitch * ( y_first - 1 );
+    omskp += omsk_pitch * ( y_first - 1 );
     pixel *dstpn = dstp + dst_pitch;
     pixel *dstpnn = dstp + dst_pitch * 2;
     pixel *omskn = omskp + omsk_pitch * 2;
-    dmskp += dmsk_pitch * ( 2 - field );
-    for (int y = 2 - field; y < height - 1; y += 2)
+    dmskp += dmsk_pitch * y_first;
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 0; x < width; ++x)
         {
@@ -1345,21 +1445,25 @@ void FUNC(eedi2_interpolate_lattice)( const int plane, pixel *dmskp, const int d
  * @param field Field to filter
  * @param height Height of the full-frame output
  * @param width Width of dstp bitmap rows, as opposed to the pdded stride in src_pitch
+ * @param y_start First row of the output to process
+ * @param y_stop Row after the last one to process
  */
 void FUNC(eedi2_post_process)(const pixel *nmskp, const int nmsk_pitch, const pixel *omskp, const int omsk_pitch,
-                               pixel *dstp, const int src_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33])
+                               pixel *dstp, const int src_pitch, const int field, const int height, const int width, const int depth, const pixel limlut[33], const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
     const pixel shift2 = 2 + (depth - 8);
 
-    nmskp += ( 2 - field ) * nmsk_pitch;
-    omskp += ( 2 - field ) * omsk_pitch;
-    dstp += ( 2 - field ) * src_pitch;
+    const int y_first = eedi2_first_row(2 - field, 2, y_start);
+    const int y_last  = MIN(height - 1, y_stop);
+    nmskp += y_first * nmsk_pitch;
+    omskp += y_first * omsk_pitch;
+    dstp += y_first * src_pitch;
     pixel *srcpp = dstp - src_pitch;
     pixel *srcpn = dstp + src_pitch;
 
-    for( int y = 2 - field; y < height - 1; y += 2 )
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 0; x < width; ++x )
         {
@@ -1378,23 +1482,23 @@ void FUNC(eedi2_post_process)(const pixel *nmskp, const int nmsk_pitch, const pi
 }
 
 /**
- * Blurs the source field plane
+ * Blurs the source field plane horizontally, first pass of the gaussian blur
  * @param src Pointer to the half-height source field plane
  * @param src_pitch Stride of src
- * @param tmp Pointer to a temporary buffer for juggling bitmaps
+ * @param tmp Pointer to a temporary buffer storing the horizontal pass
  * @param tmp_pitch Stride of tmp
- * @param dst Pointer to the destination to store the blurred field plane
- * @param dst_pitch Stride of dst
- * @param height Height of the half-height field-sized frame
- * @param width Width of dstp bitmap rows, as opposed to the padded stride in dst_pitch
+ * @param width Width of src bitmap rows, as opposed to the padded stride in src_pitch
+ * @param y_start First row to blur
+ * @param y_stop Row after the last one to blur
  */
-void FUNC(eedi2_gaussian_blur1)(const pixel * src, const int src_pitch, pixel *tmp, int tmp_pitch, pixel *dst, const int dst_pitch, const int height, const int width)
+void FUNC(eedi2_gaussian_blur1_horizontal)(const pixel *src, const int src_pitch, pixel *tmp, const int tmp_pitch,
+                                           const int width, const int y_start, const int y_stop)
 {
-    const pixel *srcp = src;
-    pixel *dstp = tmp;
+    const pixel *srcp = src + y_start * src_pitch;
+    pixel *dstp = tmp + y_start * tmp_pitch;
     int x, y;
 
-    for( y = 0; y < height; ++y )
+    for( y = y_start; y < y_stop; ++y )
     {
         dstp[0] = ( srcp[3] * 582 + srcp[2] * 7078 + srcp[1] * 31724 +
                     srcp[0] * 26152 + 32768 ) >> 16;
@@ -1424,125 +1528,116 @@ void FUNC(eedi2_gaussian_blur1)(const pixel * src, const int src_pitch, pixel *t
         srcp += src_pitch;
         dstp += tmp_pitch;
     }
-    srcp = tmp;
-    dstp = dst;
-    const pixel *src3p = srcp - tmp_pitch * 3;
-    const pixel *src2p = srcp - tmp_pitch * 2;
-    const pixel *srcpp = srcp - tmp_pitch;
-    const pixel *srcpn = srcp + tmp_pitch;
-    const pixel *src2n = srcp + tmp_pitch * 2;
-    const pixel *src3n = srcp + tmp_pitch * 3;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 + srcpn[x] * 31724 +
-                     srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-    src2n += tmp_pitch;
-    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-    src2n += tmp_pitch;
-    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3n[x] * 582 + ( src2p[x] + src2n[x] ) * 3539 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += src_pitch;
-    src2p += src_pitch;
-    srcpp += src_pitch;
-    srcp += src_pitch;
-    srcpn += src_pitch;
-    src2n += src_pitch;
-    src3n += src_pitch;
-    dstp += dst_pitch;
-    for( y = 3; y < height - 3; ++y )
+}
+
+/**
+ * Blurs the horizontally blurred field plane vertically, second pass of the gaussian blur
+ * @param tmp Pointer to the output of eedi2_gaussian_blur1_horizontal
+ * @param tmp_pitch Stride of tmp
+ * @param dst Pointer to the destination to store the blurred field plane
+ * @param dst_pitch Stride of dst
+ * @param height Height of the half-height field-sized frame
+ * @param width Width of dst bitmap rows, as opposed to the padded stride in dst_pitch
+ * @param y_start First row to blur
+ * @param y_stop Row after the last one to blur
+ */
+void FUNC(eedi2_gaussian_blur1_vertical)(const pixel *tmp, const int tmp_pitch, pixel *dst, const int dst_pitch,
+                                         const int height, const int width, const int y_start, const int y_stop)
+{
+    for (int y = y_start; y < y_stop; ++y)
     {
-        for( x = 0; x < width; ++x )
+        const pixel *srcp  = tmp + y * tmp_pitch;
+        const pixel *src3p = srcp - tmp_pitch * 3;
+        const pixel *src2p = srcp - tmp_pitch * 2;
+        const pixel *srcpp = srcp - tmp_pitch;
+        const pixel *srcpn = srcp + tmp_pitch;
+        const pixel *src2n = srcp + tmp_pitch * 2;
+        const pixel *src3n = srcp + tmp_pitch * 3;
+        pixel *dstp = dst + y * dst_pitch;
+
+        // The taps falling outside of the plane are folded back in
+        if (y == 0)
         {
-            dstp[x] = ( ( src3p[x] + src3n[x] ) * 291 +
-                        ( src2p[x] + src2n[x] ) * 3539 +
-                        ( srcpp[x] + srcpn[x] ) * 15862 +
-                        srcp[x] * 26152 + 32768 ) >> 16;
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 + srcpn[x] * 31724 +
+                             srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else if (y == 1)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3n[x] * 582 + src2n[x] * 7078 +
+                            ( srcpp[x] + srcpn[x] ) * 15862 +
+                            srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else if (y == 2)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3n[x] * 582 + ( src2p[x] + src2n[x] ) * 3539 +
+                            ( srcpp[x] + srcpn[x] ) * 15862 +
+                            srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else if (y < height - 3)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( ( src3p[x] + src3n[x] ) * 291 +
+                            ( src2p[x] + src2n[x] ) * 3539 +
+                            ( srcpp[x] + srcpn[x] ) * 15862 +
+                            srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else if (y == height - 3)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3p[x] * 582 + ( src2p[x] + src2n[x] ) *3539 +
+                            ( srcpp[x] + srcpn[x] ) * 15862 +
+                            srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else if (y == height - 2)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3p[x] * 582 + src2p[x] * 7078 +
+                            ( srcpp[x] + srcpn[x] ) * 15862 +
+                             srcp[x] * 26152 + 32768 ) >> 16;
+            }
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src3p[x] * 582   + src2p[x] * 7078 +
+                            srcpp[x] * 31724 +  srcp[x] * 26152 + 32768 ) >> 16;
+            }
         }
-        src3p += tmp_pitch;
-        src2p += tmp_pitch;
-        srcpp += tmp_pitch;
-        srcp += tmp_pitch;
-        srcpn += tmp_pitch;
-        src2n += tmp_pitch;
-        src3n += tmp_pitch;
-        dstp += dst_pitch;
-    }
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582 + ( src2p[x] + src2n[x] ) *3539 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                    srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-    srcpn += tmp_pitch;
-//    src2n += tmp_pitch;
-//    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582 + src2p[x] * 7078 +
-                    ( srcpp[x] + srcpn[x] ) * 15862 +
-                     srcp[x] * 26152 + 32768 ) >> 16;
-    }
-    src3p += tmp_pitch;
-    src2p += tmp_pitch;
-    srcpp += tmp_pitch;
-    srcp += tmp_pitch;
-//    srcpn += tmp_pitch;
-//    src2n += tmp_pitch;
-//    src3n += tmp_pitch;
-    dstp += dst_pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src3p[x] * 582   + src2p[x] * 7078 +
-                    srcpp[x] * 31724 +  srcp[x] * 26152 + 32768 ) >> 16;
     }
 }
 
-
 /**
- * Blurs the spatial derivatives of the source field plane
+ * Blurs the spatial derivatives of the source field plane horizontally, first pass of the gaussian blur
  * @param src Pointer to the derivative array to filter
- * @param tmp Pointer to a temporary storage for the derivative array while it's being filtered
- * @param dst Pointer to the destination to store the filtered output derivative array
+ * @param tmp Pointer to a temporary storage for the horizontal pass
  * @param pitch Stride of the bitmap from which the src array is derived
- * @param height Height of the half-height field-sized frame from which the src array derivs were taken
  * @param width Width of the bitmap from which the src array is derived, as opposed to the padded stride in pitch
+ * @param y_start First row to blur
+ * @param y_stop Row after the last one to blur
  */
-void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const int pitch, const int height, const int width)
+void FUNC(eedi2_gaussian_blur_sqrt2_horizontal)(const int *src, int *tmp, const int pitch, const int width,
+                                                const int y_start, const int y_stop)
 {
-    const int *srcp = src;
-    int * dstp = tmp;
+    const int *srcp = src + y_start * pitch;
+    int * dstp = tmp + y_start * pitch;
     int x, y;
 
-    for( y = 0; y < height; ++y )
+    for( y = y_start; y < y_stop; ++y )
     {
         x = 0;
         dstp[x] = ( srcp[x+4] * 678   + srcp[x+3] * 3902  + srcp[x+2] * 13618 +
@@ -1591,159 +1686,123 @@ void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const i
         srcp += pitch;
         dstp += pitch;
     }
-    dstp = dst;
-    srcp = tmp;
-    const int * src4p = srcp - pitch * 4;
-    const int * src3p = srcp - pitch * 3;
-    const int * src2p = srcp - pitch * 2;
-    const int * srcpp = srcp - pitch;
-    const int * srcpn = srcp + pitch;
-    const int * src2n = srcp + pitch * 2;
-    const int * src3n = srcp + pitch * 3;
-    const int * src4n = srcp + pitch * 4;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678   + src3n[x] * 3902  +
-                    src2n[x] * 13618 + srcpn[x] * 28830 +
-                     srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 + src2n[x] * 13618 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4n[x] * 678 + ( src3p[x] + src3n[x] ) * 1951 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-    src3n += pitch;
-    src4n += pitch;
-    dstp += pitch;
-    for( y = 4; y < height - 4; ++y )
+}
+
+/**
+ * Blurs the horizontally blurred derivatives vertically, second pass of the gaussian blur
+ * @param tmp Pointer to the output of eedi2_gaussian_blur_sqrt2_horizontal
+ * @param dst Pointer to the destination to store the filtered output derivative array
+ * @param pitch Stride of the bitmap from which the derivative arrays are derived
+ * @param height Height of the half-height field-sized frame from which the src array derivs were taken
+ * @param width Width of the bitmap from which the src array is derived, as opposed to the padded stride in pitch
+ * @param y_start First row to blur
+ * @param y_stop Row after the last one to blur
+ */
+void FUNC(eedi2_gaussian_blur_sqrt2_vertical)(const int *tmp, int *dst, const int pitch, const int height, const int width,
+                                              const int y_start, const int y_stop)
+{
+    for (int y = y_start; y < y_stop; ++y)
     {
-        for( x = 0; x < width; ++x )
+        const int * srcp  = tmp + y * pitch;
+        const int * src4p = srcp - pitch * 4;
+        const int * src3p = srcp - pitch * 3;
+        const int * src2p = srcp - pitch * 2;
+        const int * srcpp = srcp - pitch;
+        const int * srcpn = srcp + pitch;
+        const int * src2n = srcp + pitch * 2;
+        const int * src3n = srcp + pitch * 3;
+        const int * src4n = srcp + pitch * 4;
+        int * dstp = dst + y * pitch;
+
+        // The taps falling outside of the plane are folded back in
+        if (y == 0)
         {
-            dstp[x] = ( ( src4p[x] + src4n[x] ) * 339 +
-                        ( src3p[x] + src3n[x] ) * 1951 +
-                        ( src2p[x] + src2n[x] ) * 6809 +
-                        ( srcpp[x] + srcpn[x] ) * 14415 +
-                        srcp[x] * 18508 + 32768 ) >> 18;
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4n[x] * 678   + src3n[x] * 3902  +
+                            src2n[x] * 13618 + srcpn[x] * 28830 +
+                             srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == 1)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 + src2n[x] * 13618 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == 2)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4n[x] * 678 + src3n[x] * 3902 +
+                            ( src2p[x] + src2n[x] ) * 6809 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == 3)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4n[x] * 678 + ( src3p[x] + src3n[x] ) * 1951 +
+                            ( src2p[x] + src2n[x] ) * 6809 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y < height - 4)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( ( src4p[x] + src4n[x] ) * 339 +
+                            ( src3p[x] + src3n[x] ) * 1951 +
+                            ( src2p[x] + src2n[x] ) * 6809 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == height - 4)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4p[x] * 678 +
+                            ( src3p[x] + src3n[x] ) * 1951 +
+                            ( src2p[x] + src2n[x] ) * 6809 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == height - 3)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 +
+                            ( src2p[x] + src2n[x] ) * 6809 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else if (y == height - 2)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 + src2p[x] * 13618 +
+                            ( srcpp[x] + srcpn[x] ) * 14415 +
+                            srcp[x] * 18508 + 32768 ) >> 18;
+            }
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                dstp[x] = ( src4p[x] * 678   + src3p[x] * 3902 +
+                            src2p[x] * 13618 + srcpp[x] * 28830 +
+                            srcp[x]  * 18508 + 32768 ) >> 18;
+            }
         }
-        src4p += pitch;
-        src3p += pitch;
-        src2p += pitch;
-        srcpp += pitch;
-        srcp += pitch;
-        srcpn += pitch;
-        src2n += pitch;
-        src3n += pitch;
-        src4n += pitch;
-        dstp += pitch;
-    }
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 +
-                    ( src3p[x] + src3n[x] ) * 1951 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 +
-                    ( src2p[x] + src2n[x] ) * 6809 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-    srcpn += pitch;
-//    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678 + src3p[x] * 3902 + src2p[x] * 13618 +
-                    ( srcpp[x] + srcpn[x] ) * 14415 +
-                    srcp[x] * 18508 + 32768 ) >> 18;
-    }
-    src4p += pitch;
-    src3p += pitch;
-    src2p += pitch;
-    srcpp += pitch;
-    srcp += pitch;
-//    srcpn += pitch;
-//    src2n += pitch;
-//    src3n += pitch;
-//    src4n += pitch;
-    dstp += pitch;
-    for( x = 0; x < width; ++x )
-    {
-        dstp[x] = ( src4p[x] * 678   + src3p[x] * 3902 +
-                    src2p[x] * 13618 + srcpp[x] * 28830 +
-                    srcp[x]  * 18508 + 32768 ) >> 18;
     }
 }
 
@@ -1756,44 +1815,24 @@ void FUNC(eedi2_gaussian_blur_sqrt2)(const int *src, int *tmp, int *dst, const i
  * @param x2 Pointed to the array to store the x/x derivatives
  * @param y2 Pointer to the array to store the y/y derivatives
  * @param xy Pointer to the array to store the x/y derivatives
+ * @param y_start First row to derive
+ * @param y_stop Row after the last one to derive
  */
-void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const int height, const int width, int *x2, int *y2, int *xy, const int depth)
+void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const int height, const int width, int *x2, int *y2, int *xy, const int depth,
+                                  const int y_start, const int y_stop)
 {
     const pixel shift = depth - 8;
 
-    const pixel *srcpp = srcp - src_pitch;
-    const pixel *srcpn = srcp + src_pitch;
-    int x, y;
-    {
-        const int Ix = (srcp[1] -  srcp[0]) >> shift;
-        const int Iy = (srcp[0] - srcpn[0]) >> shift;
-        x2[0] = ( Ix * Ix ) >> 1;
-        y2[0] = ( Iy * Iy ) >> 1;
-        xy[0] = ( Ix * Iy ) >> 1;
-    }
-    for( x = 1; x < width - 1; ++x )
-    {
-        const int Ix = (srcp[x+1] -  srcp[x-1]) >> shift;
-        const int Iy = (srcp[x]   - srcpn[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    {
-        const int Ix = (srcp[x] -  srcp[x-1]) >> shift;
-        const int Iy = (srcp[x] - srcpn[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    srcpp += src_pitch;
-    srcp += src_pitch;
-    srcpn += src_pitch;
-    x2 += src_pitch;
-    y2 += src_pitch;
-    xy += src_pitch;
-    for( y = 1; y < height - 1; ++y )
+    srcp += y_start * src_pitch;
+    x2 += y_start * src_pitch;
+    y2 += y_start * src_pitch;
+    xy += y_start * src_pitch;
+    for (int y = y_start; y < y_stop; ++y)
     {
+        // The first and the last rows are derived from the row itself
+        const pixel *srcpp = y > 0 ? srcp - src_pitch : srcp;
+        const pixel *srcpn = y < height - 1 ? srcp + src_pitch : srcp;
+        int x;
         {
             const int Ix =  (srcp[1] -  srcp[0]) >> shift;
             const int Iy = (srcpp[0] - srcpn[0]) >> shift;
@@ -1816,35 +1855,11 @@ void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const
             y2[x] = ( Iy *Iy ) >> 1;
             xy[x] = ( Ix *Iy ) >> 1;
         }
-        srcpp += src_pitch;
         srcp += src_pitch;
-        srcpn += src_pitch;
         x2 += src_pitch;
         y2 += src_pitch;
         xy += src_pitch;
     }
-    {
-        const int Ix =  (srcp[1] - srcp[0]) >> shift;
-        const int Iy = (srcpp[0] - srcp[0]) >> shift;
-        x2[0] = ( Ix * Ix ) >> 1;
-        y2[0] = ( Iy * Iy ) >> 1;
-        xy[0] = ( Ix * Iy ) >> 1;
-    }
-    for( x = 1; x < width - 1; ++x )
-    {
-        const int Ix =  (srcp[x+1] - srcp[x-1]) >> shift;
-        const int Iy = (srcpp[x]   - srcp[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
-    {
-        const int Ix =  (srcp[x] - srcp[x-1]) >> shift;
-        const int Iy = (srcpp[x] - srcp[x]) >> shift;
-        x2[x] = ( Ix * Ix ) >> 1;
-        y2[x] = ( Iy * Iy ) >> 1;
-        xy[x] = ( Ix * Iy ) >> 1;
-    }
 }
 
 /**
@@ -1860,25 +1875,32 @@ void FUNC(eedi2_calc_derivatives)(const pixel *srcp, const int src_pitch, const
  * @param height Height of the full-frame output plane
  * @param width Width of dstp bitmap rows, as opposed to the padded stride in dst_pitch
  * @param field Field to filter
+ * @param y_start First row of the output to filter
+ * @param y_stop Row after the last one to filter
  */
-void FUNC(eedi2_post_process_corner)(int *x2, int *y2, int *xy, const int pitch, const pixel *mskp, const int msk_pitch,
-                                     pixel *dstp, const int dst_pitch, const int height, const int width, const int field, const int depth)
+void FUNC(eedi2_post_process_corner)(const int *x2, const int *y2, const int *xy, const int pitch, const pixel *mskp, const int msk_pitch,
+                                     pixel *dstp, const int dst_pitch, const int height, const int width, const int field, const int depth,
+                                     const int y_start, const int y_stop)
 {
     const pixel neutral = 1 << (depth - 1);
     const pixel peak = (1 << depth) - 1;
 
-    mskp += ( 8 - field ) * msk_pitch;
-    dstp += ( 8 - field ) * dst_pitch;
+    const int y_first = eedi2_first_row(8 - field, 2, y_start);
+    const int y_last  = MIN(height - 7, y_stop);
+    mskp += y_first * msk_pitch;
+    dstp += y_first * dst_pitch;
     pixel * dstpp = dstp - dst_pitch;
     pixel * dstpn = dstp + dst_pitch;
-    x2 += pitch * 3;
-    y2 += pitch * 3;
-    xy += pitch * 3;
-    int *x2n = x2 + pitch;
-    int *y2n = y2 + pitch;
-    int *xyn = xy + pitch;
-
-    for (int y = 8 - field; y < height - 7; y += 2)
+    // One row of derivatives per output row of the field, from the 3rd one
+    const int offset = pitch * (3 + ((y_first - (8 - field)) >> 1));
+    x2 += offset;
+    y2 += offset;
+    xy += offset;
+    const int *x2n = x2 + pitch;
+    const int *y2n = y2 + pitch;
+    const int *xyn = xy + pitch;
+
+    for (int y = y_first; y < y_last; y += 2)
     {
         for (int x = 4; x < width - 4; ++x)
         {
@@ -590,6 +590,41 @@ static void FUNC(build_integral_scalar)(uint32_t *integral,
     }
 }
 
+static void FUNC(nlmeans_accumulate_scalar)(struct PixelSum *sums,
+                                      const uint32_t *integral_ptr1,
+                                      const uint32_t *integral_ptr2,
+                                      const void  *in_compare,
+                                            int    n,
+                                            int    w,
+                                      const float *exptable,
+                                      const float  weight_fact_table,
+                                      const int    diff_max)
+{
+    const pixel *compare = (const pixel *)in_compare;
+
+    for (int x = 0; x < w; x++)
+    {
+
+        // Difference between patches
+        const int diff = (uint32_t)(integral_ptr2[n] - integral_ptr2[0] - integral_ptr1[n] + integral_ptr1[0]);
+
+        // Sum pixel with weight
+        if (diff < diff_max)
+        {
+            const int diffidx = diff * weight_fact_table;
+
+            //float weight = exp(-diff*weightFact);
+            const float weight = exptable[diffidx];
+
+            sums[x].weight_sum += weight;
+            sums[x].pixel_sum  += weight * compare[x];
+        }
+
+        integral_ptr1++;
+        integral_ptr2++;
+    }
+}
+
 static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                                 Frame *frame,
                                 int prefilter,
@@ -675,27 +710,195 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
                     const uint32_t *integral_ptr1 = integral + (y  -1)*integral_stride - 1;
                     const uint32_t *integral_ptr2 = integral + (y+n-1)*integral_stride - 1;
 
-                    for (int x = 0; x < dst_w; x++)
-                    {
+                    functions->accumulate(tmp_data + y*dst_w,
+                                          integral_ptr1,
+                                          integral_ptr2,
+                                          compare + (y+dy)*bw + dx,
+                                          n,
+                                          dst_w,
+                                          exptable,
+                                          weight_fact_table,
+                                          diff_max);
+                }
+            }
+        }
+    }
+
+    // Copy image without border
+    pixel result;
+    for (int y = 0; y < dst_h; y++)
+    {
+        for (int x = 0; x < dst_w; x++)
+        {
+            result = (pixel)(tmp_data[y*dst_w + x].pixel_sum / tmp_data[y*dst_w + x].weight_sum);
+            *(dst + y*dst_s + x) = result ? result : *(src + y*bw + x);
+        }
+    }
 
-                        // Difference between patches
-                        const int diff = (uint32_t)(integral_ptr2[n] - integral_ptr2[0] - integral_ptr1[n] + integral_ptr1[0]);
+    free(tmp_data);
+    free(integral_mem);
+}
 
-                        // Sum pixel with weight
-                        if (diff < diff_max)
-                        {
-                            const int diffidx = diff * weight_fact_table;
+// Fast mode counterpart of build_integral, 16-bit and with the squared
+// differences rounded down by sq_shift. The integral wraps around, but the
+// patch sums taken from it are exact since each fits in 16 bits.
+static void FUNC(build_integral_fast_scalar)(uint16_t *integral,
+                                             int       integral_stride,
+                                       const void     *in_src_pre,
+                                       const void     *in_compare_pre,
+                                             int       bw,
+                                             int       dst_w,
+                                             int       dst_h,
+                                             int       dx,
+                                             int       dy,
+                                             int       n,
+                                             int       sq_shift)
+{
+    const int n_half = (n-1) /2;
+    const uint32_t round = (1 << sq_shift) >> 1;
 
-                            //float weight = exp(-diff*weightFact);
-                            const float weight = exptable[diffidx];
+    const pixel *src_pre      = (const pixel *)in_src_pre;
+    const pixel *compare_pre  = (const pixel *)in_compare_pre;
 
-                            tmp_data[y*dst_w + x].weight_sum += weight;
-                            tmp_data[y*dst_w + x].pixel_sum  += weight * compare[(y+dy)*bw + x + dx];
-                        }
+    for (int y = 0; y < dst_h + n; y++)
+    {
+        const pixel *p1 = src_pre     + (y-n_half   )*bw - n_half;
+        const pixel *p2 = compare_pre + (y-n_half+dy)*bw - n_half + dx;
+        uint16_t *out = integral + (y*integral_stride);
+
+        for (int x = 0; x < dst_w + n; x++)
+        {
+            const int diff = p1[x] - p2[x];
+            out[x] = out[x-1] + (uint16_t)(((uint32_t)(diff * diff) + round) >> sq_shift);
+        }
+
+        if (y > 0)
+        {
+            for (int x = 0; x < dst_w + n; x++)
+            {
+                out[x] += out[x - integral_stride];
+            }
+        }
+    }
+}
+
+static void FUNC(nlmeans_accumulate_fast_scalar)(uint32_t *weight_sum,
+                                                 uint32_t *pixel_sum,
+                                           const uint16_t *integral_ptr1,
+                                           const uint16_t *integral_ptr2,
+                                           const void     *in_compare,
+                                                 int       n,
+                                                 int       w,
+                                           const NLMeansFixed *fixed)
+{
+    const pixel *compare = (const pixel *)in_compare;
 
-                        integral_ptr1++;
-                        integral_ptr2++;
+    for (int x = 0; x < w; x++)
+    {
+        // Difference between patches
+        const uint32_t diff = (uint16_t)(integral_ptr2[x+n] - integral_ptr2[x] -
+                                         integral_ptr1[x+n] + integral_ptr1[x]);
+
+        // Sum pixel with weight
+        if (diff < fixed->diff_max)
+        {
+            const uint32_t diffidx = MIN((diff * fixed->fact) >> 16, NLMEANS_EXPSIZE - 1);
+            const uint32_t weight  = fixed->exptable[diffidx];
+
+            weight_sum[x] += weight;
+            pixel_sum[x]  += weight * compare[x];
+        }
+    }
+}
+
+static void FUNC(nlmeans_plane_fast)(NLMeansFunctions *functions,
+                                     Frame *frame,
+                                     int prefilter,
+                                     int plane,
+                                     int nframes,
+                                     void *in_dst,
+                                     int dst_w,
+                                     int dst_s,
+                                     int dst_h,
+                                     int n,
+                                     int r,
+                               const NLMeansFixed *fixed)
+{
+    pixel *dst = in_dst;
+    const int r_half = (r-1) /2;
+
+    // Source image
+    const pixel *src     = frame[0].plane[plane].image;
+    const pixel *src_pre = frame[0].plane[plane].image_pre;
+    const int w      = frame[0].plane[plane].w;
+    const int border = frame[0].plane[plane].border;
+    const int bw     = w + 2 * border;
+
+    // Allocate temporary pixel sums
+    uint32_t *weight_sum = calloc(dst_w * dst_h, sizeof(uint32_t));
+    uint32_t *pixel_sum  = calloc(dst_w * dst_h, sizeof(uint32_t));
+
+    // Allocate integral image
+    const int integral_stride    = ((dst_w + n + 15) / 16 * 16) + 2 * 16;
+    uint16_t* const integral_mem = calloc(integral_stride * (dst_h + n + 1), sizeof(uint16_t));
+    uint16_t* const integral     = integral_mem + integral_stride + 16;
+
+    // Iterate through available frames
+    for (int f = 0; f < nframes; f++)
+    {
+        FUNC(nlmeans_prefilter)(&frame[f].plane[plane], prefilter);
+
+        // Compare image
+        const pixel *compare     = frame[f].plane[plane].image;
+        const pixel *compare_pre = frame[f].plane[plane].image_pre;
+
+        // Iterate through all displacements
+        for (int dy = -r_half; dy <= r_half; dy++)
+        {
+            for (int dx = -r_half; dx <= r_half; dx++)
+            {
+
+                // Apply special weight tuning to origin patch
+                if (dx == 0 && dy == 0 && f == 0)
+                {
+                    for (int y = 0; y < dst_h; y++)
+                    {
+                        for (int x = 0; x < dst_w; x++)
+                        {
+                            weight_sum[y*dst_w + x] += fixed->origin;
+                            pixel_sum[y*dst_w + x]  += fixed->origin * src[y*bw + x];
+                        }
                     }
+                    continue;
+                }
+
+                // Build integral
+                functions->build_integral_fast(integral,
+                                               integral_stride,
+                                               src_pre,
+                                               compare_pre,
+                                               bw,
+                                               dst_w,
+                                               dst_h,
+                                               dx,
+                                               dy,
+                                               n,
+                                               fixed->sq_shift);
+
+                // Average displacement
+                for (int y = 0; y < dst_h; y++)
+                {
+                    const uint16_t *integral_ptr1 = integral + (y  -1)*integral_stride - 1;
+                    const uint16_t *integral_ptr2 = integral + (y+n-1)*integral_stride - 1;
+
+                    functions->accumulate_fast(weight_sum + y*dst_w,
+                                               pixel_sum  + y*dst_w,
+                                               integral_ptr1,
+                                               integral_ptr2,
+                                               compare + (y+dy)*bw + dx,
+                                               n,
+                                               dst_w,
+                                               fixed);
                 }
             }
         }
@@ -707,12 +910,14 @@ static void FUNC(nlmeans_plane)(NLMeansFunctions *functions,
     {
         for (int x = 0; x < dst_w; x++)
         {
-            result = (pixel)(tmp_data[y*dst_w + x].pixel_sum / tmp_data[y*dst_w + x].weight_sum);
+            const uint32_t wsum = weight_sum[y*dst_w + x];
+            result = wsum ? (pixel)(pixel_sum[y*dst_w + x] / wsum) : 0;
             *(dst + y*dst_s + x) = result ? result : *(src + y*bw + x);
         }
     }
 
-    free(tmp_data);
+    free(weight_sum);
+    free(pixel_sum);
     free(integral_mem);
 }
 
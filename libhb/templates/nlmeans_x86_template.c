@@ -0,0 +1,432 @@
+/* nlmeans_x86_template.c
+
+   Copyright (c) 2013 Dirk Farin
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#if BIT_DEPTH > 8
+#   define pixel   uint16_t
+#   define FUNC(name) name##_##16
+// Zero extend 8 or 16 pixels to 32 bit
+#   define LOAD8_EPI32(p)  _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#   define LOAD16_EPI32(p) _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(p)))
+#else
+#   define pixel   uint8_t
+#   define FUNC(name) name##_##8
+#   define LOAD8_EPI32(p)  _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p)))
+#   define LOAD16_EPI32(p) _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(p)))
+#endif
+
+// Same as the scalar accumulate, for the pixels left over by the vector
+// loops. Not inlined so that it keeps the baseline target: inside an
+// AVX-512 function the compiler would be free to fuse the multiply-add,
+// and the result would no longer match the C path bit for bit.
+static __attribute__((noinline)) void FUNC(accumulate_tail)(struct PixelSum *sums,
+                                   const uint32_t *integral_ptr1,
+                                   const uint32_t *integral_ptr2,
+                                   const pixel *compare,
+                                         int    n,
+                                         int    x,
+                                         int    w,
+                                   const float *exptable,
+                                   const float  weight_fact_table,
+                                   const int    diff_max)
+{
+    for (; x < w; x++)
+    {
+        const int diff = (uint32_t)(integral_ptr2[x+n] - integral_ptr2[x] - integral_ptr1[x+n] + integral_ptr1[x]);
+
+        if (diff < diff_max)
+        {
+            const int diffidx = diff * weight_fact_table;
+            const float weight = exptable[diffidx];
+
+            sums[x].weight_sum += weight;
+            sums[x].pixel_sum  += weight * compare[x];
+        }
+    }
+}
+
+/*
+ * AVX2
+ */
+
+static TARGET_AVX2 void FUNC(build_integral_avx2)(uint32_t *integral,
+                                                  int       integral_stride,
+                                            const void  *in_src,
+                                            const void  *in_src_pre,
+                                            const void  *in_compare,
+                                            const void  *in_compare_pre,
+                                                  int    w,
+                                                  int    border,
+                                                  int    dst_w,
+                                                  int    dst_h,
+                                                  int    dx,
+                                                  int    dy,
+                                                  int    n)
+{
+    const int bw = w + 2 * border;
+    const int n_half = (n-1) /2;
+
+    const pixel *src_pre      = (const pixel *)in_src_pre;
+    const pixel *compare_pre  = (const pixel *)in_compare_pre;
+
+    for (int y = 0; y < dst_h + n; y++)
+    {
+        __m256i carry = _mm256_setzero_si256();
+
+        const pixel *p1 = src_pre     + (y-n_half   )*bw - n_half;
+        const pixel *p2 = compare_pre + (y-n_half+dy)*bw - n_half + dx;
+        uint32_t *out = integral + (y*integral_stride);
+
+        for (int x = 0; x < dst_w + n; x += 16)
+        {
+            __m256i lo, hi;
+
+            // Squared differences, widened to 32 bit
+            lo = _mm256_sub_epi32(LOAD8_EPI32(p1),     LOAD8_EPI32(p2));
+            hi = _mm256_sub_epi32(LOAD8_EPI32(p1 + 8), LOAD8_EPI32(p2 + 8));
+            lo = _mm256_mullo_epi32(lo, lo);
+            hi = _mm256_mullo_epi32(hi, hi);
+
+            // Running sum along the row
+            lo    = prefix_sum_avx2(lo, carry);
+            carry = _mm256_permutevar8x32_epi32(lo, _mm256_set1_epi32(7));
+            hi    = prefix_sum_avx2(hi, carry);
+            carry = _mm256_permutevar8x32_epi32(hi, _mm256_set1_epi32(7));
+
+            _mm256_storeu_si256((__m256i*)(out),     lo);
+            _mm256_storeu_si256((__m256i*)(out + 8), hi);
+
+            out += 16;
+            p1  += 16;
+            p2  += 16;
+        }
+
+        if (y > 0)
+        {
+            out = integral + y*integral_stride;
+
+            for (int x = 0; x < dst_w + n; x += 8)
+            {
+                __m256i above = _mm256_loadu_si256((__m256i*)(out - integral_stride));
+                __m256i cur   = _mm256_loadu_si256((__m256i*)(out));
+                _mm256_storeu_si256((__m256i*)out, _mm256_add_epi32(above, cur));
+                out += 8;
+            }
+        }
+    }
+}
+
+static TARGET_AVX2 void FUNC(nlmeans_accumulate_avx2)(struct PixelSum *sums,
+                                                const uint32_t *integral_ptr1,
+                                                const uint32_t *integral_ptr2,
+                                                const void  *in_compare,
+                                                      int    n,
+                                                      int    w,
+                                                const float *exptable,
+                                                const float  weight_fact_table,
+                                                const int    diff_max)
+{
+    const pixel *compare = (const pixel *)in_compare;
+    const __m256i v_diff_max = _mm256_set1_epi32(diff_max);
+    const __m256  v_fact     = _mm256_set1_ps(weight_fact_table);
+    int x;
+
+    for (x = 0; x + 8 <= w; x += 8)
+    {
+        __m256i diff, mask, idx;
+        __m256  weight, wpixel, wl, wh, s0, s1;
+
+        // Difference between patches
+        diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(integral_ptr2 + x + n)),
+                                _mm256_loadu_si256((const __m256i*)(integral_ptr2 + x)));
+        diff = _mm256_sub_epi32(diff, _mm256_loadu_si256((const __m256i*)(integral_ptr1 + x + n)));
+        diff = _mm256_add_epi32(diff, _mm256_loadu_si256((const __m256i*)(integral_ptr1 + x)));
+
+        mask = _mm256_cmpgt_epi32(v_diff_max, diff);
+        if (_mm256_testz_si256(mask, mask))
+        {
+            continue;
+        }
+
+        // Look up the weights of the patches that are close enough,
+        // leaving 0 in the others so that they add nothing
+        idx    = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(diff), v_fact));
+        weight = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), exptable, idx,
+                                          _mm256_castsi256_ps(mask), 4);
+        wpixel = _mm256_mul_ps(weight, _mm256_cvtepi32_ps(LOAD8_EPI32(compare + x)));
+
+        // Interleave to match the layout of struct PixelSum
+        wl = _mm256_unpacklo_ps(weight, wpixel);
+        wh = _mm256_unpackhi_ps(weight, wpixel);
+        s0 = _mm256_loadu_ps((const float*)(sums + x));
+        s1 = _mm256_loadu_ps((const float*)(sums + x + 4));
+        s0 = _mm256_add_ps(s0, _mm256_permute2f128_ps(wl, wh, 0x20));
+        s1 = _mm256_add_ps(s1, _mm256_permute2f128_ps(wl, wh, 0x31));
+        _mm256_storeu_ps((float*)(sums + x),     s0);
+        _mm256_storeu_ps((float*)(sums + x + 4), s1);
+    }
+
+    FUNC(accumulate_tail)(sums, integral_ptr1, integral_ptr2, compare, n, x, w,
+                          exptable, weight_fact_table, diff_max);
+}
+
+/*
+ * AVX-512
+ */
+
+static TARGET_AVX512 void FUNC(build_integral_avx512)(uint32_t *integral,
+                                                      int       integral_stride,
+                                                const void  *in_src,
+                                                const void  *in_src_pre,
+                                                const void  *in_compare,
+                                                const void  *in_compare_pre,
+                                                      int    w,
+                                                      int    border,
+                                                      int    dst_w,
+                                                      int    dst_h,
+                                                      int    dx,
+                                                      int    dy,
+                                                      int    n)
+{
+    const int bw = w + 2 * border;
+    const int n_half = (n-1) /2;
+
+    const pixel *src_pre      = (const pixel *)in_src_pre;
+    const pixel *compare_pre  = (const pixel *)in_compare_pre;
+
+    for (int y = 0; y < dst_h + n; y++)
+    {
+        __m512i carry = _mm512_setzero_si512();
+
+        const pixel *p1 = src_pre     + (y-n_half   )*bw - n_half;
+        const pixel *p2 = compare_pre + (y-n_half+dy)*bw - n_half + dx;
+        uint32_t *out = integral + (y*integral_stride);
+
+        for (int x = 0; x < dst_w + n; x += 16)
+        {
+            __m512i sq;
+
+            sq    = _mm512_sub_epi32(LOAD16_EPI32(p1), LOAD16_EPI32(p2));
+            sq    = _mm512_mullo_epi32(sq, sq);
+            sq    = prefix_sum_avx512(sq, carry);
+            carry = _mm512_permutexvar_epi32(_mm512_set1_epi32(15), sq);
+
+            _mm512_storeu_si512(out, sq);
+
+            out += 16;
+            p1  += 16;
+            p2  += 16;
+        }
+
+        if (y > 0)
+        {
+            out = integral + y*integral_stride;
+
+            for (int x = 0; x < dst_w + n; x += 16)
+            {
+                _mm512_storeu_si512(out,
+                                    _mm512_add_epi32(_mm512_loadu_si512(out - integral_stride),
+                                                     _mm512_loadu_si512(out)));
+                out += 16;
+            }
+        }
+    }
+}
+
+static TARGET_AVX512 void FUNC(nlmeans_accumulate_avx512)(struct PixelSum *sums,
+                                                    const uint32_t *integral_ptr1,
+                                                    const uint32_t *integral_ptr2,
+                                                    const void  *in_compare,
+                                                          int    n,
+                                                          int    w,
+                                                    const float *exptable,
+                                                    const float  weight_fact_table,
+                                                    const int    diff_max)
+{
+    const pixel *compare = (const pixel *)in_compare;
+    const __m512i v_diff_max = _mm512_set1_epi32(diff_max);
+    const __m512  v_fact     = _mm512_set1_ps(weight_fact_table);
+    // Element indices that interleave weights and weighted pixels
+    const __m512i lo_idx = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19,
+                                             4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i hi_idx = _mm512_setr_epi32(8, 24,  9, 25, 10, 26, 11, 27,
+                                            12, 28, 13, 29, 14, 30, 15, 31);
+    int x;
+
+    for (x = 0; x + 16 <= w; x += 16)
+    {
+        __m512i  diff, idx;
+        __m512   weight, wpixel, s0, s1;
+        __mmask16 mask;
+
+        diff = _mm512_sub_epi32(_mm512_loadu_si512(integral_ptr2 + x + n),
+                                _mm512_loadu_si512(integral_ptr2 + x));
+        diff = _mm512_sub_epi32(diff, _mm512_loadu_si512(integral_ptr1 + x + n));
+        diff = _mm512_add_epi32(diff, _mm512_loadu_si512(integral_ptr1 + x));
+
+        mask = _mm512_cmpgt_epi32_mask(v_diff_max, diff);
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        idx    = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(diff), v_fact));
+        weight = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, idx, exptable, 4);
+        wpixel = _mm512_mul_ps(weight, _mm512_cvtepi32_ps(LOAD16_EPI32(compare + x)));
+
+        s0 = _mm512_loadu_ps(sums + x);
+        s1 = _mm512_loadu_ps(sums + x + 8);
+        s0 = _mm512_add_ps(s0, _mm512_permutex2var_ps(weight, lo_idx, wpixel));
+        s1 = _mm512_add_ps(s1, _mm512_permutex2var_ps(weight, hi_idx, wpixel));
+        _mm512_storeu_ps(sums + x,     s0);
+        _mm512_storeu_ps(sums + x + 8, s1);
+    }
+
+    FUNC(accumulate_tail)(sums, integral_ptr1, integral_ptr2, compare, n, x, w,
+                          exptable, weight_fact_table, diff_max);
+}
+
+/*
+ * AVX2 fast mode
+ */
+
+static TARGET_AVX2 void FUNC(build_integral_fast_avx2)(uint16_t *integral,
+                                                       int       integral_stride,
+                                                 const void     *in_src_pre,
+                                                 const void     *in_compare_pre,
+                                                       int       bw,
+                                                       int       dst_w,
+                                                       int       dst_h,
+                                                       int       dx,
+                                                       int       dy,
+                                                       int       n,
+                                                       int       sq_shift)
+{
+    const int n_half = (n-1) /2;
+    const __m256i round = _mm256_set1_epi32((1 << sq_shift) >> 1);
+    const __m128i shift = _mm_cvtsi32_si128(sq_shift);
+    // Broadcasts the last 16-bit element of each 128 bit lane
+    const __m256i last  = _mm256_set1_epi16(0x0f0e);
+
+    const pixel *src_pre      = (const pixel *)in_src_pre;
+    const pixel *compare_pre  = (const pixel *)in_compare_pre;
+
+    for (int y = 0; y < dst_h + n; y++)
+    {
+        __m256i carry = _mm256_setzero_si256();
+
+        const pixel *p1 = src_pre     + (y-n_half   )*bw - n_half;
+        const pixel *p2 = compare_pre + (y-n_half+dy)*bw - n_half + dx;
+        uint16_t *out = integral + (y*integral_stride);
+
+        for (int x = 0; x < dst_w + n; x += 16)
+        {
+            __m256i lo, hi, sq;
+
+            // Rounded squared differences, computed at 32 bit and packed
+            // back to 16 bit in order
+            lo = _mm256_sub_epi32(LOAD8_EPI32(p1),     LOAD8_EPI32(p2));
+            hi = _mm256_sub_epi32(LOAD8_EPI32(p1 + 8), LOAD8_EPI32(p2 + 8));
+            lo = _mm256_srl_epi32(_mm256_add_epi32(_mm256_mullo_epi32(lo, lo), round), shift);
+            hi = _mm256_srl_epi32(_mm256_add_epi32(_mm256_mullo_epi32(hi, hi), round), shift);
+            sq = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+
+            // Running sum along the row
+            sq    = prefix_sum_epi16_avx2(sq, carry);
+            carry = _mm256_shuffle_epi8(_mm256_permute2x128_si256(sq, sq, 0x11), last);
+
+            _mm256_storeu_si256((__m256i*)out, sq);
+
+            out += 16;
+            p1  += 16;
+            p2  += 16;
+        }
+
+        if (y > 0)
+        {
+            out = integral + y*integral_stride;
+
+            for (int x = 0; x < dst_w + n; x += 16)
+            {
+                _mm256_storeu_si256((__m256i*)out,
+                                    _mm256_add_epi16(_mm256_loadu_si256((__m256i*)(out - integral_stride)),
+                                                     _mm256_loadu_si256((__m256i*)out)));
+                out += 16;
+            }
+        }
+    }
+}
+
+static TARGET_AVX2 void FUNC(nlmeans_accumulate_fast_avx2)(uint32_t *weight_sum,
+                                                           uint32_t *pixel_sum,
+                                                     const uint16_t *integral_ptr1,
+                                                     const uint16_t *integral_ptr2,
+                                                     const void     *in_compare,
+                                                           int       n,
+                                                           int       w,
+                                                     const NLMeansFixed *fixed)
+{
+    const pixel *compare = (const pixel *)in_compare;
+    const __m256i v_diff_max = _mm256_set1_epi32(fixed->diff_max);
+    const __m256i v_fact     = _mm256_set1_epi32(fixed->fact);
+    const __m256i v_idx_max  = _mm256_set1_epi32(NLMEANS_EXPSIZE - 1);
+    int x;
+
+    for (x = 0; x + 8 <= w; x += 8)
+    {
+        __m128i diff16;
+        __m256i diff, mask, idx, weight, wsum, psum;
+
+        // Difference between patches, wrapping around like the integral
+        diff16 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(integral_ptr2 + x + n)),
+                               _mm_loadu_si128((const __m128i*)(integral_ptr2 + x)));
+        diff16 = _mm_sub_epi16(diff16, _mm_loadu_si128((const __m128i*)(integral_ptr1 + x + n)));
+        diff16 = _mm_add_epi16(diff16, _mm_loadu_si128((const __m128i*)(integral_ptr1 + x)));
+        diff   = _mm256_cvtepu16_epi32(diff16);
+
+        mask = _mm256_cmpgt_epi32(v_diff_max, diff);
+        if (_mm256_testz_si256(mask, mask))
+        {
+            continue;
+        }
+
+        // Look up the weights of the patches that are close enough,
+        // leaving 0 in the others so that they add nothing
+        idx    = _mm256_min_epu32(_mm256_srli_epi32(_mm256_mullo_epi32(diff, v_fact), 16), v_idx_max);
+        weight = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)fixed->exptable,
+                                             idx, mask, 4);
+
+        wsum = _mm256_loadu_si256((const __m256i*)(weight_sum + x));
+        psum = _mm256_loadu_si256((const __m256i*)(pixel_sum  + x));
+        wsum = _mm256_add_epi32(wsum, weight);
+        psum = _mm256_add_epi32(psum, _mm256_mullo_epi32(weight, LOAD8_EPI32(compare + x)));
+        _mm256_storeu_si256((__m256i*)(weight_sum + x), wsum);
+        _mm256_storeu_si256((__m256i*)(pixel_sum  + x), psum);
+    }
+
+    for (; x < w; x++)
+    {
+        const uint32_t diff = (uint16_t)(integral_ptr2[x+n] - integral_ptr2[x] -
+                                         integral_ptr1[x+n] + integral_ptr1[x]);
+
+        if (diff < fixed->diff_max)
+        {
+            const uint32_t diffidx = MIN((diff * fixed->fact) >> 16, NLMEANS_EXPSIZE - 1);
+            const uint32_t weight  = fixed->exptable[diffidx];
+
+            weight_sum[x] += weight;
+            pixel_sum[x]  += weight * compare[x];
+        }
+    }
+}
+
+#undef LOAD16_EPI32
+#undef LOAD8_EPI32
+#undef pixel
+#undef FUNC
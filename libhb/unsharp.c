@@ -9,6 +9,7 @@
  */
 
 #include "handbrake/handbrake.h"
+#include "handbrake/unsharp.h"
 
 #define UNSHARP_STRENGTH_LUMA_DEFAULT 0.25
 #define UNSHARP_SIZE_LUMA_DEFAULT 7
@@ -27,14 +28,13 @@ typedef struct
     int        size;      // pixel context region width (must be odd)
 
     int        steps;
-    int        amount;
-    int        scalebits;
-    int32_t    halfscale;
+    UnsharpMix mix;
 } unsharp_plane_context_t;
 
 typedef struct
 {
     uint32_t * SC[UNSHARP_SIZE_MAX - 1];
+    uint32_t * row;
 } unsharp_thread_context_t;
 
 typedef unsharp_thread_context_t unsharp_thread_context3_t[3];
@@ -43,6 +43,7 @@ struct hb_filter_private_s
 {
     int depth;
 
+    UnsharpFunctions            functions;
     unsharp_plane_context_t     plane_ctx[3];
     unsharp_thread_context3_t * thread_ctx;
     int                         threads;
@@ -85,98 +86,150 @@ hb_filter_object_t hb_filter_unsharp =
 };
 
 
-#define DEF_UNSHARP_FUNC(name, nbits)                                                           \
-static void name##_##nbits(const uint8_t *frame_src,                                            \
-                                 uint8_t *frame_dst,                                            \
-                           const int width,                                                     \
-                           const int height,                                                    \
-                           int stride_src,                                                      \
-                           int stride_dst,                                                      \
-                           unsharp_plane_context_t *ctx,                                        \
-                           unsharp_thread_context_t *tctx)                                      \
+// The blur is a binomial filter of order 2 * steps in each direction.
+// Each pass over a row applies two [1 1] stages of it, right to left
+// so that the row can be updated in place.
+static void unsharp_blur_sums(uint32_t *row, int w, int steps)
+{
+    for (int z = 0; z < steps; z++)
+    {
+        for (int x = w - 1; x > 1; x--)
+        {
+            row[x] += (row[x - 1] << 1) + row[x - 2];
+        }
+        row[1] += row[0] << 1;
+    }
+}
+
+static void unsharp_blur_column(uint32_t *row, uint32_t **SC, int width, int steps)
+{
+    uint32_t Tmp1, Tmp2;
+
+    for (int x = 0; x < width; x++)
+    {
+        Tmp1 = row[x];
+        for (int z = 0; z < steps * 2; z += 2)
+        {
+            Tmp2 = SC[z + 0][x] + Tmp1; SC[z + 0][x] = Tmp1;
+            Tmp1 = SC[z + 1][x] + Tmp2; SC[z + 1][x] = Tmp2;
+        }
+        row[x] = Tmp1;
+    }
+}
+
+#define DEF_UNSHARP_FUNCS(nbits)                                                                \
+static void unsharp_blur_row_##nbits(uint32_t *row, const uint##nbits##_t *src,                 \
+                                     int width, int steps)                                      \
 {                                                                                               \
-    uint32_t **SC = tctx->SC;                                                                   \
-    uint32_t SR[UNSHARP_SIZE_MAX - 1];                                                          \
-    const uint##nbits##_t *src  = (const uint##nbits##_t *)frame_src;                           \
-    uint##nbits##_t       *dst  = (uint##nbits##_t *)frame_dst;                                 \
-    const uint##nbits##_t *src2 = (const uint##nbits##_t *)frame_src;                           \
-    const int amount        = ctx->amount;                                                      \
-    const int steps         = ctx->steps;                                                       \
-    const int scalebits     = ctx->scalebits;                                                   \
-    const int32_t halfscale = ctx->halfscale;                                                   \
-    const int16_t max_value = ctx->max_value;                                                   \
-                                                                                                \
-    int32_t res;                                                                                \
-    int x, y, z;                                                                                \
-    uint32_t Tmp1, Tmp2;                                                                        \
-                                                                                                \
-    if (!amount)                                                                                \
+    for (int x = 0; x < steps; x++)                                                             \
     {                                                                                           \
-        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);              \
-        return;                                                                                 \
+        row[x]                 = src[0];                                                        \
+        row[steps + width + x] = src[width - 1];                                                \
     }                                                                                           \
-                                                                                                \
-    for (y = 0; y < 2 * steps; y++)                                                             \
+    for (int x = 0; x < width; x++)                                                             \
     {                                                                                           \
-        memset(SC[y], 0, sizeof(SC[y][0]) * (width + 2 * steps));                               \
+        row[steps + x] = src[x];                                                                \
     }                                                                                           \
+    unsharp_blur_sums(row, width + 2 * steps, steps);                                           \
+}                                                                                               \
                                                                                                 \
-    stride_src /= ctx->bps;                                                                     \
-    stride_dst /= ctx->bps;                                                                     \
+static void unsharp_mix_row_##nbits(uint##nbits##_t *dst, const uint##nbits##_t *src,           \
+                                    const uint32_t *blur, int width, const UnsharpMix *mix)     \
+{                                                                                               \
+    const int amount         = mix->amount;                                                     \
+    const int scalebits      = mix->scalebits;                                                  \
+    const uint32_t halfscale = mix->halfscale;                                                  \
+    const int32_t min_value  = mix->min_value;                                                  \
+    const int32_t max_value  = mix->max_value;                                                  \
+    int32_t res;                                                                                \
                                                                                                 \
-    for (y = -steps; y < height + steps; y++)                                                   \
+    for (int x = 0; x < width; x++)                                                             \
     {                                                                                           \
-        if (y < height)                                                                         \
-        {                                                                                       \
-            src2 = src;                                                                         \
-        }                                                                                       \
-                                                                                                \
-        memset(SR, 0, sizeof(SR[0]) * (2 * steps));                                             \
-                                                                                                \
-        for (x = -steps; x < width + steps; x++)                                                \
-        {                                                                                       \
-            Tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width - 1] : src2[x];                   \
-                                                                                                \
-            for (z = 0; z < steps * 2; z += 2)                                                  \
-            {                                                                                   \
-                Tmp2 = SR[z + 0] + Tmp1; SR[z + 0] = Tmp1;                                      \
-                Tmp1 = SR[z + 1] + Tmp2; SR[z + 1] = Tmp2;                                      \
-            }                                                                                   \
-                                                                                                \
-            for (z = 0; z < steps * 2; z += 2)                                                  \
-            {                                                                                   \
-                Tmp2 = SC[z + 0][x + steps] + Tmp1; SC[z + 0][x + steps] = Tmp1;                \
-                Tmp1 = SC[z + 1][x + steps] + Tmp2; SC[z + 1][x + steps] = Tmp2;                \
-            }                                                                                   \
-                                                                                                \
-            if (x >= steps && y >= steps)                                                       \
-            {                                                                                   \
-                const uint##nbits##_t *srx = src - steps * stride_src + x - steps;              \
-                uint##nbits##_t       *dsx = dst - steps * stride_dst + x - steps;              \
-                                                                                                \
-                res = (int32_t)*srx + ((((int32_t)*srx -                                        \
-                     (int32_t)((Tmp1 + halfscale) >> scalebits)) * amount) >> 16);              \
-                *dsx = res > max_value ? max_value : res < 0 ? 0 : (uint##nbits##_t)res;        \
-            }                                                                                   \
-        }                                                                                       \
-                                                                                                \
-        if (y >= 0)                                                                             \
-        {                                                                                       \
-            dst += stride_dst;                                                                  \
-            src += stride_src;                                                                  \
-        }                                                                                       \
+        res = ((((int32_t)src[x] -                                                              \
+              (int32_t)((blur[x] + halfscale) >> scalebits)) * amount) >> 16);                  \
+        res = mix->smooth ? (int32_t)src[x] - res : (int32_t)src[x] + res;                      \
+        dst[x] = res > max_value ? max_value : res < min_value ? min_value : res;               \
     }                                                                                           \
 }                                                                                               \
 
-DEF_UNSHARP_FUNC(unsharp, 16)
-DEF_UNSHARP_FUNC(unsharp, 8)
+DEF_UNSHARP_FUNCS(16)
+DEF_UNSHARP_FUNCS(8)
+
+void unsharp_init_functions(UnsharpFunctions *functions, const char *name)
+{
+    functions->blur_row_8   = unsharp_blur_row_8;
+    functions->blur_row_16  = unsharp_blur_row_16;
+    functions->blur_column  = unsharp_blur_column;
+    functions->mix_row_8    = unsharp_mix_row_8;
+    functions->mix_row_16   = unsharp_mix_row_16;
+
+#if defined(ARCH_X86)
+    unsharp_init_x86(functions, name);
+#elif defined(__aarch64__)
+    unsharp_init_neon(functions, name);
+#endif
+}
+
+static void unsharp(const UnsharpFunctions *functions,
+                    const uint8_t *frame_src,
+                          uint8_t *frame_dst,
+                    const int width,
+                    const int height,
+                    const int stride_src,
+                    const int stride_dst,
+                    unsharp_plane_context_t *ctx,
+                    unsharp_thread_context_t *tctx)
+{
+    uint32_t **SC  = tctx->SC;
+    uint32_t *row  = tctx->row;
+    const int steps = ctx->steps;
+    const int w     = width + 2 * steps;
+
+    if (!ctx->mix.amount)
+    {
+        hb_image_copy_plane(frame_dst, frame_src, stride_dst, stride_src, height);
+        return;
+    }
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        memset(SC[z], 0, sizeof(SC[z][0]) * w);
+    }
+
+    // Rows above and below the frame repeat its edge rows. The result for
+    // a row is complete once the blur has seen the 'steps' rows after it.
+    for (int y = -steps; y < height + steps; y++)
+    {
+        const int ys = y < 0 ? 0 : y >= height ? height - 1 : y;
+        const uint8_t *src = frame_src + ys * stride_src;
+
+        if (ctx->bps == 1)
+        {
+            functions->blur_row_8(row, src, width, steps);
+        }
+        else
+        {
+            functions->blur_row_16(row, (const uint16_t *)src, width, steps);
+        }
+        functions->blur_column(row, SC, w, steps);
 
-#define unsharp(...)                                  \
-    switch (pv->depth)                                \
-    {                                                 \
-        case  8: unsharp_8(__VA_ARGS__); break;       \
-        default: unsharp_16(__VA_ARGS__); break;      \
-    }                                                 \
+        if (y >= steps)
+        {
+            src          = frame_src + (y - steps) * stride_src;
+            uint8_t *dst = frame_dst + (y - steps) * stride_dst;
+
+            if (ctx->bps == 1)
+            {
+                functions->mix_row_8(dst, src, row + 2 * steps, width, &ctx->mix);
+            }
+            else
+            {
+                functions->mix_row_16((uint16_t *)dst, (const uint16_t *)src,
+                                      row + 2 * steps, width, &ctx->mix);
+            }
+        }
+    }
+}
 
 static int unsharp_init(hb_filter_object_t *filter,
                         hb_filter_init_t   *init)
@@ -254,12 +307,17 @@ static int unsharp_init(hb_filter_object_t *filter,
         if (ctx->size < UNSHARP_SIZE_MIN) ctx->size = UNSHARP_SIZE_MIN;
         if (ctx->size > UNSHARP_SIZE_MAX) ctx->size = UNSHARP_SIZE_MAX;
 
-        ctx->amount    = ctx->strength * 65536.0;
-        ctx->steps     = ctx->size / 2;
-        ctx->scalebits = ctx->steps * 4;
-        ctx->halfscale = 1 << (ctx->scalebits - 1);
+        ctx->steps         = ctx->size / 2;
+        ctx->mix.amount    = ctx->strength * 65536.0;
+        ctx->mix.scalebits = ctx->steps * 4;
+        ctx->mix.halfscale = 1 << (ctx->mix.scalebits - 1);
+        ctx->mix.min_value = 0;
+        ctx->mix.max_value = ctx->max_value;
+        ctx->mix.smooth    = 0;
     }
 
+    unsharp_init_functions(&pv->functions, "Unsharp");
+
     if (unsharp_init_thread(filter, 1) < 0)
     {
         unsharp_close(filter);
@@ -285,6 +343,8 @@ static void unsharp_thread_close(hb_filter_private_t *pv)
                 free(tctx->SC[z]);
                 tctx->SC[z] = NULL;
             }
+            free(tctx->row);
+            tctx->row = NULL;
         }
     }
     free(pv->thread_ctx);
@@ -321,6 +381,12 @@ static int unsharp_init_thread(hb_filter_object_t *filter, int threads)
                     return -1;
                 }
             }
+            tctx->row = malloc(sizeof(*(tctx->row)) * (w + 2 * ctx->steps));
+            if (tctx->row == NULL)
+            {
+                hb_error("Unsharp calloc failed");
+                return -1;
+            }
         }
     }
     return 0;
@@ -366,7 +432,8 @@ static int unsharp_work_thread(hb_filter_object_t *filter,
     {
         unsharp_plane_context_t  * ctx  = &pv->plane_ctx[c];
         unsharp_thread_context_t * tctx = &pv->thread_ctx[thread][c];
-        unsharp(in->plane[c].data,
+        unsharp(&pv->functions,
+                in->plane[c].data,
                 out->plane[c].data,
                 in->plane[c].width,
                 in->plane[c].height,
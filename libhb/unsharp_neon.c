@@ -0,0 +1,198 @@
+/* unsharp_neon.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/unsharp.h"
+
+static av_always_inline void load8_u32(const void *src, int bps,
+                                       uint32x4_t *lo, uint32x4_t *hi)
+{
+    uint16x8_t v = bps == 1 ? vmovl_u8(vld1_u8((const uint8_t *)src)) :
+                              vld1q_u16((const uint16_t *)src);
+    *lo = vmovl_u16(vget_low_u16(v));
+    *hi = vmovl_u16(vget_high_u16(v));
+}
+
+static av_always_inline void blur_row_neon(uint32_t *row, const void *in_src,
+                                           int width, int steps, int bps)
+{
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    const int w = width + 2 * steps;
+    int x;
+
+    for (x = 0; x < steps; x++)
+    {
+        row[x]                 = bps == 1 ? src8[0] : src16[0];
+        row[steps + width + x] = bps == 1 ? src8[width - 1] : src16[width - 1];
+    }
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        uint32x4_t lo, hi;
+        load8_u32(src8 + x * bps, bps, &lo, &hi);
+        vst1q_u32(row + steps + x,     lo);
+        vst1q_u32(row + steps + x + 4, hi);
+    }
+    for (; x < width; x++)
+    {
+        row[steps + x] = bps == 1 ? src8[x] : src16[x];
+    }
+
+    // Two [1 1] stages per pass, right to left, see unsharp.c
+    for (int z = 0; z < steps; z++)
+    {
+        for (x = w - 4; x >= 2; x -= 4)
+        {
+            uint32x4_t a = vld1q_u32(row + x);
+            uint32x4_t b = vld1q_u32(row + x - 1);
+            uint32x4_t c = vld1q_u32(row + x - 2);
+            vst1q_u32(row + x, vaddq_u32(vaddq_u32(a, c), vshlq_n_u32(b, 1)));
+        }
+        for (x += 3; x > 1; x--)
+        {
+            row[x] += (row[x - 1] << 1) + row[x - 2];
+        }
+        row[1] += row[0] << 1;
+    }
+}
+
+static void blur_row_8_neon(uint32_t *row, const uint8_t *src,
+                            int width, int steps)
+{
+    blur_row_neon(row, src, width, steps, 1);
+}
+
+static void blur_row_16_neon(uint32_t *row, const uint16_t *src,
+                             int width, int steps)
+{
+    blur_row_neon(row, src, width, steps, 2);
+}
+
+static void blur_column_neon(uint32_t *row, uint32_t **SC,
+                             int width, int steps)
+{
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        uint32x4_t tmp1 = vld1q_u32(row + x);
+        for (int z = 0; z < steps * 2; z++)
+        {
+            uint32x4_t sc = vld1q_u32(SC[z] + x);
+            vst1q_u32(SC[z] + x, tmp1);
+            tmp1 = vaddq_u32(sc, tmp1);
+        }
+        vst1q_u32(row + x, tmp1);
+    }
+    for (; x < width; x++)
+    {
+        uint32_t tmp1 = row[x], tmp2;
+        for (int z = 0; z < steps * 2; z++)
+        {
+            tmp2 = SC[z][x] + tmp1; SC[z][x] = tmp1;
+            tmp1 = tmp2;
+        }
+        row[x] = tmp1;
+    }
+}
+
+static av_always_inline int32x4_t mix4_neon(uint32x4_t src, uint32x4_t blur,
+                                            const UnsharpMix *mix)
+{
+    const int32x4_t s = vreinterpretq_s32_u32(src);
+    int32x4_t b, d;
+
+    blur = vaddq_u32(blur, vdupq_n_u32(mix->halfscale));
+    b    = vreinterpretq_s32_u32(vshlq_u32(blur, vdupq_n_s32(-mix->scalebits)));
+    d    = vshrq_n_s32(vmulq_s32(vsubq_s32(s, b), vdupq_n_s32(mix->amount)), 16);
+    d    = mix->smooth ? vsubq_s32(s, d) : vaddq_s32(s, d);
+    d    = vmaxq_s32(d, vdupq_n_s32(mix->min_value));
+    return vminq_s32(d, vdupq_n_s32(mix->max_value));
+}
+
+static av_always_inline void mix_row_neon(void *in_dst, const void *in_src,
+                                          const uint32_t *blur, int width,
+                                          const UnsharpMix *mix, int bps)
+{
+    uint8_t        *dst8  = in_dst;
+    uint16_t       *dst16 = in_dst;
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    int32_t res;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        uint32x4_t lo, hi;
+        load8_u32(src8 + x * bps, bps, &lo, &hi);
+
+        uint16x8_t p = vcombine_u16(vqmovun_s32(mix4_neon(lo, vld1q_u32(blur + x), mix)),
+                                    vqmovun_s32(mix4_neon(hi, vld1q_u32(blur + x + 4), mix)));
+        if (bps == 1)
+        {
+            vst1_u8(dst8 + x, vqmovn_u16(p));
+        }
+        else
+        {
+            vst1q_u16(dst16 + x, p);
+        }
+    }
+    for (; x < width; x++)
+    {
+        const int32_t s = bps == 1 ? src8[x] : src16[x];
+        res = (((s - (int32_t)((blur[x] + mix->halfscale) >> mix->scalebits)) *
+                mix->amount) >> 16);
+        res = mix->smooth ? s - res : s + res;
+        res = res > mix->max_value ? mix->max_value :
+              res < mix->min_value ? mix->min_value : res;
+        if (bps == 1)
+        {
+            dst8[x] = res;
+        }
+        else
+        {
+            dst16[x] = res;
+        }
+    }
+}
+
+static void mix_row_8_neon(uint8_t *dst, const uint8_t *src,
+                           const uint32_t *blur, int width,
+                           const UnsharpMix *mix)
+{
+    mix_row_neon(dst, src, blur, width, mix, 1);
+}
+
+static void mix_row_16_neon(uint16_t *dst, const uint16_t *src,
+                            const uint32_t *blur, int width,
+                            const UnsharpMix *mix)
+{
+    mix_row_neon(dst, src, blur, width, mix, 2);
+}
+
+void unsharp_init_neon(UnsharpFunctions *functions, const char *name)
+{
+    if (av_get_cpu_flags() & AV_CPU_FLAG_NEON)
+    {
+        functions->blur_row_8  = blur_row_8_neon;
+        functions->blur_row_16 = blur_row_16_neon;
+        functions->blur_column = blur_column_neon;
+        functions->mix_row_8   = mix_row_8_neon;
+        functions->mix_row_16  = mix_row_16_neon;
+        hb_log("%s using NEON optimizations", name);
+    }
+}
+
+#endif // __aarch64__
@@ -0,0 +1,208 @@
+/* unsharp_x86.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/handbrake.h"     // needed for ARCH_X86
+
+#if defined(ARCH_X86)
+
+#include <immintrin.h>
+
+#include "libavutil/cpu.h"
+#include "handbrake/unsharp.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static av_always_inline TARGET_AVX2 __m256i load8_epi32(const void *src, int bps)
+{
+    if (bps == 1)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+    }
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)src));
+}
+
+static av_always_inline TARGET_AVX2 void store8_epi32(void *dst, __m256i v, int bps)
+{
+    __m128i p = _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                 _mm256_extracti128_si256(v, 1));
+    if (bps == 1)
+    {
+        _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(p, p));
+    }
+    else
+    {
+        _mm_storeu_si128((__m128i *)dst, p);
+    }
+}
+
+static av_always_inline TARGET_AVX2 void blur_row_avx2(uint32_t *row,
+                                                       const void *in_src,
+                                                       int width, int steps,
+                                                       int bps)
+{
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    const int w = width + 2 * steps;
+    int x;
+
+    for (x = 0; x < steps; x++)
+    {
+        row[x]                 = bps == 1 ? src8[0] : src16[0];
+        row[steps + width + x] = bps == 1 ? src8[width - 1] : src16[width - 1];
+    }
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        _mm256_storeu_si256((__m256i *)(row + steps + x),
+                            load8_epi32(src8 + x * bps, bps));
+    }
+    for (; x < width; x++)
+    {
+        row[steps + x] = bps == 1 ? src8[x] : src16[x];
+    }
+
+    // Two [1 1] stages per pass, right to left so that each block reads
+    // values that have not been updated yet by the pass
+    for (int z = 0; z < steps; z++)
+    {
+        for (x = w - 8; x >= 2; x -= 8)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(row + x));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(row + x - 1));
+            __m256i c = _mm256_loadu_si256((const __m256i *)(row + x - 2));
+            a = _mm256_add_epi32(_mm256_add_epi32(a, c), _mm256_slli_epi32(b, 1));
+            _mm256_storeu_si256((__m256i *)(row + x), a);
+        }
+        for (x += 7; x > 1; x--)
+        {
+            row[x] += (row[x - 1] << 1) + row[x - 2];
+        }
+        row[1] += row[0] << 1;
+    }
+}
+
+static TARGET_AVX2 void blur_row_8_avx2(uint32_t *row, const uint8_t *src,
+                                        int width, int steps)
+{
+    blur_row_avx2(row, src, width, steps, 1);
+}
+
+static TARGET_AVX2 void blur_row_16_avx2(uint32_t *row, const uint16_t *src,
+                                         int width, int steps)
+{
+    blur_row_avx2(row, src, width, steps, 2);
+}
+
+static TARGET_AVX2 void blur_column_avx2(uint32_t *row, uint32_t **SC,
+                                         int width, int steps)
+{
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m256i tmp1 = _mm256_loadu_si256((const __m256i *)(row + x));
+        for (int z = 0; z < steps * 2; z++)
+        {
+            __m256i sc = _mm256_loadu_si256((const __m256i *)(SC[z] + x));
+            _mm256_storeu_si256((__m256i *)(SC[z] + x), tmp1);
+            tmp1 = _mm256_add_epi32(sc, tmp1);
+        }
+        _mm256_storeu_si256((__m256i *)(row + x), tmp1);
+    }
+    for (; x < width; x++)
+    {
+        uint32_t tmp1 = row[x], tmp2;
+        for (int z = 0; z < steps * 2; z++)
+        {
+            tmp2 = SC[z][x] + tmp1; SC[z][x] = tmp1;
+            tmp1 = tmp2;
+        }
+        row[x] = tmp1;
+    }
+}
+
+static av_always_inline TARGET_AVX2 void mix_row_avx2(void *in_dst,
+                                                      const void *in_src,
+                                                      const uint32_t *blur,
+                                                      int width,
+                                                      const UnsharpMix *mix,
+                                                      int bps)
+{
+    uint8_t        *dst8  = in_dst;
+    uint16_t       *dst16 = in_dst;
+    const uint8_t  *src8  = in_src;
+    const uint16_t *src16 = in_src;
+    const __m256i halfscale = _mm256_set1_epi32(mix->halfscale);
+    const __m128i scalebits = _mm_cvtsi32_si128(mix->scalebits);
+    const __m256i amount    = _mm256_set1_epi32(mix->amount);
+    const __m256i min_value = _mm256_set1_epi32(mix->min_value);
+    const __m256i max_value = _mm256_set1_epi32(mix->max_value);
+    int32_t res;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        __m256i s = load8_epi32(src8 + x * bps, bps);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(blur + x));
+        __m256i d;
+
+        b = _mm256_srl_epi32(_mm256_add_epi32(b, halfscale), scalebits);
+        d = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(s, b), amount), 16);
+        d = mix->smooth ? _mm256_sub_epi32(s, d) : _mm256_add_epi32(s, d);
+        d = _mm256_min_epi32(_mm256_max_epi32(d, min_value), max_value);
+        store8_epi32(dst8 + x * bps, d, bps);
+    }
+    for (; x < width; x++)
+    {
+        const int32_t s = bps == 1 ? src8[x] : src16[x];
+        res = (((s - (int32_t)((blur[x] + mix->halfscale) >> mix->scalebits)) *
+                mix->amount) >> 16);
+        res = mix->smooth ? s - res : s + res;
+        res = res > mix->max_value ? mix->max_value :
+              res < mix->min_value ? mix->min_value : res;
+        if (bps == 1)
+        {
+            dst8[x] = res;
+        }
+        else
+        {
+            dst16[x] = res;
+        }
+    }
+}
+
+static TARGET_AVX2 void mix_row_8_avx2(uint8_t *dst, const uint8_t *src,
+                                       const uint32_t *blur, int width,
+                                       const UnsharpMix *mix)
+{
+    mix_row_avx2(dst, src, blur, width, mix, 1);
+}
+
+static TARGET_AVX2 void mix_row_16_avx2(uint16_t *dst, const uint16_t *src,
+                                        const uint32_t *blur, int width,
+                                        const UnsharpMix *mix)
+{
+    mix_row_avx2(dst, src, blur, width, mix, 2);
+}
+
+void unsharp_init_x86(UnsharpFunctions *functions, const char *name)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+    {
+        functions->blur_row_8  = blur_row_8_avx2;
+        functions->blur_row_16 = blur_row_16_avx2;
+        functions->blur_column = blur_column_avx2;
+        functions->mix_row_8   = mix_row_8_avx2;
+        functions->mix_row_16  = mix_row_16_avx2;
+        hb_log("%s using AVX2 optimizations", name);
+    }
+}
+
+#endif // ARCH_X86
@@ -57,7 +57,8 @@ static void hb_vfr_close( hb_filter_object_t * filter );
 static hb_filter_info_t * hb_vfr_info( hb_filter_object_t * filter );
 
 static const char hb_vfr_template[] =
-    "mode=^([012])$:rate=^"HB_RATIONAL_REG"$";
+    "mode=^([012])$:rate=^"HB_RATIONAL_REG"$:"
+    "metric-resolution=^([012])$";
 
 hb_filter_object_t hb_filter_vfr =
 {
@@ -72,7 +73,8 @@ hb_filter_object_t hb_filter_vfr =
     .settings_template = hb_vfr_template,
 };
 
-static hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init)
+static hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init,
+                                                         hb_dict_t *settings)
 {
     hb_motion_metric_object_t *metric;
     switch (init->hw_pix_fmt)
@@ -95,6 +97,7 @@ static hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init)
     }
 
     memcpy(metric_copy, metric, sizeof(hb_motion_metric_object_t));
+    metric_copy->settings = settings;
 
     if (metric_copy->init(metric_copy, init))
     {
@@ -376,7 +379,7 @@ static int hb_vfr_init(hb_filter_object_t *filter, hb_filter_init_t *init)
 
     if (pv->cfr)
     {
-        pv->metric = hb_motion_metric_init(init);
+        pv->metric = hb_motion_metric_init(init, filter->settings);
         if (pv->metric == NULL)
         {
             return -1;
@@ -11,6 +11,8 @@
 #include "handbrake/handbrake.h"
 #include "libavformat/avformat.h"
 #include "handbrake/decomb.h"
+#include "handbrake/taskset.h"
+#include "handbrake/pipeline_stats.h"
 #include "handbrake/hbavfilter.h"
 #include "handbrake/dovi_common.h"
 #include "handbrake/rpu.h"
@@ -36,6 +38,7 @@ typedef struct
 static void work_func(void * _work);
 static void do_job( hb_job_t *);
 static void filter_loop( void * );
+static void filter_chain_loop( void * );
 
 #define FIFO_UNBOUNDED 65536
 #define FIFO_UNBOUNDED_WAKE 65535
@@ -45,6 +48,8 @@ static void filter_loop( void * );
 #define FIFO_SMALL_WAKE 15
 #define FIFO_MINI 4
 #define FIFO_MINI_WAKE 3
+// Buffers a fifo may always hold when the job's memory budget is spent
+#define FIFO_RESERVE 2
 
 /**
  * Allocates work object and launches work thread with work_func.
@@ -1653,6 +1658,58 @@ static void sanitize_dynamic_hdr_metadata_passthru(hb_job_t *job)
     }
 #endif
 }
+// Links runs of consecutive fuse filters into chains that are run on
+// the thread of their first filter, and logs the resulting grouping.
+static void fuse_filters(hb_job_t *job)
+{
+    hb_filter_object_t * prev = NULL;
+    int                  ii, threads = 0;
+
+    for (ii = 0; ii < hb_list_count(job->list_filter); ii++)
+    {
+        hb_filter_object_t * filter = hb_list_item(job->list_filter, ii);
+        if (filter->skip)
+        {
+            continue;
+        }
+        if (job->filter_fuse >= 0 && prev != NULL &&
+            prev->fuse && filter->fuse)
+        {
+            prev->chain_next = filter;
+            filter->chained  = 1;
+        }
+        else
+        {
+            threads++;
+        }
+        prev = filter;
+    }
+
+    if (job->filter_fuse < 0)
+    {
+        hb_log("work: filter fusion disabled, %d filter threads", threads);
+        return;
+    }
+    for (ii = 0; ii < hb_list_count(job->list_filter); ii++)
+    {
+        hb_filter_object_t * filter = hb_list_item(job->list_filter, ii);
+        if (filter->skip || filter->chained || filter->chain_next == NULL)
+        {
+            continue;
+        }
+
+        char * names = strdup(filter->name);
+        while ((filter = filter->chain_next) != NULL)
+        {
+            char * tmp = hb_strdup_printf("%s, %s", names, filter->name);
+            free(names);
+            names = tmp;
+        }
+        hb_log("work: fused filters on one thread: %s", names);
+        free(names);
+    }
+    hb_log("work: %d filter threads", threads);
+}
 
 /**
  * Job initialization routine.
@@ -1763,6 +1820,9 @@ static void do_job(hb_job_t *job)
 
         sanitize_filter_list_post(job);
 
+        // All the tasksets of the filters share the job's pool workers
+        job->filter_budget = taskset_budget_init(job->filter_threads);
+
         memset(&init, 0, sizeof(init));
         init.time_base.num = 1;
         init.time_base.den = 90000;
@@ -1864,14 +1924,28 @@ static void do_job(hb_job_t *job)
         update_dolby_vision_level(job);
     }
 
-    job->fifo_in     = hb_fifo_init( FIFO_SMALL, FIFO_SMALL_WAKE );
-    job->fifo_raw    = hb_fifo_init( FIFO_SMALL, FIFO_SMALL_WAKE );
+    // With a memory budget, fifo capacities become upper bounds and
+    // the budget limits the bytes in flight between all work objects
+    if (job->memory_budget > 0)
+    {
+        job->fifo_budget = hb_fifo_budget_init((int64_t)job->memory_budget << 20);
+    }
+
+    // Fifos that are fed by one thread and drained by one other thread
+    // use the lock-free hb_fifo_init_spsc variant. fifo_sync can be fed
+    // by any of the sync work objects, so it keeps the locked fifo.
+    job->fifo_in     = hb_fifo_init_spsc( FIFO_SMALL, FIFO_SMALL_WAKE );
+    job->fifo_raw    = hb_fifo_init_spsc( FIFO_SMALL, FIFO_SMALL_WAKE );
+    hb_fifo_set_budget(job->fifo_in,  job->fifo_budget, FIFO_RESERVE);
+    hb_fifo_set_budget(job->fifo_raw, job->fifo_budget, FIFO_RESERVE);
     if (!job->indepth_scan)
     {
         // When doing subtitle indepth scan, the pipeline ends at sync
         job->fifo_sync   = hb_fifo_init( FIFO_SMALL, FIFO_SMALL_WAKE );
         job->fifo_render = NULL; // Attached to filter chain
-        job->fifo_out    = hb_fifo_init( FIFO_LARGE, FIFO_LARGE_WAKE );
+        job->fifo_out    = hb_fifo_init_spsc( FIFO_LARGE, FIFO_LARGE_WAKE );
+        hb_fifo_set_budget(job->fifo_sync, job->fifo_budget, FIFO_RESERVE);
+        hb_fifo_set_budget(job->fifo_out,  job->fifo_budget, FIFO_RESERVE);
     }
 
     result = sanitize_audio(job);
@@ -1891,10 +1965,14 @@ static void do_job(hb_job_t *job)
             audio = hb_list_item(job->list_audio, i);
 
             /* set up the audio work fifos */
-            audio->priv.fifo_in   = hb_fifo_init(FIFO_LARGE, FIFO_LARGE_WAKE);
-            audio->priv.fifo_raw  = hb_fifo_init(FIFO_SMALL, FIFO_SMALL_WAKE);
+            audio->priv.fifo_in   = hb_fifo_init_spsc(FIFO_LARGE, FIFO_LARGE_WAKE);
+            audio->priv.fifo_raw  = hb_fifo_init_spsc(FIFO_SMALL, FIFO_SMALL_WAKE);
             audio->priv.fifo_sync = hb_fifo_init(FIFO_SMALL, FIFO_SMALL_WAKE);
-            audio->priv.fifo_out  = hb_fifo_init(FIFO_LARGE, FIFO_LARGE_WAKE);
+            audio->priv.fifo_out  = hb_fifo_init_spsc(FIFO_LARGE, FIFO_LARGE_WAKE);
+            hb_fifo_set_budget(audio->priv.fifo_in,   job->fifo_budget, FIFO_RESERVE);
+            hb_fifo_set_budget(audio->priv.fifo_raw,  job->fifo_budget, FIFO_RESERVE);
+            hb_fifo_set_budget(audio->priv.fifo_sync, job->fifo_budget, FIFO_RESERVE);
+            hb_fifo_set_budget(audio->priv.fifo_out,  job->fifo_budget, FIFO_RESERVE);
 
             // Add audio decoder work object
             w = hb_audio_decoder(job->h, audio->config.in.codec);
@@ -1948,6 +2026,12 @@ static void do_job(hb_job_t *job)
             subtitle->fifo_sync = hb_fifo_init( FIFO_UNBOUNDED, FIFO_SMALL_WAKE );
             subtitle->fifo_out  = hb_fifo_init( FIFO_UNBOUNDED, FIFO_SMALL_WAKE);
         }
+        // For the reason above, subtitles are charged to the memory
+        // budget but are never held back by it
+        hb_fifo_set_budget(subtitle->fifo_in,   job->fifo_budget, FIFO_UNBOUNDED);
+        hb_fifo_set_budget(subtitle->fifo_raw,  job->fifo_budget, FIFO_UNBOUNDED);
+        hb_fifo_set_budget(subtitle->fifo_sync, job->fifo_budget, FIFO_UNBOUNDED);
+        hb_fifo_set_budget(subtitle->fifo_out,  job->fifo_budget, FIFO_UNBOUNDED);
 
         w->fifo_in = subtitle->fifo_in;
         w->fifo_out = subtitle->fifo_raw;
@@ -2026,14 +2110,21 @@ static void do_job(hb_job_t *job)
         if ( job->list_filter )
         {
             hb_fifo_t * fifo_in = job->fifo_sync;
+
+            fuse_filters(job);
             for (i = 0; i < hb_list_count(job->list_filter); i++)
             {
                 hb_filter_object_t * filter = hb_list_item(job->list_filter, i);
                 if (!filter->skip)
                 {
-                    filter->fifo_in = fifo_in;
-                    filter->fifo_out = hb_fifo_init(FIFO_MINI, FIFO_MINI_WAKE);
-                    fifo_in = filter->fifo_out;
+                    // Filters of a chain pass frames to each other directly
+                    filter->fifo_in = filter->chained ? NULL : fifo_in;
+                    if (filter->chain_next == NULL)
+                    {
+                        filter->fifo_out = hb_fifo_init_spsc(FIFO_MINI, FIFO_MINI_WAKE);
+                        hb_fifo_set_budget(filter->fifo_out, job->fifo_budget, FIFO_RESERVE);
+                        fifo_in = filter->fifo_out;
+                    }
                 }
             }
             job->fifo_render = fifo_in;
@@ -2101,6 +2192,26 @@ static void do_job(hb_job_t *job)
         }
     }
 
+    // Per stage profiling, when enabled with hb_set_pipeline_stats()
+    hb_pipeline_stats_t * pipeline_stats = hb_get_pipeline_stats(job->h);
+    int profile = hb_pipeline_stats_start(pipeline_stats, job);
+    for (i = 0; i < hb_list_count(job->list_work); i++)
+    {
+        w = hb_list_item(job->list_work, i);
+        w->stats = profile ? hb_pipeline_stats_add_stage(pipeline_stats,
+                                                         w->name, "work") : NULL;
+    }
+    if (job->list_filter && !job->indepth_scan)
+    {
+        for (i = 0; i < hb_list_count(job->list_filter); i++)
+        {
+            hb_filter_object_t * filter = hb_list_item(job->list_filter, i);
+            filter->stats = profile && !filter->skip ?
+                hb_pipeline_stats_add_stage(pipeline_stats,
+                                            filter->name, "filter") : NULL;
+        }
+    }
+
     /* Launch processing threads */
     for (i = 0; i < hb_list_count( job->list_work ); i++)
     {
@@ -2113,11 +2224,13 @@ static void do_job(hb_job_t *job)
         {
             hb_filter_object_t * filter = hb_list_item(job->list_filter, i);
 
-            if (!filter->skip)
+            if (!filter->skip && !filter->chained)
             {
                 // Filters were initialized earlier, so we just need
                 // to start the filter's thread
-                filter->thread = hb_thread_init(filter->name, filter_loop,
+                filter->thread = hb_thread_init(filter->name,
+                                                filter->chain_next != NULL ?
+                                                filter_chain_loop : filter_loop,
                                                 filter, HB_LOW_PRIORITY);
             }
         }
@@ -2166,6 +2279,8 @@ cleanup:
             hb_thread_close(&w->thread);
         }
     }
+    hb_pipeline_stats_stop(hb_get_pipeline_stats(job->h));
+
     while ((w = hb_list_item(job->list_work, 0)))
     {
         hb_list_rem(job->list_work, w);
@@ -2217,6 +2332,9 @@ cleanup:
         }
     }
 
+    hb_fifo_budget_close(&job->fifo_budget);
+    taskset_budget_close(&job->filter_budget);
+
     if (job->indepth_scan)
     {
         analyze_subtitle_scan(job);
@@ -2251,6 +2369,7 @@ void hb_work_loop( void * _w )
 {
     hb_work_object_t * w = _w;
     hb_buffer_t      * buf_in = NULL, * buf_out = NULL;
+    uint64_t           mark = 0;
 
     while ((w->die == NULL || !*w->die) && !*w->done &&
            w->status != HB_WORK_DONE)
@@ -2258,7 +2377,16 @@ void hb_work_loop( void * _w )
         // fifo_in == NULL means this is a data source (e.g. reader)
         if (w->fifo_in != NULL)
         {
+            if (w->stats)
+            {
+                hb_stage_stats_occupancy(w->stats, w->fifo_in);
+                mark = hb_get_time_us();
+            }
             buf_in = hb_fifo_get_wait( w->fifo_in );
+            if (w->stats)
+            {
+                mark = hb_stage_stats_mark(w->stats, HB_STAGE_STARVED, mark);
+            }
             if ( buf_in == NULL )
                 continue;
             if ( *w->done )
@@ -2273,7 +2401,20 @@ void hb_work_loop( void * _w )
         // Invalidate buf_out so that if there is no output
         // we don't try to pass along junk.
         buf_out = NULL;
+        if (w->stats)
+        {
+            hb_stage_stats_frames(w->stats, buf_in, NULL);
+            if (w->fifo_in == NULL)
+            {
+                mark = hb_get_time_us();
+            }
+        }
         w->status = w->work( w, &buf_in, &buf_out );
+        if (w->stats)
+        {
+            mark = hb_stage_stats_mark(w->stats, HB_STAGE_BUSY, mark);
+            hb_stage_stats_frames(w->stats, NULL, buf_out);
+        }
 
         copy_chapter( buf_out, buf_in );
 
@@ -2296,6 +2437,10 @@ void hb_work_loop( void * _w )
                     break;
                 }
             }
+            if (w->stats)
+            {
+                hb_stage_stats_mark(w->stats, HB_STAGE_BLOCKED, mark);
+            }
         }
         else if (w->fifo_in == NULL)
         {
@@ -2335,10 +2480,20 @@ static void filter_loop( void * _f )
 {
     hb_filter_object_t * f = _f;
     hb_buffer_t      * buf_in, * buf_out = NULL;
+    uint64_t           mark = 0;
 
     while( !*f->done && f->status != HB_FILTER_DONE )
     {
+        if (f->stats)
+        {
+            hb_stage_stats_occupancy(f->stats, f->fifo_in);
+            mark = hb_get_time_us();
+        }
         buf_in = hb_fifo_get_wait( f->fifo_in );
+        if (f->stats)
+        {
+            mark = hb_stage_stats_mark(f->stats, HB_STAGE_STARVED, mark);
+        }
         if ( buf_in == NULL )
             continue;
 
@@ -2362,7 +2517,16 @@ static void filter_loop( void * _f )
 
         buf_out = NULL;
 
+        if (f->stats)
+        {
+            hb_stage_stats_frames(f->stats, buf_in, NULL);
+        }
         f->status = f->work( f, &buf_in, &buf_out );
+        if (f->stats)
+        {
+            mark = hb_stage_stats_mark(f->stats, HB_STAGE_BUSY, mark);
+            hb_stage_stats_frames(f->stats, NULL, buf_out);
+        }
 
         if ( buf_out && f->chapter_val && f->chapter_time <= buf_out->s.start )
         {
@@ -2389,6 +2553,10 @@ static void filter_loop( void * _f )
                     break;
                 }
             }
+            if (f->stats)
+            {
+                hb_stage_stats_mark(f->stats, HB_STAGE_BLOCKED, mark);
+            }
         }
     }
     if ( buf_out )
@@ -2406,3 +2574,140 @@ static void filter_loop( void * _f )
     }
 }
 
+// Runs filter f on buf_in, then runs the rest of the chain on each
+// buffer that f outputs. Returns the buffers output by the last filter
+// of the chain.
+static hb_buffer_t * filter_chain_run( hb_filter_object_t * f,
+                                       hb_buffer_t * buf_in )
+{
+    hb_buffer_t      * buf_out = NULL, * buf;
+    hb_buffer_list_t   list;
+    uint64_t           mark = 0;
+
+    if ( f->status == HB_FILTER_DONE )
+    {
+        hb_buffer_close( &buf_in );
+        return NULL;
+    }
+
+    // Filters can drop buffers.  Remember chapter information
+    // so that it can be propagated to the next buffer
+    if ( buf_in->s.new_chap )
+    {
+        f->chapter_time = buf_in->s.start;
+        f->chapter_val = buf_in->s.new_chap;
+        buf_in->s.new_chap = 0;
+    }
+
+    if (f->stats)
+    {
+        hb_stage_stats_frames(f->stats, buf_in, NULL);
+        mark = hb_get_time_us();
+    }
+    f->status = f->work( f, &buf_in, &buf_out );
+    if (f->stats)
+    {
+        hb_stage_stats_mark(f->stats, HB_STAGE_BUSY, mark);
+        hb_stage_stats_frames(f->stats, NULL, buf_out);
+    }
+
+    if ( buf_out && f->chapter_val && f->chapter_time <= buf_out->s.start )
+    {
+        buf_out->s.new_chap = f->chapter_val;
+        f->chapter_val = 0;
+    }
+
+    if( buf_in )
+    {
+        hb_buffer_close( &buf_in );
+    }
+    if ( f->chain_next == NULL )
+    {
+        return buf_out;
+    }
+
+    hb_buffer_list_clear( &list );
+    while ( ( buf = buf_out ) != NULL )
+    {
+        buf_out   = buf->next;
+        buf->next = NULL;
+        hb_buffer_list_append( &list, filter_chain_run( f->chain_next, buf ) );
+    }
+    return hb_buffer_list_clear( &list );
+}
+
+/**
+ * Performs the work functions of a chain of fused filters.
+ * Each frame taken from the first filter's input fifo is run through
+ * every filter of the chain on this thread before the result is pushed
+ * to the last filter's output fifo.
+ * Exits loop when the last filter of the chain is done.
+ * @param _f Handle to the first filter object of the chain.
+ */
+static void filter_chain_loop( void * _f )
+{
+    hb_filter_object_t * f = _f, * last = f;
+    hb_buffer_t        * buf_in, * buf_out = NULL;
+    uint64_t             mark = 0;
+
+    while ( last->chain_next != NULL )
+    {
+        last = last->chain_next;
+    }
+
+    while( !*f->done && last->status != HB_FILTER_DONE )
+    {
+        if (f->stats)
+        {
+            hb_stage_stats_occupancy(f->stats, f->fifo_in);
+            mark = hb_get_time_us();
+        }
+        buf_in = hb_fifo_get_wait( f->fifo_in );
+        if (f->stats)
+        {
+            hb_stage_stats_mark(f->stats, HB_STAGE_STARVED, mark);
+        }
+        if ( buf_in == NULL )
+            continue;
+        if ( *f->done )
+        {
+            hb_buffer_close( &buf_in );
+            break;
+        }
+
+        buf_out = filter_chain_run( f, buf_in );
+        if( buf_out )
+        {
+            if (last->stats)
+            {
+                mark = hb_get_time_us();
+            }
+            while ( !*f->done )
+            {
+                if ( hb_fifo_full_wait( last->fifo_out ) )
+                {
+                    hb_fifo_push( last->fifo_out, buf_out );
+                    buf_out = NULL;
+                    break;
+                }
+            }
+            if (last->stats)
+            {
+                hb_stage_stats_mark(last->stats, HB_STAGE_BLOCKED, mark);
+            }
+        }
+    }
+    if ( buf_out )
+    {
+        hb_buffer_close( &buf_out );
+    }
+
+    // Consume data in incoming fifo till job complete so that
+    // residual data does not stall the pipeline
+    while( !*f->done )
+    {
+        buf_in = hb_fifo_get_wait( f->fifo_in );
+        if ( buf_in != NULL )
+            hb_buffer_close( &buf_in );
+    }
+}
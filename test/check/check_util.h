@@ -0,0 +1,31 @@
+/* check_util.h
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Helpers shared by the programs in test/check. Each of them is a single
+ * translation unit, so the state below is private to each program.
+ */
+
+#ifndef HANDBRAKE_CHECK_UTIL_H
+#define HANDBRAKE_CHECK_UTIL_H
+
+#include <stdint.h>
+
+static uint32_t check_rand_state = 0x12345678;
+
+// xorshift32, the same sequence on every run
+static inline uint32_t check_rand( void )
+{
+    check_rand_state ^= check_rand_state << 13;
+    check_rand_state ^= check_rand_state >> 17;
+    check_rand_state ^= check_rand_state << 5;
+    return check_rand_state;
+}
+
+#endif // HANDBRAKE_CHECK_UTIL_H
@@ -0,0 +1,169 @@
+/* lapsharp_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Checks that the SIMD row kernels of the lapsharp filter (AVX2 on x86,
+ * NEON on aarch64) produce exactly the same rows as the scalar kernels,
+ * for random planes and random 3x3 and 5x5 kernels.
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/lapsharp.h"
+#include "libavutil/cpu.h"
+#include "check_util.h"
+
+#define CHECK_BORDER 2     // neighbourhood of the largest kernel, 5x5
+
+static void sharpen_plane( const LapsharpFunctions *functions,
+                           const uint8_t *src, uint8_t *dst,
+                           int width, int height, int stride, int bps,
+                           const int *kernel, int size, double coef,
+                           double strength, int max_value )
+{
+    for (int y = 0; y < height; y++)
+    {
+        if (bps == 1)
+        {
+            functions->sharpen_row_8(dst + y * stride, src + y * stride,
+                                     stride, width, kernel, size,
+                                     coef, strength, max_value);
+        }
+        else
+        {
+            functions->sharpen_row_16((uint16_t *)(dst + y * stride),
+                                      (const uint16_t *)(src + y * stride),
+                                      stride / 2, width, kernel, size,
+                                      coef, strength, max_value);
+        }
+    }
+}
+
+static int check_plane( const LapsharpFunctions *ref,
+                        const LapsharpFunctions *test,
+                        int width, int height, int depth,
+                        const int *kernel, int size, double coef,
+                        double strength )
+{
+    const int bps    = depth > 8 ? 2 : 1;
+    const int stride = (width + 2 * CHECK_BORDER) * bps;
+    const int bh     = height + 2 * CHECK_BORDER;
+    const int offset = CHECK_BORDER * stride + CHECK_BORDER * bps;
+    const int max_value = (1 << depth) - 1;
+    uint8_t *src = malloc(stride * bh);
+    uint8_t *dst[2];
+    int ret = 0;
+
+    for (int i = 0; i < stride * bh / bps; i++)
+    {
+        const uint32_t v = check_rand() % (max_value + 1);
+        if (bps == 1)
+        {
+            src[i] = v;
+        }
+        else
+        {
+            ((uint16_t *)src)[i] = v;
+        }
+    }
+    for (int ii = 0; ii < 2; ii++)
+    {
+        dst[ii] = malloc(stride * bh);
+        memset(dst[ii], 0x5a, stride * bh);
+        sharpen_plane(ii ? test : ref, src + offset, dst[ii] + offset,
+                      width, height, stride, bps, kernel, size,
+                      coef, strength, max_value);
+    }
+    if (memcmp(dst[0], dst[1], stride * bh))
+    {
+        ret = 1;
+    }
+
+    free(src);
+    free(dst[0]);
+    free(dst[1]);
+    return ret;
+}
+
+static int check_depth( const LapsharpFunctions *ref,
+                        const LapsharpFunctions *test, int depth )
+{
+    static const int    widths[]    = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100 };
+    static const int    sizes[]     = { 3, 5 };
+    static const int    sums[]      = { 1, 5, 15 };
+    static const double strengths[] = { 0.2, 0.5, 1.5 };
+    int kernel[25];
+    int count = 0;
+
+    for (int is = 0; is < sizeof(sizes) / sizeof(sizes[0]); is++)
+    {
+        const int size   = sizes[is];
+        const int center = size * size / 2;
+
+        for (int isum = 0; isum < sizeof(sums) / sizeof(sums[0]); isum++)
+        {
+            const double coef = 1.0 / sums[isum];
+
+            // Shaped like the kernels of lapsharp.c, negative weights around
+            // a center that makes the kernel sum to 1 / coef, and small
+            // enough for the 8-bit sums to stay within int16_t
+            kernel[center] = sums[isum];
+            for (int i = 0; i < size * size; i++)
+            {
+                if (i != center)
+                {
+                    kernel[i] = -(int)(check_rand() % (size == 3 ? 5 : 3));
+                    kernel[center] -= kernel[i];
+                }
+            }
+
+            for (int ist = 0; ist < sizeof(strengths) / sizeof(strengths[0]); ist++)
+            {
+                for (int iw = 0; iw < sizeof(widths) / sizeof(widths[0]); iw++)
+                {
+                    if (check_plane(ref, test, widths[iw], 3, depth, kernel,
+                                    size, coef, strengths[ist]))
+                    {
+                        fprintf(stderr, "depth %d, size %d, sum %d, strength %.2f, width %d: FAILED\n",
+                                depth, size, sums[isum], strengths[ist], widths[iw]);
+                        return 1;
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+    fprintf(stderr, "depth %d: %d planes match\n", depth, count);
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    static const int depths[] = { 8, 10, 12, 16 };
+    const int cpu_flags = av_get_cpu_flags();
+    LapsharpFunctions ref, test;
+    int ret = 0;
+
+    av_force_cpu_flags(0);
+    lapsharp_init_functions(&ref);
+    av_force_cpu_flags(cpu_flags);
+    lapsharp_init_functions(&test);
+    av_force_cpu_flags(-1);
+
+    if (!memcmp(&ref, &test, sizeof(test)))
+    {
+        fprintf(stderr, "lapsharp: no SIMD kernels to check\n");
+        return 0;
+    }
+    for (int id = 0; id < sizeof(depths) / sizeof(depths[0]) && ret == 0; id++)
+    {
+        ret = check_depth(&ref, &test, depths[id]);
+    }
+
+    return ret;
+}
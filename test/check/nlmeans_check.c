@@ -0,0 +1,349 @@
+/* nlmeans_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Checks that the SIMD kernels of the NLMeans filter produce exactly the
+ * same integral images and pixel sums as the scalar kernels.
+ *
+ * Random planes are run through the displacement loop of nlmeans_plane and
+ * nlmeans_plane_fast once with the scalar kernels and once for each
+ * instruction set tier the cpu supports, and the results are compared
+ * with memcmp. Returns non zero on the first mismatch.
+ */
+
+#include <math.h>
+#include "handbrake/handbrake.h"
+#include "handbrake/nlmeans.h"
+#include "libavutil/cpu.h"
+#include "check_util.h"
+
+typedef struct
+{
+    void *mem;
+    void *image;
+    int   w;
+    int   h;
+    int   border;
+} check_plane_t;
+
+typedef struct
+{
+    float        exptable[NLMEANS_EXPSIZE];
+    float        weight_fact_table;
+    int          diff_max;
+    NLMeansFixed fixed;
+} check_params_t;
+
+// Allocates a plane with a border like nlmeans_alloc and fills all
+// of it, border included, with random pixels
+static void plane_init( check_plane_t *plane, int w, int h, int n, int depth )
+{
+    const int bps    = depth > 8 ? 2 : 1;
+    const int border = ((n + 2) / 2 + 15) / 16 * 16;
+    const int bw     = w + 2 * border;
+    const int bh     = h + 2 * border;
+    const uint32_t max_value = (1 << depth) - 1;
+
+    plane->mem    = malloc(bw * bh * bps);
+    plane->image  = (uint8_t *)plane->mem + (border + bw * border) * bps;
+    plane->w      = w;
+    plane->h      = h;
+    plane->border = border;
+
+    for (int i = 0; i < bw * bh; i++)
+    {
+        const uint32_t v = check_rand() % (max_value + 1);
+        if (bps == 2)
+        {
+            ((uint16_t *)plane->mem)[i] = v;
+        }
+        else
+        {
+            ((uint8_t *)plane->mem)[i] = v;
+        }
+    }
+}
+
+static void plane_close( check_plane_t *plane )
+{
+    free(plane->mem);
+    plane->mem = plane->image = NULL;
+}
+
+// Same derivation as nlmeans_init and nlmeans_init_fixed, for a
+// single frame and the default strength and origin tune
+static void params_init( check_params_t *p, int n, int r, int depth )
+{
+    const uint32_t max_value = (1 << depth) - 1;
+    const float strength = 6 * (depth > 8 ? (depth - 8) * (depth - 8) : 1);
+    const float weight_factor       = 1.0 / n / n / (strength * strength);
+    const float min_weight_in_table = 0.0005;
+    const float stretch             = NLMEANS_EXPSIZE / (-log(min_weight_in_table));
+
+    p->weight_fact_table = weight_factor * stretch;
+    p->diff_max          = NLMEANS_EXPSIZE / p->weight_fact_table;
+    for (int i = 0; i < NLMEANS_EXPSIZE; i++)
+    {
+        p->exptable[i] = exp(-i / stretch);
+    }
+    p->exptable[NLMEANS_EXPSIZE - 1] = 0;
+
+    NLMeansFixed *fixed = &p->fixed;
+    const uint64_t sq_max = (uint64_t)max_value * max_value;
+    fixed->sq_shift = 0;
+    while (n * n * ((sq_max + ((1 << fixed->sq_shift) >> 1)) >> fixed->sq_shift) > UINT16_MAX)
+    {
+        fixed->sq_shift++;
+    }
+
+    const uint64_t terms   = (uint64_t)r * r;
+    const uint64_t sum_max = UINT32_MAX / max_value;
+    fixed->weight_bits = 15;
+    while (fixed->weight_bits > 0 && (terms << fixed->weight_bits) > sum_max)
+    {
+        fixed->weight_bits--;
+    }
+
+    const double one = 1 << fixed->weight_bits;
+    for (int i = 0; i < NLMEANS_EXPSIZE; i++)
+    {
+        fixed->exptable[i] = lrint(p->exptable[i] * one);
+    }
+    fixed->origin   = lrint(one);
+    fixed->fact     = lrint(p->weight_fact_table * (1 << fixed->sq_shift) * 65536.);
+    fixed->diff_max = MIN(p->diff_max >> fixed->sq_shift, UINT16_MAX + 1);
+}
+
+// Compares the part of two integral images that the accumulate kernels
+// read, the zero row and column before the image included
+static int integral_equal( const void *a, const void *b, int stride,
+                           int dst_w, int dst_h, int n, int size )
+{
+    for (int y = -1; y < dst_h + n; y++)
+    {
+        const int offset = (y * stride - 1) * size;
+        if (memcmp((const uint8_t *)a + offset,
+                   (const uint8_t *)b + offset, (dst_w + n + 1) * size))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Runs every displacement of the search window with both kernel sets
+static int check_plane( const NLMeansFunctions *ref,
+                        const NLMeansFunctions *test,
+                        const check_plane_t *src,
+                        const check_plane_t *compare,
+                        const check_params_t *p,
+                        int n, int r, int depth )
+{
+    const int bps    = depth > 8 ? 2 : 1;
+    const int r_half = (r - 1) / 2;
+    const int dst_w  = src->w;
+    const int dst_h  = src->h;
+    const int w      = src->w;
+    const int border = src->border;
+    const int bw     = w + 2 * border;
+    const int size   = dst_w * dst_h;
+    int ret = 0;
+
+    struct PixelSum *sums[2];
+    uint32_t        *weight_sum[2];
+    uint32_t        *pixel_sum[2];
+    uint32_t        *integral_mem[2];
+    uint16_t        *integral_fast_mem[2];
+    uint32_t        *integral[2];
+    uint16_t        *integral_fast[2];
+
+    const int integral_stride = ((dst_w + n + 15) / 16 * 16) + 2 * 16;
+    for (int ii = 0; ii < 2; ii++)
+    {
+        sums[ii]              = calloc(size, sizeof(struct PixelSum));
+        weight_sum[ii]        = calloc(size, sizeof(uint32_t));
+        pixel_sum[ii]         = calloc(size, sizeof(uint32_t));
+        integral_mem[ii]      = calloc(integral_stride * (dst_h + n + 1), sizeof(uint32_t));
+        integral_fast_mem[ii] = calloc(integral_stride * (dst_h + n + 1), sizeof(uint16_t));
+        integral[ii]          = integral_mem[ii] + integral_stride + 16;
+        integral_fast[ii]     = integral_fast_mem[ii] + integral_stride + 16;
+    }
+
+    for (int dy = -r_half; dy <= r_half && ret == 0; dy++)
+    {
+        for (int dx = -r_half; dx <= r_half && ret == 0; dx++)
+        {
+            const uint8_t *row = (const uint8_t *)compare->image + (dy * bw + dx) * bps;
+
+            for (int ii = 0; ii < 2; ii++)
+            {
+                const NLMeansFunctions *functions = ii ? test : ref;
+
+                functions->build_integral(integral[ii], integral_stride,
+                                          src->image, src->image,
+                                          compare->image, compare->image,
+                                          w, border, dst_w, dst_h, dx, dy, n);
+                functions->build_integral_fast(integral_fast[ii], integral_stride,
+                                               src->image, compare->image,
+                                               bw, dst_w, dst_h, dx, dy, n,
+                                               p->fixed.sq_shift);
+
+                for (int y = 0; y < dst_h; y++)
+                {
+                    const int offset1 = (y     - 1) * integral_stride - 1;
+                    const int offset2 = (y + n - 1) * integral_stride - 1;
+
+                    functions->accumulate(sums[ii] + y * dst_w,
+                                          integral[ii] + offset1,
+                                          integral[ii] + offset2,
+                                          row + y * bw * bps,
+                                          n, dst_w,
+                                          p->exptable,
+                                          p->weight_fact_table,
+                                          p->diff_max);
+                    functions->accumulate_fast(weight_sum[ii] + y * dst_w,
+                                               pixel_sum[ii]  + y * dst_w,
+                                               integral_fast[ii] + offset1,
+                                               integral_fast[ii] + offset2,
+                                               row + y * bw * bps,
+                                               n, dst_w, &p->fixed);
+                }
+            }
+
+            if (!integral_equal(integral[0], integral[1], integral_stride,
+                                dst_w, dst_h, n, sizeof(uint32_t)))
+            {
+                fprintf(stderr, "build_integral differs at dx %d dy %d\n", dx, dy);
+                ret = 1;
+            }
+            else if (!integral_equal(integral_fast[0], integral_fast[1], integral_stride,
+                                     dst_w, dst_h, n, sizeof(uint16_t)))
+            {
+                fprintf(stderr, "build_integral_fast differs at dx %d dy %d\n", dx, dy);
+                ret = 1;
+            }
+        }
+    }
+
+    if (ret == 0 && memcmp(sums[0], sums[1], size * sizeof(struct PixelSum)))
+    {
+        fprintf(stderr, "accumulate differs\n");
+        ret = 1;
+    }
+    if (ret == 0 && (memcmp(weight_sum[0], weight_sum[1], size * sizeof(uint32_t)) ||
+                     memcmp(pixel_sum[0],  pixel_sum[1],  size * sizeof(uint32_t))))
+    {
+        fprintf(stderr, "accumulate_fast differs\n");
+        ret = 1;
+    }
+
+    for (int ii = 0; ii < 2; ii++)
+    {
+        free(sums[ii]);
+        free(weight_sum[ii]);
+        free(pixel_sum[ii]);
+        free(integral_mem[ii]);
+        free(integral_fast_mem[ii]);
+    }
+    return ret;
+}
+
+static int check_functions( const NLMeansFunctions *ref,
+                            const NLMeansFunctions *test, int depth )
+{
+    static const int patch_sizes[] = { 1, 3, 5, 7, 9 };
+    static const int ranges[]      = { 1, 3, 5, 7 };
+    static const int widths[]      = { 1, 2, 3, 5, 8, 13, 16, 17, 31, 32, 33, 47, 64, 65, 100 };
+    static const int heights[]     = { 1, 5, 16 };
+    int count = 0;
+
+    for (int in = 0; in < sizeof(patch_sizes) / sizeof(patch_sizes[0]); in++)
+    {
+        for (int ir = 0; ir < sizeof(ranges) / sizeof(ranges[0]); ir++)
+        {
+            const int n = patch_sizes[in];
+            const int r = ranges[ir];
+            check_params_t params;
+
+            params_init(&params, n, r, depth);
+
+            for (int iw = 0; iw < sizeof(widths) / sizeof(widths[0]); iw++)
+            {
+                for (int ih = 0; ih < sizeof(heights) / sizeof(heights[0]); ih++)
+                {
+                    check_plane_t src, compare;
+                    const int w = widths[iw];
+                    const int h = heights[ih];
+
+                    plane_init(&src, w, h, n, depth);
+                    plane_init(&compare, w, h, n, depth);
+
+                    const int ret = check_plane(ref, test, &src, &compare,
+                                                &params, n, r, depth);
+                    plane_close(&src);
+                    plane_close(&compare);
+                    if (ret)
+                    {
+                        fprintf(stderr, "depth %d, patch %d, range %d, %dx%d: FAILED\n",
+                                depth, n, r, w, h);
+                        return 1;
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+    fprintf(stderr, "depth %d: %d planes match\n", depth, count);
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    static const int depths[] = { 8, 10, 12 };
+    const int cpu_flags = av_get_cpu_flags();
+
+    // Each tier disables the instruction sets above it so that every
+    // kernel the cpu can run is checked, not only the fastest
+    const int tiers[] =
+    {
+        cpu_flags,
+        cpu_flags & ~AV_CPU_FLAG_AVX512,
+        cpu_flags & ~(AV_CPU_FLAG_AVX512 | AV_CPU_FLAG_AVX2),
+    };
+    int ret = 0;
+
+    for (int id = 0; id < sizeof(depths) / sizeof(depths[0]) && ret == 0; id++)
+    {
+        NLMeansFunctions ref, prev;
+        const int depth = depths[id];
+
+        av_force_cpu_flags(0);
+        nlmeans_init_functions(&ref, depth);
+        prev = ref;
+
+        for (int it = 0; it < sizeof(tiers) / sizeof(tiers[0]) && ret == 0; it++)
+        {
+            NLMeansFunctions test;
+
+            av_force_cpu_flags(tiers[it]);
+            nlmeans_init_functions(&test, depth);
+            if (!memcmp(&test, &ref, sizeof(test)) ||
+                !memcmp(&test, &prev, sizeof(test)))
+            {
+                continue;
+            }
+            fprintf(stderr, "nlmeans: checking cpu flags 0x%x\n", tiers[it]);
+            ret = check_functions(&ref, &test, depth);
+            prev = test;
+        }
+    }
+    av_force_cpu_flags(-1);
+
+    return ret;
+}
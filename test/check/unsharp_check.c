@@ -0,0 +1,295 @@
+/* unsharp_check.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/*
+ * Checks the row kernels shared by the unsharp and chroma smooth filters.
+ *
+ * Random planes are filtered with the scalar kernels and with the SIMD
+ * kernels the cpu supports (AVX2 on x86, NEON on aarch64), using the row
+ * loop of unsharp(). Both results must be identical to a reference that
+ * filters the plane in the single pass the filters used before they were
+ * split into row kernels.
+ *
+ * At 16 bits the old code kept its clamp limits in int16_t, which turned
+ * nearly every output pixel into the maximum value. The kernels clamp to
+ * the real limits, and so does the reference.
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/unsharp.h"
+#include "libavutil/cpu.h"
+#include "check_util.h"
+
+#define CHECK_STEPS_MAX 7
+
+static uint32_t get_pixel( const uint8_t *row, int x, int bps )
+{
+    return bps == 1 ? row[x] : ((const uint16_t *)row)[x];
+}
+
+static void put_pixel( uint8_t *row, int x, int bps, uint32_t v )
+{
+    if (bps == 1)
+    {
+        row[x] = v;
+    }
+    else
+    {
+        ((uint16_t *)row)[x] = v;
+    }
+}
+
+// The row loop of unsharp() and chroma_smooth()
+static void filter_plane( const UnsharpFunctions *functions,
+                          const uint8_t *frame_src, uint8_t *frame_dst,
+                          int width, int height, int stride, int bps,
+                          int steps, const UnsharpMix *mix )
+{
+    const int w = width + 2 * steps;
+    uint32_t *SC[2 * CHECK_STEPS_MAX];
+    uint32_t *row = malloc(sizeof(*row) * w);
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        SC[z] = calloc(w, sizeof(*SC[z]));
+    }
+
+    for (int y = -steps; y < height + steps; y++)
+    {
+        const int ys = y < 0 ? 0 : y >= height ? height - 1 : y;
+        const uint8_t *src = frame_src + ys * stride;
+
+        if (bps == 1)
+        {
+            functions->blur_row_8(row, src, width, steps);
+        }
+        else
+        {
+            functions->blur_row_16(row, (const uint16_t *)src, width, steps);
+        }
+        functions->blur_column(row, SC, w, steps);
+
+        if (y >= steps)
+        {
+            src          = frame_src + (y - steps) * stride;
+            uint8_t *dst = frame_dst + (y - steps) * stride;
+
+            if (bps == 1)
+            {
+                functions->mix_row_8(dst, src, row + 2 * steps, width, mix);
+            }
+            else
+            {
+                functions->mix_row_16((uint16_t *)dst, (const uint16_t *)src,
+                                      row + 2 * steps, width, mix);
+            }
+        }
+    }
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        free(SC[z]);
+    }
+    free(row);
+}
+
+// The filters before they were split into row kernels, with int32_t limits
+static void reference_plane( const uint8_t *frame_src, uint8_t *frame_dst,
+                             int width, int height, int stride, int bps,
+                             int steps, const UnsharpMix *mix )
+{
+    uint32_t *SC[2 * CHECK_STEPS_MAX];
+    uint32_t SR[2 * CHECK_STEPS_MAX];
+    const uint8_t *src  = frame_src;
+    const uint8_t *src2 = frame_src;
+    uint8_t       *dst  = frame_dst;
+    uint32_t Tmp1, Tmp2;
+    int32_t res;
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        SC[z] = calloc(width + 2 * steps, sizeof(*SC[z]));
+    }
+
+    for (int y = -steps; y < height + steps; y++)
+    {
+        if (y < height)
+        {
+            src2 = src;
+        }
+
+        memset(SR, 0, sizeof(SR[0]) * (2 * steps));
+
+        for (int x = -steps; x < width + steps; x++)
+        {
+            Tmp1 = get_pixel(src2, x <= 0 ? 0 : x >= width ? width - 1 : x, bps);
+
+            for (int z = 0; z < steps * 2; z += 2)
+            {
+                Tmp2 = SR[z + 0] + Tmp1; SR[z + 0] = Tmp1;
+                Tmp1 = SR[z + 1] + Tmp2; SR[z + 1] = Tmp2;
+            }
+
+            for (int z = 0; z < steps * 2; z += 2)
+            {
+                Tmp2 = SC[z + 0][x + steps] + Tmp1; SC[z + 0][x + steps] = Tmp1;
+                Tmp1 = SC[z + 1][x + steps] + Tmp2; SC[z + 1][x + steps] = Tmp2;
+            }
+
+            if (x >= steps && y >= steps)
+            {
+                const int32_t s = get_pixel(src - steps * stride, x - steps, bps);
+
+                res = (((s - (int32_t)((Tmp1 + mix->halfscale) >> mix->scalebits)) *
+                        mix->amount) >> 16);
+                res = mix->smooth ? s - res : s + res;
+                res = res > mix->max_value ? mix->max_value :
+                      res < mix->min_value ? mix->min_value : res;
+                put_pixel(dst - steps * stride, x - steps, bps, res);
+            }
+        }
+
+        if (y >= 0)
+        {
+            dst += stride;
+            src += stride;
+        }
+    }
+
+    for (int z = 0; z < 2 * steps; z++)
+    {
+        free(SC[z]);
+    }
+}
+
+static int check_plane( const UnsharpFunctions *ref,
+                        const UnsharpFunctions *test,
+                        int width, int height, int depth,
+                        int steps, const UnsharpMix *mix )
+{
+    const int bps    = depth > 8 ? 2 : 1;
+    const int stride = (width + 7) * bps;       // padding the kernels must not touch
+    const int size   = stride * height;
+    const uint32_t max_value = (1 << depth) - 1;
+    uint8_t *src = malloc(size);
+    uint8_t *dst[3];
+    int ret = 0;
+
+    for (int x = 0; x < width + 7; x++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            put_pixel(src + y * stride, x, bps, check_rand() % (max_value + 1));
+        }
+    }
+    for (int ii = 0; ii < 3; ii++)
+    {
+        dst[ii] = malloc(size);
+        memset(dst[ii], 0x5a, size);
+    }
+
+    reference_plane(src, dst[0], width, height, stride, bps, steps, mix);
+    filter_plane(ref, src, dst[1], width, height, stride, bps, steps, mix);
+    if (memcmp(dst[0], dst[1], size))
+    {
+        fprintf(stderr, "scalar kernels differ from the reference\n");
+        ret = 1;
+    }
+    else if (test != NULL)
+    {
+        filter_plane(test, src, dst[2], width, height, stride, bps, steps, mix);
+        if (memcmp(dst[0], dst[2], size))
+        {
+            fprintf(stderr, "SIMD kernels differ from the reference\n");
+            ret = 1;
+        }
+    }
+
+    free(src);
+    for (int ii = 0; ii < 3; ii++)
+    {
+        free(dst[ii]);
+    }
+    return ret;
+}
+
+static int check_depth( const UnsharpFunctions *ref,
+                        const UnsharpFunctions *test, int depth )
+{
+    static const int widths[]     = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100 };
+    static const int heights[]    = { 1, 2, 7, 20 };
+    // (src - blur) * amount must fit in 32 bits, as in the filters
+    const double strengths[]      = { 0.25, depth > 14 ? 0.49 : 1.5 };
+    int count = 0;
+
+    for (int smooth = 0; smooth < 2; smooth++)
+    {
+        for (int is = 0; is < sizeof(strengths) / sizeof(strengths[0]); is++)
+        {
+            for (int steps = 1; steps <= CHECK_STEPS_MAX; steps++)
+            {
+                // Limits of unsharp_init and chroma_smooth_init
+                const int max = 1 << depth;
+                UnsharpMix mix;
+
+                mix.amount    = strengths[is] * 65536.0;
+                mix.scalebits = steps * 4;
+                mix.halfscale = 1 << (mix.scalebits - 1);
+                mix.min_value = smooth ? max / 16 : 0;
+                mix.max_value = smooth ? max - max / 16 : max - 1;
+                mix.smooth    = smooth;
+
+                for (int iw = 0; iw < sizeof(widths) / sizeof(widths[0]); iw++)
+                {
+                    for (int ih = 0; ih < sizeof(heights) / sizeof(heights[0]); ih++)
+                    {
+                        if (check_plane(ref, test, widths[iw], heights[ih],
+                                        depth, steps, &mix))
+                        {
+                            fprintf(stderr, "%s, depth %d, strength %.2f, size %d, %dx%d: FAILED\n",
+                                    smooth ? "chroma smooth" : "unsharp", depth,
+                                    strengths[is], 2 * steps + 1,
+                                    widths[iw], heights[ih]);
+                            return 1;
+                        }
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+    fprintf(stderr, "depth %d: %d planes match\n", depth, count);
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    static const int depths[] = { 8, 10, 12, 14, 16 };
+    const int cpu_flags = av_get_cpu_flags();
+    UnsharpFunctions ref, test;
+    int ret = 0;
+
+    av_force_cpu_flags(0);
+    unsharp_init_functions(&ref, "unsharp check");
+    av_force_cpu_flags(cpu_flags);
+    unsharp_init_functions(&test, "unsharp check");
+    av_force_cpu_flags(-1);
+
+    if (!memcmp(&ref, &test, sizeof(test)))
+    {
+        fprintf(stderr, "unsharp: no SIMD kernels, checking the scalar kernels only\n");
+    }
+    for (int id = 0; id < sizeof(depths) / sizeof(depths[0]) && ret == 0; id++)
+    {
+        ret = check_depth(&ref, memcmp(&ref, &test, sizeof(test)) ? &test : NULL,
+                          depths[id]);
+    }
+
+    return ret;
+}
@@ -351,6 +351,8 @@ static volatile int job_running = 0;
 
 void EventLoop(hb_handle_t *h, hb_dict_t *preset_dict)
 {
+    int state_serial = 0;
+
     /* Wait... */
     work_done = 0;
     while (!die && !work_done)
@@ -433,7 +435,7 @@ void EventLoop(hb_handle_t *h, hb_dict_t *preset_dict)
             }
         }
 #endif
-        hb_snooze(200);
+        state_serial = hb_state_wait(h, state_serial, 200, NULL);
 
         HandleEvents( h, preset_dict );
     }